@@ -98,6 +98,7 @@ _poppler_document_new_from_pdfdoc (PDFDoc  *newDoc,
   document->output_dev = new SplashOutputDev(splashModeRGB8, 4, gFalse, white);
 #endif
   document->output_dev->startDoc(document->doc->getXRef ());
+  document->text_index = NULL;
 
   return document;
 }
@@ -227,6 +228,10 @@ poppler_document_finalize (GObject *object)
   PopplerDocument *document = POPPLER_DOCUMENT (object);
 
   delete document->output_dev;
+#if defined (HAVE_CAIRO)
+  gfree (document->render_buffer);
+#endif
+  delete document->text_index;
   delete document->doc;
 }
 
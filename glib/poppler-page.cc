@@ -234,44 +234,116 @@ poppler_page_get_transition (PopplerPage *page)
 
 #if defined (HAVE_CAIRO)
 
+static inline guint32
+argb_to_rgba (guint32 p)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  return (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+#else
+  return (p << 8) | (p >> 24);
+#endif
+}
+
+/* Converts @height rows of @width native-endian ARGB32 pixels (as
+ * written by cairo) to the RGB or RGBA byte order of GdkPixbuf.  @src
+ * and @dst may point to the same memory. */
+static void
+convert_argb_to_pixbuf (const guchar *src, int src_rowstride,
+			guchar *dst, int dst_rowstride, int n_channels,
+			int width, int height)
+{
+  const guint32 *s;
+  guint32 *d;
+  guchar *p;
+  int x, y;
+
+  for (y = 0; y < height; y++)
+    {
+      s = (const guint32 *) (src + y * src_rowstride);
+      if (n_channels == 4)
+        {
+	  /* one word per pixel -- simple enough for the compiler to
+	   * vectorize */
+	  d = (guint32 *) (dst + y * dst_rowstride);
+	  for (x = 0; x < width; x++)
+	    d[x] = argb_to_rgba (s[x]);
+	}
+      else
+        {
+	  p = dst + y * dst_rowstride;
+	  for (x = 0; x < width; x++)
+	    {
+	      p[0] = (s[x] >> 16) & 0xff;
+	      p[1] = (s[x] >> 8) & 0xff;
+	      p[2] = s[x] & 0xff;
+	      p += 3;
+	    }
+	}
+    }
+}
+
 typedef struct {
   unsigned char *cairo_data;
+  int cairo_rowstride;
   cairo_surface_t *surface;
   cairo_t *cairo;
 } OutputDevData;
 
 static void
-poppler_page_prepare_output_dev (PopplerPage *page,
-				 double scale,
-				 int rotation,
-				 gboolean transparent,
-				 OutputDevData *output_dev_data)
+poppler_page_get_render_size (PopplerPage *page,
+			      double scale,
+			      int rotation,
+			      int *width,
+			      int *height)
 {
-  CairoOutputDev *output_dev;
-  cairo_surface_t *surface;
-  double width, height;
-  int cairo_width, cairo_height, cairo_rowstride, rotate;
-  unsigned char *cairo_data;
+  double w, h;
+  int rotate;
 
   rotate = rotation + page->page->getRotate ();
   if (rotate == 90 || rotate == 270) {
-    height = page->page->getCropWidth ();
-    width = page->page->getCropHeight ();
+    h = page->page->getCropWidth ();
+    w = page->page->getCropHeight ();
   } else {
-    width = page->page->getCropWidth ();
-    height = page->page->getCropHeight ();
+    w = page->page->getCropWidth ();
+    h = page->page->getCropHeight ();
   }
 
-  cairo_width = (int) ceil(width * scale);
-  cairo_height = (int) ceil(height * scale);
+  *width = (int) ceil(w * scale);
+  *height = (int) ceil(h * scale);
+}
 
-  output_dev = page->document->output_dev;
-  cairo_rowstride = cairo_width * 4;
-  cairo_data = (guchar *) gmalloc (cairo_height * cairo_rowstride);
-  if (transparent)
-      memset (cairo_data, 0x00, cairo_height * cairo_rowstride);
-  else
-      memset (cairo_data, 0xff, cairo_height * cairo_rowstride);
+/* The surface memory for renders which can't go straight into the
+ * caller's buffer.  It's kept by the document and reused, so rendering
+ * a series of pages doesn't allocate a new one for each page. */
+static unsigned char *
+poppler_page_get_render_buffer (PopplerPage *page, gsize size)
+{
+  PopplerDocument *document = page->document;
+
+  if (size > document->render_buffer_size) {
+    gfree (document->render_buffer);
+    document->render_buffer = (guchar *) gmalloc (size);
+    document->render_buffer_size = size;
+  }
+
+  return document->render_buffer;
+}
+
+static void
+poppler_page_setup_surface (PopplerPage *page,
+			    unsigned char *cairo_data,
+			    int cairo_width,
+			    int cairo_height,
+			    int cairo_rowstride,
+			    gboolean transparent,
+			    OutputDevData *output_dev_data)
+{
+  cairo_surface_t *surface;
+  int y;
+
+  for (y = 0; y < cairo_height; y++)
+    memset (cairo_data + y * cairo_rowstride, transparent ? 0x00 : 0xff,
+	    cairo_width * 4);
 
   surface = cairo_image_surface_create_for_data(cairo_data,
 						CAIRO_FORMAT_ARGB32,
@@ -279,70 +351,99 @@ poppler_page_prepare_output_dev (PopplerPage *page,
 						cairo_rowstride);
 
   output_dev_data->cairo_data = cairo_data;
+  output_dev_data->cairo_rowstride = cairo_rowstride;
   output_dev_data->surface = surface;
   output_dev_data->cairo = cairo_create (surface);
-  output_dev->setCairo (output_dev_data->cairo);
+  page->document->output_dev->setCairo (output_dev_data->cairo);
 }
 
 static void
-copy_cairo_surface_to_pixbuf (cairo_surface_t *surface,
-			      unsigned char   *data,
-			      GdkPixbuf       *pixbuf)
+poppler_page_prepare_output_dev (PopplerPage *page,
+				 double scale,
+				 int rotation,
+				 gboolean transparent,
+				 OutputDevData *output_dev_data)
 {
   int cairo_width, cairo_height, cairo_rowstride;
-  unsigned char *pixbuf_data, *dst, *cairo_data;
-  int pixbuf_rowstride, pixbuf_n_channels;
-  unsigned int *src;
-  int x, y;
+  unsigned char *cairo_data;
 
-  cairo_width = cairo_image_surface_get_width (surface);
-  cairo_height = cairo_image_surface_get_height (surface);
+  poppler_page_get_render_size (page, scale, rotation,
+				&cairo_width, &cairo_height);
   cairo_rowstride = cairo_width * 4;
-  cairo_data = data;
+  cairo_data = poppler_page_get_render_buffer (page, (gsize) cairo_height *
+					       cairo_rowstride);
 
-  pixbuf_data = gdk_pixbuf_get_pixels (pixbuf);
-  pixbuf_rowstride = gdk_pixbuf_get_rowstride (pixbuf);
-  pixbuf_n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+  poppler_page_setup_surface (page, cairo_data, cairo_width, cairo_height,
+			      cairo_rowstride, transparent, output_dev_data);
+}
 
-  if (cairo_width > gdk_pixbuf_get_width (pixbuf))
-    cairo_width = gdk_pixbuf_get_width (pixbuf);
-  if (cairo_height > gdk_pixbuf_get_height (pixbuf))
-    cairo_height = gdk_pixbuf_get_height (pixbuf);
-  for (y = 0; y < cairo_height; y++)
-    {
-      src = (unsigned int *) (cairo_data + y * cairo_rowstride);
-      dst = pixbuf_data + y * pixbuf_rowstride;
-      for (x = 0; x < cairo_width; x++) 
-	{
-	  dst[0] = (*src >> 16) & 0xff;
-	  dst[1] = (*src >> 8) & 0xff; 
-	  dst[2] = (*src >> 0) & 0xff;
-	  if (pixbuf_n_channels == 4)
-	      dst[3] = (*src >> 24) & 0xff;
-	  dst += pixbuf_n_channels;
-	  src++;
-	}
-    }
-}	
+/* Cairo can render straight into a buffer with 4 bytes per pixel;
+ * the pixels are converted to RGBA in place afterwards. */
+static void
+poppler_page_prepare_output_dev_for_buffer (PopplerPage *page,
+					    double scale,
+					    int rotation,
+					    int src_width,
+					    int src_height,
+					    guchar *buffer,
+					    int width,
+					    int height,
+					    int rowstride,
+					    int n_channels,
+					    OutputDevData *output_dev_data)
+{
+  int cairo_width, cairo_height;
+
+  if (n_channels != 4 || (rowstride & 3)) {
+    poppler_page_prepare_output_dev (page, scale, rotation, FALSE,
+				     output_dev_data);
+    return;
+  }
+
+  poppler_page_get_render_size (page, scale, rotation,
+				&cairo_width, &cairo_height);
+  if (cairo_width > width)
+    cairo_width = width;
+  if (cairo_height > height)
+    cairo_height = height;
+
+  poppler_page_setup_surface (page, buffer, cairo_width, cairo_height,
+			      rowstride, FALSE, output_dev_data);
+}
 
 static void
-poppler_page_copy_to_pixbuf (PopplerPage *page,
-			     GdkPixbuf *pixbuf,
+poppler_page_copy_to_buffer (PopplerPage *page,
+			     guchar *buffer,
+			     int width,
+			     int height,
+			     int rowstride,
+			     int n_channels,
 			     OutputDevData *output_dev_data)
 {
-  copy_cairo_surface_to_pixbuf (output_dev_data->surface,
-				output_dev_data->cairo_data,
-				pixbuf);
-  
+  int cairo_width, cairo_height;
+
+  cairo_surface_flush (output_dev_data->surface);
+  cairo_width = cairo_image_surface_get_width (output_dev_data->surface);
+  cairo_height = cairo_image_surface_get_height (output_dev_data->surface);
+  if (cairo_width > width)
+    cairo_width = width;
+  if (cairo_height > height)
+    cairo_height = height;
+
+  convert_argb_to_pixbuf (output_dev_data->cairo_data,
+			  output_dev_data->cairo_rowstride,
+			  buffer, rowstride, n_channels,
+			  cairo_width, cairo_height);
+
   page->document->output_dev->setCairo (NULL);
   cairo_surface_destroy (output_dev_data->surface);
   cairo_destroy (output_dev_data->cairo);
-  gfree (output_dev_data->cairo_data);
 }
 
 #elif defined (HAVE_SPLASH)
  
 typedef struct {
+  guchar *buffer;
 } OutputDevData;
 
 static void
@@ -352,20 +453,52 @@ poppler_page_prepare_output_dev (PopplerPage *page,
 				 gboolean transparent,
 				 OutputDevData *output_dev_data)
 {
-  /* pft */
+  output_dev_data->buffer = NULL;
+}
+
+/* The output device renders in RGB8 mode, so a 3 channel buffer of
+ * the same size as the rendered slice can be used as its bitmap.
+ * Splash may clear the bitmap with one memset over all rows, so this
+ * is only done if rows aren't padded -- the last row of a pixbuf can
+ * be shorter than the rowstride. */
+static void
+poppler_page_prepare_output_dev_for_buffer (PopplerPage *page,
+					    double scale,
+					    int rotation,
+					    int src_width,
+					    int src_height,
+					    guchar *buffer,
+					    int width,
+					    int height,
+					    int rowstride,
+					    int n_channels,
+					    OutputDevData *output_dev_data)
+{
+  output_dev_data->buffer = NULL;
+  if (n_channels == 3 && rowstride == width * 3 &&
+      width == src_width && height == src_height) {
+    page->document->output_dev->setBitmap (new SplashBitmap (width, height,
+							     rowstride,
+							     splashModeRGB8,
+							     gTrue, buffer));
+    output_dev_data->buffer = buffer;
+  }
 }
 
 static void
-poppler_page_copy_to_pixbuf(PopplerPage *page,
-			    GdkPixbuf *pixbuf,
-			    OutputDevData *data)
+poppler_page_copy_to_buffer (PopplerPage *page,
+			     guchar *buffer,
+			     int width,
+			     int height,
+			     int rowstride,
+			     int n_channels,
+			     OutputDevData *output_dev_data)
 {
   SplashOutputDev *output_dev;
   SplashBitmap *bitmap;
   SplashColorPtr color_ptr;
   int splash_width, splash_height, splash_rowstride;
-  int pixbuf_rowstride, pixbuf_n_channels;
-  guchar *pixbuf_data, *dst;
+  guchar *src, *dst;
   int x, y;
 
   output_dev = page->document->output_dev;
@@ -373,39 +506,58 @@ poppler_page_copy_to_pixbuf(PopplerPage *page,
   bitmap = output_dev->getBitmap ();
   color_ptr = bitmap->getDataPtr ();
 
+  if (output_dev_data->buffer && color_ptr == output_dev_data->buffer) {
+    /* rendered in place -- detach the buffer from the output device */
+    delete output_dev->takeBitmap ();
+    return;
+  }
+
   splash_width = bitmap->getWidth ();
   splash_height = bitmap->getHeight ();
   splash_rowstride = bitmap->getRowSize ();
 
-  pixbuf_data = gdk_pixbuf_get_pixels (pixbuf);
-  pixbuf_rowstride = gdk_pixbuf_get_rowstride (pixbuf);
-  pixbuf_n_channels = gdk_pixbuf_get_n_channels (pixbuf);
-
-  if (splash_width > gdk_pixbuf_get_width (pixbuf))
-    splash_width = gdk_pixbuf_get_width (pixbuf);
-  if (splash_height > gdk_pixbuf_get_height (pixbuf))
-    splash_height = gdk_pixbuf_get_height (pixbuf);
+  if (splash_width > width)
+    splash_width = width;
+  if (splash_height > height)
+    splash_height = height;
 
-  SplashColorPtr pixel = new Guchar[4];
   for (y = 0; y < splash_height; y++)
   {
-    dst = pixbuf_data + y * pixbuf_rowstride;
+    src = color_ptr + y * splash_rowstride;
+    dst = buffer + y * rowstride;
+    if (n_channels == 3)
+    {
+      memcpy (dst, src, splash_width * 3);
+      continue;
+    }
     for (x = 0; x < splash_width; x++)
     {
-      output_dev->getBitmap()->getPixel(x, y, pixel);
-      dst[0] = pixel[0];
-      dst[1] = pixel[1];
-      dst[2] = pixel[2];
-      if (pixbuf_n_channels == 4)
-        dst[3] = 0xff;
-      dst += pixbuf_n_channels;
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+      dst[3] = 0xff;
+      src += 3;
+      dst += 4;
     }
   }
-  delete [] pixel;
 }
 
 #endif
 
+static void
+poppler_page_copy_to_pixbuf (PopplerPage *page,
+			     GdkPixbuf *pixbuf,
+			     OutputDevData *output_dev_data)
+{
+  poppler_page_copy_to_buffer (page,
+			       gdk_pixbuf_get_pixels (pixbuf),
+			       gdk_pixbuf_get_width (pixbuf),
+			       gdk_pixbuf_get_height (pixbuf),
+			       gdk_pixbuf_get_rowstride (pixbuf),
+			       gdk_pixbuf_get_n_channels (pixbuf),
+			       output_dev_data);
+}
+
 #if defined (HAVE_CAIRO)
 
 /**
@@ -442,6 +594,39 @@ poppler_page_render (PopplerPage *page,
 
 #endif
 
+static void
+poppler_page_render_to_data (PopplerPage *page,
+			     int src_x, int src_y,
+			     int src_width, int src_height,
+			     double scale,
+			     int rotation,
+			     guchar *buffer,
+			     int width,
+			     int height,
+			     int rowstride,
+			     int n_channels)
+{
+  OutputDevData data;
+
+  poppler_page_prepare_output_dev_for_buffer (page, scale, rotation,
+					      src_width, src_height,
+					      buffer, width, height,
+					      rowstride, n_channels, &data);
+
+  page->page->displaySlice(page->document->output_dev,
+			   72.0 * scale, 72.0 * scale,
+			   rotation,
+			   gFalse, /* useMediaBox */
+			   gTrue, /* Crop */
+			   src_x, src_y,
+			   src_width, src_height,
+			   gFalse, /* printing */
+			   page->document->doc->getCatalog ());
+
+  poppler_page_copy_to_buffer (page, buffer, width, height,
+			       rowstride, n_channels, &data);
+}
+
 /**
  * poppler_page_render_to_pixbuf:
  * @page: the page to render from
@@ -456,6 +641,9 @@ poppler_page_render (PopplerPage *page,
  * First scale the document to match the specified pixels per point,
  * then render the rectangle given by the upper left corner at
  * (src_x, src_y) and src_width and src_height.
+ *
+ * Where the pixel format allows it the page is rendered straight into
+ * the pixels of @pixbuf, without an intermediate copy.
  **/
 void
 poppler_page_render_to_pixbuf (PopplerPage *page,
@@ -465,25 +653,57 @@ poppler_page_render_to_pixbuf (PopplerPage *page,
 			       int rotation,
 			       GdkPixbuf *pixbuf)
 {
-  OutputDevData data;
-
   g_return_if_fail (POPPLER_IS_PAGE (page));
   g_return_if_fail (scale > 0.0);
   g_return_if_fail (pixbuf != NULL);
 
-  poppler_page_prepare_output_dev (page, scale, rotation, FALSE, &data);
+  poppler_page_render_to_data (page, src_x, src_y, src_width, src_height,
+			       scale, rotation,
+			       gdk_pixbuf_get_pixels (pixbuf),
+			       gdk_pixbuf_get_width (pixbuf),
+			       gdk_pixbuf_get_height (pixbuf),
+			       gdk_pixbuf_get_rowstride (pixbuf),
+			       gdk_pixbuf_get_n_channels (pixbuf));
+}
 
-  page->page->displaySlice(page->document->output_dev,
-			   72.0 * scale, 72.0 * scale,
-			   rotation,
-			   gFalse, /* useMediaBox */
-			   gTrue, /* Crop */
-			   src_x, src_y,
-			   src_width, src_height,
-			   gFalse, /* printing */
-			   page->document->doc->getCatalog ());
-  
-  poppler_page_copy_to_pixbuf (page, pixbuf, &data);
+/**
+ * poppler_page_render_to_buffer:
+ * @page: the page to render from
+ * @src_x: x coordinate of upper left corner  
+ * @src_y: y coordinate of upper left corner  
+ * @src_width: width of rectangle to render  
+ * @src_height: height of rectangle to render
+ * @scale: scale specified as pixels per point
+ * @rotation: rotate the document by the specified degree
+ * @buffer: memory to render into
+ * @width: width of @buffer in pixels
+ * @height: height of @buffer in pixels
+ * @rowstride: distance in bytes between rows of @buffer, a multiple of 4
+ *
+ * Like poppler_page_render_to_pixbuf(), but renders into @buffer,
+ * which holds 8 bit RGBA pixels in the layout of a #GdkPixbuf with an
+ * alpha channel.  This lets callers render into memory they manage
+ * themselves, e.g. one large buffer for a strip of thumbnails.
+ **/
+void
+poppler_page_render_to_buffer (PopplerPage *page,
+			       int src_x, int src_y,
+			       int src_width, int src_height,
+			       double scale,
+			       int rotation,
+			       guchar *buffer,
+			       int width,
+			       int height,
+			       int rowstride)
+{
+  g_return_if_fail (POPPLER_IS_PAGE (page));
+  g_return_if_fail (scale > 0.0);
+  g_return_if_fail (buffer != NULL);
+  g_return_if_fail (rowstride >= width * 4 && (rowstride & 3) == 0);
+
+  poppler_page_render_to_data (page, src_x, src_y, src_width, src_height,
+			       scale, rotation,
+			       buffer, width, height, rowstride, 4);
 }
 
 static TextOutputDev *
@@ -951,6 +1171,22 @@ poppler_page_get_text (PopplerPage          *page,
   return result;
 }
 
+/* Sort matches the way TextPage::findText finds them: top to bottom,
+ * then left to right. */
+static int
+compare_text_index_matches (const void *p1,
+			    const void *p2)
+{
+  TextIndexMatch *m1 = *(TextIndexMatch **) p1;
+  TextIndexMatch *m2 = *(TextIndexMatch **) p2;
+
+  if (m1->yMin != m2->yMin)
+    return m1->yMin < m2->yMin ? -1 : 1;
+  if (m1->xMin != m2->xMin)
+    return m1->xMin < m2->xMin ? -1 : 1;
+  return 0;
+}
+
 /**
  * poppler_page_find_text:
  * @page: a #PopplerPage
@@ -965,46 +1201,49 @@ GList *
 poppler_page_find_text (PopplerPage *page,
 			const char  *text)
 {
+  PopplerDocument *document;
   PopplerRectangle *match;
-  TextOutputDev *output_dev;
-  PDFDoc *doc;
+  TextIndexMatch *m, *prev;
+  GooList *found;
   GList *matches;
-  double xMin, yMin, xMax, yMax;
   gunichar *ucs4;
   glong ucs4_len;
   double height;
+  int i;
 
   g_return_val_if_fail (POPPLER_IS_PAGE (page), FALSE);
   g_return_val_if_fail (text != NULL, FALSE);
 
   ucs4 = g_utf8_to_ucs4_fast (text, -1, &ucs4_len);
 
-  output_dev = new TextOutputDev (NULL, gTrue, gFalse, gFalse);
-  doc = page->document->doc;
+  /* the text of each page is only extracted by the first search */
+  document = page->document;
+  if (document->text_index == NULL)
+    document->text_index = new TextIndex (document->doc);
+  found = document->text_index->findOnPage (page->index + 1,
+					    ucs4, ucs4_len, gFalse);
+  found->sort (compare_text_index_matches);
 
   poppler_page_get_size (page, NULL, &height);
-  page->page->display (output_dev, 72, 72, 0, gFalse,
-		       gTrue, gFalse, doc->getCatalog());
-  
+
   matches = NULL;
-  xMin = 0;
-  yMin = 0;
-
-  while (output_dev->findText (ucs4, ucs4_len,
-			       gFalse, gTrue, // startAtTop, stopAtBottom
-			       gTrue, gFalse, // startAtLast, stopAtLast
-			       gFalse, gFalse, // caseSensitive, backwards
-			       &xMin, &yMin, &xMax, &yMax))
+  prev = NULL;
+  for (i = 0; i < found->getLength (); i++)
     {
+      m = (TextIndexMatch *) found->get (i);
+      if (prev && m->yMin == prev->yMin && m->xMin == prev->xMin)
+	continue;
+      prev = m;
+
       match = g_new (PopplerRectangle, 1);
-      match->x1 = xMin;
-      match->y1 = height - yMax;
-      match->x2 = xMax;
-      match->y2 = height - yMin;
+      match->x1 = m->xMin;
+      match->y1 = height - m->yMax;
+      match->x2 = m->xMax;
+      match->y2 = height - m->yMin;
       matches = g_list_prepend (matches, match);
     }
 
-  delete output_dev;
+  deleteGooList (found, TextIndexMatch);
   g_free (ucs4);
 
   return g_list_reverse (matches);
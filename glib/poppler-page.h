@@ -47,6 +47,17 @@ void                   poppler_page_render_to_pixbuf     (PopplerPage        *pa
 							  double              scale,
 							  int                 rotation,
 							  GdkPixbuf          *pixbuf);
+void                   poppler_page_render_to_buffer     (PopplerPage        *page,
+							  int                 src_x,
+							  int                 src_y,
+							  int                 src_width,
+							  int                 src_height,
+							  double              scale,
+							  int                 rotation,
+							  guchar             *buffer,
+							  int                 width,
+							  int                 height,
+							  int                 rowstride);
 
 #ifdef POPPLER_HAS_CAIRO
 void                   poppler_page_render               (PopplerPage        *page,
@@ -9,6 +9,7 @@
 #include <Gfx.h>
 #include <FontInfo.h>
 #include <TextOutputDev.h>
+#include <TextIndex.h>
 #include <Catalog.h>
 
 #if defined (HAVE_CAIRO)
@@ -24,9 +25,12 @@ struct _PopplerDocument
 
 #if defined (HAVE_CAIRO)
   CairoOutputDev *output_dev;
+  guchar *render_buffer;	/* reused by page renders */
+  gsize render_buffer_size;
 #elif defined (HAVE_SPLASH)
   SplashOutputDev *output_dev;
 #endif
+  TextIndex *text_index;	/* created by the first text search */
 };
 
 struct _PopplerPSFile
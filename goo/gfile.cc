@@ -29,6 +29,10 @@
 #    include <unixlib.h>
 #  endif
 #endif // WIN32
+#if HAVE_MMAP
+#  include <sys/mman.h>
+#endif
+#include "gmem.h"
 #include "GooString.h"
 #include "gfile.h"
 
@@ -593,6 +597,91 @@ char *getLine(char *buf, int size, FILE *f) {
   return buf;
 }
 
+GBool getFileInfo(FILE *f, Guint *size, time_t *mtime) {
+#ifdef WIN32
+  struct _stat st;
+
+  if (_fstat(_fileno(f), &st)) {
+    return gFalse;
+  }
+#else
+  struct stat st;
+
+  if (fstat(fileno(f), &st)) {
+    return gFalse;
+  }
+#endif
+  *size = (Guint)st.st_size;
+  if (mtime) {
+    *mtime = st.st_mtime;
+  }
+  return gTrue;
+}
+
+void *mapFile(char *fileName, Guint *len) {
+  FILE *f;
+  void *p;
+
+  if (!(f = fopen(fileName, "rb"))) {
+    return NULL;
+  }
+  if (!getFileInfo(f, len, NULL) || *len == 0) {
+    fclose(f);
+    return NULL;
+  }
+#if HAVE_MMAP
+  p = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+  if (p == MAP_FAILED) {
+    p = NULL;
+  }
+#else
+  p = gmalloc(*len);
+  if (fread(p, 1, *len, f) != *len) {
+    gfree(p);
+    p = NULL;
+  }
+#endif
+  fclose(f);
+  return p;
+}
+
+void unmapFile(void *p, Guint len) {
+#if HAVE_MMAP
+  munmap(p, len);
+#else
+  gfree(p);
+#endif
+}
+
+GBool writeFileAtomic(char *fileName, void *buf, Guint len) {
+  GooString *tmpName;
+  FILE *f;
+  GBool ok;
+
+#ifdef WIN32
+  tmpName = GooString::format("{0:s}.{1:d}.tmp", fileName,
+			      (int)GetCurrentProcessId());
+#else
+  tmpName = GooString::format("{0:s}.{1:d}.tmp", fileName, (int)getpid());
+#endif
+  if (!(f = fopen(tmpName->getCString(), "wb"))) {
+    delete tmpName;
+    return gFalse;
+  }
+  ok = fwrite(buf, 1, len, f) == len;
+  if (fclose(f)) {
+    ok = gFalse;
+  }
+  if (ok && rename(tmpName->getCString(), fileName)) {
+    ok = gFalse;
+  }
+  if (!ok) {
+    remove(tmpName->getCString());
+  }
+  delete tmpName;
+  return ok;
+}
+
 //------------------------------------------------------------------------
 // GDir and GDirEntry
 //------------------------------------------------------------------------
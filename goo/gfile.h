@@ -94,6 +94,24 @@ extern GBool executeCommand(char *cmd);
 // conventions.
 extern char *getLine(char *buf, int size, FILE *f);
 
+// Get the size and modification time of the open file <f>.  Returns
+// false if there is an error.
+extern GBool getFileInfo(FILE *f, Guint *size, time_t *mtime);
+
+// Map <fileName> into memory, and set *<len> to its length.  The
+// mapping is private: it can be modified, but the changes are never
+// written back to the file.  Where mmap isn't available, the file is
+// read into memory instead.  Returns NULL on error.
+extern void *mapFile(char *fileName, Guint *len);
+
+// Release a mapping created by mapFile.
+extern void unmapFile(void *p, Guint len);
+
+// Write <len> bytes to <fileName>.  The data is written to a
+// temporary file which is then renamed, so other processes never see
+// a partial file.  Returns true on success.
+extern GBool writeFileAtomic(char *fileName, void *buf, Guint len);
+
 //------------------------------------------------------------------------
 // GDir and GDirEntry
 //------------------------------------------------------------------------
@@ -346,7 +346,7 @@ void Annot::generateFieldAppearance(Dict *field, Dict *annot, Dict *acroForm) {
   GBool hasCaption;
   double w, dx, dy, r;
   double *dash;
-  GooString *caption, *da;
+  GooString *caption, *da, *oldAppearBuf;
   GooString **text;
   GBool *selection;
   int dashLength, ff, quadding, comb, nOptions, topIdx, i, j;
@@ -370,6 +370,9 @@ void Annot::generateFieldAppearance(Dict *field, Dict *annot, Dict *acroForm) {
     return;
   }
 
+  // the current appearance stream (if any) still reads from the old
+  // buffer, so it is only freed once the new stream replaces it
+  oldAppearBuf = appearBuf;
   appearBuf = new GooString ();
   // get the appearance characteristics (MK) dictionary
   if (annot->lookup("MK", &mkObj)->isDict()) {
@@ -709,6 +712,9 @@ void Annot::generateFieldAppearance(Dict *field, Dict *annot, Dict *acroForm) {
       appearBuf->getLength(), &appearDict);
   appearance.free();
   appearance.initStream(appearStream);
+  if (oldAppearBuf) {
+    delete oldAppearBuf;
+  }
 
   if (fontDict) {
     delete fontDict;
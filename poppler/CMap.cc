@@ -19,6 +19,7 @@
 #include "goo/gmem.h"
 #include "goo/gfile.h"
 #include "goo/GooString.h"
+#include "goo/GooList.h"
 #include "Error.h"
 #include "GlobalParams.h"
 #include "PSTokenizer.h"
@@ -26,12 +27,23 @@
 
 //------------------------------------------------------------------------
 
-struct CMapVectorEntry {
-  GBool isVector;
-  union {
-    CMapVectorEntry *vector;
-    CID cid;
-  };
+#define cMapNode 0x80000000	// flags table entries which point to a
+				//   node instead of holding a CID
+
+#define cMapCompiledMagic "%PCM"	// compiled CMaps start with this,
+#define cMapCompiledOrder 0x01020304	//   this word (to check the byte
+#define cMapCompiledVersion 1		//   order), and the version
+
+//------------------------------------------------------------------------
+
+struct CMapSource {
+  CMapSource(GooString *nameA, Guint sizeA, Guint mtimeA)
+    { name = nameA; size = sizeA; mtime = mtimeA; }
+  ~CMapSource() { delete name; }
+
+  GooString *name;		// CMap name
+  Guint size;			// size and modification time of the
+  Guint mtime;			//   CMap file
 };
 
 //------------------------------------------------------------------------
@@ -47,9 +59,11 @@ CMap *CMap::parse(CMapCache *cache, GooString *collectionA,
   FILE *f;
   CMap *cmap;
   PSTokenizer *pst;
+  GooString *name, *compiledName;
   char tok1[256], tok2[256], tok3[256];
   int n1, n2, n3;
-  Guint start, end, code;
+  Guint start, end, code, size;
+  time_t mtime;
 
   if (!(f = globalParams->findCMapFile(collectionA, cMapNameA))) {
 
@@ -66,7 +80,27 @@ CMap *CMap::parse(CMapCache *cache, GooString *collectionA,
     return NULL;
   }
 
+  if (!getFileInfo(f, &size, &mtime)) {
+    size = 0;
+    mtime = 0;
+  }
+  compiledName = NULL;
+  if (size) {
+    name = GooString::format("{0:t}.{1:t}.cmap", collectionA, cMapNameA);
+    compiledName = globalParams->getCMapCacheFile(name);
+    delete name;
+  }
+  if (compiledName &&
+      (cmap = loadCompiled(compiledName, collectionA, cMapNameA,
+			   size, (Guint)mtime))) {
+    delete compiledName;
+    fclose(f);
+    return cmap;
+  }
+
   cmap = new CMap(collectionA->copy(), cMapNameA->copy());
+  cmap->sources->append(new CMapSource(cMapNameA->copy(),
+				       size, (Guint)mtime));
 
   pst = new PSTokenizer(&getCharFromFile, f);
   pst->getToken(tok1, sizeof(tok1), &n1);
@@ -95,7 +129,7 @@ CMap *CMap::parse(CMapCache *cache, GooString *collectionA,
 	  sscanf(tok1 + 1, "%x", &start);
 	  sscanf(tok2 + 1, "%x", &end);
 	  n1 = (n1 - 2) / 2;
-	  cmap->addCodeSpace(cmap->vector, start, end, n1);
+	  cmap->addCodeSpace(0, start, end, n1);
 	}
       }
       pst->getToken(tok1, sizeof(tok1), &n1);
@@ -153,20 +187,24 @@ CMap *CMap::parse(CMapCache *cache, GooString *collectionA,
 
   fclose(f);
 
+  if (compiledName) {
+    cmap->writeCompiled(compiledName);
+    delete compiledName;
+  }
+
   return cmap;
 }
 
 CMap::CMap(GooString *collectionA, GooString *cMapNameA) {
-  int i;
-
   collection = collectionA;
   cMapName = cMapNameA;
   wMode = 0;
-  vector = (CMapVectorEntry *)gmallocn(256, sizeof(CMapVectorEntry));
-  for (i = 0; i < 256; ++i) {
-    vector[i].isVector = gFalse;
-    vector[i].cid = 0;
-  }
+  table = NULL;
+  nNodes = nodesSize = 0;
+  addNode();
+  compiled = NULL;
+  compiledLen = 0;
+  sources = new GooList();
   refCnt = 1;
 #if MULTITHREADED
   gInitMutex(&mutex);
@@ -177,16 +215,135 @@ CMap::CMap(GooString *collectionA, GooString *cMapNameA, int wModeA) {
   collection = collectionA;
   cMapName = cMapNameA;
   wMode = wModeA;
-  vector = NULL;
+  table = NULL;
+  nNodes = nodesSize = 0;
+  compiled = NULL;
+  compiledLen = 0;
+  sources = new GooList();
   refCnt = 1;
 #if MULTITHREADED
   gInitMutex(&mutex);
 #endif
 }
 
+// Compiled CMaps are made of native-endian 32-bit words:
+//   magic, byte order, version, wMode, nNodes, nSources,
+//   nSources * (size, mtime, name length, name padded to 4 bytes),
+//   nNodes * 256 table entries
+// The first source is the CMap itself, the others are the CMaps it
+// uses.  The table is used in place, without copying.
+CMap *CMap::loadCompiled(GooString *compiledName, GooString *collectionA,
+			 GooString *cMapNameA, Guint size, Guint mtime) {
+  CMap *cmap;
+  GooString *name;
+  FILE *f;
+  void *p;
+  Guint *w;
+  Guint len, nWords, nNodesA, nSourcesA, srcSize, i, pos, n;
+  time_t srcMtime;
+  GBool ok;
+
+  if (!(p = mapFile(compiledName->getCString(), &len))) {
+    return NULL;
+  }
+  w = (Guint *)p;
+  nWords = len / 4;
+  if (nWords < 6 || memcmp(p, cMapCompiledMagic, 4) ||
+      w[1] != cMapCompiledOrder || w[2] != cMapCompiledVersion ||
+      w[4] == 0 || w[5] == 0) {
+    unmapFile(p, len);
+    return NULL;
+  }
+  nNodesA = w[4];
+  nSourcesA = w[5];
+  cmap = new CMap(collectionA->copy(), cMapNameA->copy(), (int)w[3]);
+  cmap->compiled = p;
+  cmap->compiledLen = len;
+
+  // check that none of the CMap files have changed
+  ok = gTrue;
+  pos = 6;
+  for (i = 0; i < nSourcesA && ok; ++i) {
+    if (pos + 3 > nWords || w[pos + 2] > 256 ||
+	pos + 3 + (w[pos + 2] + 3) / 4 > nWords) {
+      ok = gFalse;
+      break;
+    }
+    n = w[pos + 2];
+    name = new GooString((char *)&w[pos + 3], n);
+    if (i == 0) {
+      ok = !name->cmp(cMapNameA) && w[pos] == size && w[pos + 1] == mtime;
+    } else if ((f = globalParams->findCMapFile(collectionA, name))) {
+      ok = getFileInfo(f, &srcSize, &srcMtime) && w[pos] == srcSize &&
+	   w[pos + 1] == (Guint)srcMtime;
+      fclose(f);
+    } else {
+      ok = gFalse;
+    }
+    cmap->sources->append(new CMapSource(name, w[pos], w[pos + 1]));
+    pos += 3 + (n + 3) / 4;
+  }
+  if (!ok || nNodesA > (nWords - pos) / 256) {
+    cmap->decRefCnt();
+    return NULL;
+  }
+  cmap->table = w + pos;
+  cmap->nNodes = cmap->nodesSize = nNodesA;
+  return cmap;
+}
+
+void CMap::writeCompiled(GooString *compiledName) {
+  CMapSource *src;
+  Guint *w;
+  Guint nWords, pos, n;
+  int i;
+
+  nWords = 6;
+  for (i = 0; i < sources->getLength(); ++i) {
+    src = (CMapSource *)sources->get(i);
+    nWords += 3 + (src->name->getLength() + 3) / 4;
+  }
+  nWords += nNodes * 256;
+  w = (Guint *)gmallocn(nWords, sizeof(Guint));
+  memcpy(w, cMapCompiledMagic, 4);
+  w[1] = cMapCompiledOrder;
+  w[2] = cMapCompiledVersion;
+  w[3] = (Guint)wMode;
+  w[4] = nNodes;
+  w[5] = (Guint)sources->getLength();
+  pos = 6;
+  for (i = 0; i < sources->getLength(); ++i) {
+    src = (CMapSource *)sources->get(i);
+    n = (Guint)src->name->getLength();
+    w[pos] = src->size;
+    w[pos + 1] = src->mtime;
+    w[pos + 2] = n;
+    if (n & 3) {
+      w[pos + 3 + n / 4] = 0;
+    }
+    memcpy(&w[pos + 3], src->name->getCString(), n);
+    pos += 3 + (n + 3) / 4;
+  }
+  memcpy(&w[pos], table, nNodes * 256 * sizeof(Guint));
+  writeFileAtomic(compiledName->getCString(), w, nWords * sizeof(Guint));
+  gfree(w);
+}
+
+// Add an empty node to the table, and return its index.
+Guint CMap::addNode() {
+  if (nNodes == nodesSize) {
+    nodesSize = nodesSize ? 2 * nodesSize : 16;
+    table = (Guint *)greallocn(table, nodesSize * 256, sizeof(Guint));
+  }
+  memset(table + nNodes * 256, 0, 256 * sizeof(Guint));
+  return nNodes++;
+}
+
 void CMap::useCMap(CMapCache *cache, char *useName) {
   GooString *useNameStr;
   CMap *subCMap;
+  CMapSource *src;
+  int i;
 
   useNameStr = new GooString(useName);
   subCMap = cache->getCMap(collection, useNameStr);
@@ -194,39 +351,48 @@ void CMap::useCMap(CMapCache *cache, char *useName) {
   if (!subCMap) {
     return;
   }
-  copyVector(vector, subCMap->vector);
+  if (subCMap->table) {
+    copyVector(0, subCMap, 0);
+  }
+  for (i = 0; i < subCMap->sources->getLength(); ++i) {
+    src = (CMapSource *)subCMap->sources->get(i);
+    sources->append(new CMapSource(src->name->copy(), src->size, src->mtime));
+  }
   subCMap->decRefCnt();
 }
 
-void CMap::copyVector(CMapVectorEntry *dest, CMapVectorEntry *src) {
-  int i, j;
+void CMap::copyVector(Guint dest, CMap *src, Guint srcNode) {
+  Guint e, d, child;
+  int i;
 
   for (i = 0; i < 256; ++i) {
-    if (src[i].isVector) {
-      if (!dest[i].isVector) {
-	dest[i].isVector = gTrue;
-	dest[i].vector =
-	  (CMapVectorEntry *)gmallocn(256, sizeof(CMapVectorEntry));
-	for (j = 0; j < 256; ++j) {
-	  dest[i].vector[j].isVector = gFalse;
-	  dest[i].vector[j].cid = 0;
-	}
+    e = src->table[srcNode * 256 + i];
+    if (e & cMapNode) {
+      // nodes always point forward, so this can't loop, even with a
+      // damaged compiled file
+      child = e & ~cMapNode;
+      if (child <= srcNode || child >= src->nNodes) {
+	continue;
+      }
+      d = table[dest * 256 + i];
+      if (!(d & cMapNode)) {
+	d = cMapNode | addNode();
+	table[dest * 256 + i] = d;
       }
-      copyVector(dest[i].vector, src[i].vector);
+      copyVector(d & ~cMapNode, src, child);
     } else {
-      if (dest[i].isVector) {
+      if (table[dest * 256 + i] & cMapNode) {
 	error(-1, "Collision in usecmap");
       } else {
-	dest[i].cid = src[i].cid;
+	table[dest * 256 + i] = e;
       }
     }
   }
 }
 
-void CMap::addCodeSpace(CMapVectorEntry *vec, Guint start, Guint end,
-			Guint nBytes) {
-  Guint start2, end2;
-  int startByte, endByte, i, j;
+void CMap::addCodeSpace(Guint node, Guint start, Guint end, Guint nBytes) {
+  Guint start2, end2, e;
+  int startByte, endByte, i;
 
   if (nBytes > 1) {
     startByte = (start >> (8 * (nBytes - 1))) & 0xff;
@@ -234,43 +400,40 @@ void CMap::addCodeSpace(CMapVectorEntry *vec, Guint start, Guint end,
     start2 = start & ((1 << (8 * (nBytes - 1))) - 1);
     end2 = end & ((1 << (8 * (nBytes - 1))) - 1);
     for (i = startByte; i <= endByte; ++i) {
-      if (!vec[i].isVector) {
-	vec[i].isVector = gTrue;
-	vec[i].vector =
-	  (CMapVectorEntry *)gmallocn(256, sizeof(CMapVectorEntry));
-	for (j = 0; j < 256; ++j) {
-	  vec[i].vector[j].isVector = gFalse;
-	  vec[i].vector[j].cid = 0;
-	}
+      e = table[node * 256 + i];
+      if (!(e & cMapNode)) {
+	e = cMapNode | addNode();
+	table[node * 256 + i] = e;
       }
-      addCodeSpace(vec[i].vector, start2, end2, nBytes - 1);
+      addCodeSpace(e & ~cMapNode, start2, end2, nBytes - 1);
     }
   }
 }
 
 void CMap::addCIDs(Guint start, Guint end, Guint nBytes, CID firstCID) {
-  CMapVectorEntry *vec;
+  Guint node, e;
   CID cid;
   int byte;
   Guint i;
 
-  vec = vector;
+  node = 0;
   for (i = nBytes - 1; i >= 1; --i) {
     byte = (start >> (8 * i)) & 0xff;
-    if (!vec[byte].isVector) {
+    e = table[node * 256 + byte];
+    if (!(e & cMapNode)) {
       error(-1, "Invalid CID (%0*x - %0*x) in CMap",
 	    2*nBytes, start, 2*nBytes, end);
       return;
     }
-    vec = vec[byte].vector;
+    node = e & ~cMapNode;
   }
   cid = firstCID;
   for (byte = (int)(start & 0xff); byte <= (int)(end & 0xff); ++byte) {
-    if (vec[byte].isVector) {
+    if ((table[node * 256 + byte] & cMapNode) || (cid & cMapNode)) {
       error(-1, "Invalid CID (%0*x - %0*x) in CMap",
 	    2*nBytes, start, 2*nBytes, end);
     } else {
-      vec[byte].cid = cid;
+      table[node * 256 + byte] = cid;
     }
     ++cid;
   }
@@ -279,25 +442,17 @@ void CMap::addCIDs(Guint start, Guint end, Guint nBytes, CID firstCID) {
 CMap::~CMap() {
   delete collection;
   delete cMapName;
-  if (vector) {
-    freeCMapVector(vector);
+  if (compiled) {
+    unmapFile(compiled, compiledLen);
+  } else {
+    gfree(table);
   }
+  deleteGooList(sources, CMapSource);
 #if MULTITHREADED
   gDestroyMutex(&mutex);
 #endif
 }
 
-void CMap::freeCMapVector(CMapVectorEntry *vec) {
-  int i;
-
-  for (i = 0; i < 256; ++i) {
-    if (vec[i].isVector) {
-      freeCMapVector(vec[i].vector);
-    }
-  }
-  gfree(vec);
-}
-
 void CMap::incRefCnt() {
 #if MULTITHREADED
   gLockMutex(&mutex);
@@ -328,10 +483,10 @@ GBool CMap::match(GooString *collectionA, GooString *cMapNameA) {
 }
 
 CID CMap::getCID(char *s, int len, int *nUsed) {
-  CMapVectorEntry *vec;
-  int n, i;
+  Guint node, e;
+  int n;
 
-  if (!(vec = vector)) {
+  if (!table) {
     // identity CMap
     *nUsed = 2;
     if (len < 2) {
@@ -339,18 +494,23 @@ CID CMap::getCID(char *s, int len, int *nUsed) {
     }
     return ((s[0] & 0xff) << 8) + (s[1] & 0xff);
   }
+  node = 0;
   n = 0;
   while (1) {
     if (n >= len) {
       *nUsed = n;
       return 0;
     }
-    i = s[n++] & 0xff;
-    if (!vec[i].isVector) {
+    e = table[node * 256 + (s[n++] & 0xff)];
+    if (!(e & cMapNode)) {
       *nUsed = n;
-      return vec[i].cid;
+      return e;
+    }
+    node = e & ~cMapNode;
+    if (node >= nNodes) {
+      *nUsed = n;
+      return 0;
     }
-    vec = vec[i].vector;
   }
 }
 
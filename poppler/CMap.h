@@ -22,7 +22,7 @@
 #endif
 
 class GooString;
-struct CMapVectorEntry;
+class GooList;
 class CMapCache;
 
 //------------------------------------------------------------------------
@@ -32,6 +32,12 @@ public:
 
   // Create the CMap specified by <collection> and <cMapName>.  Sets
   // the initial reference count to 1.  Returns NULL on failure.
+  //
+  // If GlobalParams::setCMapCacheDir is set, the parsed CMap is also
+  // written there in compiled form, and later calls (in this or other
+  // processes) map the compiled file instead of parsing the CMap
+  // again, as long as the CMap file and the files it includes with
+  // usecmap haven't changed.
   static CMap *parse(CMapCache *cache, GooString *collectionA,
 		     GooString *cMapNameA);
 
@@ -59,18 +65,29 @@ private:
 
   CMap(GooString *collectionA, GooString *cMapNameA);
   CMap(GooString *collectionA, GooString *cMapNameA, int wModeA);
+  static CMap *loadCompiled(GooString *compiledName, GooString *collectionA,
+			    GooString *cMapNameA, Guint size, Guint mtime);
+  void writeCompiled(GooString *compiledName);
+  Guint addNode();
   void useCMap(CMapCache *cache, char *useName);
-  void copyVector(CMapVectorEntry *dest, CMapVectorEntry *src);
-  void addCodeSpace(CMapVectorEntry *vec, Guint start, Guint end,
-		    Guint nBytes);
+  void copyVector(Guint dest, CMap *src, Guint srcNode);
+  void addCodeSpace(Guint node, Guint start, Guint end, Guint nBytes);
   void addCIDs(Guint start, Guint end, Guint nBytes, CID firstCID);
-  void freeCMapVector(CMapVectorEntry *vec);
 
   GooString *collection;
   GooString *cMapName;
   int wMode;			// writing mode (0=horizontal, 1=vertical)
-  CMapVectorEntry *vector;	// vector for first byte (NULL for
-				//   identity CMap)
+  Guint *table;			// [nNodes * 256] one node per code byte:
+				//   each entry is a CID, or cMapNode plus
+				//   the index of the node for the next
+				//   byte; node 0 is for the first byte
+				//   (NULL for identity CMap)
+  Guint nNodes;
+  Guint nodesSize;		// allocated size of <table>, in nodes
+  void *compiled;		// mapped compiled file <table> points
+  Guint compiledLen;		//   into (NULL if <table> is allocated)
+  GooList *sources;		// CMap files this was built from, for
+				//   checking compiled files [CMapSource]
   int refCnt;
 #if MULTITHREADED
   GooMutex mutex;
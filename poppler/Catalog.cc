@@ -14,6 +14,7 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include "goo/gmem.h"
 #include "Object.h"
 #include "XRef.h"
@@ -41,6 +42,8 @@ Catalog::Catalog(XRef *xrefA) {
   xref = xrefA;
   pages = NULL;
   pageRefs = NULL;
+  pageRefHash = NULL;
+  pageRefHashSize = 0;
   numPages = pagesSize = 0;
   baseURI = NULL;
   pageLabelInfo = NULL;
@@ -200,6 +203,7 @@ Catalog::~Catalog() {
     gfree(pages);
     gfree(pageRefs);
   }
+  gfree(pageRefHash);
   dests.free();
   destNameTree.free();
   embeddedFileNameTree.free();
@@ -318,12 +322,59 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
   return -1;
 }
 
-int Catalog::findPage(int num, int gen) {
-  int i;
+static inline Guint pageRefHashFunc(int num, int gen) {
+  return (Guint)num * 2654435761U + (Guint)gen;
+}
+
+void Catalog::buildPageRefHash() {
+  Ref *ref;
+  Guint h;
+  int i, pg;
 
+  // at most half full, so probe sequences stay short
+  pageRefHashSize = 16;
+  while (pageRefHashSize < 2 * numPages) {
+    pageRefHashSize <<= 1;
+  }
+  pageRefHash = (int *)gmallocn(pageRefHashSize, sizeof(int));
+  memset(pageRefHash, 0, pageRefHashSize * sizeof(int));
   for (i = 0; i < numPages; ++i) {
-    if (pageRefs[i].num == num && pageRefs[i].gen == gen)
-      return i + 1;
+    ref = &pageRefs[i];
+    if (ref->num < 0) {
+      continue;
+    }
+    // if a page object is used more than once, keep the first page,
+    // as the linear search did
+    h = pageRefHashFunc(ref->num, ref->gen) & (pageRefHashSize - 1);
+    while ((pg = pageRefHash[h])) {
+      if (pageRefs[pg - 1].num == ref->num &&
+	  pageRefs[pg - 1].gen == ref->gen) {
+	break;
+      }
+      h = (h + 1) & (pageRefHashSize - 1);
+    }
+    if (!pg) {
+      pageRefHash[h] = i + 1;
+    }
+  }
+}
+
+int Catalog::findPage(int num, int gen) {
+  Guint h;
+  int pg;
+
+  if (numPages <= 0) {
+    return 0;
+  }
+  if (!pageRefHash) {
+    buildPageRefHash();
+  }
+  h = pageRefHashFunc(num, gen) & (pageRefHashSize - 1);
+  while ((pg = pageRefHash[h])) {
+    if (pageRefs[pg - 1].num == num && pageRefs[pg - 1].gen == gen) {
+      return pg;
+    }
+    h = (h + 1) & (pageRefHashSize - 1);
   }
   return 0;
 }
@@ -475,11 +526,25 @@ EmbFile *Catalog::embeddedFile(int i)
     return embeddedFile;
 }
 
+#define nameTreeLeafCacheSize 8	// number of leaf nodes kept by NameTree
+#define nameTreeMaxDepth 64	// to avoid loops in broken name trees
+#define nameTreeMaxNodes 1024	// ditto (in addition to the number of
+				//   objects in the file)
+#define nameTreeMaxLeafReads 64	// read the whole tree once lookups have
+				//   read this many leaf nodes
+
 NameTree::NameTree()
 {
+  root.initNull();
+  parsed = gFalse;
   size = 0;
   length = 0;
   entries = NULL;
+  rootNode = NULL;
+  nNodes = 0;
+  leaves = NULL;
+  useCount = 0;
+  leafReads = 0;
 }
 
 NameTree::Entry::Entry(Array *array, int index) {
@@ -514,9 +579,19 @@ void NameTree::addEntry(Entry *entry)
   ++length;
 }
 
+// The tree is only read completely when the entries are enumerated.
+// Lookups descend from the root, using the /Limits of the nodes.
 void NameTree::init(XRef *xrefA, Object *tree) {
+  int i;
+
   xref = xrefA;
-  parse(tree);
+  tree->copy(&root);
+  leaves = (Leaf *)gmallocn(nameTreeLeafCacheSize, sizeof(Leaf));
+  for (i = 0; i < nameTreeLeafCacheSize; ++i) {
+    leaves[i].node = NULL;
+    leaves[i].names.initNull();
+    leaves[i].lastUse = 0;
+  }
 }
 
 void NameTree::parse(Object *tree) {
@@ -557,25 +632,254 @@ int NameTree::Entry::cmp(const void *voidKey, const void *voidEntry)
   return key->cmp(&entry->name);
 }
 
-GBool NameTree::lookup(GooString *name, Object *obj)
+// Read the node <ref> (a reference or a dictionary from a /Kids
+// array).  Returns NULL if the tree has more nodes than the file has
+// objects, which can only happen if it has loops.
+NameTree::Node *NameTree::makeNode(Object *ref)
 {
-  Entry **entry;
+  Node *node;
+  Object dict, names, limits, low, high;
+  int i;
 
-  entry = (Entry **) bsearch(name, entries,
-			     length, sizeof(Entry *), Entry::cmp);
-  if (entry != NULL) {
-    (*entry)->value.fetch(xref, obj);
+  if (nNodes > xref->getNumObjects() + nameTreeMaxNodes) {
+    return NULL;
+  }
+  ++nNodes;
+  node = new Node;
+  ref->copy(&node->ref);
+  node->low = node->high = NULL;
+  node->hasNames = gFalse;
+  node->kids.initNull();
+  node->children = NULL;
+  if (ref->fetch(xref, &dict)->isDict()) {
+    if (dict.dictLookup("Limits", &limits)->isArray() &&
+	limits.arrayGetLength() == 2) {
+      if (limits.arrayGet(0, &low)->isString() &&
+	  limits.arrayGet(1, &high)->isString()) {
+	node->low = low.getString()->copy();
+	node->high = high.getString()->copy();
+      }
+      low.free();
+      high.free();
+    }
+    limits.free();
+    node->hasNames = dict.dictLookup("Names", &names)->isArray();
+    names.free();
+    if (dict.dictLookup("Kids", &node->kids)->isArray()) {
+      node->children = (Node **)gmallocn(node->kids.arrayGetLength(),
+					 sizeof(Node *));
+      for (i = 0; i < node->kids.arrayGetLength(); ++i) {
+	node->children[i] = NULL;
+      }
+    }
+  }
+  dict.free();
+  return node;
+}
+
+void NameTree::freeNode(Node *node)
+{
+  int i;
+
+  if (node->children) {
+    for (i = 0; i < node->kids.arrayGetLength(); ++i) {
+      if (node->children[i]) {
+	freeNode(node->children[i]);
+      }
+    }
+    gfree(node->children);
+  }
+  node->ref.free();
+  node->kids.free();
+  if (node->low) {
+    delete node->low;
+    delete node->high;
+  }
+  delete node;
+}
+
+NameTree::Node *NameTree::getChild(Node *node, int i)
+{
+  Object ref;
+
+  if (!node->children[i]) {
+    node->children[i] = makeNode(node->kids.arrayGetNF(i, &ref));
+    ref.free();
+  }
+  return node->children[i];
+}
+
+// Binary search for <name> in the /Names array of a leaf node.
+GBool NameTree::lookupInNames(Array *names, GooString *name, Object *obj)
+{
+  Object key, value;
+  int a, b, m, c;
+
+  a = 0;
+  b = names->getLength() / 2 - 1;
+  while (a <= b) {
+    m = (a + b) / 2;
+    if (!names->get(2 * m, &key)->isString()) {
+      key.free();
+      break;
+    }
+    c = name->cmp(key.getString());
+    key.free();
+    if (c < 0) {
+      b = m - 1;
+    } else if (c > 0) {
+      a = m + 1;
+    } else {
+      names->getNF(2 * m + 1, &value);
+      value.fetch(xref, obj);
+      value.free();
+      return gTrue;
+    }
+  }
+  return gFalse;
+}
+
+// Look up <name> in the /Names array of <node>.  The arrays of the
+// most recently used leaf nodes are kept, so that they don't have to
+// be parsed again.
+GBool NameTree::lookupInLeaf(Node *node, GooString *name, Object *obj)
+{
+  Object dict;
+  Leaf *leaf;
+  int i;
+
+  leaf = NULL;
+  for (i = 0; i < nameTreeLeafCacheSize; ++i) {
+    if (leaves[i].node == node) {
+      leaf = &leaves[i];
+      break;
+    }
+  }
+  if (!leaf) {
+    leaf = &leaves[0];
+    for (i = 1; i < nameTreeLeafCacheSize; ++i) {
+      if (leaves[i].lastUse < leaf->lastUse) {
+	leaf = &leaves[i];
+      }
+    }
+    leaf->names.free();
+    leaf->node = node;
+    ++leafReads;
+    if (node->ref.fetch(xref, &dict)->isDict()) {
+      dict.dictLookup("Names", &leaf->names);
+    } else {
+      leaf->names.initNull();
+    }
+    dict.free();
+  }
+  leaf->lastUse = ++useCount;
+  if (!leaf->names.isArray()) {
+    return gFalse;
+  }
+  return lookupInNames(leaf->names.getArray(), name, obj);
+}
+
+GBool NameTree::lookupInNode(Node *node, GooString *name, Object *obj,
+			     int depth)
+{
+  Node *child;
+  GBool linear;
+  int a, b, m, n, i;
+
+  if (!node || depth > nameTreeMaxDepth) {
+    return gFalse;
+  }
+
+  // leaf node
+  if (node->hasNames && lookupInLeaf(node, name, obj)) {
     return gTrue;
-  } else {
-    printf("failed to look up %s\n", name->getCString());
-    obj->initNull();
+  }
+  if (!node->children) {
     return gFalse;
   }
+
+  // root or intermediate node: the kids are sorted, so do a binary
+  // search on their /Limits, unless some of them are missing
+  n = node->kids.arrayGetLength();
+  a = 0;
+  b = n - 1;
+  linear = gFalse;
+  while (a <= b) {
+    m = (a + b) / 2;
+    if (!(child = getChild(node, m)) || !child->low) {
+      linear = gTrue;
+      break;
+    }
+    if (name->cmp(child->low) < 0) {
+      b = m - 1;
+    } else if (name->cmp(child->high) > 0) {
+      a = m + 1;
+    } else {
+      return lookupInNode(child, name, obj, depth + 1);
+    }
+  }
+  for (i = 0; linear && i < n; ++i) {
+    if ((child = getChild(node, i)) &&
+	(!child->low ||
+	 (name->cmp(child->low) >= 0 && name->cmp(child->high) <= 0)) &&
+	lookupInNode(child, name, obj, depth + 1)) {
+      return gTrue;
+    }
+  }
+  return gFalse;
+}
+
+GBool NameTree::lookup(GooString *name, Object *obj)
+{
+  Entry **entry;
+  int i;
+
+  // if lookups are spread all over the tree, reading it completely is
+  // cheaper than reading the leaves again and again
+  if (!parsed && leafReads >= nameTreeMaxLeafReads) {
+    numEntries();
+    for (i = 0; i < nameTreeLeafCacheSize; ++i) {
+      leaves[i].node = NULL;
+      leaves[i].names.free();
+      leaves[i].names.initNull();
+    }
+    if (rootNode) {
+      freeNode(rootNode);
+      rootNode = NULL;
+    }
+  }
+
+  if (parsed) {
+    entry = (Entry **) bsearch(name, entries,
+			       length, sizeof(Entry *), Entry::cmp);
+    if (entry != NULL) {
+      (*entry)->value.fetch(xref, obj);
+      return gTrue;
+    }
+  } else if (root.isDict()) {
+    if (!rootNode) {
+      rootNode = makeNode(&root);
+    }
+    if (lookupInNode(rootNode, name, obj, 0)) {
+      return gTrue;
+    }
+  }
+  obj->initNull();
+  return gFalse;
+}
+
+int NameTree::numEntries()
+{
+  if (!parsed) {
+    parse(&root);
+    parsed = gTrue;
+  }
+  return length;
 }
 
 Object NameTree::getValue(int index)
 {
-  if (index < length) {
+  if (index < numEntries()) {
     return entries[index]->value;
   } else {
     return Object();
@@ -584,7 +888,7 @@ Object NameTree::getValue(int index)
 
 GooString *NameTree::getName(int index)
 {
-    if (index < length) {
+    if (index < numEntries()) {
 	return &entries[index]->name;
     } else {
 	return NULL;
@@ -599,6 +903,16 @@ void NameTree::free()
     delete entries[i];
 
   gfree(entries);
+  if (leaves) {
+    for (i = 0; i < nameTreeLeafCacheSize; ++i) {
+      leaves[i].names.free();
+    }
+    gfree(leaves);
+  }
+  if (rootNode) {
+    freeNode(rootNode);
+  }
+  root.free();
 }
 
 GBool Catalog::labelToIndex(GooString *label, int *index)
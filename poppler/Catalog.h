@@ -30,11 +30,10 @@ class NameTree {
 public:
   NameTree();
   void init(XRef *xref, Object *tree);
-  void parse(Object *tree);
   GBool lookup(GooString *name, Object *obj);
   void free();
-  int numEntries() { return length; };
-  // iterator accessor
+  // iterator accessors -- the first call reads the whole tree
+  int numEntries();
   Object getValue(int i);
   GooString *getName(int i);
 
@@ -48,14 +47,43 @@ private:
     static int cmp(const void *key, const void *entry);
   };
 
+  // node of the tree, read when a lookup first visits it
+  struct Node {
+    Object ref;			// the node, as found in its parent
+    GooString *low, *high;	// /Limits, or NULL if missing
+    GBool hasNames;		// does it have a /Names array?
+    Object kids;		// /Kids array (or null)
+    Node **children;		// [length of kids]
+  };
+
+  // recently used leaf node
+  struct Leaf {
+    Node *node;
+    Object names;		// /Names array of the node
+    int lastUse;		// for LRU replacement
+  };
+
+  void parse(Object *tree);
   void addEntry(Entry *entry);
+  Node *makeNode(Object *ref);
+  void freeNode(Node *node);
+  Node *getChild(Node *node, int i);
+  GBool lookupInNode(Node *node, GooString *name, Object *obj, int depth);
+  GBool lookupInLeaf(Node *node, GooString *name, Object *obj);
+  GBool lookupInNames(Array *names, GooString *name, Object *obj);
 
   XRef *xref;
-  Object *root;
+  Object root;
+  GBool parsed;			// has the whole tree been read?
   Entry **entries;
   int size, length; // size is the number of entries in
                     // the array of Entry*
                     // length is the number of real Entry
+  Node *rootNode;		// root of the lookup tree
+  int nNodes;			// number of nodes in the lookup tree
+  Leaf *leaves;			// [nameTreeLeafCacheSize]
+  int useCount;
+  int leafReads;		// number of leaf nodes read by lookups
 };
 
 class EmbFile {
@@ -139,7 +167,7 @@ public:
   Object *getStructTreeRoot() { return &structTreeRoot; }
 
   // Find a page, given its object ID.  Returns page number, or 0 if
-  // not found.
+  // not found.  The first call builds a hash table of the page refs.
   int findPage(int num, int gen);
 
   // Find a named destination.  Returns the link destination, or
@@ -191,6 +219,9 @@ private:
   XRef *xref;			// the xref table for this PDF file
   Page **pages;			// array of pages
   Ref *pageRefs;		// object ID for each page
+  int *pageRefHash;		// page refs hash table, for findPage: each
+				//   slot is a page number, or 0 if unused
+  int pageRefHashSize;		// size of pageRefHash (a power of 2)
   Form *form;
   int numPages;			// number of pages
   int pagesSize;		// size of pages array
@@ -209,6 +240,7 @@ private:
 
   int readPageTree(Dict *pages, PageAttrs *attrs, int start,
 		   char *alreadyRead);
+  void buildPageRefHash();
   Object *findDestInTree(Object *tree, GooString *name, Object *obj);
 };
 
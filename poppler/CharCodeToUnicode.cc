@@ -26,6 +26,11 @@
 
 #define maxUnicodeString 8
 
+#define ctuCompiledMagic "%PCU"		// compiled mappings start with this,
+#define ctuCompiledOrder 0x01020304	//   this word (to check the byte
+#define ctuCompiledVersion 1		//   order), and the version
+#define ctuCompiledHeader 8		// header size, in words
+
 struct CharCodeToUnicodeString {
   CharCode c;
   Unicode u[maxUnicodeString];
@@ -55,7 +60,8 @@ static int getCharFromFile(void *data) {
 //------------------------------------------------------------------------
 
 CharCodeToUnicode *CharCodeToUnicode::parseCIDToUnicode(GooString *fileName,
-							GooString *collection) {
+							GooString *collection,
+							GooString *compiledName) {
   FILE *f;
   Unicode *mapA;
   CharCode size, mapLenA;
@@ -68,6 +74,11 @@ CharCodeToUnicode *CharCodeToUnicode::parseCIDToUnicode(GooString *fileName,
 	  fileName->getCString());
     return NULL;
   }
+  if (compiledName &&
+      (ctu = loadCompiled(compiledName, collection, f, 0))) {
+    fclose(f);
+    return ctu;
+  }
 
   size = 32768;
   mapA = (Unicode *)gmallocn(size, sizeof(Unicode));
@@ -87,11 +98,14 @@ CharCodeToUnicode *CharCodeToUnicode::parseCIDToUnicode(GooString *fileName,
     }
     ++mapLenA;
   }
-  fclose(f);
 
   ctu = new CharCodeToUnicode(collection->copy(), mapA, mapLenA, gTrue,
 			      NULL, 0, 0);
   gfree(mapA);
+  if (compiledName) {
+    ctu->writeCompiled(compiledName, f, 0);
+  }
+  fclose(f);
   return ctu;
 }
 
@@ -200,13 +214,31 @@ CharCodeToUnicode *CharCodeToUnicode::parseCMap(GooString *buf, int nBits) {
 CharCodeToUnicode *CharCodeToUnicode::parseCMapFromFile(GooString *fileName,
   int nBits) {
   CharCodeToUnicode *ctu;
+  GooString *name, *compiledName;
   FILE *f;
 
-  ctu = new CharCodeToUnicode(NULL);
   if ((f = globalParams->findToUnicodeFile(fileName))) {
-    ctu->parseCMap1(&getCharFromFile, f, nBits);
+    name = GooString::format("{0:t}.{1:d}.toUnicode", fileName, nBits);
+    compiledName = globalParams->getCMapCacheFile(name);
+    delete name;
+    if (compiledName &&
+	(ctu = loadCompiled(compiledName, NULL, f, nBits))) {
+      delete compiledName;
+      fclose(f);
+      return ctu;
+    }
+    ctu = new CharCodeToUnicode(NULL);
+    // mappings which include other files aren't compiled, since
+    // changes to those files wouldn't be noticed
+    if (!ctu->parseCMap1(&getCharFromFile, f, nBits) && compiledName) {
+      ctu->writeCompiled(compiledName, f, nBits);
+    }
+    if (compiledName) {
+      delete compiledName;
+    }
     fclose(f);
   } else {
+    ctu = new CharCodeToUnicode(NULL);
     error(-1, "Couldn't find ToUnicode CMap file for '%s'",
 	  fileName->getCString());
   }
@@ -220,8 +252,9 @@ void CharCodeToUnicode::mergeCMap(GooString *buf, int nBits) {
   parseCMap1(&getCharFromString, &p, nBits);
 }
 
-void CharCodeToUnicode::parseCMap1(int (*getCharFunc)(void *), void *data,
-				   int nBits) {
+// Returns true if the CMap included other files with usecmap.
+GBool CharCodeToUnicode::parseCMap1(int (*getCharFunc)(void *), void *data,
+				    int nBits) {
   PSTokenizer *pst;
   char tok1[256], tok2[256], tok3[256];
   int nDigits, n1, n2, n3;
@@ -229,14 +262,17 @@ void CharCodeToUnicode::parseCMap1(int (*getCharFunc)(void *), void *data,
   CharCode code1, code2;
   GooString *name;
   FILE *f;
+  GBool used;
 
   nDigits = nBits / 4;
+  used = gFalse;
   pst = new PSTokenizer(getCharFunc, data);
   pst->getToken(tok1, sizeof(tok1), &n1);
   while (pst->getToken(tok2, sizeof(tok2), &n2)) {
     if (!strcmp(tok2, "usecmap")) {
       if (tok1[0] == '/') {
 	name = new GooString(tok1 + 1);
+	used = gTrue;
 	if ((f = globalParams->findToUnicodeFile(name))) {
 	  parseCMap1(&getCharFromFile, f, nBits);
 	  fclose(f);
@@ -324,19 +360,29 @@ void CharCodeToUnicode::parseCMap1(int (*getCharFunc)(void *), void *data,
     }
   }
   delete pst;
+  return used;
 }
 
 void CharCodeToUnicode::addMapping(CharCode code, char *uStr, int n,
 				   int offset) {
   CharCode oldLen, i;
   Unicode u;
+  Unicode *u2;
   char uHex[5];
   int j;
 
   if (code >= mapLen) {
     oldLen = mapLen;
     mapLen = (code + 256) & ~255;
-    map = (Unicode *)greallocn(map, mapLen, sizeof(Unicode));
+    if (compiled) {
+      u2 = (Unicode *)gmallocn(mapLen, sizeof(Unicode));
+      memcpy(u2, map, oldLen * sizeof(Unicode));
+      map = u2;
+      unmapFile(compiled, compiledLen);
+      compiled = NULL;
+    } else {
+      map = (Unicode *)greallocn(map, mapLen, sizeof(Unicode));
+    }
     for (i = oldLen; i < mapLen; ++i) {
       map[i] = 0;
     }
@@ -368,6 +414,92 @@ void CharCodeToUnicode::addMapping(CharCode code, char *uStr, int n,
   }
 }
 
+// Compiled mappings are made of native-endian 32-bit words:
+//   magic, byte order, version, source file size, source file mtime,
+//   nBits (0 for cidToUnicode files), mapLen, sMapLen,
+//   mapLen * map entry, sMapLen * (code, len, maxUnicodeString * Unicode)
+// The map is used in place, without copying.
+CharCodeToUnicode *CharCodeToUnicode::loadCompiled(GooString *compiledName,
+						   GooString *tagA, FILE *src,
+						   int nBits) {
+  CharCodeToUnicode *ctu;
+  CharCodeToUnicodeString *sMapA;
+  void *p;
+  Guint *w;
+  Guint len, nWords, size, mapLenA, sMapLenA, i, j;
+  time_t mtime;
+
+  if (!getFileInfo(src, &size, &mtime) ||
+      !(p = mapFile(compiledName->getCString(), &len))) {
+    return NULL;
+  }
+  w = (Guint *)p;
+  nWords = len / 4;
+  if (nWords < ctuCompiledHeader || memcmp(p, ctuCompiledMagic, 4) ||
+      w[1] != ctuCompiledOrder || w[2] != ctuCompiledVersion ||
+      w[3] != size || w[4] != (Guint)mtime || w[5] != (Guint)nBits ||
+      (mapLenA = w[6]) > nWords - ctuCompiledHeader ||
+      (sMapLenA = w[7]) > (nWords - ctuCompiledHeader - mapLenA) /
+	                  (2 + maxUnicodeString)) {
+    unmapFile(p, len);
+    return NULL;
+  }
+  sMapA = NULL;
+  if (sMapLenA) {
+    sMapA = (CharCodeToUnicodeString *)
+              gmallocn(sMapLenA, sizeof(CharCodeToUnicodeString));
+    w += ctuCompiledHeader + mapLenA;
+    for (i = 0; i < sMapLenA; ++i) {
+      sMapA[i].c = w[0];
+      sMapA[i].len = w[1] < maxUnicodeString ? (int)w[1] : maxUnicodeString;
+      for (j = 0; j < maxUnicodeString; ++j) {
+	sMapA[i].u[j] = w[2 + j];
+      }
+      w += 2 + maxUnicodeString;
+    }
+  }
+  ctu = new CharCodeToUnicode(tagA ? tagA->copy() : (GooString *)NULL,
+			      (Unicode *)p + ctuCompiledHeader, mapLenA,
+			      gFalse, sMapA, sMapLenA, sMapLenA);
+  ctu->compiled = p;
+  ctu->compiledLen = len;
+  return ctu;
+}
+
+void CharCodeToUnicode::writeCompiled(GooString *compiledName, FILE *src,
+				      int nBits) {
+  Guint *w, *q;
+  Guint nWords, size;
+  time_t mtime;
+  int i, j;
+
+  if (!getFileInfo(src, &size, &mtime)) {
+    return;
+  }
+  nWords = ctuCompiledHeader + mapLen + sMapLen * (2 + maxUnicodeString);
+  w = (Guint *)gmallocn(nWords, sizeof(Guint));
+  memcpy(w, ctuCompiledMagic, 4);
+  w[1] = ctuCompiledOrder;
+  w[2] = ctuCompiledVersion;
+  w[3] = size;
+  w[4] = (Guint)mtime;
+  w[5] = (Guint)nBits;
+  w[6] = mapLen;
+  w[7] = (Guint)sMapLen;
+  memcpy(w + ctuCompiledHeader, map, mapLen * sizeof(Unicode));
+  q = w + ctuCompiledHeader + mapLen;
+  for (i = 0; i < sMapLen; ++i) {
+    q[0] = sMap[i].c;
+    q[1] = (Guint)sMap[i].len;
+    for (j = 0; j < maxUnicodeString; ++j) {
+      q[2 + j] = j < sMap[i].len ? sMap[i].u[j] : 0;
+    }
+    q += 2 + maxUnicodeString;
+  }
+  writeFileAtomic(compiledName->getCString(), w, nWords * sizeof(Guint));
+  gfree(w);
+}
+
 CharCodeToUnicode::CharCodeToUnicode(GooString *tagA) {
   CharCode i;
 
@@ -379,6 +511,8 @@ CharCodeToUnicode::CharCodeToUnicode(GooString *tagA) {
   }
   sMap = NULL;
   sMapLen = sMapSize = 0;
+  compiled = NULL;
+  compiledLen = 0;
   refCnt = 1;
 #if MULTITHREADED
   gInitMutex(&mutex);
@@ -400,6 +534,8 @@ CharCodeToUnicode::CharCodeToUnicode(GooString *tagA, Unicode *mapA,
   sMap = sMapA;
   sMapLen = sMapLenA;
   sMapSize = sMapSizeA;
+  compiled = NULL;
+  compiledLen = 0;
   refCnt = 1;
 #if MULTITHREADED
   gInitMutex(&mutex);
@@ -410,7 +546,11 @@ CharCodeToUnicode::~CharCodeToUnicode() {
   if (tag) {
     delete tag;
   }
-  gfree(map);
+  if (compiled) {
+    unmapFile(compiled, compiledLen);
+  } else {
+    gfree(map);
+  }
   if (sMap) {
     gfree(sMap);
   }
@@ -15,7 +15,9 @@
 #pragma interface
 #endif
 
+#include <stdio.h>
 #include "poppler-config.h"
+#include "goo/gtypes.h"
 #include "CharTypes.h"
 
 #if MULTITHREADED
@@ -32,9 +34,12 @@ public:
 
   // Read the CID-to-Unicode mapping for <collection> from the file
   // specified by <fileName>.  Sets the initial reference count to 1.
-  // Returns NULL on failure.
+  // Returns NULL on failure.  If <compiledName> is not NULL, the
+  // mapping is read from that compiled file if it is up to date, and
+  // written to it otherwise.
   static CharCodeToUnicode *parseCIDToUnicode(GooString *fileName,
-					      GooString *collection);
+					      GooString *collection,
+					      GooString *compiledName = NULL);
 
   // Create a Unicode-to-Unicode mapping from the file specified by
   // <fileName>.  Sets the initial reference count to 1.  Returns NULL
@@ -46,7 +51,9 @@ public:
   // reference count to 1.
   static CharCodeToUnicode *make8BitToUnicode(Unicode *toUnicode);
 
-  // Parse a ToUnicode CMap for an 8- or 16-bit font.
+  // Parse a ToUnicode CMap for an 8- or 16-bit font.  The compiled
+  // form of CMaps read from files is cached in the directory set with
+  // GlobalParams::setCMapCacheDir, if any.
   static CharCodeToUnicode *parseCMap(GooString *buf, int nBits);
   static CharCodeToUnicode *parseCMapFromFile(GooString *fileName, int nBits);
 
@@ -76,8 +83,12 @@ public:
 
 private:
 
-  void parseCMap1(int (*getCharFunc)(void *), void *data, int nBits);
+  GBool parseCMap1(int (*getCharFunc)(void *), void *data, int nBits);
   void addMapping(CharCode code, char *uStr, int n, int offset);
+  static CharCodeToUnicode *loadCompiled(GooString *compiledName,
+					 GooString *tagA, FILE *src,
+					 int nBits);
+  void writeCompiled(GooString *compiledName, FILE *src, int nBits);
   CharCodeToUnicode(GooString *tagA);
   CharCodeToUnicode(GooString *tagA, Unicode *mapA,
 		    CharCode mapLenA, GBool copyMap,
@@ -87,6 +98,8 @@ private:
   GooString *tag;
   Unicode *map;
   CharCode mapLen;
+  void *compiled;		// mapped compiled file <map> points into
+  Guint compiledLen;		//   (NULL if <map> is allocated)
   CharCodeToUnicodeString *sMap;
   int sMapLen, sMapSize;
   int refCnt;
@@ -20,7 +20,7 @@ static void rc4InitKey(Guchar *key, int keyLen, Guchar *state);
 static Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c);
 static void aesKeyExpansion(DecryptAESState *s,
 			    Guchar *objKey, int objKeyLen);
-static void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last);
+static void aesDecryptBlock(Guint *w, Guchar *cbc, Guchar *blk);
 static void md5(Guchar *msg, int msgLen, Guchar *digest);
 
 static Guchar passwordPad[32] = {
@@ -177,20 +177,10 @@ GBool Decrypt::makeFileKey2(int encVersion, int encRevision, int keyLength,
   return ok;
 }
 
-//------------------------------------------------------------------------
-// DecryptStream
-//------------------------------------------------------------------------
-
-DecryptStream::DecryptStream(Stream *strA, Guchar *fileKey,
-			     CryptAlgorithm algoA, int keyLength,
-			     int objNum, int objGen):
-  FilterStream(strA)
-{
+int Decrypt::makeObjKey(Guchar *fileKey, CryptAlgorithm algo, int keyLength,
+			int objNum, int objGen, Guchar *objKey) {
   int n, i;
 
-  algo = algoA;
-
-  // construct object key
   for (i = 0; i < keyLength; ++i) {
     objKey[i] = fileKey[i];
   }
@@ -209,106 +199,144 @@ DecryptStream::DecryptStream(Stream *strA, Guchar *fileKey,
     n = keyLength + 5;
   }
   md5(objKey, n, objKey);
-  if ((objKeyLength = keyLength + 5) > 16) {
-    objKeyLength = 16;
+  if ((n = keyLength + 5) > 16) {
+    n = 16;
   }
+  return n;
+}
+
+//------------------------------------------------------------------------
+// DecryptStream
+//------------------------------------------------------------------------
+
+DecryptStream::DecryptStream(Stream *strA, Guchar *fileKey,
+			     CryptAlgorithm algoA, int keyLength,
+			     int objNum, int objGen):
+  FilterStream(strA)
+{
+  algo = algoA;
+  objKeyLength = Decrypt::makeObjKey(fileKey, algo, keyLength,
+				     objNum, objGen, objKey);
+  initKeySchedule();
+}
+
+DecryptStream::DecryptStream(Stream *strA, Guchar *objKeyA,
+			     int objKeyLengthA, CryptAlgorithm algoA):
+  FilterStream(strA)
+{
+  algo = algoA;
+  objKeyLength = objKeyLengthA;
+  memcpy(objKey, objKeyA, objKeyLength);
+  initKeySchedule();
 }
 
 DecryptStream::~DecryptStream() {
   delete str;
 }
 
-void DecryptStream::reset() {
-  int i;
-
-  str->reset();
+void DecryptStream::initKeySchedule() {
   switch (algo) {
   case cryptRC4:
-    state.rc4.x = state.rc4.y = 0;
-    rc4InitKey(objKey, objKeyLength, state.rc4.state);
-    state.rc4.buf = EOF;
+    initState.rc4.x = initState.rc4.y = 0;
+    rc4InitKey(objKey, objKeyLength, initState.rc4.state);
     break;
   case cryptAES:
-    aesKeyExpansion(&state.aes, objKey, objKeyLength);
-    for (i = 0; i < 16; ++i) {
-      state.aes.cbc[i] = str->getChar();
-    }
-    state.aes.bufIdx = 16;
+    aesKeyExpansion(&initState.aes, objKey, objKeyLength);
     break;
   }
+  bufPtr = bufEnd = buf;
+  bufPos = 0;
 }
 
-int DecryptStream::getChar() {
-  Guchar in[16];
-  int c, i;
+void DecryptStream::reset() {
+  int n;
+
+  str->reset();
+  state = initState;
+  if (algo == cryptAES) {
+    // the first block is the CBC initialization vector
+    n = str->getChars(16, state.aes.cbc);
+    if (n < 16) {
+      memset(state.aes.cbc + n, 0xff, 16 - n);
+    }
+  }
+  bufPtr = bufEnd = buf;
+}
+
+GBool DecryptStream::fillBuf() {
+  Guchar *p;
+  Guchar x, y, tx, ty;
+  GBool last;
+  int n, pad, i;
+
+  bufPtr = bufEnd = buf;
+  bufPos = str->getPos();
+  n = str->getChars(decryptStreamBufSize, buf);
+  if (n <= 0) {
+    return gFalse;
+  }
 
-  c = EOF; // make gcc happy
   switch (algo) {
   case cryptRC4:
-    if (state.rc4.buf == EOF) {
-      c = str->getChar();
-      if (c != EOF) {
-	state.rc4.buf = rc4DecryptByte(state.rc4.state, &state.rc4.x,
-				       &state.rc4.y, (Guchar)c);
-      }
+    p = state.rc4.state;
+    x = state.rc4.x;
+    y = state.rc4.y;
+    for (i = 0; i < n; ++i) {
+      x = (Guchar)(x + 1);
+      tx = p[x];
+      y = (Guchar)(y + tx);
+      ty = p[y];
+      p[x] = ty;
+      p[y] = tx;
+      buf[i] ^= p[(Guchar)(tx + ty)];
     }
-    c = state.rc4.buf;
-    state.rc4.buf = EOF;
+    state.rc4.x = x;
+    state.rc4.y = y;
     break;
+
   case cryptAES:
-    if (state.aes.bufIdx == 16) {
-      for (i = 0; i < 16; ++i) {
-	if ((c = str->getChar()) == EOF) {
-	  return EOF;
-	}
-	in[i] = (Guchar)c;
-      }
-      aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
-    }
-    if (state.aes.bufIdx == 16) {
-      c = EOF;
+    // the padding is only removed from the final block -- a trailing
+    // partial block is dropped, which also means there is no padding
+    if (n == decryptStreamBufSize) {
+      last = str->lookChar() == EOF;
     } else {
-      c = state.aes.buf[state.aes.bufIdx++];
+      last = (n & 15) == 0;
+    }
+    n &= ~15;
+    for (i = 0; i < n; i += 16) {
+      aesDecryptBlock(state.aes.w, state.aes.cbc, buf + i);
+    }
+    if (last && n > 0) {
+      pad = buf[n - 1];
+      if (pad > 16) {
+	pad = 16;
+      }
+      n -= pad;
     }
     break;
   }
-  return c;
+
+  bufEnd = buf + n;
+  return n > 0;
 }
 
-int DecryptStream::lookChar() {
-  Guchar in[16];
-  int c, i;
+int DecryptStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
 
-  c = EOF; // make gcc happy
-  switch (algo) {
-  case cryptRC4:
-    if (state.rc4.buf == EOF) {
-      c = str->getChar();
-      if (c != EOF) {
-	state.rc4.buf = rc4DecryptByte(state.rc4.state, &state.rc4.x,
-				       &state.rc4.y, (Guchar)c);
-      }
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
     }
-    c = state.rc4.buf;
-    break;
-  case cryptAES:
-    if (state.aes.bufIdx == 16) {
-      for (i = 0; i < 16; ++i) {
-	if ((c = str->getChar()) == EOF) {
-	  return EOF;
-	}
-	in[i] = c;
-      }
-      aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
-    }
-    if (state.aes.bufIdx == 16) {
-      c = EOF;
-    } else {
-      c = state.aes.buf[state.aes.bufIdx];
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
     }
-    break;
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
   }
-  return c;
+  return n;
 }
 
 GBool DecryptStream::isBinary(GBool last) {
@@ -415,37 +443,6 @@ static inline Guint rotWord(Guint x) {
   return ((x << 8) & 0xffffffff) | (x >> 24);
 }
 
-static inline void invSubBytes(Guchar *state) {
-  int i;
-
-  for (i = 0; i < 16; ++i) {
-    state[i] = invSbox[state[i]];
-  }
-}
-
-static inline void invShiftRows(Guchar *state) {
-  Guchar t;
-
-  t = state[7];
-  state[7] = state[6];
-  state[6] = state[5];
-  state[5] = state[4];
-  state[4] = t;
-
-  t = state[8];
-  state[8] = state[10];
-  state[10] = t;
-  t = state[9];
-  state[9] = state[11];
-  state[11] = t;
-
-  t = state[12];
-  state[12] = state[13];
-  state[13] = state[14];
-  state[14] = state[15];
-  state[15] = t;
-}
-
 // {09} \cdot s
 static inline Guchar mul09(Guchar s) {
   Guchar s2, s4, s8;
@@ -486,22 +483,6 @@ static inline Guchar mul0e(Guchar s) {
   return s2 ^ s4 ^ s8;
 }
 
-static inline void invMixColumns(Guchar *state) {
-  int c;
-  Guchar s0, s1, s2, s3;
-
-  for (c = 0; c < 4; ++c) {
-    s0 = state[c];
-    s1 = state[4+c];
-    s2 = state[8+c];
-    s3 = state[12+c];
-    state[c] =    mul0e(s0) ^ mul0b(s1) ^ mul0d(s2) ^ mul09(s3);
-    state[4+c] =  mul09(s0) ^ mul0e(s1) ^ mul0b(s2) ^ mul0d(s3);
-    state[8+c] =  mul0d(s0) ^ mul09(s1) ^ mul0e(s2) ^ mul0b(s3);
-    state[12+c] = mul0b(s0) ^ mul0d(s1) ^ mul09(s2) ^ mul0e(s3);
-  }
-}
-
 static inline void invMixColumnsW(Guint *w) {
   int c;
   Guchar s0, s1, s2, s3;
@@ -518,17 +499,6 @@ static inline void invMixColumnsW(Guint *w) {
   }
 }
 
-static inline void addRoundKey(Guchar *state, Guint *w) {
-  int c;
-
-  for (c = 0; c < 4; ++c) {
-    state[c] ^= w[c] >> 24;
-    state[4+c] ^= w[c] >> 16;
-    state[8+c] ^= w[c] >> 8;
-    state[12+c] ^= w[c];
-  }
-}
-
 static void aesKeyExpansion(DecryptAESState *s,
 			    Guchar *objKey, int /*objKeyLen*/) {
   Guint temp;
@@ -552,54 +522,135 @@ static void aesKeyExpansion(DecryptAESState *s,
   }
 }
 
-static void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last) {
-  int c, round, n, i;
+// Combined InvSubBytes / InvMixColumns table: invTab0[x] is the
+// InvMixColumns transform of the column (invSbox[x], 0, 0, 0).  The
+// tables for the other three rows are byte rotations of this one.
+static Guint invTab0[256] = {
+  0x51f4a750, 0x7e416553, 0x1a17a4c3, 0x3a275e96, 0x3bab6bcb, 0x1f9d45f1,
+  0xacfa58ab, 0x4be30393, 0x2030fa55, 0xad766df6, 0x88cc7691, 0xf5024c25,
+  0x4fe5d7fc, 0xc52acbd7, 0x26354480, 0xb562a38f, 0xdeb15a49, 0x25ba1b67,
+  0x45ea0e98, 0x5dfec0e1, 0xc32f7502, 0x814cf012, 0x8d4697a3, 0x6bd3f9c6,
+  0x038f5fe7, 0x15929c95, 0xbf6d7aeb, 0x955259da, 0xd4be832d, 0x587421d3,
+  0x49e06929, 0x8ec9c844, 0x75c2896a, 0xf48e7978, 0x99583e6b, 0x27b971dd,
+  0xbee14fb6, 0xf088ad17, 0xc920ac66, 0x7dce3ab4, 0x63df4a18, 0xe51a3182,
+  0x97513360, 0x62537f45, 0xb16477e0, 0xbb6bae84, 0xfe81a01c, 0xf9082b94,
+  0x70486858, 0x8f45fd19, 0x94de6c87, 0x527bf8b7, 0xab73d323, 0x724b02e2,
+  0xe31f8f57, 0x6655ab2a, 0xb2eb2807, 0x2fb5c203, 0x86c57b9a, 0xd33708a5,
+  0x302887f2, 0x23bfa5b2, 0x02036aba, 0xed16825c, 0x8acf1c2b, 0xa779b492,
+  0xf307f2f0, 0x4e69e2a1, 0x65daf4cd, 0x0605bed5, 0xd134621f, 0xc4a6fe8a,
+  0x342e539d, 0xa2f355a0, 0x058ae132, 0xa4f6eb75, 0x0b83ec39, 0x4060efaa,
+  0x5e719f06, 0xbd6e1051, 0x3e218af9, 0x96dd063d, 0xdd3e05ae, 0x4de6bd46,
+  0x91548db5, 0x71c45d05, 0x0406d46f, 0x605015ff, 0x1998fb24, 0xd6bde997,
+  0x894043cc, 0x67d99e77, 0xb0e842bd, 0x07898b88, 0xe7195b38, 0x79c8eedb,
+  0xa17c0a47, 0x7c420fe9, 0xf8841ec9, 0x00000000, 0x09808683, 0x322bed48,
+  0x1e1170ac, 0x6c5a724e, 0xfd0efffb, 0x0f853856, 0x3daed51e, 0x362d3927,
+  0x0a0fd964, 0x685ca621, 0x9b5b54d1, 0x24362e3a, 0x0c0a67b1, 0x9357e70f,
+  0xb4ee96d2, 0x1b9b919e, 0x80c0c54f, 0x61dc20a2, 0x5a774b69, 0x1c121a16,
+  0xe293ba0a, 0xc0a02ae5, 0x3c22e043, 0x121b171d, 0x0e090d0b, 0xf28bc7ad,
+  0x2db6a8b9, 0x141ea9c8, 0x57f11985, 0xaf75074c, 0xee99ddbb, 0xa37f60fd,
+  0xf701269f, 0x5c72f5bc, 0x44663bc5, 0x5bfb7e34, 0x8b432976, 0xcb23c6dc,
+  0xb6edfc68, 0xb8e4f163, 0xd731dcca, 0x42638510, 0x13972240, 0x84c61120,
+  0x854a247d, 0xd2bb3df8, 0xaef93211, 0xc729a16d, 0x1d9e2f4b, 0xdcb230f3,
+  0x0d8652ec, 0x77c1e3d0, 0x2bb3166c, 0xa970b999, 0x119448fa, 0x47e96422,
+  0xa8fc8cc4, 0xa0f03f1a, 0x567d2cd8, 0x223390ef, 0x87494ec7, 0xd938d1c1,
+  0x8ccaa2fe, 0x98d40b36, 0xa6f581cf, 0xa57ade28, 0xdab78e26, 0x3fadbfa4,
+  0x2c3a9de4, 0x5078920d, 0x6a5fcc9b, 0x547e4662, 0xf68d13c2, 0x90d8b8e8,
+  0x2e39f75e, 0x82c3aff5, 0x9f5d80be, 0x69d0937c, 0x6fd52da9, 0xcf2512b3,
+  0xc8ac993b, 0x10187da7, 0xe89c636e, 0xdb3bbb7b, 0xcd267809, 0x6e5918f4,
+  0xec9ab701, 0x834f9aa8, 0xe6956e65, 0xaaffe67e, 0x21bccf08, 0xef15e8e6,
+  0xbae79bd9, 0x4a6f36ce, 0xea9f09d4, 0x29b07cd6, 0x31a4b2af, 0x2a3f2331,
+  0xc6a59430, 0x35a266c0, 0x744ebc37, 0xfc82caa6, 0xe090d0b0, 0x33a7d815,
+  0xf104984a, 0x41ecdaf7, 0x7fcd500e, 0x1791f62f, 0x764dd68d, 0x43efb04d,
+  0xccaa4d54, 0xe49604df, 0x9ed1b5e3, 0x4c6a881b, 0xc12c1fb8, 0x4665517f,
+  0x9d5eea04, 0x018c355d, 0xfa877473, 0xfb0b412e, 0xb3671d5a, 0x92dbd252,
+  0xe9105633, 0x6dd64713, 0x9ad7618c, 0x37a10c7a, 0x59f8148e, 0xeb133c89,
+  0xcea927ee, 0xb761c935, 0xe11ce5ed, 0x7a47b13c, 0x9cd2df59, 0x55f2733f,
+  0x1814ce79, 0x73c737bf, 0x53f7cdea, 0x5ffdaa5b, 0xdf3d6f14, 0x7844db86,
+  0xcaaff381, 0xb968c43e, 0x3824342c, 0xc2a3405f, 0x161dc372, 0xbce2250c,
+  0x283c498b, 0xff0d9541, 0x39a80171, 0x080cb3de, 0xd8b4e49c, 0x6456c190,
+  0x7bcb8461, 0xd532b670, 0x486c5c74, 0xd0b85742
+};
 
-  // initial state
-  for (c = 0; c < 4; ++c) {
-    s->state[c] = in[4*c];
-    s->state[4+c] = in[4*c+1];
-    s->state[8+c] = in[4*c+2];
-    s->state[12+c] = in[4*c+3];
-  }
+static inline Guint rotr8(Guint x) {
+  return (x >> 8) | (x << 24);
+}
+
+static inline Guint invTab(Guint s0, Guint s1, Guint s2, Guint s3) {
+  return invTab0[s0 >> 24]
+         ^ rotr8(invTab0[(s1 >> 16) & 0xff]
+		 ^ rotr8(invTab0[(s2 >> 8) & 0xff]
+			 ^ rotr8(invTab0[s3 & 0xff])));
+}
 
-  // round 0
-  addRoundKey(s->state, &s->w[10 * 4]);
+static inline Guint invLast(Guint s0, Guint s1, Guint s2, Guint s3) {
+  return ((Guint)invSbox[s0 >> 24] << 24)
+         | ((Guint)invSbox[(s1 >> 16) & 0xff] << 16)
+         | ((Guint)invSbox[(s2 >> 8) & 0xff] << 8)
+         | (Guint)invSbox[s3 & 0xff];
+}
+
+// Decrypt the 16-byte block <blk> in place, using (and updating) the
+// CBC chaining value <cbc>.  Each column of the state is kept in a
+// 32-bit word, with row 0 in the high byte.
+static void aesDecryptBlock(Guint *w, Guchar *cbc, Guchar *blk) {
+  Guint s0, s1, s2, s3, t0, t1, t2, t3;
+  Guint *rk;
+  Guchar out[16];
+  Guchar c;
+  int round, i;
+
+  // initial state + round 0
+  rk = &w[10 * 4];
+  s0 = (((Guint)blk[0] << 24) | ((Guint)blk[1] << 16) |
+	((Guint)blk[2] << 8) | (Guint)blk[3]) ^ rk[0];
+  s1 = (((Guint)blk[4] << 24) | ((Guint)blk[5] << 16) |
+	((Guint)blk[6] << 8) | (Guint)blk[7]) ^ rk[1];
+  s2 = (((Guint)blk[8] << 24) | ((Guint)blk[9] << 16) |
+	((Guint)blk[10] << 8) | (Guint)blk[11]) ^ rk[2];
+  s3 = (((Guint)blk[12] << 24) | ((Guint)blk[13] << 16) |
+	((Guint)blk[14] << 8) | (Guint)blk[15]) ^ rk[3];
 
   // rounds 1-9
   for (round = 9; round >= 1; --round) {
-    invSubBytes(s->state);
-    invShiftRows(s->state);
-    invMixColumns(s->state);
-    addRoundKey(s->state, &s->w[round * 4]);
+    rk = &w[round * 4];
+    t0 = invTab(s0, s3, s2, s1) ^ rk[0];
+    t1 = invTab(s1, s0, s3, s2) ^ rk[1];
+    t2 = invTab(s2, s1, s0, s3) ^ rk[2];
+    t3 = invTab(s3, s2, s1, s0) ^ rk[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
   }
 
   // round 10
-  invSubBytes(s->state);
-  invShiftRows(s->state);
-  addRoundKey(s->state, &s->w[0]);
-
-  // CBC
-  for (c = 0; c < 4; ++c) {
-    s->buf[4*c] = s->state[c] ^ s->cbc[4*c];
-    s->buf[4*c+1] = s->state[4+c] ^ s->cbc[4*c+1];
-    s->buf[4*c+2] = s->state[8+c] ^ s->cbc[4*c+2];
-    s->buf[4*c+3] = s->state[12+c] ^ s->cbc[4*c+3];
-  }
-
-  // save the input block for the next CBC
+  t0 = invLast(s0, s3, s2, s1) ^ w[0];
+  t1 = invLast(s1, s0, s3, s2) ^ w[1];
+  t2 = invLast(s2, s1, s0, s3) ^ w[2];
+  t3 = invLast(s3, s2, s1, s0) ^ w[3];
+
+  out[0] = (Guchar)(t0 >> 24);
+  out[1] = (Guchar)(t0 >> 16);
+  out[2] = (Guchar)(t0 >> 8);
+  out[3] = (Guchar)t0;
+  out[4] = (Guchar)(t1 >> 24);
+  out[5] = (Guchar)(t1 >> 16);
+  out[6] = (Guchar)(t1 >> 8);
+  out[7] = (Guchar)t1;
+  out[8] = (Guchar)(t2 >> 24);
+  out[9] = (Guchar)(t2 >> 16);
+  out[10] = (Guchar)(t2 >> 8);
+  out[11] = (Guchar)t2;
+  out[12] = (Guchar)(t3 >> 24);
+  out[13] = (Guchar)(t3 >> 16);
+  out[14] = (Guchar)(t3 >> 8);
+  out[15] = (Guchar)t3;
+
+  // CBC -- and save the input block for the next CBC
   for (i = 0; i < 16; ++i) {
-    s->cbc[i] = in[i];
-  }
-
-  // remove padding
-  s->bufIdx = 0;
-  if (last) {
-    n = s->buf[15];
-    for (i = 15; i >= n; --i) {
-      s->buf[i] = s->buf[i-n];
-    }
-    s->bufIdx = n;
+    c = blk[i];
+    blk[i] = out[i] ^ cbc[i];
+    cbc[i] = c;
   }
 }
 
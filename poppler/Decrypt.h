@@ -37,6 +37,12 @@ public:
 			   Guchar *fileKey, GBool encryptMetadata,
 			   GBool *ownerPasswordOk);
 
+  // Generate the key for object <objNum>/<objGen> from the file key.
+  // The <objKey> buffer must have space for at least 16 + 9 bytes.
+  // Returns the length of the object key.
+  static int makeObjKey(Guchar *fileKey, CryptAlgorithm algo, int keyLength,
+			int objNum, int objGen, Guchar *objKey);
+
 private:
 
   static GBool makeFileKey2(int encVersion, int encRevision, int keyLength,
@@ -53,41 +59,63 @@ private:
 struct DecryptRC4State {
   Guchar state[256];
   Guchar x, y;
-  int buf;
 };
 
 struct DecryptAESState {
   Guint w[44];
-  Guchar state[16];
   Guchar cbc[16];
-  Guchar buf[16];
-  int bufIdx;
 };
 
+#define decryptStreamBufSize 1024
+
 class DecryptStream: public FilterStream {
 public:
 
   DecryptStream(Stream *strA, Guchar *fileKey,
 		CryptAlgorithm algoA, int keyLength,
 		int objNum, int objGen);
+
+  // Same as above, but with an object key which has already been
+  // computed by Decrypt::makeObjKey.
+  DecryptStream(Stream *strA, Guchar *objKeyA, int objKeyLengthA,
+		CryptAlgorithm algoA);
+
   virtual ~DecryptStream();
   virtual StreamKind getKind() { return strWeird; }
   virtual void reset();
-  virtual int getChar();
-  virtual int lookChar();
+  virtual int getChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : *bufPtr++; }
+  virtual int lookChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : *bufPtr; }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int getPos()
+    { return bufPtr < bufEnd ? bufPos + (int)(bufPtr - buf) : str->getPos(); }
   virtual GBool isBinary(GBool last);
   virtual Stream *getUndecodedStream() { return this; }
 
 private:
 
+  void initKeySchedule();
+  GBool fillBuf();
+
   CryptAlgorithm algo;
   int objKeyLength;
   Guchar objKey[16 + 9];
 
+  // The RC4 key setup and the AES key expansion only depend on the
+  // object key, so they are done once by the constructor; reset()
+  // just copies <initState> to <state>.
   union {
     DecryptRC4State rc4;
     DecryptAESState aes;
-  } state;
+  } initState, state;
+
+  // decrypted data
+  Guchar buf[decryptStreamBufSize];
+  Guchar *bufPtr;
+  Guchar *bufEnd;
+  int bufPos;			// position of buf[0] in the underlying
+				//   stream
 };
 
 #endif
@@ -65,6 +65,28 @@ int FlateStream::lookChar() {
   return out_buf[out_pos];
 }
 
+int FlateStream::getChars(int nChars, Guchar *buffer) {
+  if (pred)
+    return pred->getChars(nChars, buffer);
+  else
+    return getRawChars(nChars, buffer);
+}
+
+int FlateStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars && !fill_buffer()) {
+    m = out_buf_len - out_pos;
+    if (m > nChars - n)
+      m = nChars - n;
+    memcpy(buffer + n, out_buf + out_pos, m);
+    out_pos += m;
+    n += m;
+  }
+  return n;
+}
+
 int FlateStream::fill_buffer() {
   /* only fill the buffer if it has all been used */
   if (out_pos >= out_buf_len) {
@@ -582,29 +582,40 @@ void Gfx::go(GBool topLevel) {
 	printf("\n");
 	fflush(stdout);
       }
-      GooTimer timer;
-
       // Run the operation
-      execOp(&obj, args, numArgs);
-
-      // Update the profile information
-      if (profileCommands) {
-	GooHash *hash;
-
-	hash = out->getProfileHash ();
-	if (hash) {
-	  GooString *cmd_g;
-	  ProfileData *data_p;
-
-	  cmd_g = new GooString (obj.getCmd());
-	  data_p = (ProfileData *)hash->lookup (cmd_g);
-	  if (data_p == NULL) {
-	    data_p = new ProfileData();
-	    hash->add (cmd_g, data_p);
-	  }
+      if (profileCommands || PageProfile::getActive()) {
+	GooTimer timer;
+	double elapsed;
+
+	execOp(&obj, args, numArgs);
+	elapsed = timer.getElapsed();
+
+	// Update the profile information
+	if (profileCommands) {
+	  GooHash *hash;
+
+	  hash = out->getProfileHash ();
+	  if (hash) {
+	    GooString *cmd_g;
+	    ProfileData *data_p;
+
+	    cmd_g = new GooString (obj.getCmd());
+	    data_p = (ProfileData *)hash->lookup (cmd_g);
+	    if (data_p == NULL) {
+	      data_p = new ProfileData();
+	      hash->add (cmd_g, data_p);
+	    } else {
+	      delete cmd_g;
+	    }
 	  
-	  data_p->addElement(timer.getElapsed ());
+	    data_p->addElement(elapsed);
+	  }
 	}
+	if (PageProfile::getActive()) {
+	  PageProfile::getActive()->addOp(obj.getCmd(), elapsed);
+	}
+      } else {
+	execOp(&obj, args, numArgs);
       }
       obj.free();
       for (i = 0; i < numArgs; ++i)
@@ -3333,6 +3344,7 @@ void Gfx::doShowText(GooString *s) {
 void Gfx::opXObject(Object args[], int numArgs) {
   char *name;
   Object obj1, obj2, obj3, refObj;
+  Ref ref;
 #if OPI_SUPPORT
   Object opiDict;
 #endif
@@ -3363,6 +3375,9 @@ void Gfx::opXObject(Object args[], int numArgs) {
     res->lookupXObjectNF(name, &refObj);
     if (out->useDrawForm() && refObj.isRef()) {
       out->drawForm(refObj.getRef());
+    } else if (refObj.isRef()) {
+      ref = refObj.getRef();
+      doForm(&obj1, &ref);
     } else {
       doForm(&obj1);
     }
@@ -3710,7 +3725,55 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   error(getPos(), "Bad image parameters");
 }
 
-void Gfx::doForm(Object *str) {
+static inline Guint hashFormBytes(Guint h, void *p, int n) {
+  int i;
+
+  // FNV-1a
+  for (i = 0; i < n; ++i) {
+    h = (h ^ ((Guchar *)p)[i]) * 16777619U;
+  }
+  return h;
+}
+
+// Hash the parts of the graphics state which a form inherits and
+// which affect how it is drawn (other than the CTM and clip, and the
+// colors, which depend on the output device's color conversion and
+// are hashed by the device).
+static Guint hashFormState(GfxState *state) {
+  GfxFont *font;
+  double *dash;
+  double d[9];
+  int n[6];
+  double start;
+  int dashLength;
+  Guint h;
+
+  h = 2166136261U;
+  state->getLineDash(&dash, &dashLength, &start);
+  h = hashFormBytes(h, dash, dashLength * sizeof(double));
+  font = state->getFont();
+  d[0] = state->getLineWidth();
+  d[1] = state->getMiterLimit();
+  d[2] = start;
+  d[3] = state->getFontSize();
+  d[4] = state->getCharSpace();
+  d[5] = state->getWordSpace();
+  d[6] = state->getHorizScaling();
+  d[7] = state->getLeading();
+  d[8] = state->getRise();
+  h = hashFormBytes(h, d, sizeof(d));
+  h = hashFormBytes(h, state->getTextMat(), 6 * sizeof(double));
+  n[0] = state->getFlatness();
+  n[1] = state->getLineJoin();
+  n[2] = state->getLineCap();
+  n[3] = state->getRender();
+  n[4] = font ? font->getID()->num : -1;
+  n[5] = font ? font->getID()->gen : -1;
+  h = hashFormBytes(h, n, sizeof(n));
+  return h;
+}
+
+void Gfx::doForm(Object *str, Ref *id) {
   Dict *dict;
   GBool transpGroup, isolated, knockout;
   GfxColorSpace *blendingColorSpace;
@@ -3718,6 +3781,7 @@ void Gfx::doForm(Object *str) {
   double m[6], bbox[4];
   Object resObj;
   Dict *resDict;
+  Ref *cacheID;
   Object obj1, obj2, obj3;
   int i;
 
@@ -3792,10 +3856,26 @@ void Gfx::doForm(Object *str) {
   }
   obj1.free();
 
+  // the output device can draw a form XObject from a cached bitmap
+  // if it is composited with the normal blend mode at full opacity,
+  // and isn't a non-isolated or knockout group; forms without their
+  // own resources are excluded because their resource names depend
+  // on where they are used
+  cacheID = NULL;
+  if (id && resDict && out->useFormCache() &&
+      (!transpGroup || (isolated && !knockout)) &&
+      state->getBlendMode() == gfxBlendNormal &&
+      state->getFillOpacity() == 1 && state->getStrokeOpacity() == 1 &&
+      state->getFillColorSpace()->getMode() != csPattern &&
+      state->getStrokeColorSpace()->getMode() != csPattern) {
+    cacheID = id;
+  }
+
   // draw it
   ++formDepth;
   doForm1(str, resDict, m, bbox,
-	  transpGroup, gFalse, blendingColorSpace, isolated, knockout);
+	  transpGroup, gFalse, blendingColorSpace, isolated, knockout,
+	  gFalse, NULL, NULL, cacheID);
   --formDepth;
 
   if (blendingColorSpace) {
@@ -3809,9 +3889,10 @@ void Gfx::doForm1(Object *str, Dict *resDict, double *matrix, double *bbox,
 		  GfxColorSpace *blendingColorSpace,
 		  GBool isolated, GBool knockout,
 		  GBool alpha, Function *transferFunc,
-		  GfxColor *backdropColor) {
+		  GfxColor *backdropColor, Ref *cacheID) {
   Parser *oldParser;
   double oldBaseMatrix[6];
+  GBool cached, doStore;
   int i;
 
   // push new resources on stack
@@ -3832,6 +3913,26 @@ void Gfx::doForm1(Object *str, Dict *resDict, double *matrix, double *bbox,
   out->updateCTM(state, matrix[0], matrix[1], matrix[2],
 		 matrix[3], matrix[4], matrix[5]);
 
+  // draw the form from the output device's cache, or have the device
+  // record it -- the recorded bitmap is composited like an isolated
+  // transparency group, so it replaces the form's own group
+  cached = gFalse;
+  if (cacheID) {
+    if (out->drawCachedForm(state, *cacheID, hashFormState(state), bbox,
+			    &doStore)) {
+      restoreState();
+      popResources();
+      return;
+    }
+    if (doStore && checkFormResources(resDict, 0) &&
+	checkInheritedResources()) {
+      cached = out->beginCachedForm(state, bbox);
+    }
+    if (cached) {
+      transpGroup = gFalse;
+    }
+  }
+
   // set form bounding box
   state->moveTo(bbox[0], bbox[1]);
   state->lineTo(bbox[2], bbox[1]);
@@ -3871,6 +3972,8 @@ void Gfx::doForm1(Object *str, Dict *resDict, double *matrix, double *bbox,
 
   if (softMask || transpGroup) {
     out->endTransparencyGroup(state);
+  } else if (cached) {
+    out->endCachedForm(state);
   }
 
   // restore base matrix
@@ -3896,6 +3999,150 @@ void Gfx::doForm1(Object *str, Dict *resDict, double *matrix, double *bbox,
   return;
 }
 
+// The resource categories which can set a blend mode or soft mask, or
+// draw a knockout group, checked by checkFormResources.
+#define nFormResCats 3
+static char *formResCatNames[nFormResCats] = {
+  "ExtGState",
+  "XObject",
+  "Pattern"
+};
+
+static Object *getFormResCat(GfxResources *r, int cat) {
+  switch (cat) {
+  case 0:  return r->getGStateDict();
+  case 1:  return r->getXObjDict();
+  default: return r->getPatternDict();
+  }
+}
+
+// Returns true if a form with resources <resDict> can be rasterized
+// on its own and composited later, i.e., if it can't set a blend mode
+// or soft mask, or draw a knockout group -- directly, or through the
+// forms and patterns it uses.
+GBool Gfx::checkFormResources(Dict *resDict, int depth) {
+  Object dictObj, obj1;
+  GBool ok;
+  int cat, i;
+
+  if (depth > 4) {
+    return gFalse;
+  }
+  ok = gTrue;
+  for (cat = 0; ok && cat < nFormResCats; ++cat) {
+    resDict->lookup(formResCatNames[cat], &dictObj);
+    if (dictObj.isDict()) {
+      for (i = 0; ok && i < dictObj.dictGetLength(); ++i) {
+	ok = checkFormResource(cat, dictObj.dictGetVal(i, &obj1), depth);
+	obj1.free();
+      }
+    }
+    dictObj.free();
+  }
+  return ok;
+}
+
+// Names missing from a form's resources are looked up in the
+// resources of the content using it, so check the entries of the
+// enclosing resource dictionaries (below res) which the form can
+// reach this way, i.e., which aren't hidden by an entry of the same
+// name closer to it.
+GBool Gfx::checkInheritedResources() {
+  GfxResources *r, *r2;
+  Object *dictObj, *dictObj2;
+  Object obj1;
+  char *key;
+  GBool ok, hidden;
+  int cat, i;
+
+  ok = gTrue;
+  for (r = res->getNext(); ok && r; r = r->getNext()) {
+    for (cat = 0; ok && cat < nFormResCats; ++cat) {
+      dictObj = getFormResCat(r, cat);
+      if (!dictObj->isDict()) {
+	continue;
+      }
+      for (i = 0; ok && i < dictObj->dictGetLength(); ++i) {
+	key = dictObj->dictGetKey(i);
+	hidden = gFalse;
+	for (r2 = res; !hidden && r2 != r; r2 = r2->getNext()) {
+	  dictObj2 = getFormResCat(r2, cat);
+	  if (dictObj2->isDict()) {
+	    hidden = !dictObj2->dictLookupNF(key, &obj1)->isNull();
+	    obj1.free();
+	  }
+	}
+	if (!hidden) {
+	  ok = checkFormResource(cat, dictObj->dictGetVal(i, &obj1), 0);
+	  obj1.free();
+	}
+      }
+    }
+  }
+  return ok;
+}
+
+// Check one entry of resource category <cat> (see formResCatNames).
+GBool Gfx::checkFormResource(int cat, Object *obj, int depth) {
+  Object obj1, obj2, obj3;
+  GBool ok;
+
+  ok = gTrue;
+  switch (cat) {
+  case 0:			// ExtGState
+    if (obj->isDict()) {
+      ok = checkExtGState(obj->getDict());
+    }
+    break;
+  case 1:			// XObject
+    if (obj->isStream() &&
+	obj->streamGetDict()->lookup("Subtype", &obj1)->isName("Form")) {
+      if (obj->streamGetDict()->lookup("Group", &obj2)->isDict()) {
+	ok = !obj2.dictLookup("K", &obj3)->isBool() || !obj3.getBool();
+	obj3.free();
+      }
+      obj2.free();
+      if (ok && obj->streamGetDict()->lookup("Resources", &obj2)->isDict()) {
+	ok = checkFormResources(obj2.getDict(), depth + 1);
+      }
+      obj2.free();
+    }
+    obj1.free();
+    break;
+  case 2:			// Pattern
+    if (obj->isStream()) {
+      if (obj->streamGetDict()->lookup("Resources", &obj1)->isDict()) {
+	ok = checkFormResources(obj1.getDict(), depth + 1);
+      }
+      obj1.free();
+    } else if (obj->isDict()) {
+      if (obj->dictLookup("ExtGState", &obj1)->isDict()) {
+	ok = checkExtGState(obj1.getDict());
+      }
+      obj1.free();
+    }
+    break;
+  }
+  return ok;
+}
+
+GBool Gfx::checkExtGState(Dict *gsDict) {
+  Object obj1;
+  GfxBlendMode mode;
+  GBool ok;
+
+  ok = gTrue;
+  if (!gsDict->lookup("BM", &obj1)->isNull()) {
+    ok = state->parseBlendMode(&obj1, &mode) && mode == gfxBlendNormal;
+  }
+  obj1.free();
+  if (ok && !gsDict->lookup("SMask", &obj1)->isNull()) {
+    ok = obj1.isName("None");
+  }
+  obj1.free();
+  return ok;
+}
+
 //------------------------------------------------------------------------
 // in-line image operators
 //------------------------------------------------------------------------
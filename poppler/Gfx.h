@@ -90,6 +90,11 @@ public:
 
   GfxResources *getNext() { return next; }
 
+  // the resource dictionaries (null objects if missing)
+  Object *getXObjDict() { return &xObjDict; }
+  Object *getPatternDict() { return &patternDict; }
+  Object *getGStateDict() { return &gStateDict; }
+
 private:
 
   GfxFontDict *fonts;
@@ -278,13 +283,17 @@ private:
   // XObject operators
   void opXObject(Object args[], int numArgs);
   void doImage(Object *ref, Stream *str, GBool inlineImg);
-  void doForm(Object *str);
+  void doForm(Object *str, Ref *id = NULL);
   void doForm1(Object *str, Dict *resDict, double *matrix, double *bbox,
 	       GBool transpGroup = gFalse, GBool softMask = gFalse,
 	       GfxColorSpace *blendingColorSpace = NULL,
 	       GBool isolated = gFalse, GBool knockout = gFalse,
 	       GBool alpha = gFalse, Function *transferFunc = NULL,
-	       GfxColor *backdropColor = NULL);
+	       GfxColor *backdropColor = NULL, Ref *cacheID = NULL);
+  GBool checkFormResources(Dict *resDict, int depth);
+  GBool checkInheritedResources();
+  GBool checkFormResource(int cat, Object *obj, int depth);
+  GBool checkExtGState(Dict *gsDict);
 
   // in-line image operators
   void opBeginImage(Object args[], int numArgs);
@@ -25,6 +25,7 @@
 #include "CharCodeToUnicode.h"
 #include "FontEncodingTables.h"
 #include "BuiltinFontTables.h"
+#include "ProfileData.h"
 #include <fofi/FoFiType1.h>
 #include <fofi/FoFiType1C.h>
 #include <fofi/FoFiTrueType.h>
@@ -1816,6 +1817,7 @@ double GfxCIDFont::getWidth (char* s, int len) {
 //------------------------------------------------------------------------
 
 GfxFontDict::GfxFontDict(XRef *xref, Ref *fontDictRef, Dict *fontDict) {
+  ProfileTimer timer(profileFontLoad);
   int i;
   Object obj1, obj2;
   Ref r;
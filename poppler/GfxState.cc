@@ -223,6 +223,59 @@ void GfxColorSpace::getGrayLine(Guchar *in, unsigned char *out, int length) {
   }
 }
 
+void GfxColorSpace::getGrayByteLine(GfxColorComp *in, Guchar *out,
+				    int length) {
+  GfxColor color;
+  GfxGray gray;
+  int i, j, n;
+
+  n = getNComps();
+  for (i = 0; i < length; ++i, in += n) {
+    for (j = 0; j < n; ++j) {
+      color.c[j] = in[j];
+    }
+    getGray(&color, &gray);
+    out[i] = colToByte(gray);
+  }
+}
+
+void GfxColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+				   int length) {
+  GfxColor color;
+  GfxRGB rgb;
+  int i, j, n;
+
+  n = getNComps();
+  for (i = 0; i < length; ++i, in += n) {
+    for (j = 0; j < n; ++j) {
+      color.c[j] = in[j];
+    }
+    getRGB(&color, &rgb);
+    *out++ = colToByte(rgb.r);
+    *out++ = colToByte(rgb.g);
+    *out++ = colToByte(rgb.b);
+  }
+}
+
+void GfxColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+				    int length) {
+  GfxColor color;
+  GfxCMYK cmyk;
+  int i, j, n;
+
+  n = getNComps();
+  for (i = 0; i < length; ++i, in += n) {
+    for (j = 0; j < n; ++j) {
+      color.c[j] = in[j];
+    }
+    getCMYK(&color, &cmyk);
+    *out++ = colToByte(cmyk.c);
+    *out++ = colToByte(cmyk.m);
+    *out++ = colToByte(cmyk.y);
+    *out++ = colToByte(cmyk.k);
+  }
+}
+
 
 //------------------------------------------------------------------------
 // GfxDeviceGrayColorSpace
@@ -414,6 +467,32 @@ void GfxDeviceRGBColorSpace::getRGBLine(Guchar *in, unsigned int *out,
     out[i] = (p[0] << 16) | (p[1] << 8) | (p[2] << 0);
 }
 
+// The byte line converters call getGray, getRGB and getCMYK directly
+// (not through the vtable), so the compiler can inline them.
+void GfxDeviceRGBColorSpace::getGrayByteLine(GfxColorComp *in, Guchar *out,
+					     int length) {
+  GfxColor color;
+  GfxGray gray;
+  int i;
+
+  for (i = 0; i < length; ++i, in += 3) {
+    color.c[0] = in[0];
+    color.c[1] = in[1];
+    color.c[2] = in[2];
+    GfxDeviceRGBColorSpace::getGray(&color, &gray);
+    out[i] = colToByte(gray);
+  }
+}
+
+void GfxDeviceRGBColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+					    int length) {
+  int i;
+
+  for (i = 0; i < 3 * length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
 void GfxDeviceRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   GfxColorComp c, m, y, k;
 
@@ -433,6 +512,24 @@ void GfxDeviceRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = k;
 }
 
+void GfxDeviceRGBColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+					     int length) {
+  GfxColor color;
+  GfxCMYK cmyk;
+  int i;
+
+  for (i = 0; i < length; ++i, in += 3) {
+    color.c[0] = in[0];
+    color.c[1] = in[1];
+    color.c[2] = in[2];
+    GfxDeviceRGBColorSpace::getCMYK(&color, &cmyk);
+    *out++ = colToByte(cmyk.c);
+    *out++ = colToByte(cmyk.m);
+    *out++ = colToByte(cmyk.y);
+    *out++ = colToByte(cmyk.k);
+  }
+}
+
 void GfxDeviceRGBColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
   color->c[1] = 0;
@@ -571,6 +668,15 @@ void GfxCalRGBColorSpace::getRGBLine(Guchar *in, unsigned int *out,
     out[i] = (p[0] << 16) | (p[1] << 8) | (p[2] << 0);
 }
 
+void GfxCalRGBColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+					 int length) {
+  int i;
+
+  for (i = 0; i < 3 * length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
 void GfxCalRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   GfxColorComp c, m, y, k;
 
@@ -590,6 +696,24 @@ void GfxCalRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = k;
 }
 
+void GfxCalRGBColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+					  int length) {
+  GfxColor color;
+  GfxCMYK cmyk;
+  int i;
+
+  for (i = 0; i < length; ++i, in += 3) {
+    color.c[0] = in[0];
+    color.c[1] = in[1];
+    color.c[2] = in[2];
+    GfxCalRGBColorSpace::getCMYK(&color, &cmyk);
+    *out++ = colToByte(cmyk.c);
+    *out++ = colToByte(cmyk.m);
+    *out++ = colToByte(cmyk.y);
+    *out++ = colToByte(cmyk.k);
+  }
+}
+
 void GfxCalRGBColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
   color->c[1] = 0;
@@ -686,6 +810,59 @@ void GfxDeviceCMYKColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = clip01(color->c[3]);
 }
 
+void GfxDeviceCMYKColorSpace::getGrayByteLine(GfxColorComp *in, Guchar *out,
+					      int length) {
+  GfxColor color;
+  GfxGray gray;
+  int i;
+
+  for (i = 0; i < length; ++i, in += 4) {
+    color.c[0] = in[0];
+    color.c[1] = in[1];
+    color.c[2] = in[2];
+    color.c[3] = in[3];
+    GfxDeviceCMYKColorSpace::getGray(&color, &gray);
+    out[i] = colToByte(gray);
+  }
+}
+
+void GfxDeviceCMYKColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+					     int length) {
+  GfxColor color;
+  GfxRGB rgb;
+  int i;
+
+  for (i = 0; i < length; ++i, in += 4, out += 3) {
+
+    // runs of the same color are common in CMYK images
+    if (i > 0 && in[0] == in[-4] && in[1] == in[-3] &&
+	in[2] == in[-2] && in[3] == in[-1]) {
+      out[0] = out[-3];
+      out[1] = out[-2];
+      out[2] = out[-1];
+      continue;
+    }
+
+    color.c[0] = in[0];
+    color.c[1] = in[1];
+    color.c[2] = in[2];
+    color.c[3] = in[3];
+    GfxDeviceCMYKColorSpace::getRGB(&color, &rgb);
+    out[0] = colToByte(rgb.r);
+    out[1] = colToByte(rgb.g);
+    out[2] = colToByte(rgb.b);
+  }
+}
+
+void GfxDeviceCMYKColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+					      int length) {
+  int i;
+
+  for (i = 0; i < 4 * length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
 void GfxDeviceCMYKColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
   color->c[1] = 0;
@@ -844,9 +1021,9 @@ void GfxLabColorSpace::getRGB(GfxColor *color, GfxRGB *rgb) {
   r = xyzrgb[0][0] * X + xyzrgb[0][1] * Y + xyzrgb[0][2] * Z;
   g = xyzrgb[1][0] * X + xyzrgb[1][1] * Y + xyzrgb[1][2] * Z;
   b = xyzrgb[2][0] * X + xyzrgb[2][1] * Y + xyzrgb[2][2] * Z;
-  rgb->r = dblToCol(pow(clip01(r * kr), 0.5));
-  rgb->g = dblToCol(pow(clip01(g * kg), 0.5));
-  rgb->b = dblToCol(pow(clip01(b * kb), 0.5));
+  rgb->r = dblToCol(sqrt(clip01(r * kr)));
+  rgb->g = dblToCol(sqrt(clip01(g * kg)));
+  rgb->b = dblToCol(sqrt(clip01(b * kb)));
 }
 
 void GfxLabColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
@@ -1014,6 +1191,21 @@ void GfxICCBasedColorSpace::getRGBLine(Guchar *in, unsigned int *out,
   alt->getRGBLine(in, out, length);
 }
 
+void GfxICCBasedColorSpace::getGrayByteLine(GfxColorComp *in, Guchar *out,
+					    int length) {
+  alt->getGrayByteLine(in, out, length);
+}
+
+void GfxICCBasedColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+					   int length) {
+  alt->getRGBByteLine(in, out, length);
+}
+
+void GfxICCBasedColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+					    int length) {
+  alt->getCMYKByteLine(in, out, length);
+}
+
 void GfxICCBasedColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   alt->getCMYK(color, cmyk);
 }
@@ -1179,18 +1371,21 @@ void GfxIndexedColorSpace::getRGB(GfxColor *color, GfxRGB *rgb) {
 }
 
 void GfxIndexedColorSpace::getRGBLine(Guchar *in, unsigned int *out, int length) {
-  Guchar *line;
-  int i, j, n;
+  Guchar line[256 * gfxColorMaxComps];
+  int i, j, n, len;
 
+  // convert in chunks of up to 256 pixels, to avoid allocating a line
   n = base->getNComps();
-  line = (Guchar *) gmalloc (length * n);
-  for (i = 0; i < length; i++)
-    for (j = 0; j < n; j++)
-      line[i * n + j] = lookup[in[i] * n + j];
-
-  base->getRGBLine(line, out, length);
-
-  gfree (line);
+  while (length > 0) {
+    len = length < 256 ? length : 256;
+    for (i = 0; i < len; i++)
+      for (j = 0; j < n; j++)
+	line[i * n + j] = lookup[in[i] * n + j];
+    base->getRGBLine(line, out, len);
+    in += len;
+    out += len;
+    length -= len;
+  }
 }
 
 void GfxIndexedColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
@@ -3329,6 +3524,15 @@ GfxShading *GfxPatchMeshShading::copy() {
 // GfxImageColorMap
 //------------------------------------------------------------------------
 
+// Returns true if <cs> is Lab, possibly as the alternate of an
+// ICCBased space.
+static GBool isLabBased(GfxColorSpace *cs) {
+  while (cs->getMode() == csICCBased) {
+    cs = ((GfxICCBasedColorSpace *)cs)->getAlt();
+  }
+  return cs->getMode() == csLab;
+}
+
 GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
 				   GfxColorSpace *colorSpaceA) {
   GfxIndexedColorSpace *indexedCS;
@@ -3353,6 +3557,12 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
   for (k = 0; k < gfxColorMaxComps; ++k) {
     lookup[k] = NULL;
   }
+  byteLookupOk = gFalse;
+  byteLookupIdentity = gFalse;
+  tmp_line = NULL;
+  tmpLineSize = 0;
+  colorLine = NULL;
+  colorLineSize = 0;
 
   // get decode map
   if (decode->isNull()) {
@@ -3449,8 +3659,21 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
 	byte_lookup[i * nComps + k] = byte;	
       }
     }
+    byteLookupIdentity = bits == 8;
+    for (i = 0; byteLookupIdentity && i <= maxPixel; ++i) {
+      for (k = 0; k < nComps; ++k) {
+	if (byte_lookup[i * nComps + k] != i) {
+	  byteLookupIdentity = gFalse;
+	  break;
+	}
+      }
+    }
   }
 
+  // the line converters work on bytes standing for [0,1], which
+  // doesn't fit Lab's component ranges
+  byteLookupOk = !isLabBased(getLineColorSpace());
+
   return;
 
  err2:
@@ -3490,6 +3713,19 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
       memcpy(lookup[k], colorMap->lookup[k], n * sizeof(GfxColorComp));
     }
   }
+  if (colorMap->byte_lookup) {
+    k = colorSpace2 ? nComps2 : nComps;
+    byte_lookup = (Guchar *)gmallocn(n, k);
+    memcpy(byte_lookup, colorMap->byte_lookup, n * k);
+  } else {
+    byte_lookup = NULL;
+  }
+  byteLookupOk = colorMap->byteLookupOk;
+  byteLookupIdentity = colorMap->byteLookupIdentity;
+  tmp_line = NULL;
+  tmpLineSize = 0;
+  colorLine = NULL;
+  colorLineSize = 0;
   for (i = 0; i < nComps; ++i) {
     decodeLow[i] = colorMap->decodeLow[i];
     decodeRange[i] = colorMap->decodeRange[i];
@@ -3505,6 +3741,8 @@ GfxImageColorMap::~GfxImageColorMap() {
     gfree(lookup[i]);
   }
   gfree(byte_lookup);
+  gfree(tmp_line);
+  gfree(colorLine);
 }
 
 void GfxImageColorMap::getGray(Guchar *x, GfxGray *gray) {
@@ -3541,64 +3779,111 @@ void GfxImageColorMap::getRGB(Guchar *x, GfxRGB *rgb) {
   }
 }
 
-void GfxImageColorMap::getGrayLine(Guchar *in, Guchar *out, int length) {
-  int i, j;
-  Guchar *inp, *tmp_line;
-
-  switch (colorSpace->getMode()) {
-  case csIndexed:
-  case csSeparation:
-    tmp_line = (Guchar *) gmalloc (length * nComps2);
-    for (i = 0; i < length; i++) {
-      for (j = 0; j < nComps2; j++) {
-	tmp_line[i * nComps2 + j] = byte_lookup[in[i] * nComps2 + j];
+// Map a line of image pixels through byte_lookup, into components
+// of the color space which is converted by the line converters (the
+// base or alternate space for Indexed and Separation images).  The
+// result goes into tmp_line, which is reused from line to line.
+Guchar *GfxImageColorMap::mapLine(Guchar *in, int length) {
+  Guchar *p, *q;
+  int n, i, j;
+
+  if (byteLookupIdentity) {
+    return in;
+  }
+  n = colorSpace2 ? nComps2 : nComps;
+  if (length * n > tmpLineSize) {
+    gfree(tmp_line);
+    tmp_line = (Guchar *)gmallocn(length, n);
+    tmpLineSize = length * n;
+  }
+  q = tmp_line;
+  if (colorSpace2) {
+    for (i = 0; i < length; ++i) {
+      p = &byte_lookup[in[i] * n];
+      for (j = 0; j < n; ++j) {
+	*q++ = p[j];
       }
     }
-    colorSpace2->getGrayLine(tmp_line, out, length);
-    gfree (tmp_line);
-    break;
+  } else {
+    for (i = 0; i < length; ++i, in += n) {
+      for (j = 0; j < n; ++j) {
+	*q++ = byte_lookup[in[j] * n + j];
+      }
+    }
+  }
+  return tmp_line;
+}
 
-  default:
-    inp = in;
-    for (j = 0; j < length; j++)
-      for (i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
+// Map a line of image pixels through lookup, into the same components
+// which getGray, getRGB and getCMYK pass to the color space.  The
+// result goes into colorLine, which is reused from line to line.
+GfxColorComp *GfxImageColorMap::mapColorLine(Guchar *in, int length) {
+  GfxColorComp *q;
+  int n, i, j;
+
+  n = colorSpace2 ? nComps2 : nComps;
+  if (length * n > colorLineSize) {
+    gfree(colorLine);
+    colorLine = (GfxColorComp *)gmallocn(length * n, sizeof(GfxColorComp));
+    colorLineSize = length * n;
+  }
+  q = colorLine;
+  if (colorSpace2) {
+    for (i = 0; i < length; ++i) {
+      for (j = 0; j < n; ++j) {
+	*q++ = lookup[j][in[i]];
       }
-    colorSpace->getGrayLine(in, out, length);
-    break;
+    }
+  } else {
+    for (i = 0; i < length; ++i, in += n) {
+      for (j = 0; j < n; ++j) {
+	*q++ = lookup[j][in[j]];
+      }
+    }
   }
+  return colorLine;
+}
 
+void GfxImageColorMap::getGrayLine(Guchar *in, Guchar *out, int length) {
+  GfxGray gray;
+  int i;
+
+  if (!byteLookupOk) {
+    for (i = 0; i < length; ++i, in += nComps) {
+      getGray(in, &gray);
+      out[i] = colToByte(gray);
+    }
+    return;
+  }
+  getLineColorSpace()->getGrayLine(mapLine(in, length), out, length);
 }
 
 void GfxImageColorMap::getRGBLine(Guchar *in, unsigned int *out, int length) {
-  int i, j;
-  Guchar *inp, *tmp_line;
-
-  switch (colorSpace->getMode()) {
-  case csIndexed:
-  case csSeparation:
-    tmp_line = (Guchar *) gmalloc (length * nComps2);
-    for (i = 0; i < length; i++) {
-      for (j = 0; j < nComps2; j++) {
-	tmp_line[i * nComps2 + j] = byte_lookup[in[i] * nComps2 + j];
-      }
-    }
-    colorSpace2->getRGBLine(tmp_line, out, length);
-    gfree (tmp_line);
-    break;
+  GfxRGB rgb;
+  int i;
 
-  default:
-    inp = in;
-    for (j = 0; j < length; j++)
-      for (i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
-      }
-    colorSpace->getRGBLine(in, out, length);
-    break;
+  if (!byteLookupOk) {
+    for (i = 0; i < length; ++i, in += nComps) {
+      getRGB(in, &rgb);
+      out[i] = ((int)colToByte(rgb.r) << 16) |
+	       ((int)colToByte(rgb.g) << 8) |
+	       (int)colToByte(rgb.b);
+    }
+    return;
   }
+  getLineColorSpace()->getRGBLine(mapLine(in, length), out, length);
+}
+
+void GfxImageColorMap::getGrayByteLine(Guchar *in, Guchar *out, int length) {
+  getLineColorSpace()->getGrayByteLine(mapColorLine(in, length), out, length);
+}
+
+void GfxImageColorMap::getRGBByteLine(Guchar *in, Guchar *out, int length) {
+  getLineColorSpace()->getRGBByteLine(mapColorLine(in, length), out, length);
+}
 
+void GfxImageColorMap::getCMYKByteLine(Guchar *in, Guchar *out, int length) {
+  getLineColorSpace()->getCMYKByteLine(mapColorLine(in, length), out, length);
 }
 
 void GfxImageColorMap::getCMYK(Guchar *x, GfxCMYK *cmyk) {
@@ -153,6 +153,14 @@ public:
   virtual void getRGBLine(Guchar *in, unsigned int *out, int length);
   virtual void getGrayLine(Guchar *in, Guchar *out, int length);
 
+  // Convert a line of <length> pixels, with getNComps() components
+  // each, to 1 byte (gray), 3 bytes (R, G, B) or 4 bytes (C, M, Y, K)
+  // per pixel.  The results are the same as those of getGray, getRGB
+  // and getCMYK.
+  virtual void getGrayByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
+
   // Return the number of color components.
   virtual int getNComps() = 0;
 
@@ -258,6 +266,9 @@ public:
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
   virtual void getGrayLine(Guchar *in, Guchar *out, int length);
   virtual void getRGBLine(Guchar *in, unsigned int *out, int length);
+  virtual void getGrayByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -285,6 +296,8 @@ public:
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
   virtual void getGrayLine(Guchar *in, Guchar *out, int length);
   virtual void getRGBLine(Guchar *in, unsigned int *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -324,6 +337,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return 4; }
   virtual void getDefaultColor(GfxColor *color);
@@ -397,6 +413,9 @@ public:
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
 
   virtual void getRGBLine(Guchar *in, unsigned int *out, int length);
+  virtual void getGrayByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
   virtual int getNComps() { return nComps; }
   virtual void getDefaultColor(GfxColor *color);
 
@@ -898,9 +917,21 @@ public:
   void getCMYK(Guchar *x, GfxCMYK *cmyk);
   void getColor(Guchar *x, GfxColor *color);
 
+  // Convert a line of <length> image pixels to 1 byte (gray), 3 bytes
+  // (R, G, B) or 4 bytes (C, M, Y, K) per pixel, with the same results
+  // as getGray, getRGB and getCMYK.  These, and getGrayLine, don't
+  // modify <in>.
+  void getGrayByteLine(Guchar *in, Guchar *out, int length);
+  void getRGBByteLine(Guchar *in, Guchar *out, int length);
+  void getCMYKByteLine(Guchar *in, Guchar *out, int length);
+
 private:
 
   GfxImageColorMap(GfxImageColorMap *colorMap);
+  Guchar *mapLine(Guchar *in, int length);
+  GfxColorComp *mapColorLine(Guchar *in, int length);
+  GfxColorSpace *getLineColorSpace()
+    { return colorSpace2 ? colorSpace2 : colorSpace; }
 
   GfxColorSpace *colorSpace;	// the image color space
   int bits;			// bits per component
@@ -910,7 +941,13 @@ private:
   GfxColorComp *		// lookup table
     lookup[gfxColorMaxComps];
   Guchar *byte_lookup;
-  Guchar *tmp_line;
+  GBool byteLookupOk;		// byte_lookup is usable (decoded values
+				//   are in [0,1]; not true for Lab)
+  GBool byteLookupIdentity;	// byte_lookup maps every value to itself
+  Guchar *tmp_line;		// mapped line, for the line converters
+  int tmpLineSize;		// size of tmp_line
+  GfxColorComp *colorLine;	// decoded line, for the byte line converters
+  int colorLineSize;		// size of colorLine
   double			// minimum values for each component
     decodeLow[gfxColorMaxComps];
   double			// max - min value for each component
@@ -79,6 +79,10 @@ extern XpdfPluginVecTable xpdfPluginVecTable;
 
 #define cidToUnicodeCacheSize     4
 #define unicodeToUnicodeCacheSize 4
+#define defaultImageCacheSize     (16 * 1024 * 1024)
+#define defaultFormCacheSize      0
+#define defaultT3CacheSize        (8 * 1024 * 1024)
+#define defaultClipMaskThreshold  256
 
 //------------------------------------------------------------------------
 
@@ -608,7 +612,14 @@ GlobalParams::GlobalParams() {
   mapUnknownCharNames = gFalse;
   printCommands = gFalse;
   profileCommands = gFalse;
+  drawAnnotations = gTrue;
   errQuiet = gFalse;
+  xrefCacheDir = NULL;
+  cMapCacheDir = NULL;
+  imageCacheSize = defaultImageCacheSize;
+  formCacheSize = defaultFormCacheSize;
+  t3CacheSize = defaultT3CacheSize;
+  clipMaskThreshold = defaultClipMaskThreshold;
 
   cidToUnicodeCache = new CharCodeToUnicodeCache(cidToUnicodeCacheSize);
   unicodeToUnicodeCache =
@@ -775,6 +786,12 @@ GlobalParams::~GlobalParams() {
   deleteGooList(psFonts16, PSFontParam);
   delete textEncoding;
   deleteGooList(fontDirs, GooString);
+  if (xrefCacheDir) {
+    delete xrefCacheDir;
+  }
+  if (cMapCacheDir) {
+    delete cMapCacheDir;
+  }
 
   GooHashIter *iter;
   GooString *key;
@@ -1457,22 +1474,112 @@ GBool GlobalParams::getProfileCommands() {
   return p;
 }
 
+GBool GlobalParams::getDrawAnnotations() {
+  GBool draw;
+
+  lockGlobalParams;
+  draw = drawAnnotations;
+  unlockGlobalParams;
+  return draw;
+}
+
 GBool GlobalParams::getErrQuiet() {
   // no locking -- this function may get called from inside a locked
   // section
   return errQuiet;
 }
 
+GooString *GlobalParams::getXRefCacheDir() {
+  GooString *s;
+
+  lockGlobalParams;
+  s = xrefCacheDir ? xrefCacheDir->copy() : (GooString *)NULL;
+  unlockGlobalParams;
+  return s;
+}
+
+int GlobalParams::getImageCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = imageCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getFormCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = formCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getT3CacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = t3CacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getClipMaskThreshold() {
+  int threshold;
+
+  lockGlobalParams;
+  threshold = clipMaskThreshold;
+  unlockGlobalParams;
+  return threshold;
+}
+
+GooString *GlobalParams::getCMapCacheFile(GooString *name) {
+  GooString *path;
+
+  lockGlobalParams;
+  path = makeCMapCacheFile(name);
+  unlockGlobalParams;
+  return path;
+}
+
+// Same as getCMapCacheFile, without locking.
+GooString *GlobalParams::makeCMapCacheFile(GooString *name) {
+  char c;
+  int i;
+
+  if (!cMapCacheDir) {
+    return NULL;
+  }
+  // names come from PDF files: don't allow them to point outside of
+  // the cache directory
+  for (i = 0; i < name->getLength(); ++i) {
+    c = name->getChar(i);
+    if (!(isalnum(c & 0xff) || c == '-' || c == '_' || c == '+' ||
+	  (c == '.' && i > 0 && name->getChar(i - 1) != '.'))) {
+      return NULL;
+    }
+  }
+  return appendToPath(cMapCacheDir->copy(), name->getCString());
+}
+
 CharCodeToUnicode *GlobalParams::getCIDToUnicode(GooString *collection) {
-  GooString *fileName;
+  GooString *fileName, *name, *compiledName;
   CharCodeToUnicode *ctu;
 
   lockGlobalParams;
-  if (!(ctu = cidToUnicodeCache->getCharCodeToUnicode(collection))) {
-    if ((fileName = (GooString *)cidToUnicodes->lookup(collection)) &&
-	(ctu = CharCodeToUnicode::parseCIDToUnicode(fileName, collection))) {
+  if (!(ctu = cidToUnicodeCache->getCharCodeToUnicode(collection)) &&
+      (fileName = (GooString *)cidToUnicodes->lookup(collection))) {
+    name = collection->copy()->append(".cidToUnicode");
+    compiledName = makeCMapCacheFile(name);
+    delete name;
+    if ((ctu = CharCodeToUnicode::parseCIDToUnicode(fileName, collection,
+						    compiledName))) {
       cidToUnicodeCache->add(ctu);
     }
+    if (compiledName) {
+      delete compiledName;
+    }
   }
   unlockGlobalParams;
   return ctu;
@@ -1689,12 +1796,60 @@ void GlobalParams::setProfileCommands(GBool profileCommandsA) {
   unlockGlobalParams;
 }
 
+void GlobalParams::setDrawAnnotations(GBool drawAnnotationsA) {
+  lockGlobalParams;
+  drawAnnotations = drawAnnotationsA;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setErrQuiet(GBool errQuietA) {
   lockGlobalParams;
   errQuiet = errQuietA;
   unlockGlobalParams;
 }
 
+void GlobalParams::setXRefCacheDir(char *dir) {
+  lockGlobalParams;
+  if (xrefCacheDir) {
+    delete xrefCacheDir;
+  }
+  xrefCacheDir = dir ? new GooString(dir) : (GooString *)NULL;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setImageCacheSize(int size) {
+  lockGlobalParams;
+  imageCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setFormCacheSize(int size) {
+  lockGlobalParams;
+  formCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setT3CacheSize(int size) {
+  lockGlobalParams;
+  t3CacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setClipMaskThreshold(int threshold) {
+  lockGlobalParams;
+  clipMaskThreshold = threshold;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setCMapCacheDir(char *dir) {
+  lockGlobalParams;
+  if (cMapCacheDir) {
+    delete cMapCacheDir;
+  }
+  cMapCacheDir = dir ? new GooString(dir) : (GooString *)NULL;
+  unlockGlobalParams;
+}
+
 void GlobalParams::addSecurityHandler(XpdfSecurityHandler *handler) {
 #ifdef ENABLE_PLUGINS
   lockGlobalParams;
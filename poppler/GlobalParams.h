@@ -194,7 +194,17 @@ public:
   GBool getMapUnknownCharNames();
   GBool getPrintCommands();
   GBool getProfileCommands();
+  GBool getDrawAnnotations();
   GBool getErrQuiet();
+  GooString *getXRefCacheDir();
+  int getImageCacheSize();
+  int getFormCacheSize();
+  int getT3CacheSize();
+  int getClipMaskThreshold();
+  // Returns the path of the file <name> in the directory set with
+  // setCMapCacheDir, or NULL if there is none, or <name> isn't a
+  // plain file name.
+  GooString *getCMapCacheFile(GooString *name);
 
   CharCodeToUnicode *getCIDToUnicode(GooString *collection);
   CharCodeToUnicode *getUnicodeToUnicode(GooString *fontName);
@@ -228,7 +238,14 @@ public:
   void setMapUnknownCharNames(GBool map);
   void setPrintCommands(GBool printCommandsA);
   void setProfileCommands(GBool profileCommandsA);
+  void setDrawAnnotations(GBool drawAnnotationsA);
   void setErrQuiet(GBool errQuietA);
+  void setXRefCacheDir(char *dir);
+  void setCMapCacheDir(char *dir);
+  void setImageCacheSize(int size);
+  void setFormCacheSize(int size);
+  void setT3CacheSize(int size);
+  void setClipMaskThreshold(int threshold);
 
   //----- security handlers
 
@@ -240,6 +257,7 @@ private:
   void parseNameToUnicode(GooString *name);
   GBool parseYesNo2(char *token, GBool *flag);
   UnicodeMap *getUnicodeMap2(GooString *encodingName);
+  GooString *makeCMapCacheFile(GooString *name);
 
   void scanEncodingDirs();
   void addCIDToUnicode(GooString *collection, GooString *fileName);
@@ -310,7 +328,26 @@ private:
   GBool mapUnknownCharNames;	// map unknown char names?
   GBool printCommands;		// print the drawing commands
   GBool profileCommands;	// profile the drawing commands
+  GBool drawAnnotations;	// draw annotations (if false, they
+				//   aren't even parsed)?
   GBool errQuiet;		// suppress error messages?
+  GooString *xrefCacheDir;	// directory for reconstructed xref tables
+				//   of damaged files (NULL = don't cache)
+  GooString *cMapCacheDir;	// directory for compiled CMaps and
+				//   CID-to-Unicode tables (NULL = don't
+				//   cache)
+  int imageCacheSize;		// memory used by output devices to keep
+				//   decoded images, in bytes (0 = don't
+				//   cache)
+  int formCacheSize;		// memory used by output devices to keep
+				//   rasterized form XObjects, in bytes
+				//   (0 = don't cache)
+  int t3CacheSize;		// memory used by output devices to keep
+				//   rasterized Type 3 glyphs, in bytes
+				//   (0 = don't cache)
+  int clipMaskThreshold;	// number of clip path segments at which
+				//   the clip region is rasterized into a
+				//   mask (0 = never)
 
   CharCodeToUnicodeCache *cidToUnicodeCache;
   CharCodeToUnicodeCache *unicodeToUnicodeCache;
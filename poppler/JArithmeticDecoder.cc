@@ -141,8 +141,8 @@ void JArithmeticDecoder::cleanup() {
   }
 }
 
-int JArithmeticDecoder::decodeBit(Guint context,
-				  JArithmeticDecoderStats *stats) {
+int JArithmeticDecoder::decodeBitSlow(Guint context,
+				      JArithmeticDecoderStats *stats) {
   int bit;
   Guint qe;
   int iCX, mpsCX;
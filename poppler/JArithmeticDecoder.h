@@ -70,8 +70,16 @@ public:
   // Read any leftover data in the stream.
   void cleanup();
 
-  // Decode one bit.
-  int decodeBit(Guint context, JArithmeticDecoderStats *stats);
+  // Decode one bit.  The common case (MPS with no renormalization)
+  // is handled inline; everything else goes through decodeBitSlow.
+  int decodeBit(Guint context, JArithmeticDecoderStats *stats) {
+    Guint aa = a - qeTab[stats->cxTab[context] >> 1];
+    if (c < aa && (aa & 0x80000000)) {
+      a = aa;
+      return stats->cxTab[context] & 1;
+    }
+    return decodeBitSlow(context, stats);
+  }
 
   // Decode eight bits.
   int decodeByte(Guint context, JArithmeticDecoderStats *stats);
@@ -85,6 +93,7 @@ public:
 private:
 
   Guint readByte();
+  int decodeBitSlow(Guint context, JArithmeticDecoderStats *stats);
   int decodeIntBit(JArithmeticDecoderStats *stats);
   void byteIn();
 
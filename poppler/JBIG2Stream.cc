@@ -668,6 +668,7 @@ public:
   void combine(JBIG2Bitmap *bitmap, int x, int y, Guint combOp);
   Guchar *getDataPtr() { return data; }
   int getDataSize() { return h * line; }
+  int getLineSize() { return line; }
 
 private:
 
@@ -799,12 +800,73 @@ void JBIG2Bitmap::duplicateRow(int yDest, int ySrc) {
   memcpy(data + yDest * line, data + ySrc * line, line);
 }
 
+// Returns the eight source pixels which land on destination byte
+// (<k> + sByte), where <sOff> is the destination x offset mod 8.
+static inline Guint jbig2SrcByte(Guchar *srcRow, int k, int sOff) {
+  Guint src;
+
+  src = srcRow[k] >> sOff;
+  if (sOff && k > 0) {
+    src |= (srcRow[k - 1] << (8 - sOff)) & 0xff;
+  }
+  return src;
+}
+
+// Same as jbig2SrcByte, but returns 32 pixels.  Only used for interior
+// bytes, so srcRow[k - 1] .. srcRow[k + 3] are always valid.
+static inline Guint jbig2SrcWord(Guchar *srcRow, int k, int sOff) {
+  Guint src;
+
+  src = ((Guint)srcRow[k] << 24) | (srcRow[k + 1] << 16) |
+        (srcRow[k + 2] << 8) | srcRow[k + 3];
+  if (sOff) {
+    src = (src >> sOff) | ((Guint)srcRow[k - 1] << (32 - sOff));
+  }
+  return src;
+}
+
+static inline Guint jbig2GetWord(Guchar *p) {
+  return ((Guint)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline void jbig2PutWord(Guchar *p, Guint x) {
+  p[0] = (Guchar)(x >> 24);
+  p[1] = (Guchar)(x >> 16);
+  p[2] = (Guchar)(x >> 8);
+  p[3] = (Guchar)x;
+}
+
+// Combine <src> into *<destPtr>, touching only the bits set in <m>.
+static inline void jbig2CombineByte(Guchar *destPtr, Guint src, Guint m,
+				    Guint combOp) {
+  Guint dest;
+
+  dest = *destPtr;
+  switch (combOp) {
+  case 0: // or
+    dest |= src & m;
+    break;
+  case 1: // and
+    dest &= src | (m ^ 0xff);
+    break;
+  case 2: // xor
+    dest ^= src & m;
+    break;
+  case 3: // xnor
+    dest ^= (src ^ 0xff) & m;
+    break;
+  case 4: // replace
+    dest = (dest & ~m) | (src & m);
+    break;
+  }
+  *destPtr = (Guchar)dest;
+}
+
 void JBIG2Bitmap::combine(JBIG2Bitmap *bitmap, int x, int y,
 			  Guint combOp) {
-  int x0, x1, y0, y1, xx, yy;
-  Guchar *srcPtr, *destPtr;
-  Guint src0, src1, src, dest, s1, s2, m1, m2, m3;
-  GBool oneByte;
+  int x0, x1, y0, y1, yy, sOff, sByte, d0, d1, d, k;
+  Guchar *srcRow, *destRow;
+  Guint m0, m1;
 
   if (y < 0) {
     y0 = -y;
@@ -820,8 +882,9 @@ void JBIG2Bitmap::combine(JBIG2Bitmap *bitmap, int x, int y,
     return;
   }
 
+  // destination pixel range is [x0, x1)
   if (x >= 0) {
-    x0 = x & ~7;
+    x0 = x;
   } else {
     x0 = 0;
   }
@@ -833,156 +896,79 @@ void JBIG2Bitmap::combine(JBIG2Bitmap *bitmap, int x, int y,
     return;
   }
 
-  s1 = x & 7;
-  s2 = 8 - s1;
-  m1 = 0xff >> (x1 & 7);
-  m2 = 0xff << (((x1 & 7) == 0) ? 0 : 8 - (x1 & 7));
-  m3 = (0xff >> s1) & m2;
-
-  oneByte = x0 == ((x1 - 1) & ~7);
-
+  // destination byte d gets its high (8 - sOff) bits from source byte
+  // (d - sByte) and its low sOff bits from source byte (d - sByte - 1);
+  // only the left-most (d0) and right-most (d1) bytes need masking
+  sOff = x & 7;
+  sByte = (x - sOff) >> 3;
+  d0 = x0 >> 3;
+  d1 = (x1 - 1) >> 3;
+  m0 = 0xff >> (x0 & 7);
+  m1 = (0xff << (7 - ((x1 - 1) & 7))) & 0xff;
+
+  // note: the right-most source byte (srcRow[d1 - sByte]) may not
+  // actually be used, depending on sOff and m1 - and in fact, it may be
+  // off the edge of the source bitmap, which means we need to allocate
+  // one extra guard byte at the end of each bitmap
   for (yy = y0; yy < y1; ++yy) {
+    destRow = data + (y + yy) * line;
+    srcRow = bitmap->data + yy * bitmap->line;
 
     // one byte per line -- need to mask both left and right side
-    if (oneByte) {
-      if (x >= 0) {
-	destPtr = data + (y + yy) * line + (x >> 3);
-	srcPtr = bitmap->data + yy * bitmap->line;
-	dest = *destPtr;
-	src1 = *srcPtr;
-	switch (combOp) {
-	case 0: // or
-	  dest |= (src1 >> s1) & m2;
-	  break;
-	case 1: // and
-	  dest &= ((0xff00 | src1) >> s1) | m1;
-	  break;
-	case 2: // xor
-	  dest ^= (src1 >> s1) & m2;
-	  break;
-	case 3: // xnor
-	  dest ^= ((src1 ^ 0xff) >> s1) & m2;
-	  break;
-	case 4: // replace
-	  dest = (dest & ~m3) | ((src1 >> s1) & m3);
-	  break;
-	}
-	*destPtr = dest;
-      } else {
-	destPtr = data + (y + yy) * line;
-	srcPtr = bitmap->data + yy * bitmap->line + (-x >> 3);
-	dest = *destPtr;
-	src1 = *srcPtr;
-	switch (combOp) {
-	case 0: // or
-	  dest |= src1 & m2;
-	  break;
-	case 1: // and
-	  dest &= src1 | m1;
-	  break;
-	case 2: // xor
-	  dest ^= src1 & m2;
-	  break;
-	case 3: // xnor
-	  dest ^= (src1 ^ 0xff) & m2;
-	  break;
-	case 4: // replace
-	  dest = (src1 & m2) | (dest & m1);
-	  break;
-	}
-	*destPtr = dest;
+    if (d0 == d1) {
+      jbig2CombineByte(destRow + d0, jbig2SrcByte(srcRow, d0 - sByte, sOff),
+		       m0 & m1, combOp);
+      continue;
+    }
+
+    // left-most byte
+    jbig2CombineByte(destRow + d0, jbig2SrcByte(srcRow, d0 - sByte, sOff),
+		     m0, combOp);
+
+    // middle bytes, 32 bits at a time
+    d = d0 + 1;
+    k = d - sByte;
+    switch (combOp) {
+    case 0: // or
+      for (; d + 4 <= d1; d += 4, k += 4) {
+	jbig2PutWord(destRow + d, jbig2GetWord(destRow + d) |
+		                  jbig2SrcWord(srcRow, k, sOff));
       }
-
-    // multiple bytes per line -- need to mask left side of left-most
-    // byte and right side of right-most byte
-    } else {
-
-      // left-most byte
-      if (x >= 0) {
-	destPtr = data + (y + yy) * line + (x >> 3);
-	srcPtr = bitmap->data + yy * bitmap->line;
-	src1 = *srcPtr++;
-	dest = *destPtr;
-	switch (combOp) {
-	case 0: // or
-	  dest |= src1 >> s1;
-	  break;
-	case 1: // and
-	  dest &= (0xff00 | src1) >> s1;
-	  break;
-	case 2: // xor
-	  dest ^= src1 >> s1;
-	  break;
-	case 3: // xnor
-	  dest ^= (src1 ^ 0xff) >> s1;
-	  break;
-	case 4: // replace
-	  dest = (dest & (0xff << s2)) | (src1 >> s1);
-	  break;
-	}
-	*destPtr++ = dest;
-	xx = x0 + 8;
-      } else {
-	destPtr = data + (y + yy) * line;
-	srcPtr = bitmap->data + yy * bitmap->line + (-x >> 3);
-	src1 = *srcPtr++;
-	xx = x0;
+      break;
+    case 1: // and
+      for (; d + 4 <= d1; d += 4, k += 4) {
+	jbig2PutWord(destRow + d, jbig2GetWord(destRow + d) &
+		                  jbig2SrcWord(srcRow, k, sOff));
       }
-
-      // middle bytes
-      for (; xx < x1 - 8; xx += 8) {
-	dest = *destPtr;
-	src0 = src1;
-	src1 = *srcPtr++;
-	src = (((src0 << 8) | src1) >> s1) & 0xff;
-	switch (combOp) {
-	case 0: // or
-	  dest |= src;
-	  break;
-	case 1: // and
-	  dest &= src;
-	  break;
-	case 2: // xor
-	  dest ^= src;
-	  break;
-	case 3: // xnor
-	  dest ^= src ^ 0xff;
-	  break;
-	case 4: // replace
-	  dest = src;
-	  break;
-	}
-	*destPtr++ = dest;
+      break;
+    case 2: // xor
+      for (; d + 4 <= d1; d += 4, k += 4) {
+	jbig2PutWord(destRow + d, jbig2GetWord(destRow + d) ^
+		                  jbig2SrcWord(srcRow, k, sOff));
       }
-
-      // right-most byte
-      // note: this last byte (src1) may not actually be used, depending
-      // on the values of s1, m1, and m2 - and in fact, it may be off
-      // the edge of the source bitmap, which means we need to allocate
-      // one extra guard byte at the end of each bitmap
-      dest = *destPtr;
-      src0 = src1;
-      src1 = *srcPtr++;
-      src = (((src0 << 8) | src1) >> s1) & 0xff;
-      switch (combOp) {
-      case 0: // or
-	dest |= src & m2;
-	break;
-      case 1: // and
-	dest &= src | m1;
-	break;
-      case 2: // xor
-	dest ^= src & m2;
-	break;
-      case 3: // xnor
-	dest ^= (src ^ 0xff) & m2;
-	break;
-      case 4: // replace
-	dest = (src & m2) | (dest & m1);
-	break;
+      break;
+    case 3: // xnor
+      for (; d + 4 <= d1; d += 4, k += 4) {
+	jbig2PutWord(destRow + d, ~(jbig2GetWord(destRow + d) ^
+				    jbig2SrcWord(srcRow, k, sOff)));
       }
-      *destPtr = dest;
+      break;
+    case 4: // replace
+      for (; d + 4 <= d1; d += 4, k += 4) {
+	jbig2PutWord(destRow + d, jbig2SrcWord(srcRow, k, sOff));
+      }
+      break;
     }
+
+    // remaining middle bytes
+    for (; d < d1; ++d, ++k) {
+      jbig2CombineByte(destRow + d, jbig2SrcByte(srcRow, k, sOff),
+		       0xff, combOp);
+    }
+
+    // right-most byte
+    jbig2CombineByte(destRow + d1, jbig2SrcByte(srcRow, d1 - sByte, sOff),
+		     m1, combOp);
   }
 }
 
@@ -2584,6 +2570,11 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
   int *refLine, *codingLine;
   int code1, code2, code3;
   int x, y, a0, pix, i, refI, codingI;
+  Guchar *pp, *p0, *p1;
+  Guint win[3], mask, mask0, mask1;
+  int atRow[4], atShift[4];
+  int x0, x1, nAT, lineSize;
+  GBool useWin;
 
   bitmap = new JBIG2Bitmap(0, w, h);
   bitmap->clearToZero();
@@ -2719,13 +2710,24 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       } while (a0 < w);
       codingLine[codingI++] = w;
 
-      // convert the run lengths to a bitmap line
-      i = 0;
-      while (codingLine[i] < w) {
-	for (x = codingLine[i]; x < codingLine[i+1]; ++x) {
-	  bitmap->setPixel(x, y);
+      // convert the run lengths to a bitmap line, filling whole bytes
+      // in the middle of each black run
+      pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
+      for (i = 0; codingLine[i] < w; i += 2) {
+	x0 = codingLine[i] < 0 ? 0 : codingLine[i];
+	x1 = codingLine[i+1] > w ? w : codingLine[i+1];
+	if (x0 >= x1) {
+	  continue;
+	}
+	mask0 = 0xff >> (x0 & 7);
+	mask1 = (0xff << (7 - ((x1 - 1) & 7))) & 0xff;
+	if ((x0 >> 3) == ((x1 - 1) >> 3)) {
+	  pp[x0 >> 3] |= mask0 & mask1;
+	} else {
+	  pp[x0 >> 3] |= mask0;
+	  memset(pp + (x0 >> 3) + 1, 0xff, ((x1 - 1) >> 3) - (x0 >> 3) - 1);
+	  pp[(x1 - 1) >> 3] |= mask1;
 	}
-	i += 2;
       }
     }
 
@@ -2762,6 +2764,23 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       }
     }
 
+    // the adaptive template pixels can be read out of the same row
+    // windows as the fixed context pixels, as long as they lie in the
+    // current or the two previous rows, and no more than 16 pixels to
+    // the left or 8 pixels to the right of the current pixel (this
+    // covers the nominal AT positions for all four templates)
+    nAT = templ == 0 ? 4 : 1;
+    useWin = gTrue;
+    for (i = 0; i < nAT; ++i) {
+      if (aty[i] < -2 || aty[i] > 0 || atx[i] < -16 || atx[i] > 8) {
+	useWin = gFalse;
+	break;
+      }
+      atRow[i] = aty[i] + 2;
+      atShift[i] = 15 - atx[i];
+    }
+    lineSize = bitmap->getLineSize();
+
     ltp = 0;
     cx = cx0 = cx1 = cx2 = 0; // make gcc happy
     for (y = 0; y < h; ++y) {
@@ -2772,11 +2791,120 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 	  ltp = !ltp;
 	}
 	if (ltp) {
-	  bitmap->duplicateRow(y, y-1);
+	  // the row above the first one is all zero, which is what
+	  // the freshly cleared bitmap already contains
+	  if (y > 0) {
+	    bitmap->duplicateRow(y, y-1);
+	  }
 	  continue;
 	}
       }
 
+      if (useWin) {
+
+	// set up the row windows: win[i] holds row (y - 2 + i), with the
+	// current pixel at bit 15, the pixels to its left in the higher
+	// bits, and (at least) the next eight pixels in the lower bits;
+	// row y is still blank, so win[2] is built from the decoded
+	// pixels only
+	pp = bitmap->getDataPtr() + y * lineSize;
+	p0 = (y >= 2) ? pp - 2 * lineSize : (Guchar *)NULL;
+	p1 = (y >= 1) ? pp - lineSize : (Guchar *)NULL;
+	win[0] = p0 ? (*p0++ << 8) : 0;
+	win[1] = p1 ? (*p1++ << 8) : 0;
+	win[2] = 0;
+
+	// decode the row, eight pixels (one output byte) at a time
+	for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
+	  if (x0 + 8 < w) {
+	    if (p0) {
+	      win[0] |= *p0++;
+	    }
+	    if (p1) {
+	      win[1] |= *p1++;
+	    }
+	  }
+	  x1 = (x0 + 8 < w) ? x0 + 8 : w;
+	  mask = 0x80;
+
+	  switch (templ) {
+	  case 0:
+	    for (; x < x1; ++x, mask >>= 1) {
+	      cx = (((win[0] >> 14) & 0x07) << 13) |
+		   (((win[1] >> 13) & 0x1f) << 8) |
+		   (((win[2] >> 16) & 0x0f) << 4) |
+		   (((win[atRow[0]] >> atShift[0]) & 1) << 3) |
+		   (((win[atRow[1]] >> atShift[1]) & 1) << 2) |
+		   (((win[atRow[2]] >> atShift[2]) & 1) << 1) |
+		   ((win[atRow[3]] >> atShift[3]) & 1);
+	      if (!(useSkip && skip->getPixel(x, y)) &&
+		  arithDecoder->decodeBit(cx, genericRegionStats)) {
+		*pp |= mask;
+		win[2] |= 0x8000;
+	      }
+	      win[0] <<= 1;
+	      win[1] <<= 1;
+	      win[2] <<= 1;
+	    }
+	    break;
+
+	  case 1:
+	    for (; x < x1; ++x, mask >>= 1) {
+	      cx = (((win[0] >> 13) & 0x0f) << 9) |
+		   (((win[1] >> 13) & 0x1f) << 4) |
+		   (((win[2] >> 16) & 0x07) << 1) |
+		   ((win[atRow[0]] >> atShift[0]) & 1);
+	      if (!(useSkip && skip->getPixel(x, y)) &&
+		  arithDecoder->decodeBit(cx, genericRegionStats)) {
+		*pp |= mask;
+		win[2] |= 0x8000;
+	      }
+	      win[0] <<= 1;
+	      win[1] <<= 1;
+	      win[2] <<= 1;
+	    }
+	    break;
+
+	  case 2:
+	    for (; x < x1; ++x, mask >>= 1) {
+	      cx = (((win[0] >> 14) & 0x07) << 7) |
+		   (((win[1] >> 14) & 0x0f) << 3) |
+		   (((win[2] >> 16) & 0x03) << 1) |
+		   ((win[atRow[0]] >> atShift[0]) & 1);
+	      if (!(useSkip && skip->getPixel(x, y)) &&
+		  arithDecoder->decodeBit(cx, genericRegionStats)) {
+		*pp |= mask;
+		win[2] |= 0x8000;
+	      }
+	      win[0] <<= 1;
+	      win[1] <<= 1;
+	      win[2] <<= 1;
+	    }
+	    break;
+
+	  case 3:
+	    for (; x < x1; ++x, mask >>= 1) {
+	      cx = (((win[1] >> 14) & 0x1f) << 5) |
+		   (((win[2] >> 16) & 0x0f) << 1) |
+		   ((win[atRow[0]] >> atShift[0]) & 1);
+	      if (!(useSkip && skip->getPixel(x, y)) &&
+		  arithDecoder->decodeBit(cx, genericRegionStats)) {
+		*pp |= mask;
+		win[2] |= 0x8000;
+	      }
+	      // row y-2 is not part of the fixed context, but may be
+	      // referenced by the AT pixel
+	      win[0] <<= 1;
+	      win[1] <<= 1;
+	      win[2] <<= 1;
+	    }
+	    break;
+	  }
+	}
+	continue;
+      }
+
+      // general case: unusual AT pixel positions
       switch (templ) {
       case 0:
 
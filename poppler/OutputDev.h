@@ -230,6 +230,23 @@ public:
   //----- form XObjects
   virtual void drawForm(Ref /*id*/) {}
 
+  // Form XObject caching.  Before interpreting a form <id> which
+  // could be cached, Gfx calls drawCachedForm with the form's CTM in
+  // <state> and a <hash> of the graphics state the form inherits
+  // (except for the fill and stroke colors, which the device adds as
+  // converted to its own color space).  If the device has the form
+  // cached, it draws it and returns true.  Otherwise, if it sets
+  // *<doStore>, and the form turns out to be safe to cache, Gfx
+  // interprets the form between beginCachedForm and endCachedForm (if
+  // beginCachedForm returns true).
+  virtual GBool useFormCache() { return gFalse; }
+  virtual GBool drawCachedForm(GfxState * /*state*/, Ref /*id*/,
+			       Guint /*hash*/, double * /*bbox*/,
+			       GBool *doStore) { *doStore = gFalse; return gFalse; }
+  virtual GBool beginCachedForm(GfxState * /*state*/, double * /*bbox*/)
+    { return gFalse; }
+  virtual void endCachedForm(GfxState * /*state*/) {}
+
   //----- PostScript XObjects
   virtual void psXObject(Stream * /*psStream*/, Stream * /*level1Stream*/) {}
 
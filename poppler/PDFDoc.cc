@@ -20,6 +20,7 @@
 #ifdef WIN32
 #  include <windows.h>
 #endif
+#include "goo/gmem.h"
 #include "goo/GooString.h"
 #include "poppler-config.h"
 #include "GlobalParams.h"
@@ -44,6 +45,8 @@
 #define headerSearchSize 1024	// read this many bytes at beginning of
 				//   file to look for '%PDF'
 
+#define saveBufSize 65536	// size of the blocks copied when saving
+
 //------------------------------------------------------------------------
 // PDFDoc
 //------------------------------------------------------------------------
@@ -189,7 +192,7 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
   checkHeader();
 
   // read xref table
-  xref = new XRef(str);
+  xref = new XRef(str, fileName);
   if (!xref->isOk()) {
     error(-1, "Couldn't read xref table");
     errCode = xref->getErrorCode();
@@ -437,17 +440,481 @@ GBool PDFDoc::isLinearized() {
 
 GBool PDFDoc::saveAs(GooString *name) {
   FILE *f;
-  int c;
+  GBool res;
 
+  if (isModified() && xref->isEncrypted()) {
+    error(-1, "Saving changes to encrypted files isn't supported");
+    return gFalse;
+  }
   if (!(f = fopen(name->getCString(), "wb"))) {
     error(-1, "Couldn't open file '%s'", name->getCString());
     return gFalse;
   }
+  // a reconstructed xref table has no valid offset for /Prev, so the
+  // whole file is rewritten instead of being updated
+  if (isModified() && xref->isReconstructed()) {
+    res = saveRewrite(f);
+  } else {
+    res = copyFile(f);
+    if (res && isModified()) {
+      res = saveIncrementalUpdate(f);
+    }
+  }
+  if (fclose(f)) {
+    res = gFalse;
+  }
+  if (!res) {
+    error(-1, "Couldn't write file '%s'", name->getCString());
+  }
+  return res;
+}
+
+GBool PDFDoc::saveWithoutChangesAs(GooString *name) {
+  FILE *f;
+  GBool res;
+
+  if (!(f = fopen(name->getCString(), "wb"))) {
+    error(-1, "Couldn't open file '%s'", name->getCString());
+    return gFalse;
+  }
+  res = copyFile(f);
+  if (fclose(f)) {
+    res = gFalse;
+  }
+  if (!res) {
+    error(-1, "Couldn't write file '%s'", name->getCString());
+  }
+  return res;
+}
+
+GBool PDFDoc::isModified() {
+  int i;
+
+  for (i = 0; i < xref->getNumObjects(); ++i) {
+    if (xref->isModifiedObject(i)) {
+      return gTrue;
+    }
+  }
+  return gFalse;
+}
+
+// Copy the original file to <f>, in large blocks.
+GBool PDFDoc::copyFile(FILE *f) {
+  Guchar *buf;
+  int n;
+  GBool res;
+
+  buf = (Guchar *)gmalloc(saveBufSize);
+  res = gTrue;
   str->reset();
-  while ((c = str->getChar()) != EOF) {
-    fputc(c, f);
+  while ((n = str->getChars(saveBufSize, buf)) > 0) {
+    if (fwrite(buf, 1, n, f) != (size_t)n) {
+      res = gFalse;
+      break;
+    }
   }
   str->close();
-  fclose(f);
-  return gTrue;
+  gfree(buf);
+  return res;
+}
+
+//------------------------------------------------------------------------
+// incremental updates
+//------------------------------------------------------------------------
+
+// Entries copied from the original trailer.
+static char *trailerKeys[] = {
+  "Root",
+  "Info",
+  "ID",
+  NULL
+};
+
+static GBool writeObject(FILE *f, Object *obj);
+
+static void writeString(FILE *f, GooString *s) {
+  char *p;
+  int c, i;
+
+  fputc('(', f);
+  p = s->getCString();
+  for (i = 0; i < s->getLength(); ++i) {
+    c = p[i] & 0xff;
+    if (c == '(' || c == ')' || c == '\\') {
+      fprintf(f, "\\%c", c);
+    } else if (c < 0x20 || c >= 0x7f) {
+      fprintf(f, "\\%03o", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc(')', f);
+}
+
+static void writeName(FILE *f, char *name) {
+  char *p;
+  int c;
+
+  fputc('/', f);
+  for (p = name; *p; ++p) {
+    c = *p & 0xff;
+    if (c <= 0x20 || c >= 0x7f || c == '#' || c == '/' || c == '%' ||
+	c == '(' || c == ')' || c == '<' || c == '>' ||
+	c == '[' || c == ']' || c == '{' || c == '}') {
+      fprintf(f, "#%02x", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+}
+
+// Write the entries of <dict>, except <skipKey>.
+static GBool writeDictEntries(FILE *f, Dict *dict, char *skipKey) {
+  Object obj;
+  GBool res;
+  int i;
+
+  res = gTrue;
+  for (i = 0; res && i < dict->getLength(); ++i) {
+    if (skipKey && !strcmp(dict->getKey(i), skipKey)) {
+      continue;
+    }
+    writeName(f, dict->getKey(i));
+    fputc(' ', f);
+    res = writeObject(f, dict->getValNF(i, &obj));
+    obj.free();
+    fputc('\n', f);
+  }
+  return res;
+}
+
+// Write a stream, with its data exactly as it appears in the original
+// file (i.e., still encoded), and a corrected /Length.
+static GBool writeStream(FILE *f, Stream *stream) {
+  BaseStream *baseStr;
+  Guchar *buf;
+  int size, len, n;
+  GBool res;
+
+  baseStr = stream->getBaseStream();
+  size = saveBufSize;
+  buf = (Guchar *)gmalloc(size);
+  len = 0;
+  baseStr->reset();
+  while ((n = baseStr->getChars(size - len, buf + len)) > 0) {
+    len += n;
+    if (len == size) {
+      size *= 2;
+      buf = (Guchar *)grealloc(buf, size);
+    }
+  }
+  baseStr->close();
+
+  fputs("<<\n", f);
+  res = writeDictEntries(f, baseStr->getDict(), "Length");
+  fprintf(f, "/Length %d\n>>\nstream\n", len);
+  fwrite(buf, 1, len, f);
+  fputs("\nendstream", f);
+  gfree(buf);
+  return res;
+}
+
+static GBool writeObject(FILE *f, Object *obj) {
+  Object obj1;
+  GooString *s;
+  GBool res;
+  int i;
+
+  res = gTrue;
+  switch (obj->getType()) {
+  case objBool:
+    fputs(obj->getBool() ? "true" : "false", f);
+    break;
+  case objInt:
+    fprintf(f, "%d", obj->getInt());
+    break;
+  case objReal:
+    s = GooString::format("{0:.10g}", obj->getReal());
+    fputs(s->getCString(), f);
+    delete s;
+    break;
+  case objString:
+    writeString(f, obj->getString());
+    break;
+  case objName:
+    writeName(f, obj->getName());
+    break;
+  case objNull:
+    fputs("null", f);
+    break;
+  case objArray:
+    fputc('[', f);
+    for (i = 0; res && i < obj->arrayGetLength(); ++i) {
+      if (i > 0) {
+	fputc(' ', f);
+      }
+      res = writeObject(f, obj->arrayGetNF(i, &obj1));
+      obj1.free();
+    }
+    fputc(']', f);
+    break;
+  case objDict:
+    fputs("<<\n", f);
+    res = writeDictEntries(f, obj->getDict(), NULL);
+    fputs(">>", f);
+    break;
+  case objStream:
+    res = writeStream(f, obj->getStream());
+    break;
+  case objRef:
+    fprintf(f, "%d %d R", obj->getRefNum(), obj->getRefGen());
+    break;
+  default:
+    error(-1, "Can't write object of type '%s'", obj->getTypeName());
+    res = gFalse;
+    break;
+  }
+  return res;
+}
+
+// Append the modified and new objects, followed by a cross-reference
+// section and a trailer pointing back to the original one.  If the
+// original file ends with a cross-reference stream, a cross-reference
+// stream is written too.
+GBool PDFDoc::saveIncrementalUpdate(FILE *f) {
+  Object *trailer;
+  Object obj1;
+  XRefEntry *e;
+  Guint *offsets;
+  int *gens;
+  Guchar entry[7];
+  Guint pos, offset;
+  GBool xrefStream, res;
+  int nObjs, size, xrefNum, first, i, j;
+
+  trailer = xref->getTrailerDict();
+  trailer->dictLookup("Type", &obj1);
+  xrefStream = obj1.isName("XRef");
+  obj1.free();
+
+  // write the objects
+  nObjs = xref->getNumObjects();
+  offsets = (Guint *)gmallocn(nObjs + 1, sizeof(Guint));
+  gens = (int *)gmallocn(nObjs + 1, sizeof(int));
+  res = gTrue;
+  fputc('\n', f);
+  for (i = 0; res && i < nObjs; ++i) {
+    if (!xref->isModifiedObject(i)) {
+      continue;
+    }
+    // objects from object streams always have generation 0
+    e = xref->getEntry(i);
+    gens[i] = e->type == xrefEntryCompressed ? 0 : e->gen;
+    offsets[i] = (Guint)ftell(f);
+    fprintf(f, "%d %d obj\n", i, gens[i]);
+    xref->fetch(i, e->gen, &obj1);
+    res = writeObject(f, &obj1);
+    obj1.free();
+    fputs("\nendobj\n", f);
+  }
+  if (!res) {
+    gfree(offsets);
+    gfree(gens);
+    return gFalse;
+  }
+  pos = (Guint)ftell(f);
+
+  // the new /Size covers the original objects and the modified ones;
+  // the cross-reference stream gets the next free object number
+  trailer->dictLookup("Size", &obj1);
+  size = obj1.isInt() ? obj1.getInt() : 0;
+  obj1.free();
+  if (size < 0 || size > nObjs) {
+    size = nObjs;
+  }
+  for (i = size; i < nObjs; ++i) {
+    if (xref->isModifiedObject(i)) {
+      size = i + 1;
+    }
+  }
+  xrefNum = -1;
+  if (xrefStream) {
+    xrefNum = size++;
+    offsets[xrefNum] = pos;
+    gens[xrefNum] = 0;
+  }
+
+  // write the cross-reference section, with one subsection for each
+  // run of consecutive objects
+  if (xrefStream) {
+    fprintf(f, "%d 0 obj\n<<\n/Type /XRef\n/W [1 4 2]\n/Index [", xrefNum);
+  } else {
+    fputs("xref\n", f);
+  }
+  for (i = 0; i < size; i = j) {
+    if (i != xrefNum && !xref->isModifiedObject(i)) {
+      j = i + 1;
+      continue;
+    }
+    first = i;
+    for (j = i + 1;
+	 j == xrefNum || xref->isModifiedObject(j);
+	 ++j) ;
+    if (xrefStream) {
+      fprintf(f, "%d %d ", first, j - first);
+    } else {
+      fprintf(f, "%d %d\n", first, j - first);
+      for (i = first; i < j; ++i) {
+	fprintf(f, "%010u %05d n\r\n", offsets[i], gens[i]);
+      }
+    }
+  }
+  if (xrefStream) {
+    fputs("]\n", f);
+  } else {
+    fputs("trailer\n<<\n", f);
+  }
+
+  // the trailer keeps the document-level entries of the original one
+  fprintf(f, "/Size %d\n", size);
+  fprintf(f, "/Prev %u\n", xref->getLastXRefPos());
+  for (i = 0; trailerKeys[i]; ++i) {
+    trailer->dictLookupNF(trailerKeys[i], &obj1);
+    if (!obj1.isNull()) {
+      writeName(f, trailerKeys[i]);
+      fputc(' ', f);
+      writeObject(f, &obj1);
+      fputc('\n', f);
+    }
+    obj1.free();
+  }
+
+  if (xrefStream) {
+    j = 0;
+    for (i = 0; i < size; ++i) {
+      if (i == xrefNum || xref->isModifiedObject(i)) {
+	++j;
+      }
+    }
+    fprintf(f, "/Length %d\n>>\nstream\n", 7 * j);
+    for (i = 0; i < size; ++i) {
+      if (i != xrefNum && !xref->isModifiedObject(i)) {
+	continue;
+      }
+      offset = offsets[i];
+      entry[0] = 1;
+      entry[1] = (offset >> 24) & 0xff;
+      entry[2] = (offset >> 16) & 0xff;
+      entry[3] = (offset >> 8) & 0xff;
+      entry[4] = offset & 0xff;
+      entry[5] = (gens[i] >> 8) & 0xff;
+      entry[6] = gens[i] & 0xff;
+      fwrite(entry, 1, 7, f);
+    }
+    fputs("\nendstream\nendobj\n", f);
+  } else {
+    fputs(">>\n", f);
+  }
+  fprintf(f, "startxref\n%u\n%%%%EOF\n", pos);
+
+  gfree(offsets);
+  gfree(gens);
+  return !ferror(f);
+}
+
+// Write a complete new file: every object in the xref table, followed
+// by a single cross-reference table and a trailer with no /Prev.  This
+// is used for damaged files, whose original cross-reference data can't
+// be chained to.  Cross-reference and object streams are dropped, since
+// their contents are written as plain objects.
+GBool PDFDoc::saveRewrite(FILE *f) {
+  Object *trailer;
+  Object obj1, obj2;
+  XRefEntry *e;
+  Guint *offsets;
+  int *gens;
+  Guint pos;
+  GBool res;
+  int nObjs, nextFree, i;
+
+  nObjs = xref->getNumObjects();
+  offsets = (Guint *)gmallocn(nObjs + 1, sizeof(Guint));
+  gens = (int *)gmallocn(nObjs + 1, sizeof(int));
+  fprintf(f, "%%PDF-%.1f\n%%\xe2\xe3\xcf\xd3\n",
+	  pdfVersion > 0 ? pdfVersion : 1.4);
+
+  // write the objects; an offset of 0 marks a free entry
+  res = gTrue;
+  for (i = 0; res && i < nObjs; ++i) {
+    offsets[i] = 0;
+    gens[i] = 0;
+    e = xref->getEntry(i);
+    if (i == 0 || e->type == xrefEntryFree) {
+      continue;
+    }
+    xref->fetch(i, e->gen, &obj1);
+    if (obj1.isNull()) {
+      obj1.free();
+      continue;
+    }
+    if (obj1.isStream()) {
+      obj1.streamGetDict()->lookup("Type", &obj2);
+      if (obj2.isName("XRef") || obj2.isName("ObjStm")) {
+	obj2.free();
+	obj1.free();
+	continue;
+      }
+      obj2.free();
+    }
+    // objects from object streams always have generation 0
+    gens[i] = e->type == xrefEntryCompressed ? 0 : e->gen;
+    offsets[i] = (Guint)ftell(f);
+    fprintf(f, "%d %d obj\n", i, gens[i]);
+    res = writeObject(f, &obj1);
+    obj1.free();
+    fputs("\nendobj\n", f);
+  }
+  if (!res) {
+    gfree(offsets);
+    gfree(gens);
+    return gFalse;
+  }
+
+  // write the cross-reference table as a single subsection; the free
+  // entries are linked in increasing order, with the link to the next
+  // free object stored in <gens>
+  nextFree = 0;
+  for (i = nObjs - 1; i >= 0; --i) {
+    if (i == 0 || offsets[i] == 0) {
+      gens[i] = nextFree;
+      nextFree = i;
+    }
+  }
+  pos = (Guint)ftell(f);
+  fprintf(f, "xref\n0 %d\n", nObjs);
+  for (i = 0; i < nObjs; ++i) {
+    if (i == 0 || offsets[i] == 0) {
+      fprintf(f, "%010d %05d f\r\n", gens[i], i == 0 ? 65535 : 0);
+    } else {
+      fprintf(f, "%010u %05d n\r\n", offsets[i], gens[i]);
+    }
+  }
+
+  trailer = xref->getTrailerDict();
+  fprintf(f, "trailer\n<<\n/Size %d\n", nObjs);
+  for (i = 0; trailerKeys[i]; ++i) {
+    trailer->dictLookupNF(trailerKeys[i], &obj1);
+    if (!obj1.isNull()) {
+      writeName(f, trailerKeys[i]);
+      fputc(' ', f);
+      writeObject(f, &obj1);
+      fputc('\n', f);
+    }
+    obj1.free();
+  }
+  fprintf(f, ">>\nstartxref\n%u\n%%%%EOF\n", pos);
+
+  gfree(offsets);
+  gfree(gens);
+  return !ferror(f);
 }
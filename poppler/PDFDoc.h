@@ -168,9 +168,19 @@ public:
   // Return the PDF version specified by the file.
   double getPDFVersion() { return pdfVersion; }
 
-  // Save this file with another name.
+  // Save this file with another name.  Objects changed through
+  // XRef::setModifiedObject or added with XRef::addIndirectObject are
+  // appended to a copy of the original file, as an incremental
+  // update.  If the file was damaged and its xref table had to be
+  // reconstructed, a complete new file is written instead.
   GBool saveAs(GooString *name);
 
+  // Save an unmodified copy of this file with another name.
+  GBool saveWithoutChangesAs(GooString *name);
+
+  // Returns true if any object has been modified or added.
+  GBool isModified();
+
   // Return a pointer to the GUI (XPDFCore or WinPDFCore object).
   void *getGUIData() { return guiData; }
 
@@ -180,6 +190,9 @@ private:
   GBool checkFooter();
   void checkHeader();
   GBool checkEncryption(GooString *ownerPassword, GooString *userPassword);
+  GBool copyFile(FILE *f);
+  GBool saveIncrementalUpdate(FILE *f);
+  GBool saveRewrite(FILE *f);
 
   GooString *fileName;
   FILE *file;
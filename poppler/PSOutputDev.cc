@@ -1382,8 +1382,10 @@ void PSOutputDev::writeDocSetup(Catalog *catalog,
     if ((resDict = page->getResourceDict())) {
       setupResources(resDict);
     }
-    annots = new Annots(xref, catalog, page->getAnnots(&obj1));
-    obj1.free();
+    if (!globalParams->getDrawAnnotations()) {
+      continue;
+    }
+    annots = page->getAnnotList(catalog);
     for (i = 0; i < annots->getNumAnnots(); ++i) {
       if (annots->getAnnot(i)->getAppearance(&obj1)->isStream()) {
 	obj1.streamGetDict()->lookup("Resources", &obj2);
@@ -1394,7 +1396,6 @@ void PSOutputDev::writeDocSetup(Catalog *catalog,
       }
       obj1.free();
     }
-    delete annots;
   }
   if (mode != psModeForm) {
     if (mode != psModeEPS && !manualCtrl) {
@@ -228,13 +228,16 @@ GBool PageAttrs::readBox(Dict *dict, char *key, PDFRectangle *box) {
 // Page
 //------------------------------------------------------------------------
 
-Page::Page(XRef *xrefA, int numA, Dict *pageDict, PageAttrs *attrsA, Form *form) {
+Page::Page(XRef *xrefA, int numA, Dict *pageDict, PageAttrs *attrsA, Form *formA) {
   Object tmp;
 	
   ok = gTrue;
   xref = xrefA;
   num = numA;
   duration = -1;
+  form = formA;
+  pageWidgets = NULL;
+  annotList = NULL;
 
   // get attributes
   attrs = attrsA;
@@ -266,10 +269,6 @@ Page::Page(XRef *xrefA, int numA, Dict *pageDict, PageAttrs *attrsA, Form *form)
     goto err2;
   }
 
-  // forms
-  pageWidgets = new FormPageWidgets(xrefA, this->getAnnots(&tmp),num,form);
-  tmp.free();
-
   // contents
   pageDict->lookupNF("Contents", &contents);
   if (!(contents.isRef() || contents.isArray() ||
@@ -307,12 +306,37 @@ Page::Page(XRef *xrefA, int numA, Dict *pageDict, PageAttrs *attrsA, Form *form)
 }
 
 Page::~Page() {
-  delete pageWidgets;
+  if (pageWidgets) {
+    delete pageWidgets;
+  }
+  if (annotList) {
+    delete annotList;
+  }
   delete attrs;
   annots.free();
   contents.free();
 }
 
+Annots *Page::getAnnotList(Catalog *catalog) {
+  Object obj;
+
+  if (!annotList) {
+    annotList = new Annots(xref, catalog, getAnnots(&obj));
+    obj.free();
+  }
+  return annotList;
+}
+
+FormPageWidgets *Page::getPageWidgets() {
+  Object obj;
+
+  if (!pageWidgets) {
+    pageWidgets = new FormPageWidgets(xref, getAnnots(&obj), num, form);
+    obj.free();
+  }
+  return pageWidgets;
+}
+
 Links *Page::getLinks(Catalog *catalog) {
   Links *links;
   Object obj;
@@ -383,7 +407,6 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
                         void *annotDisplayDecideCbkData) {
   Gfx *gfx;
   Object obj;
-  Annots *annotList;
   Dict *acroForm;
   int i;
   
@@ -410,8 +433,11 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
 
 
   // draw annotations
-  annotList = new Annots(xref, catalog, getAnnots(&obj));
-  obj.free();
+  if (!globalParams->getDrawAnnotations()) {
+    delete gfx;
+    return;
+  }
+  annotList = getAnnotList(catalog);
   acroForm = catalog->getAcroForm()->isDict() ?
                catalog->getAcroForm()->getDict() : NULL;
   if (acroForm) {
@@ -432,7 +458,6 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
     }
     out->dump();
   }
-  delete annotList;
 
   delete gfx;
 }
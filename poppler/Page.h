@@ -107,7 +107,7 @@ class Page {
 public:
 
   // Constructor.
-  Page(XRef *xrefA, int numA, Dict *pageDict, PageAttrs *attrsA, Form *form);
+  Page(XRef *xrefA, int numA, Dict *pageDict, PageAttrs *attrsA, Form *formA);
 
   // Destructor.
   ~Page();
@@ -145,6 +145,10 @@ public:
   // Get annotations array.
   Object *getAnnots(Object *obj) { return annots.fetch(xref, obj); }
 
+  // Get the parsed annotations.  The list is built the first time it
+  // is needed, and belongs to the page.
+  Annots *getAnnotList(Catalog *catalog);
+
   // Return a list of links.
   Links *getLinks(Catalog *catalog);
 
@@ -158,8 +162,9 @@ public:
   // Get transition.
   Object *getTrans(Object *obj) { return trans.fetch(xref, obj); }
 
-  // Get form.
-  FormPageWidgets *getPageWidgets() { return pageWidgets; }
+  // Get form.  The widgets are matched with the page's annotations
+  // the first time they are needed.
+  FormPageWidgets *getPageWidgets();
 
   // Get duration, the maximum length of time, in seconds,
   // that the page is displayed before the presentation automatically
@@ -217,7 +222,11 @@ private:
   PageAttrs *attrs;		// page attributes
   Object annots;		// annotations array
   Object contents;		// page contents
+  Form *form;			// the document's form (may be NULL)
   FormPageWidgets *pageWidgets; 			// the form for that page
+				//   (NULL until first used)
+  Annots *annotList;		// parsed annotations (NULL until first
+				//   used)
   Object thumb;			// page thumbnail
   Object trans;			// page transition
   Object actions;		// page addiction actions
@@ -26,6 +26,8 @@ Parser::Parser(XRef *xrefA, Lexer *lexerA, GBool allowStreamsA) {
   lexer = lexerA;
   inlineImg = 0;
   allowStreams = allowStreamsA;
+  objKeyNum = objKeyGen = -1;
+  objKeyLength = 0;
   lexer->getObj(&buf1);
   lexer->getObj(&buf2);
 }
@@ -45,7 +47,9 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
   int num;
   DecryptStream *decrypt;
   GooString *s, *s2;
-  int c;
+  Guchar *objKeyA;
+  char strBuf[256];
+  int n;
 
   // refill buffer after inline image data
   if (inlineImg == 2) {
@@ -119,13 +123,13 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
     s = buf1.getString();
     s2 = new GooString();
     obj2.initNull();
+    objKeyA = getObjKey(fileKey, encAlgorithm, keyLength, objNum, objGen);
     decrypt = new DecryptStream(new MemStream(s->getCString(), 0,
 					      s->getLength(), &obj2),
-				fileKey, encAlgorithm, keyLength,
-				objNum, objGen);
+				objKeyA, objKeyLength, encAlgorithm);
     decrypt->reset();
-    while ((c = decrypt->getChar()) != EOF) {
-      s2->append((char)c);
+    while ((n = decrypt->getChars(sizeof(strBuf), (Guchar *)strBuf)) > 0) {
+      s2->append(strBuf, n);
     }
     delete decrypt;
     obj->initString(s2);
@@ -150,6 +154,7 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
   Object obj;
   BaseStream *baseStr;
   Stream *str;
+  Guchar *objKeyA;
   Guint pos, endPos, length;
 
   // get stream start position
@@ -204,8 +209,8 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
 
   // handle decryption
   if (fileKey) {
-    str = new DecryptStream(str, fileKey, encAlgorithm, keyLength,
-			    objNum, objGen);
+    objKeyA = getObjKey(fileKey, encAlgorithm, keyLength, objNum, objGen);
+    str = new DecryptStream(str, objKeyA, objKeyLength, encAlgorithm);
   }
 
   // get filters
@@ -214,6 +219,19 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
   return str;
 }
 
+// All of the strings (and the stream, if any) in one object are
+// decrypted with the same key, so it is only computed once.
+Guchar *Parser::getObjKey(Guchar *fileKey, CryptAlgorithm encAlgorithm,
+			  int keyLength, int objNum, int objGen) {
+  if (objNum != objKeyNum || objGen != objKeyGen) {
+    objKeyLength = Decrypt::makeObjKey(fileKey, encAlgorithm, keyLength,
+				       objNum, objGen, objKey);
+    objKeyNum = objNum;
+    objKeyGen = objGen;
+  }
+  return objKey;
+}
+
 void Parser::shift(int objNum) {
   if (inlineImg > 0) {
     if (inlineImg < 2) {
@@ -46,7 +46,12 @@ private:
   GBool allowStreams;		// parse stream objects?
   Object buf1, buf2;		// next two tokens
   int inlineImg;		// set when inline image data is encountered
+  int objKeyNum, objKeyGen;	// object which <objKey> was computed for
+  Guchar objKey[16 + 9];	// cached decryption key for one object
+  int objKeyLength;
 
+  Guchar *getObjKey(Guchar *fileKey, CryptAlgorithm encAlgorithm,
+		    int keyLength, int objNum, int objGen);
   Stream *makeStream(Object *dict, Guchar *fileKey,
 		     CryptAlgorithm encAlgorithm, int keyLength,
 		     int objNum, int objGen);
@@ -14,6 +14,8 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include "goo/GooString.h"
+#include "goo/GooHash.h"
 #include "ProfileData.h"
 
 //------------------------------------------------------------------------
@@ -42,3 +44,206 @@ ProfileData::addElement (double elapsed) {
 	count ++;
 }
 
+
+//------------------------------------------------------------------------
+// PageProfile
+//------------------------------------------------------------------------
+
+struct ProfileFilterData {
+  ProfileData time;
+  double nBytes;
+};
+
+static const char *phaseNames[profileNumPhases] = {
+  "xrefFetch",
+  "streamDecode",
+  "fontLoad",
+  "glyph",
+  "image",
+  "fill",
+  "stroke",
+  "composite"
+};
+
+static const char *counterNames[profileNumCounters] = {
+  "glyphCacheHits",
+  "glyphCacheMisses",
+  "fontCacheHits",
+  "fontCacheMisses",
+  "objStrCacheHits",
+  "objStrCacheMisses",
+  "imageCacheHits",
+  "imageCacheMisses",
+  "formCacheHits",
+  "formCacheMisses",
+  "t3GlyphCacheHits",
+  "t3GlyphCacheMisses"
+};
+
+PageProfile *PageProfile::active = NULL;
+
+PageProfile::PageProfile(int pageA) {
+  int i;
+
+  page = pageA;
+  total = 0;
+  nested = 0;
+  for (i = 0; i < profileNumCounters; ++i) {
+    counters[i] = 0;
+  }
+  filters = new GooHash(gTrue);
+  ops = new GooHash(gTrue);
+}
+
+PageProfile::~PageProfile() {
+  if (active == this) {
+    active = NULL;
+  }
+  deleteGooHash(filters, ProfileFilterData);
+  deleteGooHash(ops, ProfileData);
+}
+
+void PageProfile::start() {
+  nested = 0;
+  clock.start();
+  active = this;
+}
+
+void PageProfile::stop() {
+  total += clock.getElapsed();
+  if (active == this) {
+    active = NULL;
+  }
+}
+
+void PageProfile::addFilter(char *filter, double elapsed, int nBytes) {
+  ProfileFilterData *data;
+
+  if (!(data = (ProfileFilterData *)filters->lookup(filter))) {
+    data = new ProfileFilterData;
+    data->nBytes = 0;
+    filters->add(new GooString(filter), data);
+  }
+  data->time.addElement(elapsed);
+  data->nBytes += nBytes;
+}
+
+void PageProfile::addOp(char *op, double elapsed) {
+  ProfileData *data;
+
+  if (!(data = (ProfileData *)ops->lookup(op))) {
+    data = new ProfileData();
+    ops->add(new GooString(op), data);
+  }
+  data->addElement(elapsed);
+}
+
+// Write <s> as a JSON string.
+static void writeJSONString(FILE *f, GooString *s) {
+  int c, i;
+
+  fputc('"', f);
+  for (i = 0; i < s->getLength(); ++i) {
+    c = s->getChar(i) & 0xff;
+    if (c == '"' || c == '\\') {
+      fprintf(f, "\\%c", c);
+    } else if (c < 0x20 || c >= 0x7f) {
+      fprintf(f, "\\u%04x", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+static void writeJSONTime(FILE *f, ProfileData *data) {
+  fprintf(f, "{\"count\": %d, \"total\": %.3f, \"min\": %.3f, \"max\": %.3f",
+	  data->getCount(), data->getTotal() * 1000,
+	  data->getMin() * 1000, data->getMax() * 1000);
+}
+
+void PageProfile::writeJSON(FILE *f) {
+  GooHashIter *iter;
+  GooString *key;
+  ProfileFilterData *filterData;
+  ProfileData *opData;
+  double phaseTotal;
+  GBool first;
+  int i;
+
+  fprintf(f, "{\"page\": %d, \"total\": %.3f,\n", page, total * 1000);
+
+  phaseTotal = 0;
+  fprintf(f, " \"phases\": {");
+  for (i = 0; i < profileNumPhases; ++i) {
+    fprintf(f, "%s\n  \"%s\": ", i ? "," : "", phaseNames[i]);
+    writeJSONTime(f, &phases[i]);
+    fputc('}', f);
+    phaseTotal += phases[i].getTotal();
+  }
+  // everything else: content stream parsing, operators, text layout,
+  // ...
+  fprintf(f, ",\n  \"other\": {\"total\": %.3f}},\n",
+	  total > phaseTotal ? (total - phaseTotal) * 1000 : 0.0);
+
+  fprintf(f, " \"filters\": {");
+  first = gTrue;
+  filters->startIter(&iter);
+  while (filters->getNext(&iter, &key, (void **)&filterData)) {
+    fprintf(f, "%s\n  ", first ? "" : ",");
+    writeJSONString(f, key);
+    fprintf(f, ": ");
+    writeJSONTime(f, &filterData->time);
+    fprintf(f, ", \"bytes\": %.0f}", filterData->nBytes);
+    first = gFalse;
+  }
+  fprintf(f, "},\n");
+
+  fprintf(f, " \"counters\": {");
+  for (i = 0; i < profileNumCounters; ++i) {
+    fprintf(f, "%s\"%s\": %d", i ? ", " : "", counterNames[i], counters[i]);
+  }
+  fprintf(f, "},\n");
+
+  fprintf(f, " \"operators\": {");
+  first = gTrue;
+  ops->startIter(&iter);
+  while (ops->getNext(&iter, &key, (void **)&opData)) {
+    fprintf(f, "%s\n  ", first ? "" : ",");
+    writeJSONString(f, key);
+    fprintf(f, ": ");
+    writeJSONTime(f, opData);
+    fputc('}', f);
+    first = gFalse;
+  }
+  fprintf(f, "}}");
+}
+
+//------------------------------------------------------------------------
+// ProfileTimer
+//------------------------------------------------------------------------
+
+void ProfileTimer::begin() {
+  startTime = profile->clock.getElapsed();
+  savedNested = profile->nested;
+  profile->nested = 0;
+}
+
+void ProfileTimer::end() {
+  double elapsed, exclusive;
+
+  // the profile may have been stopped while this timer was running
+  if (PageProfile::active != profile) {
+    return;
+  }
+  elapsed = profile->clock.getElapsed() - startTime;
+  exclusive = elapsed - profile->nested;
+  if (exclusive < 0) {
+    exclusive = 0;
+  }
+  profile->nested = savedNested + elapsed;
+  profile->addTime(phase, exclusive);
+  if (filter) {
+    profile->addFilter(filter, exclusive, nBytes);
+  }
+}
@@ -13,6 +13,12 @@
 #pragma interface
 #endif
 
+#include <stdio.h>
+#include "goo/gtypes.h"
+#include "goo/GooTimer.h"
+
+class GooHash;
+
 //------------------------------------------------------------------------
 // ProfileData
 //------------------------------------------------------------------------
@@ -29,13 +35,136 @@ public:
   void addElement (double elapsed);
   int getCount () { return count; }
   double getTotal () { return total; }
-  double getMin () { return max; }
+  double getMin () { return min; }
   double getMax () { return max; }
 private:
-  int count;			// size of <elems> array
-  double total;			// number of elements in array
-  double min;			// reference count
-  double max;			// reference count
+  int count;			// number of elements added
+  double total;			// sum of the elements
+  double min;			// smallest element
+  double max;			// largest element
+};
+
+//------------------------------------------------------------------------
+// PageProfile
+//------------------------------------------------------------------------
+
+// Phases of rendering.  Times are exclusive: time spent in a nested
+// phase (e.g., decoding the stream of an image which is being drawn,
+// or fetching an object while loading a font) is only counted in the
+// nested phase.
+enum ProfilePhase {
+  profileXRefFetch,		// fetching and parsing objects
+  profileStreamDecode,		// running stream filters (also broken
+				//   down by filter)
+  profileFontLoad,		// loading fonts
+  profileGlyph,			// rasterizing and drawing glyphs
+  profileImage,			// converting and resampling images
+  profileFill,			// rasterizing fills
+  profileStroke,		// rasterizing strokes
+  profileComposite,		// compositing groups and soft masks
+  profileNumPhases
+};
+
+enum ProfileCounter {
+  profileGlyphCacheHit,
+  profileGlyphCacheMiss,
+  profileFontCacheHit,
+  profileFontCacheMiss,
+  profileObjStrCacheHit,
+  profileObjStrCacheMiss,
+  profileImageCacheHit,
+  profileImageCacheMiss,
+  profileFormCacheHit,
+  profileFormCacheMiss,
+  profileT3GlyphCacheHit,
+  profileT3GlyphCacheMiss,
+  profileNumCounters
+};
+
+// Collects the profile of one page: time spent in each phase,
+// per-filter decoding times and byte counts, per-operator times, and
+// cache hit/miss counters.
+//
+// Events are recorded in the active profile, set by start() and
+// cleared by stop(), so only one page (in one thread) can be profiled
+// at a time.  When no profile is active, recording costs one pointer
+// test.
+class PageProfile {
+public:
+
+  PageProfile(int pageA);
+  ~PageProfile();
+
+  // Make this the active profile and start the page clock.
+  void start();
+
+  // Stop the page clock and deactivate this profile.
+  void stop();
+
+  static PageProfile *getActive() { return active; }
+
+  void addTime(ProfilePhase phase, double elapsed)
+    { phases[phase].addElement(elapsed); }
+  void addFilter(char *filter, double elapsed, int nBytes);
+  void addOp(char *op, double elapsed);
+  void count(ProfileCounter counter, int n = 1)
+    { counters[counter] += n; }
+
+  int getPage() { return page; }
+  double getTotal() { return total; }
+  ProfileData *getPhase(ProfilePhase phase) { return &phases[phase]; }
+  int getCounter(ProfileCounter counter) { return counters[counter]; }
+
+  // Write the profile as a JSON object.  Times are in milliseconds.
+  void writeJSON(FILE *f);
+
+private:
+
+  static PageProfile *active;
+
+  int page;
+  GooTimer clock;		// started by start()
+  double total;			// page time, in seconds
+  double nested;		// time spent in nested ProfileTimers
+  ProfileData phases[profileNumPhases];
+  int counters[profileNumCounters];
+  GooHash *filters;		// filter name -> ProfileFilterData
+  GooHash *ops;			// operator -> ProfileData
+
+  friend class ProfileTimer;
+};
+
+//------------------------------------------------------------------------
+// ProfileTimer
+//------------------------------------------------------------------------
+
+// Times the enclosing scope as <phase> of the active PageProfile, if
+// there is one.
+class ProfileTimer {
+public:
+
+  ProfileTimer(ProfilePhase phaseA)
+    { phase = phaseA; filter = NULL; nBytes = 0;
+      if ((profile = PageProfile::active)) { begin(); } }
+
+  ~ProfileTimer() { if (profile) { end(); } }
+
+  // Also record the elapsed time for <filterA>, which produced
+  // <nBytesA> bytes.
+  void setFilter(char *filterA, int nBytesA)
+    { filter = filterA; nBytes = nBytesA; }
+
+private:
+
+  void begin();
+  void end();
+
+  PageProfile *profile;
+  ProfilePhase phase;
+  char *filter;
+  int nBytes;
+  double startTime;
+  double savedNested;
 };
 
 #endif
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <math.h>
 #include "goo/gfile.h"
+#include "goo/GooList.h"
 #include "GlobalParams.h"
 #include "Error.h"
 #include "Object.h"
@@ -22,12 +23,14 @@
 #include "Link.h"
 #include "CharCodeToUnicode.h"
 #include "FontEncodingTables.h"
+#include "ProfileData.h"
 #include "fofi/FoFiTrueType.h"
 #include "splash/SplashBitmap.h"
 #include "splash/SplashGlyphBitmap.h"
 #include "splash/SplashPattern.h"
 #include "splash/SplashScreen.h"
 #include "splash/SplashPath.h"
+#include "splash/SplashClip.h"
 #include "splash/SplashState.h"
 #include "splash/SplashErrorCodes.h"
 #include "splash/SplashFontEngine.h"
@@ -439,9 +442,20 @@ private:
 // T3FontCache
 //------------------------------------------------------------------------
 
+// Glyph bitmaps of one Type 3 font at one transform.  The glyphs are
+// kept in cacheSets sets of cacheAssoc glyphs, selected by the low
+// bits of the char code -- with 8-bit codes, each set has room for
+// all the codes which map to it.  Bitmaps are allocated when a glyph
+// is first stored, and all fonts share the byte budget set by
+// GlobalParams::setT3CacheSize.
+
+#define t3FontCacheSets  32
+#define t3FontCacheAssoc 8
+
 struct T3FontCacheTag {
   Gushort code;
   Gushort mru;			// valid bit (0x8000) and MRU index
+  Guchar *data;			// glyph bitmap (NULL if not allocated)
 };
 
 class T3FontCache {
@@ -450,7 +464,7 @@ public:
   T3FontCache(Ref *fontID, double m11A, double m12A,
 	      double m21A, double m22A,
 	      int glyphXA, int glyphYA, int glyphWA, int glyphHA,
-	      GBool aa, GBool validBBoxA);
+	      GBool validBBoxA, GBool aa);
   ~T3FontCache();
   GBool matches(Ref *idA, double m11A, double m12A,
 		double m21A, double m22A)
@@ -465,8 +479,8 @@ public:
   int glyphSize;		// size of glyph bitmaps, in bytes
   int cacheSets;		// number of sets in cache
   int cacheAssoc;		// cache associativity (glyphs per set)
-  Guchar *cacheData;		// glyph pixmap cache
   T3FontCacheTag *cacheTags;	// cache tags, i.e., char codes
+  int size;			// bytes used by tags and bitmaps
 };
 
 T3FontCache::T3FontCache(Ref *fontIDA, double m11A, double m12A,
@@ -490,26 +504,23 @@ T3FontCache::T3FontCache(Ref *fontIDA, double m11A, double m12A,
   } else {
     glyphSize = ((glyphW + 7) >> 3) * glyphH;
   }
-  cacheAssoc = 8;
-  if (glyphSize <= 256) {
-    cacheSets = 8;
-  } else if (glyphSize <= 512) {
-    cacheSets = 4;
-  } else if (glyphSize <= 1024) {
-    cacheSets = 2;
-  } else {
-    cacheSets = 1;
-  }
-  cacheData = (Guchar *)gmallocn(cacheSets * cacheAssoc, glyphSize);
+  cacheSets = t3FontCacheSets;
+  cacheAssoc = t3FontCacheAssoc;
   cacheTags = (T3FontCacheTag *)gmallocn(cacheSets * cacheAssoc,
 					 sizeof(T3FontCacheTag));
   for (i = 0; i < cacheSets * cacheAssoc; ++i) {
     cacheTags[i].mru = i & (cacheAssoc - 1);
+    cacheTags[i].data = NULL;
   }
+  size = cacheSets * cacheAssoc * sizeof(T3FontCacheTag);
 }
 
 T3FontCache::~T3FontCache() {
-  gfree(cacheData);
+  int i;
+
+  for (i = 0; i < cacheSets * cacheAssoc; ++i) {
+    gfree(cacheTags[i].data);
+  }
   gfree(cacheTags);
 }
 
@@ -519,7 +530,10 @@ struct T3GlyphStack {
   //----- cache info
   T3FontCache *cache;		// font cache for the current font
   T3FontCacheTag *cacheTag;	// pointer to cache tag for the glyph
+				//   (NULL if the glyph isn't kept)
   Guchar *cacheData;		// pointer to cache data for the glyph
+  GBool cacheOwned;		// set if <cache> isn't in the font cache
+				//   (it's deleted along with this record)
 
   //----- saved state
   SplashBitmap *origBitmap;
@@ -529,13 +543,504 @@ struct T3GlyphStack {
   T3GlyphStack *next;		// next object on stack
 };
 
+//------------------------------------------------------------------------
+// SplashOutImageCache
+//------------------------------------------------------------------------
+
+// Images drawn with drawImage and drawSoftMaskedImage, decoded and
+// converted to the output color mode.  Entries are keyed by the image
+// object's reference and size, the color mode, and a hash of the
+// color map and color key mask -- the color space of an image XObject
+// can be a resource name, which may resolve differently on different
+// pages.  Images are only stored the second time they are drawn, so
+// images which are drawn once don't use any memory.
+
+#define splashOutImageCacheMaxEntries 256  // entries, including images
+					   //   which were drawn once
+
+struct SplashOutImageCacheEntry {
+  Ref ref;
+  Guint hash;			// hash of the color map and mask colors
+  SplashColorMode srcMode;
+  int width, height;
+  SplashColorPtr colors;	// [height * width * nComps], or NULL if
+				//   the image was only drawn once
+  Guchar *alpha;		// [height * width], or NULL
+  int size;			// bytes used by colors and alpha
+};
+
+class SplashOutImageCache {
+public:
+
+  SplashOutImageCache(int maxSizeA);
+  ~SplashOutImageCache();
+
+  // Look up an image, and make it the most recently used one.
+  // Returns the entry if the image is stored.  Otherwise returns
+  // NULL, and sets *<doStore> if the image should now be stored with
+  // store().
+  SplashOutImageCacheEntry *lookup(Ref ref, Guint hash,
+				   SplashColorMode srcMode,
+				   int width, int height, int nComps,
+				   GBool srcAlpha, GBool *doStore);
+
+  // Read all the lines of the image last passed to lookup() from
+  // <src>, and store them.
+  SplashOutImageCacheEntry *store(SplashImageSource src, void *srcData,
+				  int nComps, GBool srcAlpha);
+
+private:
+
+  void freeEntry(SplashOutImageCacheEntry *entry);
+
+  GooList *entries;		// [SplashOutImageCacheEntry], most
+				//   recently used first
+  int size;			// bytes used by all entries
+  int maxSize;
+};
+
+SplashOutImageCache::SplashOutImageCache(int maxSizeA) {
+  entries = new GooList();
+  size = 0;
+  maxSize = maxSizeA;
+}
+
+SplashOutImageCache::~SplashOutImageCache() {
+  int i;
+
+  for (i = 0; i < entries->getLength(); ++i) {
+    freeEntry((SplashOutImageCacheEntry *)entries->get(i));
+  }
+  delete entries;
+}
+
+void SplashOutImageCache::freeEntry(SplashOutImageCacheEntry *entry) {
+  gfree(entry->colors);
+  gfree(entry->alpha);
+  delete entry;
+}
+
+SplashOutImageCacheEntry *SplashOutImageCache::lookup(Ref ref, Guint hash,
+						      SplashColorMode srcMode,
+						      int width, int height,
+						      int nComps,
+						      GBool srcAlpha,
+						      GBool *doStore) {
+  SplashOutImageCacheEntry *entry;
+  int i;
+
+  *doStore = gFalse;
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (SplashOutImageCacheEntry *)entries->get(i);
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen &&
+	entry->hash == hash && entry->srcMode == srcMode &&
+	entry->width == width && entry->height == height) {
+      if (i > 0) {
+	entries->del(i);
+	entries->insert(0, entry);
+      }
+      if (entry->colors) {
+	return entry;
+      }
+      *doStore = (double)width * height * (nComps + (srcAlpha ? 1 : 0))
+	         <= maxSize;
+      return NULL;
+    }
+  }
+
+  // first use: just remember the image
+  entry = new SplashOutImageCacheEntry;
+  entry->ref = ref;
+  entry->hash = hash;
+  entry->srcMode = srcMode;
+  entry->width = width;
+  entry->height = height;
+  entry->colors = NULL;
+  entry->alpha = NULL;
+  entry->size = 0;
+  entries->insert(0, entry);
+  if (entries->getLength() > splashOutImageCacheMaxEntries) {
+    entry = (SplashOutImageCacheEntry *)entries->del(entries->getLength() - 1);
+    size -= entry->size;
+    freeEntry(entry);
+  }
+  return NULL;
+}
+
+SplashOutImageCacheEntry *SplashOutImageCache::store(SplashImageSource src,
+						     void *srcData,
+						     int nComps,
+						     GBool srcAlpha) {
+  SplashOutImageCacheEntry *entry, *old;
+  int rowSize, y;
+
+  entry = (SplashOutImageCacheEntry *)entries->get(0);
+  rowSize = entry->width * nComps;
+  entry->colors = (SplashColorPtr)gmallocn(entry->height, rowSize);
+  if (srcAlpha) {
+    entry->alpha = (Guchar *)gmallocn(entry->height, entry->width);
+  }
+  for (y = 0; y < entry->height; ++y) {
+    (*src)(srcData, entry->colors + y * rowSize,
+	   entry->alpha ? entry->alpha + y * entry->width : (Guchar *)NULL);
+  }
+  entry->size = entry->height * (rowSize + (srcAlpha ? entry->width : 0));
+  size += entry->size;
+
+  // evict the least recently used images
+  while (size > maxSize && entries->getLength() > 1) {
+    old = (SplashOutImageCacheEntry *)entries->del(entries->getLength() - 1);
+    size -= old->size;
+    freeEntry(old);
+  }
+  return entry;
+}
+
+struct SplashOutCachedImageData {
+  SplashOutImageCacheEntry *entry;
+  int nComps;
+  int y;
+};
+
+static inline Guint hashWord(Guint h, Guint x) {
+  int i;
+
+  // FNV-1a
+  for (i = 0; i < 32; i += 8) {
+    h = (h ^ ((x >> i) & 0xff)) * 16777619U;
+  }
+  return h;
+}
+
+// Hash the conversion done by <colorMap> (and the color key mask, if
+// any) to <srcMode>.  Besides the parameters of the color map, this
+// hashes the colors of a set of test pixels: all values of
+// one-component images, and the range of each component of others.
+static Guint hashImageColorMap(GfxImageColorMap *colorMap,
+			       SplashColorMode srcMode, int *maskColors) {
+  Guchar pix[gfxColorMaxComps];
+  GfxGray gray;
+  GfxRGB rgb;
+#if SPLASH_CMYK
+  GfxCMYK cmyk;
+#endif
+  GfxColorComp c[4];
+  double d[2];
+  Guint h;
+  int nComps, maxPix, nTests, comp, i, j;
+
+  nComps = colorMap->getNumPixelComps();
+  maxPix = (1 << colorMap->getBits()) - 1;
+  if (maxPix > 255) {
+    maxPix = 255;
+  }
+
+  h = 2166136261U;
+  h = hashWord(h, (Guint)nComps);
+  h = hashWord(h, (Guint)colorMap->getBits());
+  h = hashWord(h, (Guint)colorMap->getColorSpace()->getMode());
+  for (i = 0; i < nComps; ++i) {
+    d[0] = colorMap->getDecodeLow(i);
+    d[1] = colorMap->getDecodeHigh(i);
+    for (j = 0; j < (int)sizeof(d); ++j) {
+      h = (h ^ ((Guchar *)d)[j]) * 16777619U;
+    }
+    if (maskColors) {
+      h = hashWord(h, (Guint)maskColors[2*i]);
+      h = hashWord(h, (Guint)maskColors[2*i+1]);
+    }
+  }
+  h = hashWord(h, maskColors ? 1 : 0);
+
+  nTests = nComps == 1 ? maxPix + 1 : 4 * nComps;
+  for (i = 0; i < nTests; ++i) {
+    if (nComps == 1) {
+      pix[0] = (Guchar)i;
+    } else {
+      comp = i / 4;
+      for (j = 0; j < nComps; ++j) {
+	pix[j] = (Guchar)(j == comp ? ((i % 4) * maxPix) / 3 : maxPix / 2);
+      }
+    }
+    c[0] = c[1] = c[2] = c[3] = 0;
+    switch (srcMode) {
+    case splashModeMono1:
+    case splashModeMono8:
+      colorMap->getGray(pix, &gray);
+      c[0] = gray;
+      break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+    case splashModeXBGR8:
+      colorMap->getRGB(pix, &rgb);
+      c[0] = rgb.r;
+      c[1] = rgb.g;
+      c[2] = rgb.b;
+      break;
+#if SPLASH_CMYK
+    case splashModeCMYK8:
+      colorMap->getCMYK(pix, &cmyk);
+      c[0] = cmyk.c;
+      c[1] = cmyk.m;
+      c[2] = cmyk.y;
+      c[3] = cmyk.k;
+      break;
+#endif
+    }
+    for (j = 0; j < 4; ++j) {
+      h = hashWord(h, (Guint)c[j]);
+    }
+  }
+  return h;
+}
+
+// Hash <color> in <colorSpace>, converted to <mode>.
+static Guint hashColor(Guint h, GfxColorSpace *colorSpace, GfxColor *color,
+		       SplashColorMode mode) {
+  GfxGray gray;
+  GfxRGB rgb;
+#if SPLASH_CMYK
+  GfxCMYK cmyk;
+#endif
+  GfxColorComp c[4];
+  int i;
+
+  c[0] = c[1] = c[2] = c[3] = 0;
+  switch (mode) {
+  case splashModeMono1:
+  case splashModeMono8:
+    colorSpace->getGray(color, &gray);
+    c[0] = gray;
+    break;
+  case splashModeRGB8:
+  case splashModeBGR8:
+  case splashModeXBGR8:
+    colorSpace->getRGB(color, &rgb);
+    c[0] = rgb.r;
+    c[1] = rgb.g;
+    c[2] = rgb.b;
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    colorSpace->getCMYK(color, &cmyk);
+    c[0] = cmyk.c;
+    c[1] = cmyk.m;
+    c[2] = cmyk.y;
+    c[3] = cmyk.k;
+    break;
+#endif
+  }
+  for (i = 0; i < 4; ++i) {
+    h = hashWord(h, (Guint)c[i]);
+  }
+  return h;
+}
+
+// Hash the color <color> in <colorSpace>, as a form inheriting it
+// would draw it in <mode>.  The form can set other values in the same
+// space, so for spaces other than the device ones, this also hashes
+// the colors of a set of test values: every entry of an indexed
+// space, and the range of each component of others.
+static Guint hashFormColor(Guint h, GfxColorSpace *colorSpace,
+			   GfxColor *color, SplashColorMode mode) {
+  GfxColor test;
+  double low[gfxColorMaxComps], range[gfxColorMaxComps];
+  int nComps, i, j;
+
+  nComps = colorSpace->getNComps();
+  h = hashWord(h, (Guint)colorSpace->getMode());
+  h = hashWord(h, (Guint)nComps);
+  h = hashColor(h, colorSpace, color, mode);
+  switch (colorSpace->getMode()) {
+  case csDeviceGray:
+  case csDeviceRGB:
+  case csDeviceCMYK:
+    break;
+  case csIndexed:
+    for (i = 0; i <= ((GfxIndexedColorSpace *)colorSpace)->getIndexHigh();
+	 ++i) {
+      test.c[0] = dblToCol(i);
+      h = hashColor(h, colorSpace, &test, mode);
+    }
+    break;
+  default:
+    colorSpace->getDefaultRanges(low, range, 255);
+    for (i = 0; i < 4 * nComps; ++i) {
+      for (j = 0; j < nComps; ++j) {
+	test.c[j] = dblToCol(low[j] + range[j] *
+			     (j == i / 4 ? (i % 4) / 3.0 : 0.5));
+      }
+      h = hashColor(h, colorSpace, &test, mode);
+    }
+    break;
+  }
+  return h;
+}
+
+//------------------------------------------------------------------------
+// SplashOutFormCache
+//------------------------------------------------------------------------
+
+// Form XObjects, rasterized as isolated transparency groups into
+// bitmaps with alpha.  Entries are keyed by the form's reference, a
+// hash of the graphics state it inherits, and the scale and rotation
+// part of its CTM; a stored form is reused at any translation,
+// rounded to whole pixels.  Like images, forms are only stored the
+// second time they are drawn.
+
+#define splashOutFormCacheMaxEntries 256  // entries, including forms
+					  //   which were drawn once
+
+struct SplashOutFormCacheEntry {
+  Ref ref;
+  Guint hash;			// hash of the inherited graphics state
+  double m[4];			// scale and rotation part of the CTM
+  GBool vectorAntialias;
+  SplashBitmap *bitmap;		// the rasterized form, or NULL if it was
+				//   only drawn once
+  double dx, dy;		// position of the bitmap, relative to the
+				//   CTM's translation
+  int size;			// bytes used by bitmap
+};
+
+class SplashOutFormCache {
+public:
+
+  SplashOutFormCache(int maxSizeA);
+  ~SplashOutFormCache();
+
+  // Look up a form, and make it the most recently used one.  Returns
+  // the entry if the form is stored.  Otherwise returns NULL, and
+  // sets *<doStore> if the form should now be rasterized and stored
+  // with store().
+  SplashOutFormCacheEntry *lookup(Ref ref, Guint hash, double *m,
+				  GBool vectorAntialias, GBool *doStore);
+
+  // Store <bitmap> (which is taken over by the cache) as the form
+  // last passed to lookup().
+  SplashOutFormCacheEntry *store(SplashBitmap *bitmap, double dx, double dy);
+
+  int getMaxSize() { return maxSize; }
+
+private:
+
+  void freeEntry(SplashOutFormCacheEntry *entry);
+
+  GooList *entries;		// [SplashOutFormCacheEntry], most
+				//   recently used first
+  int size;			// bytes used by all entries
+  int maxSize;
+};
+
+SplashOutFormCache::SplashOutFormCache(int maxSizeA) {
+  entries = new GooList();
+  size = 0;
+  maxSize = maxSizeA;
+}
+
+SplashOutFormCache::~SplashOutFormCache() {
+  int i;
+
+  for (i = 0; i < entries->getLength(); ++i) {
+    freeEntry((SplashOutFormCacheEntry *)entries->get(i));
+  }
+  delete entries;
+}
+
+void SplashOutFormCache::freeEntry(SplashOutFormCacheEntry *entry) {
+  if (entry->bitmap) {
+    delete entry->bitmap;
+  }
+  delete entry;
+}
+
+SplashOutFormCacheEntry *SplashOutFormCache::lookup(Ref ref, Guint hash,
+						    double *m,
+						    GBool vectorAntialias,
+						    GBool *doStore) {
+  SplashOutFormCacheEntry *entry;
+  int i;
+
+  *doStore = gFalse;
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (SplashOutFormCacheEntry *)entries->get(i);
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen &&
+	entry->hash == hash &&
+	entry->m[0] == m[0] && entry->m[1] == m[1] &&
+	entry->m[2] == m[2] && entry->m[3] == m[3] &&
+	entry->vectorAntialias == vectorAntialias) {
+      if (i > 0) {
+	entries->del(i);
+	entries->insert(0, entry);
+      }
+      if (entry->bitmap) {
+	return entry;
+      }
+      *doStore = gTrue;
+      return NULL;
+    }
+  }
+
+  // first use: just remember the form
+  entry = new SplashOutFormCacheEntry;
+  entry->ref = ref;
+  entry->hash = hash;
+  for (i = 0; i < 4; ++i) {
+    entry->m[i] = m[i];
+  }
+  entry->vectorAntialias = vectorAntialias;
+  entry->bitmap = NULL;
+  entry->dx = entry->dy = 0;
+  entry->size = 0;
+  entries->insert(0, entry);
+  if (entries->getLength() > splashOutFormCacheMaxEntries) {
+    entry = (SplashOutFormCacheEntry *)entries->del(entries->getLength() - 1);
+    size -= entry->size;
+    freeEntry(entry);
+  }
+  return NULL;
+}
+
+SplashOutFormCacheEntry *SplashOutFormCache::store(SplashBitmap *bitmap,
+						   double dx, double dy) {
+  SplashOutFormCacheEntry *entry, *old;
+
+  entry = (SplashOutFormCacheEntry *)entries->get(0);
+  entry->bitmap = bitmap;
+  entry->dx = dx;
+  entry->dy = dy;
+  entry->size = bitmap->getHeight() * (bitmap->getRowSize() +
+				       bitmap->getWidth());
+  size += entry->size;
+
+  // evict the least recently used forms
+  while (size > maxSize && entries->getLength() > 1) {
+    old = (SplashOutFormCacheEntry *)entries->del(entries->getLength() - 1);
+    size -= old->size;
+    freeEntry(old);
+  }
+  return entry;
+}
+
 //------------------------------------------------------------------------
 // SplashTransparencyGroup
 //------------------------------------------------------------------------
 
+// Group bitmaps come from a pool, with their sizes rounded up to a
+// multiple of splashOutGroupSizeClass, so that they can be reused by
+// later groups of similar size.  Pooled bitmaps are kept cleared: when
+// a group is done, only the region it modified is cleared again.
+
+#define splashOutGroupSizeClass   64
+#define splashOutGroupPoolMaxSize (32 * 1024 * 1024)
+
 struct SplashTransparencyGroup {
   int tx, ty;			// translation coordinates
+  int w, h;			// size of the group (tBitmap may be larger)
   SplashBitmap *tBitmap;	// bitmap for transparency group
+  GBool pooled;			// does tBitmap come from the pool?
+  int modXMin, modYMin,		// region of tBitmap modified by the
+      modXMax, modYMax;		//   group
   GfxColorSpace *blendingColorSpace;
   GBool isolated;
 
@@ -546,6 +1051,71 @@ struct SplashTransparencyGroup {
   SplashTransparencyGroup *next;
 };
 
+// Clear (to zero color and alpha) the rectangle (<x0>,<y0>)-(<x1>,<y1>)
+// of <bitmap>.
+static void clearBitmapRect(SplashBitmap *bitmap,
+			    int x0, int y0, int x1, int y1) {
+  SplashColorPtr p;
+  int bx0, bx1, y;
+
+  if (x0 < 0) {
+    x0 = 0;
+  }
+  if (y0 < 0) {
+    y0 = 0;
+  }
+  if (x1 >= bitmap->getWidth()) {
+    x1 = bitmap->getWidth() - 1;
+  }
+  if (y1 >= bitmap->getHeight()) {
+    y1 = bitmap->getHeight() - 1;
+  }
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  switch (bitmap->getMode()) {
+  case splashModeMono1:
+    bx0 = x0 >> 3;
+    bx1 = x1 >> 3;
+    break;
+  case splashModeMono8:
+  default:
+    bx0 = x0;
+    bx1 = x1;
+    break;
+  case splashModeRGB8:
+  case splashModeBGR8:
+    bx0 = 3 * x0;
+    bx1 = 3 * x1 + 2;
+    break;
+  case splashModeXBGR8:
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+#endif
+    bx0 = 4 * x0;
+    bx1 = 4 * x1 + 3;
+    break;
+  }
+  for (y = y0; y <= y1; ++y) {
+    p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    memset(p + bx0, 0, bx1 - bx0 + 1);
+    if (bitmap->getAlphaPtr()) {
+      memset(bitmap->getAlphaPtr() + y * bitmap->getWidth() + x0, 0,
+	     x1 - x0 + 1);
+    }
+  }
+}
+
+static int groupBitmapSize(SplashBitmap *bitmap) {
+  int rowSize;
+
+  rowSize = bitmap->getRowSize();
+  if (rowSize < 0) {
+    rowSize = -rowSize;
+  }
+  return bitmap->getHeight() * (rowSize + bitmap->getWidth());
+}
+
 //------------------------------------------------------------------------
 // SplashOutputDev
 //------------------------------------------------------------------------
@@ -576,14 +1146,22 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
 
   fontEngine = NULL;
 
-  nT3Fonts = 0;
+  t3FontCache = new GooList();
+  t3CacheSize = 0;
+  t3CacheMaxSize = globalParams->getT3CacheSize();
   t3GlyphStack = NULL;
 
+  imageCache = NULL;
+  formCache = NULL;
+  formTx = formTy = 0;
+
   font = NULL;
   needFontUpdate = gFalse;
   textClipPath = NULL;
 
   transpGroupStack = NULL;
+  groupBitmapPool = new GooList();
+  groupBitmapPoolSize = 0;
 }
 
 void SplashOutputDev::setupScreenParams(double hDPI, double vDPI) {
@@ -638,11 +1216,14 @@ void SplashOutputDev::setupScreenParams(double hDPI, double vDPI) {
 }
 
 SplashOutputDev::~SplashOutputDev() {
-  int i;
-
-  for (i = 0; i < nT3Fonts; ++i) {
-    delete t3FontCache[i];
+  deleteGooList(t3FontCache, T3FontCache);
+  if (imageCache) {
+    delete imageCache;
+  }
+  if (formCache) {
+    delete formCache;
   }
+  deleteGooList(groupBitmapPool, SplashBitmap);
   if (fontEngine) {
     delete fontEngine;
   }
@@ -655,8 +1236,6 @@ SplashOutputDev::~SplashOutputDev() {
 }
 
 void SplashOutputDev::startDoc(XRef *xrefA) {
-  int i;
-
   xref = xrefA;
   if (fontEngine) {
     delete fontEngine;
@@ -671,10 +1250,28 @@ void SplashOutputDev::startDoc(XRef *xrefA) {
 				    allowAntialias &&
 				      globalParams->getAntialias() &&
 				      colorMode != splashModeMono1);
-  for (i = 0; i < nT3Fonts; ++i) {
-    delete t3FontCache[i];
+
+  // Type 3 fonts, images and forms are identified by their object
+  // references, so the caches are kept for all the pages of a
+  // document, but not across documents
+  deleteGooList(t3FontCache, T3FontCache);
+  t3FontCache = new GooList();
+  t3CacheSize = 0;
+  t3CacheMaxSize = globalParams->getT3CacheSize();
+  if (imageCache) {
+    delete imageCache;
+    imageCache = NULL;
+  }
+  if (globalParams->getImageCacheSize() > 0) {
+    imageCache = new SplashOutImageCache(globalParams->getImageCacheSize());
+  }
+  if (formCache) {
+    delete formCache;
+    formCache = NULL;
+  }
+  if (globalParams->getFormCacheSize() > 0 && colorMode != splashModeMono1) {
+    formCache = new SplashOutFormCache(globalParams->getFormCacheSize());
   }
-  nT3Fonts = 0;
 }
 
 void SplashOutputDev::startPage(int pageNum, GfxState *state) {
@@ -699,7 +1296,8 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
   if (splash) {
     delete splash;
   }
-  if (!bitmap || w != bitmap->getWidth() || h != bitmap->getHeight()) {
+  if (!bitmap || w != bitmap->getWidth() || h != bitmap->getHeight() ||
+      bitmap->getMode() != colorMode) {
     if (bitmap) {
       delete bitmap;
     }
@@ -707,6 +1305,7 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
 			      colorMode != splashModeMono1, bitmapTopDown);
   }
   splash = new Splash(bitmap, vectorAntialias, &screenParams);
+  splash->setClipMaskThreshold(globalParams->getClipMaskThreshold());
   if (state) {
     ctm = state->getCTM();
     mat[0] = (SplashCoord)ctm[0];
@@ -940,6 +1539,8 @@ void SplashOutputDev::updateFont(GfxState * /*state*/) {
 }
 
 void SplashOutputDev::doUpdateFont(GfxState *state) {
+  ProfileTimer timer(profileFontLoad);
+  PageProfile *profile;
   GfxFont *gfxFont;
   GfxFontType fontType;
   SplashOutFontFileID *id;
@@ -976,10 +1577,17 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
 
   // check the font file cache
   id = new SplashOutFontFileID(gfxFont->getID());
+  profile = PageProfile::getActive();
   if ((fontFile = fontEngine->getFontFile(id))) {
     delete id;
+    if (profile) {
+      profile->count(profileFontCacheHit);
+    }
 
   } else {
+    if (profile) {
+      profile->count(profileFontCacheMiss);
+    }
 
     // if there is an embedded font, write it to disk
     if (gfxFont->getEmbeddedFontID(&embRef)) {
@@ -1163,6 +1771,7 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
 }
 
 void SplashOutputDev::stroke(GfxState *state) {
+  ProfileTimer timer(profileStroke);
   SplashPath *path;
 
   if (state->getStrokeColorSpace()->isNonMarking()) {
@@ -1174,6 +1783,7 @@ void SplashOutputDev::stroke(GfxState *state) {
 }
 
 void SplashOutputDev::fill(GfxState *state) {
+  ProfileTimer timer(profileFill);
   SplashPath *path;
 
   if (state->getFillColorSpace()->isNonMarking()) {
@@ -1185,6 +1795,7 @@ void SplashOutputDev::fill(GfxState *state) {
 }
 
 void SplashOutputDev::eoFill(GfxState *state) {
+  ProfileTimer timer(profileFill);
   SplashPath *path;
 
   if (state->getFillColorSpace()->isNonMarking()) {
@@ -1261,8 +1872,10 @@ void SplashOutputDev::drawChar(GfxState *state, double x, double y,
 			       double originX, double originY,
 			       CharCode code, int nBytes,
 			       Unicode *u, int uLen) {
+  ProfileTimer timer(profileGlyph);
+  PageProfile *profile;
   SplashPath *path;
-  int render;
+  int render, hits, misses;
 
   // check for invisible text -- this is used by Acrobat Capture
   render = state->getRender();
@@ -1283,7 +1896,16 @@ void SplashOutputDev::drawChar(GfxState *state, double x, double y,
   // fill
   if (!(render & 1)) {
     if (!state->getFillColorSpace()->isNonMarking()) {
+      if ((profile = PageProfile::getActive())) {
+	hits = font->getCacheHits();
+	misses = font->getCacheMisses();
+      }
       splash->fillChar((SplashCoord)x, (SplashCoord)y, code, font);
+      if (profile) {
+	profile->count(profileGlyphCacheHit, font->getCacheHits() - hits);
+	profile->count(profileGlyphCacheMiss,
+		       font->getCacheMisses() - misses);
+      }
     }
   }
 
@@ -1320,7 +1942,8 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
   double *ctm, *bbox;
   T3FontCache *t3Font;
   T3GlyphStack *t3gs;
-  GBool validBBox;
+  PageProfile *profile;
+  GBool validBBox, uncached;
   double x1, y1, xMin, yMin, xMax, yMax, xt, yt;
   int i, j;
 
@@ -1332,31 +1955,23 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
   state->transform(0, 0, &xt, &yt);
 
   // is it the first (MRU) font in the cache?
-  if (!(nT3Fonts > 0 &&
-	t3FontCache[0]->matches(fontID, ctm[0], ctm[1], ctm[2], ctm[3]))) {
+  uncached = gFalse;
+  if (!(t3FontCache->getLength() > 0 &&
+	((T3FontCache *)t3FontCache->get(0))->matches(fontID, ctm[0], ctm[1],
+						      ctm[2], ctm[3]))) {
 
     // is the font elsewhere in the cache?
-    for (i = 1; i < nT3Fonts; ++i) {
-      if (t3FontCache[i]->matches(fontID, ctm[0], ctm[1], ctm[2], ctm[3])) {
-	t3Font = t3FontCache[i];
-	for (j = i; j > 0; --j) {
-	  t3FontCache[j] = t3FontCache[j - 1];
-	}
-	t3FontCache[0] = t3Font;
+    for (i = 1; i < t3FontCache->getLength(); ++i) {
+      t3Font = (T3FontCache *)t3FontCache->get(i);
+      if (t3Font->matches(fontID, ctm[0], ctm[1], ctm[2], ctm[3])) {
+	t3FontCache->del(i);
+	t3FontCache->insert(0, t3Font);
 	break;
       }
     }
-    if (i >= nT3Fonts) {
+    if (i >= t3FontCache->getLength()) {
 
       // create new entry in the font cache
-      if (nT3Fonts == splashOutT3FontCacheSize) {
-	delete t3FontCache[nT3Fonts - 1];
-	--nT3Fonts;
-      }
-      for (j = nT3Fonts; j > 0; --j) {
-	t3FontCache[j] = t3FontCache[j - 1];
-      }
-      ++nT3Fonts;
       bbox = gfxFont->getFontBBox();
       if (bbox[0] == 0 && bbox[1] == 0 && bbox[2] == 0 && bbox[3] == 0) {
 	// unspecified bounding box -- just take a guess
@@ -1404,27 +2019,44 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
 	}
 	validBBox = gTrue;
       }
-      t3FontCache[0] = new T3FontCache(fontID, ctm[0], ctm[1], ctm[2], ctm[3],
-	                               (int)floor(xMin - xt),
-				       (int)floor(yMin - yt),
-				       (int)ceil(xMax) - (int)floor(xMin) + 3,
-				       (int)ceil(yMax) - (int)floor(yMin) + 3,
-				       validBBox,
-				       colorMode != splashModeMono1);
+      t3Font = new T3FontCache(fontID, ctm[0], ctm[1], ctm[2], ctm[3],
+			       (int)floor(xMin - xt),
+			       (int)floor(yMin - yt),
+			       (int)ceil(xMax) - (int)floor(xMin) + 3,
+			       (int)ceil(yMax) - (int)floor(yMin) + 3,
+			       validBBox,
+			       colorMode != splashModeMono1);
+      // if there's no room for it, the font is used for this glyph
+      // only, without caching anything
+      if (makeT3CacheRoom(t3Font->size)) {
+	t3FontCache->insert(0, t3Font);
+	t3CacheSize += t3Font->size;
+      } else {
+	uncached = gTrue;
+      }
     }
   }
-  t3Font = t3FontCache[0];
+  if (!uncached) {
+    t3Font = (T3FontCache *)t3FontCache->get(0);
+  }
 
   // is the glyph in the cache?
+  profile = PageProfile::getActive();
   i = (code & (t3Font->cacheSets - 1)) * t3Font->cacheAssoc;
   for (j = 0; j < t3Font->cacheAssoc; ++j) {
     if ((t3Font->cacheTags[i+j].mru & 0x8000) &&
 	t3Font->cacheTags[i+j].code == code) {
+      if (profile) {
+	profile->count(profileT3GlyphCacheHit);
+      }
       drawType3Glyph(t3Font, &t3Font->cacheTags[i+j],
-		     t3Font->cacheData + (i+j) * t3Font->glyphSize);
+		     t3Font->cacheTags[i+j].data);
       return gTrue;
     }
   }
+  if (profile) {
+    profile->count(profileT3GlyphCacheMiss);
+  }
 
   // push a new Type 3 glyph record
   t3gs = new T3GlyphStack();
@@ -1434,6 +2066,7 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
   t3GlyphStack->cache = t3Font;
   t3GlyphStack->cacheTag = NULL;
   t3GlyphStack->cacheData = NULL;
+  t3GlyphStack->cacheOwned = uncached;
 
   return gFalse;
 }
@@ -1442,7 +2075,7 @@ void SplashOutputDev::endType3Char(GfxState *state) {
   T3GlyphStack *t3gs;
   double *ctm;
 
-  if (t3GlyphStack->cacheTag) {
+  if (t3GlyphStack->cacheData) {
     memcpy(t3GlyphStack->cacheData, bitmap->getDataPtr(),
 	   t3GlyphStack->cache->glyphSize);
     delete bitmap;
@@ -1455,9 +2088,15 @@ void SplashOutputDev::endType3Char(GfxState *state) {
     updateCTM(state, 0, 0, 0, 0, 0, 0);
     drawType3Glyph(t3GlyphStack->cache,
 		   t3GlyphStack->cacheTag, t3GlyphStack->cacheData);
+    if (!t3GlyphStack->cacheTag) {
+      gfree(t3GlyphStack->cacheData);
+    }
   }
   t3gs = t3GlyphStack;
   t3GlyphStack = t3gs->next;
+  if (t3gs->cacheOwned) {
+    delete t3gs->cache;
+  }
   delete t3gs;
 }
 
@@ -1468,6 +2107,7 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
 			      double llx, double lly, double urx, double ury) {
   double *ctm;
   T3FontCache *t3Font;
+  T3FontCacheTag *tag;
   SplashColor color;
   double xt, yt, xMin, xMax, yMin, yMax, x1, y1;
   int i, j;
@@ -1522,17 +2162,40 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
     return;
   }
 
-  // allocate a cache entry
+  // allocate a cache entry -- if there's no room for another bitmap,
+  // the glyph is still rendered into one, which is freed after it is
+  // drawn, so that the cache size never changes the output
   i = (t3GlyphStack->code & (t3Font->cacheSets - 1)) * t3Font->cacheAssoc;
   for (j = 0; j < t3Font->cacheAssoc; ++j) {
     if ((t3Font->cacheTags[i+j].mru & 0x7fff) == t3Font->cacheAssoc - 1) {
-      t3Font->cacheTags[i+j].mru = 0x8000;
-      t3Font->cacheTags[i+j].code = t3GlyphStack->code;
-      t3GlyphStack->cacheTag = &t3Font->cacheTags[i+j];
-      t3GlyphStack->cacheData = t3Font->cacheData + (i+j) * t3Font->glyphSize;
+      break;
+    }
+  }
+  tag = &t3Font->cacheTags[i+j];
+  if (t3GlyphStack->cacheOwned) {
+    tag = NULL;
+  } else if (!tag->data) {
+    if (makeT3CacheRoom(t3Font->glyphSize)) {
+      tag->data = (Guchar *)gmalloc(t3Font->glyphSize);
+      t3Font->size += t3Font->glyphSize;
+      t3CacheSize += t3Font->glyphSize;
     } else {
-      ++t3Font->cacheTags[i+j].mru;
+      tag = NULL;
+    }
+  }
+  if (tag) {
+    for (j = 0; j < t3Font->cacheAssoc; ++j) {
+      if (&t3Font->cacheTags[i+j] == tag) {
+	tag->mru = 0x8000;
+	tag->code = t3GlyphStack->code;
+      } else {
+	++t3Font->cacheTags[i+j].mru;
+      }
     }
+    t3GlyphStack->cacheTag = tag;
+    t3GlyphStack->cacheData = tag->data;
+  } else {
+    t3GlyphStack->cacheData = (Guchar *)gmalloc(t3Font->glyphSize);
   }
 
   // save state
@@ -1570,6 +2233,7 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
 
 void SplashOutputDev::drawType3Glyph(T3FontCache *t3Font,
 				     T3FontCacheTag * /*tag*/, Guchar *data) {
+  ProfileTimer timer(profileGlyph);
   SplashGlyphBitmap glyph;
 
   glyph.x = -t3Font->glyphX;
@@ -1582,6 +2246,32 @@ void SplashOutputDev::drawType3Glyph(T3FontCache *t3Font,
   splash->fillGlyph(0, 0, &glyph);
 }
 
+// Free Type 3 fonts, least recently used first, until <n> more bytes
+// fit in the cache.  Fonts with glyphs being rendered are kept.
+// Returns false if there still isn't enough room.
+GBool SplashOutputDev::makeT3CacheRoom(int n) {
+  T3FontCache *t3Font;
+  T3GlyphStack *t3gs;
+  int i;
+
+  for (i = t3FontCache->getLength() - 1;
+       i >= 0 && t3CacheSize + n > t3CacheMaxSize;
+       --i) {
+    t3Font = (T3FontCache *)t3FontCache->get(i);
+    for (t3gs = t3GlyphStack; t3gs; t3gs = t3gs->next) {
+      if (t3gs->cache == t3Font) {
+	break;
+      }
+    }
+    if (!t3gs) {
+      t3FontCache->del(i);
+      t3CacheSize -= t3Font->size;
+      delete t3Font;
+    }
+  }
+  return t3CacheSize + n <= t3CacheMaxSize;
+}
+
 void SplashOutputDev::endTextObject(GfxState *state) {
   if (textClipPath) {
     splash->clipToPath(textClipPath, gFalse);
@@ -1617,6 +2307,7 @@ GBool SplashOutputDev::imageMaskSrc(void *data, SplashColorPtr line) {
 void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 				    int width, int height, GBool invert,
 				    GBool inlineImg) {
+  ProfileTimer timer(profileImage);
   double *ctm;
   SplashCoord mat[6];
   SplashOutImageMaskData imgMaskData;
@@ -1662,109 +2353,85 @@ struct SplashOutImageData {
   int width, height, y;
 };
 
-GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
-				Guchar * /*alphaLine*/) {
-  SplashOutImageData *imgData = (SplashOutImageData *)data;
-  Guchar *p;
+// Convert a line of image pixels to <colorMode> colors.  One-component
+// images use the precomputed <lookup> table; everything else goes
+// through the color map's line converters.
+static void convertImageLine(GfxImageColorMap *colorMap,
+			     SplashColorPtr lookup, SplashColorMode colorMode,
+			     Guchar *in, SplashColorPtr out, int width) {
   SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
-  int nComps, x;
-
-  if (imgData->y == imgData->height) {
-    return gFalse;
-  }
-
-  nComps = imgData->colorMap->getNumPixelComps();
+  int x;
 
-  if (imgData->lookup) {
-    switch (imgData->colorMode) {
-  case splashModeMono1:
-  case splashModeMono8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, ++p) {
-	*q++ = imgData->lookup[*p];
+  if (lookup) {
+    switch (colorMode) {
+    case splashModeMono1:
+    case splashModeMono8:
+      for (x = 0; x < width; ++x) {
+	out[x] = lookup[in[x]];
       }
-    break;
-  case splashModeRGB8:
-  case splashModeBGR8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, ++p) {
-	col = &imgData->lookup[3 * *p];
+      break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+      for (x = 0, q = out; x < width; ++x) {
+	col = &lookup[3 * in[x]];
 	*q++ = col[0];
 	*q++ = col[1];
 	*q++ = col[2];
       }
-    break;
-  case splashModeXBGR8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, ++p) {
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = col[3];
-      }
       break;
+    case splashModeXBGR8:
 #if SPLASH_CMYK
     case splashModeCMYK8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, ++p) {
-	col = &imgData->lookup[4 * *p];
+#endif
+      for (x = 0, q = out; x < width; ++x) {
+	col = &lookup[4 * in[x]];
 	*q++ = col[0];
 	*q++ = col[1];
 	*q++ = col[2];
 	*q++ = col[3];
       }
       break;
-#endif
-  }
+    }
   } else {
-    switch (imgData->colorMode) {
+    switch (colorMode) {
     case splashModeMono1:
     case splashModeMono8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-      }
-	break;
-	case splashModeXBGR8:
+      colorMap->getGrayByteLine(in, out, width);
+      break;
     case splashModeRGB8:
     case splashModeBGR8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-	if (imgData->colorMode == splashModeXBGR8) *q++ = 255;
+      colorMap->getRGBByteLine(in, out, width);
+      break;
+    case splashModeXBGR8:
+      // convert to RGB, then spread out to four bytes per pixel in
+      // place, starting from the end
+      colorMap->getRGBByteLine(in, out, width);
+      for (x = width - 1; x >= 0; --x) {
+	out[4*x+3] = 255;
+	out[4*x+2] = out[3*x+2];
+	out[4*x+1] = out[3*x+1];
+	out[4*x] = out[3*x];
       }
       break;
 #if SPLASH_CMYK
     case splashModeCMYK8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getCMYK(p, &cmyk);
-	*q++ = colToByte(cmyk.c);
-	*q++ = colToByte(cmyk.m);
-	*q++ = colToByte(cmyk.y);
-	*q++ = colToByte(cmyk.k);
-      }
+      colorMap->getCMYKByteLine(in, out, width);
       break;
 #endif
     }
   }
+}
+
+GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
+				Guchar * /*alphaLine*/) {
+  SplashOutImageData *imgData = (SplashOutImageData *)data;
+
+  if (imgData->y == imgData->height) {
+    return gFalse;
+  }
+
+  convertImageLine(imgData->colorMap, imgData->lookup, imgData->colorMode,
+		   imgData->imgStr->getLine(), colorLine, imgData->width);
 
   ++imgData->y;
   return gTrue;
@@ -1774,12 +2441,6 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 				     Guchar *alphaLine) {
   SplashOutImageData *imgData = (SplashOutImageData *)data;
   Guchar *p, *aq;
-  SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
   Guchar alpha;
   int nComps, x, i;
 
@@ -1789,9 +2450,10 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 
   nComps = imgData->colorMap->getNumPixelComps();
 
-  for (x = 0, p = imgData->imgStr->getLine(), q = colorLine, aq = alphaLine;
-       x < imgData->width;
-       ++x, p += nComps) {
+  p = imgData->imgStr->getLine();
+  convertImageLine(imgData->colorMap, imgData->lookup, imgData->colorMode,
+		   p, colorLine, imgData->width);
+  for (x = 0, aq = alphaLine; x < imgData->width; ++x, p += nComps) {
     alpha = 0;
     for (i = 0; i < nComps; ++i) {
       if (p[i] < imgData->maskColors[2*i] ||
@@ -1800,83 +2462,78 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 	break;
       }
     }
-    if (imgData->lookup) {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	*q++ = imgData->lookup[*p];
-	*aq++ = alpha;
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	col = &imgData->lookup[3 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*aq++ = alpha;
-	break;
-      case splashModeXBGR8:
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = 255;
-	*aq++ = alpha;
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = col[3];
-	*aq++ = alpha;
-	break;
-#endif
-      }
-    } else {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-	*aq++ = alpha;
-	break;
-      case splashModeXBGR8:
-      case splashModeRGB8:
-      case splashModeBGR8:
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-	if (imgData->colorMode == splashModeXBGR8) *q++ = 255;
-	*aq++ = alpha;
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	imgData->colorMap->getCMYK(p, &cmyk);
-	*q++ = colToByte(cmyk.c);
-	*q++ = colToByte(cmyk.m);
-	*q++ = colToByte(cmyk.y);
-	*q++ = colToByte(cmyk.k);
-	*aq++ = alpha;
-	break;
-#endif
-      }
-    }
+    *aq++ = alpha;
   }
 
   ++imgData->y;
   return gTrue;
 }
 
+GBool SplashOutputDev::cachedImageSrc(void *data, SplashColorPtr colorLine,
+				      Guchar *alphaLine) {
+  SplashOutCachedImageData *imgData = (SplashOutCachedImageData *)data;
+  SplashOutImageCacheEntry *entry = imgData->entry;
+  int rowSize;
+
+  if (imgData->y == entry->height) {
+    return gFalse;
+  }
+  rowSize = entry->width * imgData->nComps;
+  memcpy(colorLine, entry->colors + imgData->y * rowSize, rowSize);
+  if (entry->alpha) {
+    memcpy(alphaLine, entry->alpha + imgData->y * entry->width,
+	   entry->width);
+  }
+  ++imgData->y;
+  return gTrue;
+}
+
+// Look up an image in the image cache.  Only image XObjects (i.e.,
+// images with a reference) are cached.
+SplashOutImageCacheEntry *SplashOutputDev::lookupImage(
+			      Object *ref, GfxImageColorMap *colorMap,
+			      int *maskColors, SplashColorMode srcMode,
+			      int width, int height, GBool *doStore) {
+  SplashOutImageCacheEntry *entry;
+  PageProfile *profile;
+
+  *doStore = gFalse;
+  if (!imageCache || !ref || !ref->isRef()) {
+    return NULL;
+  }
+  entry = imageCache->lookup(ref->getRef(),
+			     hashImageColorMap(colorMap, srcMode, maskColors),
+			     srcMode, width, height,
+			     splashColorModeNComps[srcMode],
+			     maskColors ? gTrue : gFalse, doStore);
+  if ((profile = PageProfile::getActive())) {
+    profile->count(entry ? profileImageCacheHit : profileImageCacheMiss);
+  }
+  return entry;
+}
+
+void SplashOutputDev::drawCachedImage(SplashOutImageCacheEntry *entry,
+				      SplashCoord *mat) {
+  SplashOutCachedImageData imgData;
+
+  imgData.entry = entry;
+  imgData.nComps = splashColorModeNComps[entry->srcMode];
+  imgData.y = 0;
+  splash->drawImage(&cachedImageSrc, &imgData, entry->srcMode,
+		    entry->alpha ? gTrue : gFalse,
+		    entry->width, entry->height, mat);
+}
+
 void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 				int width, int height,
 				GfxImageColorMap *colorMap,
 				int *maskColors, GBool inlineImg) {
+  ProfileTimer timer(profileImage);
   double *ctm;
   SplashCoord mat[6];
   SplashOutImageData imgData;
+  SplashOutImageCacheEntry *cacheEntry;
+  GBool doStore;
   SplashColorMode srcMode;
   SplashImageSource src;
   GfxGray gray;
@@ -1895,6 +2552,18 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
+  if (colorMode == splashModeMono1) {
+    srcMode = splashModeMono8;
+  } else {
+    srcMode = colorMode;
+  }
+
+  if ((cacheEntry = lookupImage(ref, colorMap, maskColors, srcMode,
+				width, height, &doStore))) {
+    drawCachedImage(cacheEntry, mat);
+    return;
+  }
+
   imgData.imgStr = new ImageStream(str, width,
 				   colorMap->getNumPixelComps(),
 				   colorMap->getBits());
@@ -1960,14 +2629,16 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
     }
   }
 
-  if (colorMode == splashModeMono1) {
-    srcMode = splashModeMono8;
+  src = maskColors ? &alphaImageSrc : &imageSrc;
+  if (doStore) {
+    drawCachedImage(imageCache->store(src, &imgData,
+				      splashColorModeNComps[srcMode],
+				      maskColors ? gTrue : gFalse),
+		    mat);
   } else {
-    srcMode = colorMode;
+    splash->drawImage(src, &imgData, srcMode, maskColors ? gTrue : gFalse,
+		      width, height, mat);
   }
-  src = maskColors ? &alphaImageSrc : &imageSrc;
-  splash->drawImage(src, &imgData, srcMode, maskColors ? gTrue : gFalse,
-		    width, height, mat);
   if (inlineImg) {
     while (imgData.y < height) {
       imgData.imgStr->getLine();
@@ -1992,92 +2663,19 @@ struct SplashOutMaskedImageData {
 GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr colorLine,
 				      Guchar *alphaLine) {
   SplashOutMaskedImageData *imgData = (SplashOutMaskedImageData *)data;
-  Guchar *p, *aq;
   SplashColor maskColor;
-  SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
-  Guchar alpha;
-  int nComps, x;
+  Guchar *aq;
+  int x;
 
   if (imgData->y == imgData->height) {
     return gFalse;
   }
 
-  nComps = imgData->colorMap->getNumPixelComps();
-
-  for (x = 0, p = imgData->imgStr->getLine(), q = colorLine, aq = alphaLine;
-       x < imgData->width;
-       ++x, p += nComps) {
+  convertImageLine(imgData->colorMap, imgData->lookup, imgData->colorMode,
+		   imgData->imgStr->getLine(), colorLine, imgData->width);
+  for (x = 0, aq = alphaLine; x < imgData->width; ++x) {
     imgData->mask->getPixel(x, imgData->y, maskColor);
-    alpha = maskColor[0] ? 0xff : 0x00;
-    if (imgData->lookup) {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	*q++ = imgData->lookup[*p];
-	*aq++ = alpha;
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	col = &imgData->lookup[3 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*aq++ = alpha;
-	break;
-      case splashModeXBGR8:
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = 255;
-	*aq++ = alpha;
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = col[3];
-	*aq++ = alpha;
-	break;
-#endif
-      }
-    } else {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-	*aq++ = alpha;
-	break;
-      case splashModeXBGR8:
-      case splashModeRGB8:
-      case splashModeBGR8:
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-	if (imgData->colorMode == splashModeXBGR8) *q++ = 255;
-	*aq++ = alpha;
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	imgData->colorMap->getCMYK(p, &cmyk);
-	*q++ = colToByte(cmyk.c);
-	*q++ = colToByte(cmyk.m);
-	*q++ = colToByte(cmyk.y);
-	*q++ = colToByte(cmyk.k);
-	*aq++ = alpha;
-	break;
-#endif
-      }
-    }
+    *aq++ = maskColor[0] ? 0xff : 0x00;
   }
 
   ++imgData->y;
@@ -2089,6 +2687,7 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
 				      GfxImageColorMap *colorMap,
 				      Stream *maskStr, int maskWidth,
 				      int maskHeight, GBool maskInvert) {
+  ProfileTimer timer(profileImage);
   GfxImageColorMap *maskColorMap;
   Object maskDecode, decodeLow, decodeHigh;
   double *ctm;
@@ -2245,10 +2844,13 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
 					  Stream *maskStr,
 					  int maskWidth, int maskHeight,
 					  GfxImageColorMap *maskColorMap) {
+  ProfileTimer timer(profileImage);
   double *ctm;
   SplashCoord mat[6];
   SplashOutImageData imgData;
   SplashOutImageData imgMaskData;
+  SplashOutImageCacheEntry *cacheEntry;
+  GBool doStore;
   SplashColorMode srcMode;
   SplashBitmap *maskBitmap;
   Splash *maskSplash;
@@ -2303,6 +2905,19 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
 
   //----- draw the source image
 
+  if (colorMode == splashModeMono1) {
+    srcMode = splashModeMono8;
+  } else {
+    srcMode = colorMode;
+  }
+
+  if ((cacheEntry = lookupImage(ref, colorMap, NULL, srcMode,
+				width, height, &doStore))) {
+    drawCachedImage(cacheEntry, mat);
+    splash->setSoftMask(NULL);
+    return;
+  }
+
   imgData.imgStr = new ImageStream(str, width,
 				   colorMap->getNumPixelComps(),
 				   colorMap->getBits());
@@ -2367,12 +2982,14 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
     }
   }
 
-  if (colorMode == splashModeMono1) {
-    srcMode = splashModeMono8;
+  if (doStore) {
+    drawCachedImage(imageCache->store(&imageSrc, &imgData,
+				      splashColorModeNComps[srcMode], gFalse),
+		    mat);
   } else {
-    srcMode = colorMode;
+    splash->drawImage(&imageSrc, &imgData, srcMode, gFalse,
+		      width, height, mat);
   }
-  splash->drawImage(&imageSrc, &imgData, srcMode, gFalse, width, height, mat);
 
   splash->setSoftMask(NULL);
   gfree(imgData.lookup);
@@ -2380,64 +2997,84 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   str->close();
 }
 
-void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
-					     GfxColorSpace *blendingColorSpace,
-					     GBool isolated, GBool /*knockout*/,
-					     GBool /*forSoftMask*/) {
-  SplashTransparencyGroup *transpGroup;
-  SplashColor color;
-  double xMin, yMin, xMax, yMax, x, y;
-  int tx, ty, w, h;
+// Compute the device space bounding box of <bbox> (in user space).
+static void transformBBox(GfxState *state, double *bbox,
+			  double *xMin, double *yMin,
+			  double *xMax, double *yMax) {
+  double x, y;
 
-  // transform the bbox
   state->transform(bbox[0], bbox[1], &x, &y);
-  xMin = xMax = x;
-  yMin = yMax = y;
+  *xMin = *xMax = x;
+  *yMin = *yMax = y;
   state->transform(bbox[0], bbox[3], &x, &y);
-  if (x < xMin) {
-    xMin = x;
-  } else if (x > xMax) {
-    xMax = x;
+  if (x < *xMin) {
+    *xMin = x;
+  } else if (x > *xMax) {
+    *xMax = x;
   }
-  if (y < yMin) {
-    yMin = y;
-  } else if (y > yMax) {
-    yMax = y;
+  if (y < *yMin) {
+    *yMin = y;
+  } else if (y > *yMax) {
+    *yMax = y;
   }
   state->transform(bbox[2], bbox[1], &x, &y);
-  if (x < xMin) {
-    xMin = x;
-  } else if (x > xMax) {
-    xMax = x;
+  if (x < *xMin) {
+    *xMin = x;
+  } else if (x > *xMax) {
+    *xMax = x;
   }
-  if (y < yMin) {
-    yMin = y;
-  } else if (y > yMax) {
-    yMax = y;
+  if (y < *yMin) {
+    *yMin = y;
+  } else if (y > *yMax) {
+    *yMax = y;
   }
   state->transform(bbox[2], bbox[3], &x, &y);
-  if (x < xMin) {
-    xMin = x;
-  } else if (x > xMax) {
-    xMax = x;
+  if (x < *xMin) {
+    *xMin = x;
+  } else if (x > *xMax) {
+    *xMax = x;
   }
-  if (y < yMin) {
-    yMin = y;
-  } else if (y > yMax) {
-    yMax = y;
+  if (y < *yMin) {
+    *yMin = y;
+  } else if (y > *yMax) {
+    *yMax = y;
   }
+}
+
+void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
+					     GfxColorSpace *blendingColorSpace,
+					     GBool isolated, GBool /*knockout*/,
+					     GBool /*forSoftMask*/) {
+  ProfileTimer timer(profileComposite);
+  SplashClip *clip;
+  double xMin, yMin, xMax, yMax;
+  int tx, ty, w, h;
+
+  // transform the bbox, and intersect it with the clip region -- the
+  // group can't paint anything outside of it
+  transformBBox(state, bbox, &xMin, &yMin, &xMax, &yMax);
+  clip = splash->getClip();
   tx = (int)floor(xMin);
+  if (tx < clip->getXMinI()) {
+    tx = clip->getXMinI();
+  }
   if (tx < 0) {
     tx = 0;
   } else if (tx > bitmap->getWidth()) {
     tx = bitmap->getWidth();
   }
   ty = (int)floor(yMin);
+  if (ty < clip->getYMinI()) {
+    ty = clip->getYMinI();
+  }
   if (ty < 0) {
     ty = 0;
   } else if (ty > bitmap->getHeight()) {
     ty = bitmap->getHeight();
   }
+  if (xMax > clip->getXMaxI()) {
+    xMax = clip->getXMaxI();
+  }
   w = (int)ceil(xMax) - tx + 1;
   if (tx + w > bitmap->getWidth()) {
     w = bitmap->getWidth() - tx;
@@ -2445,6 +3082,9 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
   if (w < 1) {
     w = 1;
   }
+  if (yMax > clip->getYMaxI()) {
+    yMax = clip->getYMaxI();
+  }
   h = (int)ceil(yMax) - ty + 1;
   if (ty + h > bitmap->getHeight()) {
     h = bitmap->getHeight() - ty;
@@ -2453,10 +3093,22 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
     h = 1;
   }
 
+  pushTransparencyGroup(state, tx, ty, w, h, blendingColorSpace, isolated,
+			gTrue);
+}
+
+void SplashOutputDev::pushTransparencyGroup(GfxState *state,
+					    int tx, int ty, int w, int h,
+					    GfxColorSpace *blendingColorSpace,
+					    GBool isolated, GBool pooled) {
+  SplashTransparencyGroup *transpGroup;
+
   // push a new stack entry
   transpGroup = new SplashTransparencyGroup();
   transpGroup->tx = tx;
   transpGroup->ty = ty;
+  transpGroup->w = w;
+  transpGroup->h = h;
   transpGroup->blendingColorSpace = blendingColorSpace;
   transpGroup->isolated = isolated;
   transpGroup->next = transpGroupStack;
@@ -2468,46 +3120,35 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
 
   //~ this ignores the blendingColorSpace arg
 
-  // create the temporary bitmap
-  bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, gTrue,
-			    bitmapTopDown); 
+  // get a cleared temporary bitmap; if it is larger than the group,
+  // clip to the group's area
+  transpGroup->pooled = pooled;
+  bitmap = getGroupBitmap(w, h, pooled);
   splash = new Splash(bitmap, vectorAntialias,
 		      transpGroup->origSplash->getScreen());
-  if (isolated) {
-    switch (colorMode) {
-    case splashModeMono1:
-    case splashModeMono8:
-      color[0] = 0;
-      break;
-    case splashModeXBGR8:
-      color[3] = 255;
-    case splashModeRGB8:
-    case splashModeBGR8:
-      color[0] = color[1] = color[2] = 0;
-      break;
-#if SPLASH_CMYK
-    case splashModeCMYK8:
-      color[0] = color[1] = color[2] = color[3] = 0;
-      break;
-#endif
-    default:
-      // make gcc happy
-      break;
-    }
-    splash->clear(color, 0);
-  } else {
+  splash->setClipMaskThreshold(globalParams->getClipMaskThreshold());
+  if (bitmap->getWidth() != w || bitmap->getHeight() != h) {
+    splash->clipResetToRect(0, 0, w - 0.001, h - 0.001);
+  }
+  if (!isolated) {
     splash->blitTransparent(transpGroup->origBitmap, tx, ty, 0, 0, w, h);
     splash->setInNonIsolatedGroup(transpGroup->origBitmap, tx, ty);
   }
   transpGroup->tBitmap = bitmap;
   state->shiftCTM(-tx, -ty);
   updateCTM(state, 0, 0, 0, 0, 0, 0);
+
+  // the group inherits the graphics state (colors, line parameters,
+  // and font)
+  updateAll(state);
 }
 
 void SplashOutputDev::endTransparencyGroup(GfxState *state) {
   double *ctm;
 
   // restore state
+  splash->getModRegion(&transpGroupStack->modXMin, &transpGroupStack->modYMin,
+		       &transpGroupStack->modXMax, &transpGroupStack->modYMax);
   delete splash;
   bitmap = transpGroupStack->origBitmap;
   splash = transpGroupStack->origSplash;
@@ -2517,33 +3158,97 @@ void SplashOutputDev::endTransparencyGroup(GfxState *state) {
 }
 
 void SplashOutputDev::paintTransparencyGroup(GfxState * /*state*/, double * /*bbox*/) {
-  SplashBitmap *tBitmap;
+  ProfileTimer timer(profileComposite);
   SplashTransparencyGroup *transpGroup;
-  GBool isolated;
-  int tx, ty;
+  int xMin, yMin, xMax, yMax;
 
-  tx = transpGroupStack->tx;
-  ty = transpGroupStack->ty;
-  tBitmap = transpGroupStack->tBitmap;
-  isolated = transpGroupStack->isolated;
+  transpGroup = transpGroupStack;
 
   // paint the transparency group onto the parent bitmap
   // - the clip path was set in the parent's state)
-  splash->composite(tBitmap, 0, 0, tx, ty,
-		    tBitmap->getWidth(), tBitmap->getHeight(),
-		    gFalse, !isolated);
+  // - pixels which the group didn't modify have zero alpha, and don't
+  //   change the parent bitmap
+  xMin = transpGroup->modXMin < 0 ? 0 : transpGroup->modXMin;
+  yMin = transpGroup->modYMin < 0 ? 0 : transpGroup->modYMin;
+  xMax = transpGroup->modXMax < transpGroup->w ? transpGroup->modXMax
+                                               : transpGroup->w - 1;
+  yMax = transpGroup->modYMax < transpGroup->h ? transpGroup->modYMax
+                                               : transpGroup->h - 1;
+  if (xMin <= xMax && yMin <= yMax) {
+    splash->composite(transpGroup->tBitmap, xMin, yMin,
+		      transpGroup->tx + xMin, transpGroup->ty + yMin,
+		      xMax - xMin + 1, yMax - yMin + 1,
+		      gFalse, !transpGroup->isolated);
+  }
 
   // pop the stack
-  transpGroup = transpGroupStack;
   transpGroupStack = transpGroup->next;
+  releaseGroupBitmap(transpGroup, gFalse);
   delete transpGroup;
+}
 
-  delete tBitmap;
+// Get a cleared bitmap for a transparency group -- from the pool, if
+// <pooled> is set (in which case it may be larger than <w> x <h>).
+SplashBitmap *SplashOutputDev::getGroupBitmap(int w, int h, GBool pooled) {
+  SplashBitmap *tBitmap;
+  int i;
+
+  if (pooled) {
+    w = ((w + splashOutGroupSizeClass - 1) / splashOutGroupSizeClass)
+        * splashOutGroupSizeClass;
+    h = ((h + splashOutGroupSizeClass - 1) / splashOutGroupSizeClass)
+        * splashOutGroupSizeClass;
+    for (i = 0; i < groupBitmapPool->getLength(); ++i) {
+      tBitmap = (SplashBitmap *)groupBitmapPool->get(i);
+      if (tBitmap->getWidth() == w && tBitmap->getHeight() == h) {
+	groupBitmapPool->del(i);
+	groupBitmapPoolSize -= groupBitmapSize(tBitmap);
+	return tBitmap;
+      }
+    }
+  }
+  tBitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, gTrue,
+			     bitmapTopDown);
+  clearBitmapRect(tBitmap, 0, 0, w - 1, h - 1);
+  return tBitmap;
+}
+
+// Done with the bitmap of <transpGroup>: clear the region it modified
+// (or all of it, if <all> is set), and put it back in the pool.
+void SplashOutputDev::releaseGroupBitmap(SplashTransparencyGroup *transpGroup,
+					 GBool all) {
+  SplashBitmap *tBitmap;
+
+  tBitmap = transpGroup->tBitmap;
+  if (!transpGroup->pooled) {
+    delete tBitmap;
+    return;
+  }
+  if (all) {
+    clearBitmapRect(tBitmap, 0, 0,
+		    tBitmap->getWidth() - 1, tBitmap->getHeight() - 1);
+  } else {
+    if (!transpGroup->isolated) {
+      // blitTransparent copied the backdrop
+      clearBitmapRect(tBitmap, 0, 0, transpGroup->w - 1, transpGroup->h - 1);
+    }
+    clearBitmapRect(tBitmap, transpGroup->modXMin, transpGroup->modYMin,
+		    transpGroup->modXMax, transpGroup->modYMax);
+  }
+  groupBitmapPool->insert(0, tBitmap);
+  groupBitmapPoolSize += groupBitmapSize(tBitmap);
+  while (groupBitmapPoolSize > splashOutGroupPoolMaxSize) {
+    tBitmap = (SplashBitmap *)groupBitmapPool->del(
+				  groupBitmapPool->getLength() - 1);
+    groupBitmapPoolSize -= groupBitmapSize(tBitmap);
+    delete tBitmap;
+  }
 }
 
 void SplashOutputDev::setSoftMask(GfxState * /*state*/, double * /*bbox*/,
 				  GBool alpha, Function *transferFunc,
 				  GfxColor *backdropColor) {
+  ProfileTimer timer(profileComposite);
   SplashBitmap *softMask, *tBitmap;
   Splash *tSplash;
   SplashTransparencyGroup *transpGroup;
@@ -2555,6 +3260,7 @@ void SplashOutputDev::setSoftMask(GfxState * /*state*/, double * /*bbox*/,
   GfxCMYK cmyk;
 #endif
   double lum, lum2;
+  GBool backdrop;
   int tx, ty, x, y;
 
   tx = transpGroupStack->tx;
@@ -2562,12 +3268,14 @@ void SplashOutputDev::setSoftMask(GfxState * /*state*/, double * /*bbox*/,
   tBitmap = transpGroupStack->tBitmap;
 
   // composite with backdrop color
+  backdrop = gFalse;
   if (!alpha && colorMode != splashModeMono1) {
     //~ need to correctly handle the case where no blending color
     //~ space is given
     tSplash = new Splash(tBitmap, vectorAntialias,
 			 transpGroupStack->origSplash->getScreen());
     if (transpGroupStack->blendingColorSpace) {
+      backdrop = gTrue;
       switch (colorMode) {
       case splashModeMono1:
 	// transparency is not supported in mono1 mode
@@ -2607,8 +3315,8 @@ void SplashOutputDev::setSoftMask(GfxState * /*state*/, double * /*bbox*/,
   memset(softMask->getDataPtr(), 0,
 	 softMask->getRowSize() * softMask->getHeight());
   p = softMask->getDataPtr() + ty * softMask->getRowSize() + tx;
-  for (y = 0; y < tBitmap->getHeight(); ++y) {
-    for (x = 0; x < tBitmap->getWidth(); ++x) {
+  for (y = 0; y < transpGroupStack->h; ++y) {
+    for (x = 0; x < transpGroupStack->w; ++x) {
       tBitmap->getPixel(x, y, color);
       if (alpha) {
 	//~ unimplemented
@@ -2653,15 +3361,128 @@ void SplashOutputDev::setSoftMask(GfxState * /*state*/, double * /*bbox*/,
   // pop the stack
   transpGroup = transpGroupStack;
   transpGroupStack = transpGroup->next;
+  releaseGroupBitmap(transpGroup, backdrop);
   delete transpGroup;
-
-  delete tBitmap;
 }
 
 void SplashOutputDev::clearSoftMask(GfxState * /*state*/) {
   splash->setSoftMask(NULL);
 }
 
+GBool SplashOutputDev::drawCachedForm(GfxState *state, Ref id, Guint hash,
+				      double * /*bbox*/, GBool *doStore) {
+  ProfileTimer timer(profileComposite);
+  SplashOutFormCacheEntry *entry;
+  SplashBitmap *formBitmap;
+  PageProfile *profile;
+  double *ctm;
+  int x, y, xSrc, ySrc, w, h;
+
+  *doStore = gFalse;
+
+  // forms are only cached outside of groups and Type 3 glyphs, and
+  // when no soft mask is set
+  if (!formCache || transpGroupStack || t3GlyphStack ||
+      splash->getSoftMask()) {
+    return gFalse;
+  }
+
+  // Gfx leaves the colors to the device, which knows how they are
+  // converted
+  hash = hashFormColor(hash, state->getFillColorSpace(),
+		       state->getFillColor(), colorMode);
+  hash = hashFormColor(hash, state->getStrokeColorSpace(),
+		       state->getStrokeColor(), colorMode);
+
+  ctm = state->getCTM();
+  entry = formCache->lookup(id, hash, ctm, vectorAntialias, doStore);
+  if ((profile = PageProfile::getActive())) {
+    profile->count(entry ? profileFormCacheHit : profileFormCacheMiss);
+  }
+  if (!entry) {
+    return gFalse;
+  }
+
+  // composite the bitmap, at the nearest pixel to where it would have
+  // been rasterized, with the current clip
+  formBitmap = entry->bitmap;
+  x = (int)floor(ctm[4] + entry->dx + 0.5);
+  y = (int)floor(ctm[5] + entry->dy + 0.5);
+  xSrc = ySrc = 0;
+  w = formBitmap->getWidth();
+  h = formBitmap->getHeight();
+  if (x < 0) {
+    xSrc = -x;
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    ySrc = -y;
+    h += y;
+    y = 0;
+  }
+  if (x + w > bitmap->getWidth()) {
+    w = bitmap->getWidth() - x;
+  }
+  if (y + h > bitmap->getHeight()) {
+    h = bitmap->getHeight() - y;
+  }
+  if (w > 0 && h > 0) {
+    splash->composite(formBitmap, xSrc, ySrc, x, y, w, h, gFalse, gFalse);
+  }
+  return gTrue;
+}
+
+GBool SplashOutputDev::beginCachedForm(GfxState *state, double *bbox) {
+  double xMin, yMin, xMax, yMax;
+  int tx, ty, w, h;
+
+  // the bitmap is reused at other positions, so the whole form has to
+  // be on the page
+  transformBBox(state, bbox, &xMin, &yMin, &xMax, &yMax);
+  if (xMin < 0 || yMin < 0 ||
+      ceil(xMax) + 1 > bitmap->getWidth() ||
+      ceil(yMax) + 1 > bitmap->getHeight()) {
+    return gFalse;
+  }
+  tx = (int)floor(xMin);
+  ty = (int)floor(yMin);
+  w = (int)ceil(xMax) - tx + 1;
+  h = (int)ceil(yMax) - ty + 1;
+  if ((double)w * h * (splashColorModeNComps[colorMode] + 1) >
+      formCache->getMaxSize()) {
+    return gFalse;
+  }
+
+  // the form's content may leave the CTM changed, so the bitmap's
+  // offset is taken from the CTM it starts with
+  formTx = state->getCTM()[4];
+  formTy = state->getCTM()[5];
+
+  // the bitmap is kept by the cache, so it doesn't come from the pool
+  pushTransparencyGroup(state, tx, ty, w, h, NULL, gTrue, gFalse);
+  return gTrue;
+}
+
+void SplashOutputDev::endCachedForm(GfxState *state) {
+  ProfileTimer timer(profileComposite);
+  SplashTransparencyGroup *transpGroup;
+  SplashOutFormCacheEntry *entry;
+
+  endTransparencyGroup(state);
+
+  // pop the stack, and hand the group's bitmap over to the cache
+  transpGroup = transpGroupStack;
+  transpGroupStack = transpGroup->next;
+  entry = formCache->store(transpGroup->tBitmap,
+			   transpGroup->tx - formTx, transpGroup->ty - formTy);
+
+  splash->composite(entry->bitmap, 0, 0, transpGroup->tx, transpGroup->ty,
+		    entry->bitmap->getWidth(), entry->bitmap->getHeight(),
+		    gFalse, gFalse);
+  delete transpGroup;
+}
+
 void SplashOutputDev::setPaperColor(SplashColorPtr paperColorA) {
   splashColorCopy(paperColor, paperColorA);
 }
@@ -2683,6 +3504,17 @@ SplashBitmap *SplashOutputDev::takeBitmap() {
   return ret;
 }
 
+void SplashOutputDev::setBitmap(SplashBitmap *bitmapA) {
+  if (splash) {
+    delete splash;
+  }
+  if (bitmap) {
+    delete bitmap;
+  }
+  bitmap = bitmapA;
+  splash = new Splash(bitmap, vectorAntialias, &screenParams);
+}
+
 void SplashOutputDev::getModRegion(int *xMin, int *yMin,
 				   int *xMax, int *yMax) {
   splash->getModRegion(xMin, yMin, xMax, yMax);
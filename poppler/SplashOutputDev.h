@@ -19,6 +19,7 @@
 #include "OutputDev.h"
 #include "GfxState.h"
 
+class GooList;
 class Gfx8BitFont;
 class SplashBitmap;
 class Splash;
@@ -28,14 +29,12 @@ class SplashFontEngine;
 class SplashFont;
 class T3FontCache;
 struct T3FontCacheTag;
+class SplashOutImageCache;
+struct SplashOutImageCacheEntry;
+class SplashOutFormCache;
 struct T3GlyphStack;
 struct SplashTransparencyGroup;
 
-//------------------------------------------------------------------------
-
-// number of Type 3 fonts to cache
-#define splashOutT3FontCacheSize 8
-
 //------------------------------------------------------------------------
 // SplashOutputDev
 //------------------------------------------------------------------------
@@ -65,6 +64,9 @@ public:
   // text in Type 3 fonts will be drawn with drawChar/drawString.
   virtual GBool interpretType3Chars() { return gTrue; }
 
+  // Does this device cache rasterized form XObjects?
+  virtual GBool useFormCache() { return formCache != NULL; }
+
   //----- initialization and control
 
   // Start a page.
@@ -153,6 +155,12 @@ public:
 			   Function *transferFunc, GfxColor *backdropColor);
   virtual void clearSoftMask(GfxState *state);
 
+  //----- form XObjects
+  virtual GBool drawCachedForm(GfxState *state, Ref id, Guint hash,
+			       double *bbox, GBool *doStore);
+  virtual GBool beginCachedForm(GfxState *state, double *bbox);
+  virtual void endCachedForm(GfxState *state);
+
   //----- special access
 
   // Called to indicate that a new PDF document has been loaded.
@@ -172,6 +180,12 @@ public:
   // caller.
   SplashBitmap *takeBitmap();
 
+  // Replace the bitmap with <bitmapA>, transferring ownership to the
+  // output device.  The next page is rendered into it if it has the
+  // same size and color mode as the page; otherwise startPage
+  // allocates a new bitmap as usual.
+  void setBitmap(SplashBitmap *bitmapA);
+
   // Get the Splash object.
   Splash *getSplash() { return splash; }
 
@@ -203,6 +217,7 @@ private:
   void doUpdateFont(GfxState *state);
   void drawType3Glyph(T3FontCache *t3Font,
 		      T3FontCacheTag *tag, Guchar *data);
+  GBool makeT3CacheRoom(int n);
   static GBool imageMaskSrc(void *data, SplashColorPtr line);
   static GBool imageSrc(void *data, SplashColorPtr colorLine,
 			Guchar *alphaLine);
@@ -210,6 +225,20 @@ private:
 			     Guchar *alphaLine);
   static GBool maskedImageSrc(void *data, SplashColorPtr line,
 			      Guchar *alphaLine);
+  static GBool cachedImageSrc(void *data, SplashColorPtr colorLine,
+			      Guchar *alphaLine);
+  SplashOutImageCacheEntry *lookupImage(Object *ref,
+					GfxImageColorMap *colorMap,
+					int *maskColors,
+					SplashColorMode srcMode,
+					int width, int height,
+					GBool *doStore);
+  void drawCachedImage(SplashOutImageCacheEntry *entry, SplashCoord *mat);
+  void pushTransparencyGroup(GfxState *state, int tx, int ty, int w, int h,
+			     GfxColorSpace *blendingColorSpace,
+			     GBool isolated, GBool pooled);
+  SplashBitmap *getGroupBitmap(int w, int h, GBool pooled);
+  void releaseGroupBitmap(SplashTransparencyGroup *transpGroup, GBool all);
 
   SplashColorMode colorMode;
   int bitmapRowPad;
@@ -226,17 +255,26 @@ private:
   Splash *splash;
   SplashFontEngine *fontEngine;
 
-  T3FontCache *			// Type 3 font cache
-    t3FontCache[splashOutT3FontCacheSize];
-  int nT3Fonts;			// number of valid entries in t3FontCache
+  GooList *t3FontCache;		// Type 3 font cache [T3FontCache], most
+				//   recently used first
+  int t3CacheSize;		// bytes used by the Type 3 font cache
+  int t3CacheMaxSize;		// byte budget for the Type 3 font cache
   T3GlyphStack *t3GlyphStack;	// Type 3 glyph context stack
 
+  SplashOutImageCache *imageCache; // decoded images (NULL if disabled)
+  SplashOutFormCache *formCache; // rasterized forms (NULL if disabled)
+  double formTx, formTy;	// translation of the CTM at beginCachedForm
+
   SplashFont *font;		// current font
   GBool needFontUpdate;		// set when the font needs to be updated
   SplashPath *textClipPath;	// clipping path built with text object
 
   SplashTransparencyGroup *	// transparency group stack
     transpGroupStack;
+  GooList *groupBitmapPool;	// [SplashBitmap] cleared bitmaps for
+				//   transparency groups, most recently
+				//   used first
+  int groupBitmapPoolSize;	// bytes used by groupBitmapPool
 };
 
 #endif
@@ -32,6 +32,7 @@
 #include "JBIG2Stream.h"
 #include "JPXStream.h"
 #include "Stream-CCITT.h"
+#include "ProfileData.h"
 
 #ifdef ENABLE_LIBJPEG
 #include "DCTStream.h"
@@ -72,6 +73,18 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+int Stream::getRawChars(int nChars, Guchar *buffer) {
+  int n, c;
+
+  for (n = 0; n < nChars; ++n) {
+    if ((c = getRawChar()) == EOF) {
+      break;
+    }
+    buffer[n] = (Guchar)c;
+  }
+  return n;
+}
+
 char *Stream::getLine(char *buf, int size) {
   int i;
   int c;
@@ -93,10 +106,48 @@ char *Stream::getLine(char *buf, int size) {
   return buf;
 }
 
+int Stream::getChars(int nChars, Guchar *buffer) {
+  int n, c;
+
+  for (n = 0; n < nChars; ++n) {
+    if ((c = getChar()) == EOF) {
+      break;
+    }
+    buffer[n] = (Guchar)c;
+  }
+  return n;
+}
+
 GooString *Stream::getPSFilter(int psLevel, char *indent) {
   return new GooString();
 }
 
+// Names used to report decoding times, indexed by StreamKind.
+static char *filterNames[] = {
+  NULL,
+  "ASCIIHexDecode",
+  "ASCII85Decode",
+  "LZWDecode",
+  "RunLengthDecode",
+  "CCITTFaxDecode",
+  "DCTDecode",
+  "FlateDecode",
+  "JBIG2Decode",
+  "JPXDecode",
+  NULL
+};
+
+// While a page is being profiled, add a ProfileStream above <str>.
+static Stream *addProfileStream(Stream *str) {
+  char *name;
+
+  if (!PageProfile::getActive() ||
+      !(name = filterNames[str->getKind()])) {
+    return str;
+  }
+  return new ProfileStream(str, name);
+}
+
 Stream *Stream::addFilters(Object *dict) {
   Object obj, obj2;
   Object params, params2;
@@ -116,6 +167,7 @@ Stream *Stream::addFilters(Object *dict) {
   }
   if (obj.isName()) {
     str = makeFilter(obj.getName(), str, &params);
+    str = addProfileStream(str);
   } else if (obj.isArray()) {
     for (i = 0; i < obj.arrayGetLength(); ++i) {
       obj.arrayGet(i, &obj2);
@@ -125,6 +177,7 @@ Stream *Stream::addFilters(Object *dict) {
 	params2.initNull();
       if (obj2.isName()) {
 	str = makeFilter(obj2.getName(), str, &params2);
+	str = addProfileStream(str);
       } else {
 	error(getPos(), "Bad filter name");
 	str = new EOFStream(str);
@@ -375,8 +428,9 @@ Guchar *ImageStream::getLine() {
       imgLine[i+7] = (Guchar)(c & 1);
     }
   } else if (nBits == 8) {
-    for (i = 0; i < nVals; ++i) {
-      imgLine[i] = str->getChar();
+    if ((i = str->getChars(nVals, imgLine)) < nVals) {
+      // past the end of the stream, getChar() would return EOF
+      memset(imgLine + i, EOF & 0xff, nVals - i);
     }
   } else {
     bitMask = (1 << nBits) - 1;
@@ -429,6 +483,8 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   }
   predLine = (Guchar *)gmalloc(rowBytes);
   memset(predLine, 0, rowBytes);
+  prevLine = (Guchar *)gmalloc(rowBytes);
+  memset(prevLine, 0, rowBytes);
   predIdx = rowBytes;
 
   ok = gTrue;
@@ -436,6 +492,7 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(prevLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -456,11 +513,33 @@ int StreamPredictor::getChar() {
   return predLine[predIdx++];
 }
 
+int StreamPredictor::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (predIdx >= rowBytes) {
+      if (!getNextLine()) {
+	break;
+      }
+    }
+    m = rowBytes - predIdx;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, predLine + predIdx, m);
+    predIdx += m;
+    n += m;
+  }
+  return n;
+}
+
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
+  Guchar *line, *prev;
   int left, up, upLeft, p, pa, pb, pc;
-  int c;
+  int n;
   Gulong inBuf, outBuf, bitMask;
   int inBits, outBits;
   int i, j, k, kk;
@@ -475,37 +554,49 @@ GBool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
+  // read the raw line over the one before the previous line (the
+  // first pixBytes bytes of both lines are always zero)
+  line = prevLine;
+  prevLine = predLine;
+  predLine = line;
+  prev = prevLine;
+  n = str->getRawChars(rowBytes - pixBytes, line + pixBytes);
+  if (n == 0) {
+    predLine = prevLine;
+    prevLine = line;
+    return gFalse;
+  }
+  if (n < rowBytes - pixBytes) {
+    // this ought to return false, but some (broken) PDF files contain
+    // truncated image data, and Adobe apparently reads the last
+    // partial line
+    memcpy(line + pixBytes + n, prev + pixBytes + n,
+	   rowBytes - pixBytes - n);
+  }
+  n += pixBytes;
+
+  // apply PNG (byte) predictor
+  switch (curPred) {
+  case 11:			// PNG sub
+    for (i = pixBytes; i < n; ++i) {
+      line[i] += line[i - pixBytes];
     }
-    upLeftBuf[0] = predLine[i];
-    if ((c = str->getRawChar()) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
-      return gFalse;
+    break;
+  case 12:			// PNG up
+    for (i = pixBytes; i < n; ++i) {
+      line[i] += prev[i];
     }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
-      break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (Guchar)c;
-      break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (Guchar)c;
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
+    break;
+  case 13:			// PNG average
+    for (i = pixBytes; i < n; ++i) {
+      line[i] += (line[i - pixBytes] + prev[i]) >> 1;
+    }
+    break;
+  case 14:			// PNG Paeth
+    for (i = pixBytes; i < n; ++i) {
+      left = line[i - pixBytes];
+      up = prev[i];
+      upLeft = prev[i - pixBytes];
       p = left + up - upLeft;
       if ((pa = p - left) < 0)
 	pa = -pa;
@@ -514,17 +605,16 @@ GBool StreamPredictor::getNextLine() {
       if ((pc = p - upLeft) < 0)
 	pc = -pc;
       if (pa <= pb && pa <= pc)
-	predLine[i] = left + (Guchar)c;
+	line[i] += left;
       else if (pb <= pc)
-	predLine[i] = up + (Guchar)c;
+	line[i] += up;
       else
-	predLine[i] = upLeft + (Guchar)c;
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
-      break;
+	line[i] += upLeft;
     }
+    break;
+  case 10:			// PNG none
+  default:			// no predictor or TIFF predictor
+    break;
   }
 
   // apply TIFF (component) predictor
@@ -652,6 +742,45 @@ GBool FileStream::fillBuf() {
   return gTrue;
 }
 
+int FileStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    // large reads bypass the buffer
+    if (bufPtr >= bufEnd && nChars - n >= fileStreamBufSize) {
+      bufPos += bufEnd - buf;
+      bufPtr = bufEnd = buf;
+      m = nChars - n;
+      if (limited) {
+	if (bufPos >= start + length) {
+	  break;
+	}
+	if (bufPos + m > start + length) {
+	  m = start + length - bufPos;
+	}
+      }
+      if ((m = fread(buffer + n, 1, m, f)) == 0) {
+	break;
+      }
+      bufPos += m;
+      n += m;
+      continue;
+    }
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void FileStream::setPos(Guint pos, int dir) {
   Guint size;
 
@@ -742,6 +871,22 @@ void MemStream::reset() {
 void MemStream::close() {
 }
 
+int MemStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  if (bufEnd - bufPtr < nChars) {
+    n = (int)(bufEnd - bufPtr);
+  } else {
+    n = nChars;
+  }
+  memcpy(buffer, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
 void MemStream::setPos(Guint pos, int dir) {
   Guint i;
 
@@ -988,6 +1133,11 @@ GBool ASCII85Stream::isBinary(GBool last) {
 // LZWStream
 //------------------------------------------------------------------------
 
+// Initial and maximum sizes of the history buffer.  Sequences which
+// don't fit are rebuilt from the table one char at a time.
+#define lzwHistInitSize 16384
+#define lzwHistMaxSize  (1 << 20)
+
 LZWStream::LZWStream(Stream *strA, int predictor, int columns, int colors,
 		     int bits, int earlyA):
     FilterStream(strA) {
@@ -1003,6 +1153,8 @@ LZWStream::LZWStream(Stream *strA, int predictor, int columns, int colors,
   early = earlyA;
   eof = gFalse;
   inputBits = 0;
+  histBuf = NULL;
+  histSize = 0;
   clearTable();
 }
 
@@ -1010,6 +1162,7 @@ LZWStream::~LZWStream() {
   if (pred) {
     delete pred;
   }
+  gfree(histBuf);
   delete str;
 }
 
@@ -1025,7 +1178,7 @@ int LZWStream::getChar() {
       return EOF;
     }
   }
-  return seqBuf[seqIndex++];
+  return seq[seqIndex++];
 }
 
 int LZWStream::lookChar() {
@@ -1040,7 +1193,7 @@ int LZWStream::lookChar() {
       return EOF;
     }
   }
-  return seqBuf[seqIndex];
+  return seq[seqIndex];
 }
 
 int LZWStream::getRawChar() {
@@ -1052,7 +1205,35 @@ int LZWStream::getRawChar() {
       return EOF;
     }
   }
-  return seqBuf[seqIndex++];
+  return seq[seqIndex++];
+}
+
+int LZWStream::getChars(int nChars, Guchar *buffer) {
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  return getRawChars(nChars, buffer);
+}
+
+int LZWStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (seqIndex >= seqLength) {
+      if (!processNextCode()) {
+	break;
+      }
+    }
+    m = seqLength - seqIndex;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, seq + seqIndex, m);
+    seqIndex += m;
+    n += m;
+  }
+  return n;
 }
 
 void LZWStream::reset() {
@@ -1063,8 +1244,9 @@ void LZWStream::reset() {
 }
 
 GBool LZWStream::processNextCode() {
+  Guchar *dest;
   int code;
-  int nextLength;
+  int length, nextLength, seqOffset;
   int i, j;
 
   // check for EOF
@@ -1088,33 +1270,72 @@ GBool LZWStream::processNextCode() {
     clearTable();
   }
 
-  // process the next code
+  // get the length of the next sequence
   nextLength = seqLength + 1;
   if (code < 256) {
-    seqBuf[0] = code;
-    seqLength = 1;
+    length = 1;
   } else if (code < nextCode) {
-    seqLength = table[code].length;
-    for (i = seqLength - 1, j = code; i > 0; --i) {
-      seqBuf[i] = table[j].tail;
-      j = table[j].head;
-    }
-    seqBuf[0] = j;
+    length = table[code].length;
   } else if (code == nextCode) {
-    seqBuf[seqLength] = newChar;
-    ++seqLength;
+    length = nextLength;
   } else {
     error(getPos(), "Bad LZW stream - unexpected code");
     eof = gTrue;
     return gFalse;
   }
-  newChar = seqBuf[0];
+
+  // sequences are appended to the history buffer while there is
+  // room, so that each table entry can be copied from there
+  if (histLength + length > histSize && histSize < lzwHistMaxSize) {
+    seqOffset = (seq == seqBuf) ? -1 : (int)(seq - histBuf);
+    do {
+      histSize = histSize ? 2 * histSize : lzwHistInitSize;
+    } while (histLength + length > histSize && histSize < lzwHistMaxSize);
+    histBuf = (Guchar *)grealloc(histBuf, histSize);
+    if (seqOffset >= 0) {
+      seq = histBuf + seqOffset;
+    }
+  }
+  if (histLength + length <= histSize) {
+    dest = histBuf + histLength;
+  } else {
+    dest = seqBuf;
+  }
+
+  // process the next code
+  if (code < 256) {
+    dest[0] = (Guchar)code;
+  } else if (code < nextCode) {
+    if (table[code].offset >= 0) {
+      memcpy(dest, histBuf + table[code].offset, length);
+    } else {
+      for (i = length - 1, j = code; i > 0; --i) {
+	dest[i] = table[j].tail;
+	j = table[j].head;
+      }
+      dest[0] = j;
+    }
+  } else {
+    // the previous sequence plus its first char
+    if (dest != seq) {
+      memcpy(dest, seq, length - 1);
+    }
+    dest[length - 1] = newChar;
+  }
+  newChar = dest[0];
   if (first) {
     first = gFalse;
   } else {
+    // the new entry is the previous sequence plus the first char of
+    // this one, which directly follows it in the history buffer
     table[nextCode].length = nextLength;
     table[nextCode].head = prevCode;
     table[nextCode].tail = newChar;
+    if (seq != seqBuf && dest != seqBuf) {
+      table[nextCode].offset = (int)(seq - histBuf);
+    } else {
+      table[nextCode].offset = -1;
+    }
     ++nextCode;
     if (nextCode + early == 512)
       nextBits = 10;
@@ -1126,6 +1347,11 @@ GBool LZWStream::processNextCode() {
   prevCode = code;
 
   // reset buffer
+  if (dest != seqBuf) {
+    histLength += length;
+  }
+  seq = dest;
+  seqLength = length;
   seqIndex = 0;
 
   return gTrue;
@@ -1134,6 +1360,8 @@ GBool LZWStream::processNextCode() {
 void LZWStream::clearTable() {
   nextCode = 258;
   nextBits = 9;
+  histLength = 0;
+  seq = seqBuf;
   seqIndex = seqLength = 0;
   first = gTrue;
 }
@@ -1211,30 +1439,69 @@ GBool RunLengthStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
 
+int RunLengthStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr < bufEnd) {
+      m = (int)(bufEnd - bufPtr);
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      memcpy(buffer + n, bufPtr, m);
+      bufPtr += m;
+      n += m;
+    } else if (nChars - n >= 128) {
+      // decode whole runs straight into the caller's buffer
+      if ((m = readRun(buffer + n)) == 0) {
+	break;
+      }
+      n += m;
+    } else if (!fillBuf()) {
+      break;
+    }
+  }
+  return n;
+}
+
 GBool RunLengthStream::fillBuf() {
+  int n;
+
+  if ((n = readRun((Guchar *)buf)) == 0) {
+    return gFalse;
+  }
+  bufPtr = buf;
+  bufEnd = buf + n;
+  return gTrue;
+}
+
+// Decode the next run (at most 128 bytes) into <p>.  Returns the
+// length of the run, or 0 at the end of the stream.
+int RunLengthStream::readRun(Guchar *p) {
   int c;
-  int n, i;
+  int n, m;
 
   if (eof)
-    return gFalse;
+    return 0;
   c = str->getChar();
   if (c == 0x80 || c == EOF) {
     eof = gTrue;
-    return gFalse;
+    return 0;
   }
   if (c < 0x80) {
     n = c + 1;
-    for (i = 0; i < n; ++i)
-      buf[i] = (char)str->getChar();
+    m = str->getChars(n, p);
+    if (m < n) {
+      // a truncated run is padded with EOF chars
+      memset(p + m, 0xff, n - m);
+    }
   } else {
     n = 0x101 - c;
     c = str->getChar();
-    for (i = 0; i < n; ++i)
-      buf[i] = (char)c;
+    memset(p, c & 0xff, n);
   }
-  bufPtr = buf;
-  bufEnd = buf + n;
-  return gTrue;
+  return n;
 }
 
 //------------------------------------------------------------------------
@@ -1258,24 +1525,28 @@ CCITTFaxStream::CCITTFaxStream(Stream *strA, int encodingA, GBool endOfLineA,
   rows = rowsA;
   endOfBlock = endOfBlockA;
   black = blackA;
-  refLine = (short *)gmallocn(columns + 3, sizeof(short));
-  codingLine = (short *)gmallocn(columns + 2, sizeof(short));
+  // runs are never empty (except for a leading white run), so a row
+  // has at most columns + 1 of them, and the reference line has two
+  // extra entries
+  refLine = (int *)gmallocn(columns + 2, sizeof(int));
+  codingLine = (int *)gmallocn(columns + 2, sizeof(int));
+  rowSize = columns / 8 + (columns % 8 ? 1 : 0);
+  rowBuf = (Guchar *)gmalloc(rowSize);
 
   eof = gFalse;
   row = 0;
   nextLine2D = encoding < 0;
   inputBits = 0;
-  codingLine[0] = 0;
-  codingLine[1] = refLine[2] = columns;
-  a0 = 1;
-
-  buf = EOF;
+  codingLine[0] = columns;
+  a0 = 0;
+  rowPtr = rowEnd = rowBuf;
 }
 
 CCITTFaxStream::~CCITTFaxStream() {
   delete str;
   gfree(refLine);
   gfree(codingLine);
+  gfree(rowBuf);
 }
 
 void CCITTFaxStream::reset() {
@@ -1286,10 +1557,9 @@ void CCITTFaxStream::reset() {
   row = 0;
   nextLine2D = encoding < 0;
   inputBits = 0;
-  codingLine[0] = 0;
-  codingLine[1] = columns;
-  a0 = 1;
-  buf = EOF;
+  codingLine[0] = columns;
+  a0 = 0;
+  rowPtr = rowEnd = rowBuf;
 
   // skip any initial zero bits and end-of-line marker, and get the 2D
   // encoding tag
@@ -1305,356 +1575,354 @@ void CCITTFaxStream::reset() {
   }
 }
 
-int CCITTFaxStream::lookChar() {
+int CCITTFaxStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (rowPtr < rowEnd) {
+      m = (int)(rowEnd - rowPtr);
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      memcpy(buffer + n, rowPtr, m);
+      rowPtr += m;
+      n += m;
+    } else if (nChars - n >= rowSize) {
+      // decode whole rows straight into the caller's buffer
+      if (!readRow()) {
+	break;
+      }
+      writeRow(buffer + n);
+      n += rowSize;
+    } else if (!fillBuf()) {
+      break;
+    }
+  }
+  return n;
+}
+
+GBool CCITTFaxStream::fillBuf() {
+  if (!readRow()) {
+    return gFalse;
+  }
+  writeRow(rowBuf);
+  rowPtr = rowBuf;
+  rowEnd = rowBuf + rowSize;
+  return gTrue;
+}
+
+// End the current run of <blackPixels> color at <a1>, starting a new
+// run if the last one was the other color.  Runs are only ever
+// extended to the right, and not past the end of the row.
+inline void CCITTFaxStream::addPixels(int a1, int blackPixels) {
+  if (a1 > codingLine[a0]) {
+    if (a1 > columns) {
+      a1 = columns;
+    }
+    if ((a0 & 1) ^ blackPixels) {
+      ++a0;
+    }
+    codingLine[a0] = a1;
+  }
+}
+
+// Decode the next row into codingLine.  Returns false at the end of
+// the data.
+GBool CCITTFaxStream::readRow() {
+  int *line;
   short code1, code2, code3;
-  int a0New;
+  int blackPixels, a1, b1;
   GBool err, gotEOL;
-  int ret;
-  int bits, i;
+  int i;
 
-  // if at eof just return EOF
-  if (eof && codingLine[a0] >= columns) {
-    return EOF;
+  if (eof) {
+    return gFalse;
   }
-
-  // read the next row
   err = gFalse;
-  if (codingLine[a0] >= columns) {
-
-    // 2-D encoding
-    if (nextLine2D) {
-      // state:
-      //   a0New = current position in coding line (0 <= a0New <= columns)
-      //   codingLine[a0] = last change in coding line
-      //                    (black-to-white if a0 is even,
-      //                     white-to-black if a0 is odd)
-      //   refLine[b1] = next change in reference line of opposite color
-      //                 to a0
-      // invariants:
-      //   0 <= codingLine[a0] <= a0New
-      //           <= refLine[b1] <= refLine[b1+1] <= columns
-      //   0 <= a0 <= columns+1
-      //   refLine[0] = 0
-      //   refLine[n] = refLine[n+1] = columns
-      //     -- for some 1 <= n <= columns+1
-      // end condition:
-      //   0 = codingLine[0] <= codingLine[1] < codingLine[2] < ...
-      //     < codingLine[n-1] < codingLine[n] = columns
-      //     -- where 1 <= n <= columns+1
-      for (i = 0; codingLine[i] < columns; ++i) {
-	refLine[i] = codingLine[i];
-      }
-      refLine[i] = refLine[i + 1] = columns;
-      b1 = 1;
-      a0New = codingLine[a0 = 0] = 0;
-      do {
-	code1 = getTwoDimCode();
-	switch (code1) {
-	case twoDimPass:
-	  if (refLine[b1] < columns) {
-	    a0New = refLine[b1 + 1];
+
+  // 2-D encoding
+  if (nextLine2D) {
+    // state:
+    //   codingLine[0..a0] = ends of the runs decoded so far (white
+    //                       runs at even indexes), the current
+    //                       position being codingLine[a0]
+    //   blackPixels = color of the pixels at the current position
+    //   refLine[b1] = next change in the reference line to the color
+    //                 opposite blackPixels (to the right of the
+    //                 current position, except at the start of the row)
+    // invariants:
+    //   0 <= codingLine[0] < codingLine[1] < ... < codingLine[a0]
+    //     <= columns
+    //   refLine[n] = refLine[n+1] = columns
+    //     -- for the last run n of the previous row
+    line = refLine;
+    refLine = codingLine;
+    codingLine = line;
+    refLine[a0 + 1] = columns;
+    codingLine[a0 = 0] = 0;
+    b1 = 0;
+    blackPixels = 0;
+    do {
+      code1 = getTwoDimCode();
+      switch (code1) {
+      case twoDimPass:
+	if (refLine[b1] < columns) {
+	  addPixels(refLine[b1 + 1], blackPixels);
+	  b1 += 2;
+	}
+	break;
+      case twoDimHoriz:
+	code1 = code2 = 0;
+	if (blackPixels) {
+	  do {
+	    code1 += code3 = getBlackCode();
+	  } while (code3 >= 64);
+	  do {
+	    code2 += code3 = getWhiteCode();
+	  } while (code3 >= 64);
+	} else {
+	  do {
+	    code1 += code3 = getWhiteCode();
+	  } while (code3 >= 64);
+	  do {
+	    code2 += code3 = getBlackCode();
+	  } while (code3 >= 64);
+	}
+	addPixels(codingLine[a0] + code1, blackPixels);
+	addPixels(codingLine[a0] + code2, blackPixels ^ 1);
+	while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns) {
+	  b1 += 2;
+	}
+	break;
+      case twoDimVert0:
+      case twoDimVertR1:
+      case twoDimVertR2:
+      case twoDimVertR3:
+	a1 = refLine[b1] + (code1 == twoDimVert0 ? 0 :
+			    code1 == twoDimVertR1 ? 1 :
+			    code1 == twoDimVertR2 ? 2 : 3);
+	if (a1 < columns) {
+	  addPixels(a1, blackPixels);
+	  blackPixels ^= 1;
+	  ++b1;
+	  while (refLine[b1] <= a1 && refLine[b1] < columns) {
 	    b1 += 2;
 	  }
-	  break;
-	case twoDimHoriz:
-	  if ((a0 & 1) == 0) {
-	    code1 = code2 = 0;
-	    do {
-	      code1 += code3 = getWhiteCode();
-	    } while (code3 >= 64);
-	    do {
-	      code2 += code3 = getBlackCode();
-	    } while (code3 >= 64);
-	  } else {
-	    code1 = code2 = 0;
-	    do {
-	      code1 += code3 = getBlackCode();
-	    } while (code3 >= 64);
-	    do {
-	      code2 += code3 = getWhiteCode();
-	    } while (code3 >= 64);
-	  }
-	  if (code1 > 0 || code2 > 0) {
-	    if (a0New + code1 <= columns) {
-	      codingLine[a0 + 1] = a0New + code1;
-	    } else {
-	      codingLine[a0 + 1] = columns;
-	    }
-	    ++a0;
-	    if (codingLine[a0] + code2 <= columns) {
-	      codingLine[a0 + 1] = codingLine[a0] + code2;
-	    } else {
-	      codingLine[a0 + 1] = columns;
-	    }
-	    ++a0;
-	    a0New = codingLine[a0];
-	    while (refLine[b1] <= a0New && refLine[b1] < columns) {
-	      b1 += 2;
-	    }
-	  }
-	  break;
-	case twoDimVert0:
-	  if (refLine[b1] < columns) {
-	    a0New = codingLine[++a0] = refLine[b1];
-	    ++b1;
-	    while (refLine[b1] <= a0New && refLine[b1] < columns) {
-	      b1 += 2;
-	    }
-	  } else {
-	    a0New = codingLine[++a0] = columns;
-	  }
-	  break;
-	case twoDimVertR1:
-	  if (refLine[b1] + 1 < columns) {
-	    a0New = codingLine[++a0] = refLine[b1] + 1;
-	    ++b1;
-	    while (refLine[b1] <= a0New && refLine[b1] < columns) {
-	      b1 += 2;
-	    }
-	  } else {
-	    a0New = codingLine[++a0] = columns;
-	  }
-	  break;
-	case twoDimVertL1:
-	  if (refLine[b1] - 1 > a0New || (a0 == 0 && refLine[b1] == 1)) {
-	    a0New = codingLine[++a0] = refLine[b1] - 1;
+	} else {
+	  addPixels(columns, blackPixels);
+	}
+	break;
+      case twoDimVertL1:
+      case twoDimVertL2:
+      case twoDimVertL3:
+	a1 = refLine[b1] - (code1 == twoDimVertL1 ? 1 :
+			    code1 == twoDimVertL2 ? 2 : 3);
+	// a change to the left of the current position is ignored
+	if (a1 > codingLine[a0] || (a1 == 0 && codingLine[a0] == 0)) {
+	  addPixels(a1, blackPixels);
+	  blackPixels ^= 1;
+	  if (b1 > 0) {
 	    --b1;
-	    while (refLine[b1] <= a0New && refLine[b1] < columns) {
-	      b1 += 2;
-	    }
-	  }
-	  break;
-	case twoDimVertR2:
-	  if (refLine[b1] + 2 < columns) {
-	    a0New = codingLine[++a0] = refLine[b1] + 2;
-	    ++b1;
-	    while (refLine[b1] <= a0New && refLine[b1] < columns) {
-	      b1 += 2;
-	    }
 	  } else {
-	    a0New = codingLine[++a0] = columns;
-	  }
-	  break;
-	case twoDimVertL2:
-	  if (refLine[b1] - 2 > a0New || (a0 == 0 && refLine[b1] == 2)) {
-	    a0New = codingLine[++a0] = refLine[b1] - 2;
-	    --b1;
-	    while (refLine[b1] <= a0New && refLine[b1] < columns) {
-	      b1 += 2;
-	    }
-	  }
-	  break;
-	case twoDimVertR3:
-	  if (refLine[b1] + 3 < columns) {
-	    a0New = codingLine[++a0] = refLine[b1] + 3;
 	    ++b1;
-	    while (refLine[b1] <= a0New && refLine[b1] < columns) {
-	      b1 += 2;
-	    }
-	  } else {
-	    a0New = codingLine[++a0] = columns;
 	  }
-	  break;
-	case twoDimVertL3:
-	  if (refLine[b1] - 3 > a0New || (a0 == 0 && refLine[b1] == 3)) {
-	    a0New = codingLine[++a0] = refLine[b1] - 3;
-	    --b1;
-	    while (refLine[b1] <= a0New && refLine[b1] < columns) {
-	      b1 += 2;
-	    }
+	  while (refLine[b1] <= a1 && refLine[b1] < columns) {
+	    b1 += 2;
 	  }
-	  break;
-	case EOF:
-	  eof = gTrue;
-	  codingLine[a0 = 0] = columns;
-	  return EOF;
-	default:
-	  error(getPos(), "Bad 2D code %04x in CCITTFax stream", code1);
-	  err = gTrue;
-	  break;
 	}
-      } while (codingLine[a0] < columns);
+	break;
+      case EOF:
+	eof = gTrue;
+	return gFalse;
+      default:
+	error(getPos(), "Bad 2D code %04x in CCITTFax stream", code1);
+	err = gTrue;
+	break;
+      }
+    } while (codingLine[a0] < columns);
 
-    // 1-D encoding
-    } else {
-      codingLine[a0 = 0] = 0;
-      while (1) {
-	code1 = 0;
+  // 1-D encoding
+  } else {
+    codingLine[a0 = 0] = 0;
+    blackPixels = 0;
+    do {
+      code1 = 0;
+      if (blackPixels) {
 	do {
-	  code1 += code3 = getWhiteCode();
+	  code1 += code3 = getBlackCode();
 	} while (code3 >= 64);
-	codingLine[a0+1] = codingLine[a0] + code1;
-	++a0;
-	if (codingLine[a0] >= columns) {
-	  break;
-	}
-	code2 = 0;
+      } else {
 	do {
-	  code2 += code3 = getBlackCode();
+	  code1 += code3 = getWhiteCode();
 	} while (code3 >= 64);
-	codingLine[a0+1] = codingLine[a0] + code2;
-	++a0;
-	if (codingLine[a0] >= columns) {
-	  break;
-	}
       }
-    }
-
-    if (codingLine[a0] != columns) {
-      error(getPos(), "CCITTFax row is wrong length (%d)", codingLine[a0]);
-      // force the row to be the correct length
-      while (codingLine[a0] > columns) {
-	--a0;
+      a1 = codingLine[a0] + code1;
+      if (a1 > columns) {
+	error(getPos(), "CCITTFax row is wrong length (%d)", a1);
+	err = gTrue;
       }
-      codingLine[++a0] = columns;
-      err = gTrue;
-    }
+      addPixels(a1, blackPixels);
+      blackPixels ^= 1;
+    } while (codingLine[a0] < columns);
+  }
 
-    // byte-align the row
-    if (byteAlign) {
-      inputBits &= ~7;
-    }
+  // byte-align the row
+  if (byteAlign) {
+    inputBits &= ~7;
+  }
 
-    // check for end-of-line marker, skipping over any extra zero bits
-    gotEOL = gFalse;
-    if (!endOfBlock && row == rows - 1) {
-      eof = gTrue;
-    } else {
+  // check for end-of-line marker, skipping over any extra zero bits
+  gotEOL = gFalse;
+  if (!endOfBlock && row == rows - 1) {
+    eof = gTrue;
+  } else {
+    code1 = lookBits(12);
+    while (code1 == 0) {
+      eatBits(1);
       code1 = lookBits(12);
-      while (code1 == 0) {
-	eatBits(1);
-	code1 = lookBits(12);
-      }
-      if (code1 == 0x001) {
-	eatBits(12);
-	gotEOL = gTrue;
-      } else if (code1 == EOF) {
-	eof = gTrue;
-      }
     }
-
-    // get 2D encoding tag
-    if (!eof && encoding > 0) {
-      nextLine2D = !lookBits(1);
-      eatBits(1);
+    if (code1 == 0x001) {
+      eatBits(12);
+      gotEOL = gTrue;
+    } else if (code1 == EOF) {
+      eof = gTrue;
     }
+  }
 
-    // check for end-of-block marker
-    if (endOfBlock && gotEOL) {
-      code1 = lookBits(12);
-      if (code1 == 0x001) {
-	eatBits(12);
-	if (encoding > 0) {
-	  lookBits(1);
-	  eatBits(1);
-	}
-	if (encoding >= 0) {
-	  for (i = 0; i < 4; ++i) {
-	    code1 = lookBits(12);
-	    if (code1 != 0x001) {
-	      error(getPos(), "Bad RTC code in CCITTFax stream");
-	    }
-	    eatBits(12);
-	    if (encoding > 0) {
-	      lookBits(1);
-	      eatBits(1);
-	    }
-	  }
-	}
-	eof = gTrue;
-      }
+  // get 2D encoding tag
+  if (!eof && encoding > 0) {
+    nextLine2D = !lookBits(1);
+    eatBits(1);
+  }
 
-    // look for an end-of-line marker after an error -- we only do
-    // this if we know the stream contains end-of-line markers because
-    // the "just plow on" technique tends to work better otherwise
-    } else if (err && endOfLine) {
-      do {
-	if (code1 == EOF) {
-	  eof = gTrue;
-	  return EOF;
-	}
-	eatBits(1);
-	code1 = lookBits(13);
-      } while ((code1 >> 1) != 0x001);
-      eatBits(12); 
+  // check for end-of-block marker
+  if (endOfBlock && gotEOL) {
+    code1 = lookBits(12);
+    if (code1 == 0x001) {
+      eatBits(12);
       if (encoding > 0) {
+	lookBits(1);
 	eatBits(1);
-	nextLine2D = !(code1 & 1);
       }
+      if (encoding >= 0) {
+	for (i = 0; i < 4; ++i) {
+	  code1 = lookBits(12);
+	  if (code1 != 0x001) {
+	    error(getPos(), "Bad RTC code in CCITTFax stream");
+	  }
+	  eatBits(12);
+	  if (encoding > 0) {
+	    lookBits(1);
+	    eatBits(1);
+	  }
+	}
+      }
+      eof = gTrue;
     }
 
-    a0 = 0;
-    outputBits = codingLine[1] - codingLine[0];
-    if (outputBits == 0) {
-      a0 = 1;
-      outputBits = codingLine[2] - codingLine[1];
+  // look for an end-of-line marker after an error -- we only do
+  // this if we know the stream contains end-of-line markers because
+  // the "just plow on" technique tends to work better otherwise
+  } else if (err && endOfLine) {
+    do {
+      if (code1 == EOF) {
+	eof = gTrue;
+	return gFalse;
+      }
+      eatBits(1);
+      code1 = lookBits(13);
+    } while ((code1 >> 1) != 0x001);
+    eatBits(12); 
+    if (encoding > 0) {
+      eatBits(1);
+      nextLine2D = !(code1 & 1);
     }
+  }
+
+  ++row;
+  return gTrue;
+}
 
-    ++row;
+// Set bits <x0> .. <x1>-1 of <p>.
+static inline void setBits(Guchar *p, int x0, int x1) {
+  int n;
+
+  if (x0 >= x1) {
+    return;
+  }
+  p += x0 >> 3;
+  if (x0 & 7) {
+    if ((x0 >> 3) == (x1 >> 3)) {
+      *p |= (0xff >> (x0 & 7)) & (0xff00 >> (x1 & 7));
+      return;
+    }
+    *p++ |= 0xff >> (x0 & 7);
+    x0 = (x0 | 7) + 1;
   }
+  n = (x1 - x0) >> 3;
+  while (n > 0) {
+    *p++ = 0xff;
+    --n;
+  }
+  if (x1 & 7) {
+    *p |= 0xff00 >> (x1 & 7);
+  }
+}
 
-  // get a byte
-  if (outputBits >= 8) {
-    ret = ((a0 & 1) == 0) ? 0xff : 0x00;
-    if ((outputBits -= 8) == 0) {
-      ++a0;
-      if (codingLine[a0] < columns) {
-	outputBits = codingLine[a0 + 1] - codingLine[a0];
-      }
+// Write the pixels of the row in codingLine to <p>.  White pixels are
+// 1 bits (0 bits if BlackIs1 is set), and the unused bits at the end
+// are padding, which is inverted along with the pixels.
+void CCITTFaxStream::writeRow(Guchar *p) {
+  int i;
+
+  memset(p, 0, rowSize);
+  if (black) {
+    for (i = 1; i <= a0; i += 2) {
+      setBits(p, codingLine[i - 1], codingLine[i]);
     }
+    setBits(p, columns, rowSize * 8);
   } else {
-    bits = 8;
-    ret = 0;
-    do {
-      if (outputBits > bits) {
-	i = bits;
-	bits = 0;
-	if ((a0 & 1) == 0) {
-	  ret |= 0xff >> (8 - i);
-	}
-	outputBits -= i;
-      } else {
-	i = outputBits;
-	bits -= outputBits;
-	if ((a0 & 1) == 0) {
-	  ret |= (0xff >> (8 - i)) << bits;
-	}
-	outputBits = 0;
-	++a0;
-	if (codingLine[a0] < columns) {
-	  outputBits = codingLine[a0 + 1] - codingLine[a0];
-	}
-      }
-    } while (bits > 0 && codingLine[a0] < columns);
+    setBits(p, 0, codingLine[0]);
+    for (i = 2; i <= a0; i += 2) {
+      setBits(p, codingLine[i - 1], codingLine[i]);
+    }
   }
-  buf = black ? (ret ^ 0xff) : ret;
-  return buf;
 }
 
+// The code readers look a code up in the bits which have been read so
+// far, padded with zeros, and read another byte only if that isn't
+// enough to tell which code it is -- so they never read past the byte
+// holding the end of the code.
+
 short CCITTFaxStream::getTwoDimCode() {
   short code;
   CCITTCode *p;
-  int n;
 
-  code = 0; // make gcc happy
-  if (endOfBlock) {
-    code = lookBits(7);
+  while (1) {
+    if (inputBits >= 7) {
+      code = (inputBuf >> (inputBits - 7)) & 0x7f;
+    } else {
+      code = (inputBuf << (7 - inputBits)) & 0x7f;
+    }
     p = &twoDimTab1[code];
-    if (p->bits > 0) {
+    if (p->bits > 0 && p->bits <= inputBits) {
       eatBits(p->bits);
       return p->n;
     }
-  } else {
-    for (n = 1; n <= 7; ++n) {
-      code = lookBits(n);
-      if (n < 7) {
-	code <<= 7 - n;
+    if (inputBits >= 7) {
+      break;
+    }
+    if (!readInputByte()) {
+      if (inputBits == 0) {
+	return EOF;
       }
-      p = &twoDimTab1[code];
-      if (p->bits == n) {
-	eatBits(n);
+      // the data may end in the middle of the code
+      if (p->bits > 0) {
+	eatBits(p->bits);
 	return p->n;
       }
+      break;
     }
   }
   error(getPos(), "Bad two dim code (%04x) in CCITTFax stream", code);
@@ -1664,42 +1932,35 @@ short CCITTFaxStream::getTwoDimCode() {
 short CCITTFaxStream::getWhiteCode() {
   short code;
   CCITTCode *p;
-  int n;
 
-  code = 0; // make gcc happy
-  if (endOfBlock) {
-    code = lookBits(12);
+  while (1) {
+    if (inputBits >= 12) {
+      code = (inputBuf >> (inputBits - 12)) & 0xfff;
+    } else {
+      code = (inputBuf << (12 - inputBits)) & 0xfff;
+    }
     if ((code >> 5) == 0) {
       p = &whiteTab1[code];
     } else {
       p = &whiteTab2[code >> 3];
     }
-    if (p->bits > 0) {
+    if (p->bits > 0 && p->bits <= inputBits) {
       eatBits(p->bits);
       return p->n;
     }
-  } else {
-    for (n = 1; n <= 9; ++n) {
-      code = lookBits(n);
-      if (n < 9) {
-	code <<= 9 - n;
-      }
-      p = &whiteTab2[code];
-      if (p->bits == n) {
-	eatBits(n);
-	return p->n;
-      }
+    if (inputBits >= 12) {
+      break;
     }
-    for (n = 11; n <= 12; ++n) {
-      code = lookBits(n);
-      if (n < 12) {
-	code <<= 12 - n;
+    if (!readInputByte()) {
+      if (inputBits == 0) {
+	return 1;
       }
-      p = &whiteTab1[code];
-      if (p->bits == n) {
-	eatBits(n);
+      // the data may end in the middle of the code
+      if (p->bits > 0) {
+	eatBits(p->bits);
 	return p->n;
       }
+      break;
     }
   }
   error(getPos(), "Bad white code (%04x) in CCITTFax stream", code);
@@ -1712,57 +1973,37 @@ short CCITTFaxStream::getWhiteCode() {
 short CCITTFaxStream::getBlackCode() {
   short code;
   CCITTCode *p;
-  int n;
 
-  code = 0; // make gcc happy
-  if (endOfBlock) {
-    code = lookBits(13);
+  while (1) {
+    if (inputBits >= 13) {
+      code = (inputBuf >> (inputBits - 13)) & 0x1fff;
+    } else {
+      code = (inputBuf << (13 - inputBits)) & 0x1fff;
+    }
     if ((code >> 7) == 0) {
       p = &blackTab1[code];
-    } else if ((code >> 9) == 0 && (code >> 7) != 0) {
+    } else if ((code >> 9) == 0) {
       p = &blackTab2[(code >> 1) - 64];
     } else {
       p = &blackTab3[code >> 7];
     }
-    if (p->bits > 0) {
+    if (p->bits > 0 && p->bits <= inputBits) {
       eatBits(p->bits);
       return p->n;
     }
-  } else {
-    for (n = 2; n <= 6; ++n) {
-      code = lookBits(n);
-      if (n < 6) {
-	code <<= 6 - n;
-      }
-      p = &blackTab3[code];
-      if (p->bits == n) {
-	eatBits(n);
-	return p->n;
-      }
-    }
-    for (n = 7; n <= 12; ++n) {
-      code = lookBits(n);
-      if (n < 12) {
-	code <<= 12 - n;
-      }
-      if (code >= 64) {
-	p = &blackTab2[code - 64];
-	if (p->bits == n) {
-	  eatBits(n);
-	  return p->n;
-	}
-      }
+    if (inputBits >= 13) {
+      break;
     }
-    for (n = 10; n <= 13; ++n) {
-      code = lookBits(n);
-      if (n < 13) {
-	code <<= 13 - n;
+    if (!readInputByte()) {
+      if (inputBits == 0) {
+	return 1;
       }
-      p = &blackTab1[code];
-      if (p->bits == n) {
-	eatBits(n);
+      // the data may end in the middle of the code
+      if (p->bits > 0) {
+	eatBits(p->bits);
 	return p->n;
       }
+      break;
     }
   }
   error(getPos(), "Bad black code (%04x) in CCITTFax stream", code);
@@ -1772,11 +2013,20 @@ short CCITTFaxStream::getBlackCode() {
   return 1;
 }
 
-short CCITTFaxStream::lookBits(int n) {
+GBool CCITTFaxStream::readInputByte() {
   int c;
 
+  if ((c = str->getChar()) == EOF) {
+    return gFalse;
+  }
+  inputBuf = (inputBuf << 8) | c;
+  inputBits += 8;
+  return gTrue;
+}
+
+short CCITTFaxStream::lookBits(int n) {
   while (inputBits < n) {
-    if ((c = str->getChar()) == EOF) {
+    if (!readInputByte()) {
       if (inputBits == 0) {
 	return EOF;
       }
@@ -1786,8 +2036,6 @@ short CCITTFaxStream::lookBits(int n) {
       // data in this case
       return (inputBuf << (n - inputBits)) & (0xffff >> (16 - n));
     }
-    inputBuf = (inputBuf << 8) + c;
-    inputBits += 8;
   }
   return (inputBuf >> (inputBits - n)) & (0xffff >> (16 - n));
 }
@@ -3998,6 +4246,39 @@ int FlateStream::getRawChar() {
   return c;
 }
 
+int FlateStream::getChars(int nChars, Guchar *buffer) {
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  return getRawChars(nChars, buffer);
+}
+
+int FlateStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    while (remain == 0) {
+      if (endOfBlock && eof)
+	return n;
+      readSome();
+    }
+    // copy up to the end of the window
+    m = flateWindow - index;
+    if (m > remain) {
+      m = remain;
+    }
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
+  }
+  return n;
+}
+
 GooString *FlateStream::getPSFilter(int psLevel, char *indent) {
   GooString *s;
 
@@ -4352,6 +4633,59 @@ EOFStream::~EOFStream() {
   delete str;
 }
 
+//------------------------------------------------------------------------
+// ProfileStream
+//------------------------------------------------------------------------
+
+ProfileStream::ProfileStream(Stream *strA, char *filterNameA):
+    FilterStream(strA) {
+  filterName = filterNameA;
+  bufPtr = bufEnd = buf;
+}
+
+ProfileStream::~ProfileStream() {
+  delete str;
+}
+
+void ProfileStream::reset() {
+  // some filters (JBIG2, JPX) decode everything here
+  ProfileTimer timer(profileStreamDecode);
+
+  str->reset();
+  timer.setFilter(filterName, 0);
+  bufPtr = bufEnd = buf;
+}
+
+int ProfileStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
+GBool ProfileStream::fillBuf() {
+  ProfileTimer timer(profileStreamDecode);
+  int n;
+
+  n = str->getChars(profileStreamBufSize, buf);
+  timer.setFilter(filterName, n);
+  bufPtr = buf;
+  bufEnd = buf + n;
+  return n > 0;
+}
+
 //------------------------------------------------------------------------
 // FixedLengthEncoder
 //------------------------------------------------------------------------
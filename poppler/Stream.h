@@ -87,9 +87,20 @@ public:
   // This is only used by StreamPredictor.
   virtual int getRawChar();
 
+  // Read up to <nChars> chars without using the predictor.  This is
+  // only used by StreamPredictor.  The default implementation calls
+  // getRawChar().
+  virtual int getRawChars(int nChars, Guchar *buffer);
+
   // Get next line from stream.
   virtual char *getLine(char *buf, int size);
 
+  // Read up to <nChars> chars from the stream into <buffer>.  Returns
+  // the number of chars read, which is less than <nChars> only at the
+  // end of the stream.  The default implementation calls getChar();
+  // streams which can copy whole blocks override it.
+  virtual int getChars(int nChars, Guchar *buffer);
+
   // Get current position in file.
   virtual int getPos() = 0;
 
@@ -245,6 +256,7 @@ public:
 
   int lookChar();
   int getChar();
+  int getChars(int nChars, Guchar *buffer);
 
 private:
 
@@ -259,6 +271,7 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   Guchar *predLine;		// line buffer
+  Guchar *prevLine;		// previous line
   int predIdx;			// current index in predLine
   GBool ok;
 };
@@ -284,6 +297,7 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual int getPos() { return bufPos + (bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
@@ -323,6 +337,7 @@ public:
     { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
   virtual int lookChar()
     { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual int getPos() { return (int)(bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
@@ -434,6 +449,8 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -448,12 +465,20 @@ private:
     int length;
     int head;
     Guchar tail;
+    int offset;			// position of the sequence in histBuf,
+				//   or -1 if it isn't there
   } table[4097];
   int nextCode;			// next code to be used
   int nextBits;			// number of bits in next code word
   int prevCode;			// previous code used in stream
   int newChar;			// next char to be added to table
-  Guchar seqBuf[4097];		// buffer for current sequence
+  Guchar *histBuf;		// sequences decoded since the last
+				//   table clear
+  int histSize;			// size of histBuf
+  int histLength;		// number of bytes used in histBuf
+  Guchar seqBuf[4097];		// buffer for current sequence, if it
+				//   doesn't fit in histBuf
+  Guchar *seq;			// current sequence (in histBuf or seqBuf)
   int seqLength;		// length of current sequence
   int seqIndex;			// index into current sequence
   GBool first;			// first code after a table clear
@@ -478,6 +503,7 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -489,6 +515,7 @@ private:
   GBool eof;
 
   GBool fillBuf();
+  int readRun(Guchar *p);
 };
 
 //------------------------------------------------------------------------
@@ -507,8 +534,10 @@ public:
   virtual StreamKind getKind() { return strCCITTFax; }
   virtual void reset();
   virtual int getChar()
-    { int c = lookChar(); buf = EOF; return c; }
-  virtual int lookChar();
+    { return (rowPtr >= rowEnd && !fillBuf()) ? EOF : *rowPtr++; }
+  virtual int lookChar()
+    { return (rowPtr >= rowEnd && !fillBuf()) ? EOF : *rowPtr; }
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -524,19 +553,25 @@ private:
   GBool eof;			// true if at eof
   GBool nextLine2D;		// true if next line uses 2D encoding
   int row;			// current row
-  int inputBuf;			// input buffer
+  Guint inputBuf;		// input buffer
   int inputBits;		// number of bits in input buffer
-  short *refLine;		// reference line changing elements
-  int b1;			// index into refLine
-  short *codingLine;		// coding line changing elements
-  int a0;			// index into codingLine
-  int outputBits;		// remaining ouput bits
-  int buf;			// character buffer
+  int *refLine;			// reference line: ends of the runs
+  int *codingLine;		// coding line: ends of the runs
+  int a0;			// index of the last run in codingLine
+  int rowSize;			// bytes per decoded row
+  Guchar *rowBuf;		// decoded row
+  Guchar *rowPtr;		// next unread byte in rowBuf
+  Guchar *rowEnd;		// end of rowBuf data
 
+  GBool fillBuf();
+  GBool readRow();
+  void writeRow(Guchar *p);
+  void addPixels(int a1, int blackPixels);
   short getTwoDimCode();
   short getWhiteCode();
   short getBlackCode();
   short lookBits(int n);
+  GBool readInputByte();
   void eatBits(int n) { if ((inputBits -= n) < 0) inputBits = 0; }
 };
 
@@ -687,6 +722,8 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -745,6 +782,44 @@ public:
   virtual GBool isBinary(GBool /*last = gTrue*/) { return gFalse; }
 };
 
+//------------------------------------------------------------------------
+// ProfileStream
+//------------------------------------------------------------------------
+
+#define profileStreamBufSize 4096
+
+// Inserted above each filter while a PageProfile is active.  Reads the
+// filter's output a block at a time, and records the time spent
+// decoding and the number of bytes produced, under the filter's name.
+class ProfileStream: public FilterStream {
+public:
+
+  ProfileStream(Stream *strA, char *filterNameA);
+  virtual ~ProfileStream();
+  virtual StreamKind getKind() { return strWeird; }
+  virtual void reset();
+  virtual int getChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
+  virtual int lookChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual GooString *getPSFilter(int psLevel, char *indent)
+    { return str->getPSFilter(psLevel, indent); }
+  virtual GBool isBinary(GBool last = gTrue) { return str->isBinary(last); }
+  virtual void getImageParams(int *bitsPerComponent,
+			      StreamColorSpaceMode *csMode)
+    { str->getImageParams(bitsPerComponent, csMode); }
+
+private:
+
+  GBool fillBuf();
+
+  char *filterName;
+  Guchar buf[profileStreamBufSize];
+  Guchar *bufPtr;
+  Guchar *bufEnd;
+};
+
 //------------------------------------------------------------------------
 // FixedLengthEncoder
 //------------------------------------------------------------------------
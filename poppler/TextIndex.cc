@@ -0,0 +1,576 @@
+//========================================================================
+//
+// TextIndex.cc
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "goo/GooList.h"
+#include "Object.h"
+#include "XRef.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "UnicodeTypeTable.h"
+#include "TextIndex.h"
+
+// Saved index files start with this, followed by the version.
+#define textIndexMagic "%PTI"
+#define textIndexVersion 1
+
+// Sizes of a saved line record (start, rot, bbox) and of a saved
+// character (code, left and right edges).
+#define textIndexLineSize 24
+#define textIndexCharSize 12
+
+//------------------------------------------------------------------------
+// TextIndexPage
+//------------------------------------------------------------------------
+
+struct TextIndexLine {
+  int start;			// index of the first char in the page text
+  int rot;			// text rotation
+  float xMin, yMin, xMax, yMax;	// bounding box
+};
+
+// The text of all lines of a page is stored in one array, with a zero
+// after each line, so matches can't run across lines.
+struct TextIndexPage {
+  GBool indexed;
+  int nChars;			// number of chars, including separators
+  Unicode *text;		// normalized text [nChars]
+  Unicode *folded;		// upper-cased <text> [nChars]
+  float *edges;			// near and far edge of each char
+				//   [2 * nChars]
+  int nLines;
+  TextIndexLine *lines;		// [nLines]
+};
+
+//------------------------------------------------------------------------
+// TextIndex
+//------------------------------------------------------------------------
+
+TextIndex::TextIndex(PDFDoc *docA) {
+  doc = docA;
+  nPages = doc->getNumPages();
+  nIndexed = 0;
+  pages = (TextIndexPage *)gmallocn(nPages + 1, sizeof(TextIndexPage));
+  memset(pages, 0, (nPages + 1) * sizeof(TextIndexPage));
+  docID = NULL;
+  makeDocID();
+}
+
+TextIndex::~TextIndex() {
+  int i;
+
+  for (i = 0; i < nPages; ++i) {
+    clearPage(&pages[i]);
+  }
+  gfree(pages);
+  delete docID;
+}
+
+void TextIndex::makeDocID() {
+  Object *trailer;
+  Object obj1, obj2;
+
+  // the file ID, plus a few counts which change when the file is
+  // updated
+  docID = GooString::format("{0:d} {1:d} ", nPages,
+			    doc->getXRef()->getNumObjects());
+  trailer = doc->getXRef()->getTrailerDict();
+  if (trailer->isDict()) {
+    trailer->dictLookup("ID", &obj1);
+    if (obj1.isArray() && obj1.arrayGetLength() > 0) {
+      if (obj1.arrayGet(0, &obj2)->isString()) {
+	docID->append(obj2.getString());
+      }
+      obj2.free();
+    }
+    obj1.free();
+  }
+}
+
+void TextIndex::clearPage(TextIndexPage *p) {
+  gfree(p->text);
+  gfree(p->folded);
+  gfree(p->edges);
+  gfree(p->lines);
+  memset(p, 0, sizeof(TextIndexPage));
+}
+
+GBool TextIndex::indexPage(int page) {
+  TextOutputDev *textOut;
+  TextPage *text;
+
+  if (page < 1 || page > nPages) {
+    return gFalse;
+  }
+  if (pages[page - 1].indexed) {
+    return gTrue;
+  }
+  textOut = new TextOutputDev(NULL, gFalse, gFalse, gFalse);
+  if (textOut->isOk()) {
+    doc->displayPage(textOut, page, 72, 72, 0, gFalse, gTrue, gFalse);
+    text = textOut->takeText();
+    addPage(page, text);
+    delete text;
+  }
+  delete textOut;
+  return gTrue;
+}
+
+void TextIndex::addPage(int page, TextPage *text) {
+  TextIndexPage *p;
+  TextBlock *blk;
+  TextLine *line;
+  TextIndexLine *l;
+  int n, nLines, i, j, k;
+
+  if (page < 1 || page > nPages) {
+    return;
+  }
+  p = &pages[page - 1];
+  if (p->indexed) {
+    clearPage(p);
+    --nIndexed;
+  }
+
+  // normalize the lines, and count them
+  n = nLines = 0;
+  for (i = 0; i < text->nBlocks; ++i) {
+    for (line = text->blocks[i]->lines; line; line = line->next) {
+      if (!line->normalized) {
+	line->normalized = unicodeNormalizeNFKC(line->text, line->len,
+						&line->normalized_len,
+						&line->normalized_idx);
+      }
+      n += line->normalized_len + 1;
+      ++nLines;
+    }
+  }
+
+  p->nChars = n;
+  p->text = (Unicode *)gmallocn(n, sizeof(Unicode));
+  p->folded = (Unicode *)gmallocn(n, sizeof(Unicode));
+  p->edges = (float *)gmallocn(2 * n, sizeof(float));
+  p->nLines = nLines;
+  p->lines = (TextIndexLine *)gmallocn(nLines, sizeof(TextIndexLine));
+
+  // copy the text, in the order used by TextPage::findText
+  n = nLines = 0;
+  for (i = 0; i < text->nBlocks; ++i) {
+    blk = text->blocks[i];
+    for (line = blk->lines; line; line = line->next) {
+      l = &p->lines[nLines++];
+      l->start = n;
+      l->rot = line->rot;
+      l->xMin = (float)line->xMin;
+      l->yMin = (float)line->yMin;
+      l->xMax = (float)line->xMax;
+      l->yMax = (float)line->yMax;
+      for (j = 0; j < line->normalized_len; ++j) {
+	k = line->normalized_idx[j];
+	p->text[n] = line->normalized[j];
+	p->folded[n] = unicodeToUpper(line->normalized[j]);
+	p->edges[2*n] = (float)line->edge[k];
+	p->edges[2*n + 1] = (float)line->edge[k + 1];
+	++n;
+      }
+      p->text[n] = p->folded[n] = 0;
+      p->edges[2*n] = p->edges[2*n + 1] = 0;
+      ++n;
+    }
+  }
+
+  p->indexed = gTrue;
+  ++nIndexed;
+}
+
+GBool TextIndex::indexPages(int maxPages,
+			    GBool (*abortCheckCbk)(void *data),
+			    void *abortCheckCbkData) {
+  TextOutputDev *textOut;
+  TextPage *text;
+  int page, n;
+
+  textOut = NULL;
+  n = 0;
+  for (page = 1; page <= nPages && nIndexed < nPages; ++page) {
+    if (pages[page - 1].indexed) {
+      continue;
+    }
+    if ((maxPages > 0 && n >= maxPages) ||
+	(abortCheckCbk && (*abortCheckCbk)(abortCheckCbkData))) {
+      break;
+    }
+    if (!textOut) {
+      textOut = new TextOutputDev(NULL, gFalse, gFalse, gFalse);
+      if (!textOut->isOk()) {
+	break;
+      }
+    }
+    doc->displayPage(textOut, page, 72, 72, 0, gFalse, gTrue, gFalse);
+    text = textOut->takeText();
+    addPage(page, text);
+    delete text;
+    ++n;
+  }
+  delete textOut;
+  return nIndexed == nPages;
+}
+
+GBool TextIndex::isPageIndexed(int page) {
+  return page >= 1 && page <= nPages && pages[page - 1].indexed;
+}
+
+GooList *TextIndex::find(Unicode *s, int len, GBool caseSensitive,
+			 int maxMatches) {
+  GooList *matches;
+  Unicode *s2;
+  int page;
+
+  matches = new GooList();
+  s2 = normalizeQuery(s, &len, caseSensitive);
+  if (len > 0) {
+    for (page = 1; page <= nPages; ++page) {
+      if (maxMatches > 0 && matches->getLength() >= maxMatches) {
+	break;
+      }
+      if (pages[page - 1].indexed) {
+	findInPage(page, s2, len, caseSensitive, matches, maxMatches);
+      }
+    }
+  }
+  gfree(s2);
+  return matches;
+}
+
+GooList *TextIndex::findOnPage(int page, Unicode *s, int len,
+			       GBool caseSensitive, int maxMatches) {
+  GooList *matches;
+  Unicode *s2;
+
+  matches = new GooList();
+  if (!indexPage(page)) {
+    return matches;
+  }
+  s2 = normalizeQuery(s, &len, caseSensitive);
+  if (len > 0) {
+    findInPage(page, s2, len, caseSensitive, matches, maxMatches);
+  }
+  gfree(s2);
+  return matches;
+}
+
+// Normalize the search string, and upper-case it for case-insensitive
+// searches.  Sets *<len> to 0 if the string can't match anything.
+Unicode *TextIndex::normalizeQuery(Unicode *s, int *len,
+				   GBool caseSensitive) {
+  Unicode *s2;
+  int i;
+
+  s2 = unicodeNormalizeNFKC(s, *len, len, NULL);
+  if (!caseSensitive) {
+    for (i = 0; i < *len; ++i) {
+      s2[i] = unicodeToUpper(s2[i]);
+    }
+  }
+  // zero is the line separator, so it can't be part of a match
+  for (i = 0; i < *len; ++i) {
+    if (!s2[i]) {
+      *len = 0;
+    }
+  }
+  return s2;
+}
+
+void TextIndex::findInPage(int page, Unicode *s, int len,
+			   GBool caseSensitive, GooList *matches,
+			   int maxMatches) {
+  TextIndexPage *p;
+  TextIndexLine *l;
+  TextIndexMatch *match;
+  Unicode *t;
+  Unicode c0;
+  float e0, e1;
+  int lineIdx, n, j, k;
+
+  p = &pages[page - 1];
+  t = caseSensitive ? p->text : p->folded;
+  n = p->nChars;
+  c0 = s[0];
+  lineIdx = 0;
+  for (j = 0; j + len <= n; ++j) {
+    if (t[j] != c0) {
+      if (!t[j]) {
+	++lineIdx;
+      }
+      continue;
+    }
+    for (k = 1; k < len && t[j + k] == s[k]; ++k) ;
+    if (k < len) {
+      continue;
+    }
+
+    // where the match starts or ends inside a compatibility
+    // decomposition, the entire glyph is included
+    l = &p->lines[lineIdx];
+    e0 = p->edges[2*j];
+    e1 = p->edges[2*(j + len - 1) + 1];
+    match = new TextIndexMatch;
+    match->page = page;
+    switch (l->rot) {
+    case 0:
+    default:
+      match->xMin = e0;
+      match->xMax = e1;
+      match->yMin = l->yMin;
+      match->yMax = l->yMax;
+      break;
+    case 1:
+      match->xMin = l->xMin;
+      match->xMax = l->xMax;
+      match->yMin = e0;
+      match->yMax = e1;
+      break;
+    case 2:
+      match->xMin = e1;
+      match->xMax = e0;
+      match->yMin = l->yMin;
+      match->yMax = l->yMax;
+      break;
+    case 3:
+      match->xMin = l->xMin;
+      match->xMax = l->xMax;
+      match->yMin = e1;
+      match->yMax = e0;
+      break;
+    }
+    matches->append(match);
+    if (maxMatches > 0 && matches->getLength() >= maxMatches) {
+      break;
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// saved indexes
+//------------------------------------------------------------------------
+
+// All values are written as 32-bit little-endian words.
+
+static void writeWord(FILE *f, Guint x) {
+  fputc(x & 0xff, f);
+  fputc((x >> 8) & 0xff, f);
+  fputc((x >> 16) & 0xff, f);
+  fputc((x >> 24) & 0xff, f);
+}
+
+static void writeFloat(FILE *f, float x) {
+  Guint w;
+
+  memcpy(&w, &x, 4);
+  writeWord(f, w);
+}
+
+static GBool readWord(FILE *f, Guint *x) {
+  Guchar buf[4];
+
+  if (fread(buf, 1, 4, f) != 4) {
+    return gFalse;
+  }
+  *x = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((Guint)buf[3] << 24);
+  return gTrue;
+}
+
+static GBool readInt(FILE *f, int *x) {
+  Guint w;
+
+  if (!readWord(f, &w)) {
+    return gFalse;
+  }
+  *x = (int)w;
+  return gTrue;
+}
+
+static GBool readFloat(FILE *f, float *x) {
+  Guint w;
+
+  if (!readWord(f, &w)) {
+    return gFalse;
+  }
+  memcpy(x, &w, 4);
+  return gTrue;
+}
+
+GBool TextIndex::save(char *fileName) {
+  FILE *f;
+  TextIndexPage *p;
+  TextIndexLine *l;
+  int page, i;
+  GBool ok;
+
+  if (!(f = fopen(fileName, "wb"))) {
+    return gFalse;
+  }
+  fwrite(textIndexMagic, 1, 4, f);
+  writeWord(f, textIndexVersion);
+  writeWord(f, docID->getLength());
+  fwrite(docID->getCString(), 1, docID->getLength(), f);
+  writeWord(f, nPages);
+  writeWord(f, nIndexed);
+  for (page = 1; page <= nPages; ++page) {
+    p = &pages[page - 1];
+    if (!p->indexed) {
+      continue;
+    }
+    writeWord(f, page);
+    writeWord(f, p->nLines);
+    writeWord(f, p->nChars);
+    for (i = 0; i < p->nLines; ++i) {
+      l = &p->lines[i];
+      writeWord(f, l->start);
+      writeWord(f, l->rot);
+      writeFloat(f, l->xMin);
+      writeFloat(f, l->yMin);
+      writeFloat(f, l->xMax);
+      writeFloat(f, l->yMax);
+    }
+    for (i = 0; i < p->nChars; ++i) {
+      writeWord(f, p->text[i]);
+      writeFloat(f, p->edges[2*i]);
+      writeFloat(f, p->edges[2*i + 1]);
+    }
+  }
+  ok = !ferror(f);
+  if (fclose(f)) {
+    ok = gFalse;
+  }
+  return ok;
+}
+
+GBool TextIndex::load(char *fileName) {
+  FILE *f;
+  TextIndexPage *newPages, *p;
+  TextIndexLine *l;
+  char magic[4];
+  char *id;
+  Guint c;
+  long fileLen, left;
+  int version, idLen, nPagesA, nIndexedA, page, i, j;
+  GBool ok;
+
+  if (!(f = fopen(fileName, "rb"))) {
+    return gFalse;
+  }
+  fseek(f, 0, SEEK_END);
+  fileLen = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  newPages = NULL;
+  nIndexedA = 0;
+  ok = gFalse;
+
+  // check that the index belongs to this document
+  if (fread(magic, 1, 4, f) != 4 || memcmp(magic, textIndexMagic, 4) ||
+      !readInt(f, &version) || version != textIndexVersion ||
+      !readInt(f, &idLen) || idLen != docID->getLength()) {
+    goto err;
+  }
+  id = (char *)gmalloc(idLen + 1);
+  if ((int)fread(id, 1, idLen, f) != idLen ||
+      memcmp(id, docID->getCString(), idLen)) {
+    gfree(id);
+    goto err;
+  }
+  gfree(id);
+  if (!readInt(f, &nPagesA) || nPagesA != nPages ||
+      !readInt(f, &nIndexedA) || nIndexedA < 0 || nIndexedA > nPages) {
+    goto err;
+  }
+
+  newPages = (TextIndexPage *)gmallocn(nPages + 1, sizeof(TextIndexPage));
+  memset(newPages, 0, (nPages + 1) * sizeof(TextIndexPage));
+  for (i = 0; i < nIndexedA; ++i) {
+    if (!readInt(f, &page) || page < 1 || page > nPages ||
+	newPages[page - 1].indexed) {
+      goto err;
+    }
+    p = &newPages[page - 1];
+    p->indexed = gTrue;
+    if (!readInt(f, &p->nLines) || p->nLines < 0 ||
+	!readInt(f, &p->nChars) || p->nChars < p->nLines) {
+      goto err;
+    }
+    // a corrupt index must not be able to request more memory than
+    // the rest of the file could fill
+    left = fileLen - ftell(f);
+    if (p->nLines > left / textIndexLineSize ||
+	p->nLines > INT_MAX / (int)sizeof(TextIndexLine)) {
+      goto err;
+    }
+    left -= (long)p->nLines * textIndexLineSize;
+    if (p->nChars > left / textIndexCharSize ||
+	p->nChars > INT_MAX / (2 * (int)sizeof(float))) {
+      goto err;
+    }
+    p->lines = (TextIndexLine *)gmallocn(p->nLines, sizeof(TextIndexLine));
+    p->text = (Unicode *)gmallocn(p->nChars, sizeof(Unicode));
+    p->folded = (Unicode *)gmallocn(p->nChars, sizeof(Unicode));
+    p->edges = (float *)gmallocn(2 * p->nChars, sizeof(float));
+    for (j = 0; j < p->nLines; ++j) {
+      l = &p->lines[j];
+      if (!readInt(f, &l->start) || !readInt(f, &l->rot) ||
+	  !readFloat(f, &l->xMin) || !readFloat(f, &l->yMin) ||
+	  !readFloat(f, &l->xMax) || !readFloat(f, &l->yMax)) {
+	goto err;
+      }
+    }
+    for (j = 0; j < p->nChars; ++j) {
+      if (!readWord(f, &c) ||
+	  !readFloat(f, &p->edges[2*j]) || !readFloat(f, &p->edges[2*j + 1])) {
+	goto err;
+      }
+      p->text[j] = c;
+      p->folded[j] = unicodeToUpper(c);
+    }
+    // there must be one separator per line, and the text must end
+    // with one
+    for (j = 0, c = 0; j < p->nChars; ++j) {
+      if (!p->text[j]) {
+	++c;
+      }
+    }
+    if ((int)c != p->nLines || (p->nChars > 0 && p->text[p->nChars - 1])) {
+      goto err;
+    }
+  }
+  ok = gTrue;
+
+  for (i = 0; i < nPages; ++i) {
+    clearPage(&pages[i]);
+  }
+  gfree(pages);
+  pages = newPages;
+  nIndexed = nIndexedA;
+  newPages = NULL;
+
+ err:
+  if (newPages) {
+    for (i = 0; i < nPages; ++i) {
+      clearPage(&newPages[i]);
+    }
+    gfree(newPages);
+  }
+  fclose(f);
+  return ok;
+}
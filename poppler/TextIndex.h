@@ -0,0 +1,120 @@
+//========================================================================
+//
+// TextIndex.h
+//
+// Full-text search index for a document.
+//
+//========================================================================
+
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stdio.h>
+#include "goo/gtypes.h"
+#include "CharTypes.h"
+
+class GooString;
+class GooList;
+class PDFDoc;
+class TextPage;
+struct TextIndexPage;
+
+//------------------------------------------------------------------------
+// TextIndexMatch
+//------------------------------------------------------------------------
+
+struct TextIndexMatch {
+  int page;			// page number (1-based)
+  double xMin, yMin,		// bounding box of the match, in the
+	 xMax, yMax;		//   coordinates used by TextPage (72 dpi,
+				//   upper-left origin, unrotated)
+};
+
+//------------------------------------------------------------------------
+// TextIndex
+//------------------------------------------------------------------------
+
+// The text of each page is extracted once, with TextOutputDev, and
+// kept in normalized (NFKC) form, along with the position of each
+// character.  Searches then only scan the index, instead of
+// re-interpreting the pages.  Pages can be indexed incrementally, and
+// the index can be saved to a file and loaded again later.
+//
+// Matches are found the same way as by TextPage::findText: within a
+// single line, after NFKC normalization, and optionally
+// case-insensitive.
+
+class TextIndex {
+public:
+
+  // Create an empty index for <docA>.
+  TextIndex(PDFDoc *docA);
+
+  ~TextIndex();
+
+  // Extract and index the text of page <page> (1-based), if it isn't
+  // already indexed.  Returns false if <page> is out of range.
+  GBool indexPage(int page);
+
+  // Index the text of an already extracted page.  <text> must have
+  // been produced by a TextOutputDev in reading order (rawOrder =
+  // false) at 72 dpi, with no rotation.  Only the normalized form of
+  // its lines is filled in.
+  void addPage(int page, TextPage *text);
+
+  // Index up to <maxPages> of the pages which aren't indexed yet (all
+  // of them if <maxPages> is 0).  Stops early if <abortCheckCbk>
+  // returns true.  Returns true if the whole document is indexed.
+  GBool indexPages(int maxPages = 0,
+		   GBool (*abortCheckCbk)(void *data) = NULL,
+		   void *abortCheckCbkData = NULL);
+
+  // Returns true if page <page> has been indexed.
+  GBool isPageIndexed(int page);
+
+  // Number of pages in the document / that have been indexed.
+  int getNumPages() { return nPages; }
+  int getNumIndexedPages() { return nIndexed; }
+
+  // Search the indexed pages for <s>.  Returns a list of
+  // TextIndexMatch, in page order and, within a page, in reading
+  // order.  At most <maxMatches> matches are returned, unless it is
+  // 0.  The caller must free the list with
+  // deleteGooList(list, TextIndexMatch).
+  GooList *find(Unicode *s, int len, GBool caseSensitive,
+		int maxMatches = 0);
+
+  // Same as find(), but only searches page <page>, which is indexed
+  // first if needed.
+  GooList *findOnPage(int page, Unicode *s, int len, GBool caseSensitive,
+		      int maxMatches = 0);
+
+  // Write the index to <fileName>.  Returns false on error.
+  GBool save(char *fileName);
+
+  // Load an index written by save().  Returns false (and leaves this
+  // index unchanged) if the file can't be read, or belongs to a
+  // different document.
+  GBool load(char *fileName);
+
+private:
+
+  void makeDocID();
+  void clearPage(TextIndexPage *p);
+  Unicode *normalizeQuery(Unicode *s, int *len, GBool caseSensitive);
+  void findInPage(int page, Unicode *s, int len, GBool caseSensitive,
+		  GooList *matches, int maxMatches);
+
+  PDFDoc *doc;
+  int nPages;
+  int nIndexed;
+  TextIndexPage *pages;		// [nPages]
+  GooString *docID;		// identifies the document in saved
+				//   indexes
+};
+
+#endif
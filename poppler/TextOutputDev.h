@@ -298,6 +298,7 @@ private:
   friend class TextSelectionPainter;
   friend class TextSelectionSizer;
   friend class TextSelectionDumper;
+  friend class TextIndex;
 };
 
 //------------------------------------------------------------------------
@@ -365,6 +366,7 @@ private:
   friend class TextWordList;
   friend class TextPage;
   friend class TextSelectionPainter;
+  friend class TextIndex;
 };
 
 //------------------------------------------------------------------------
@@ -586,6 +588,7 @@ private:
   friend class TextWordList;
   friend class TextSelectionPainter;
   friend class TextSelectionDumper;
+  friend class TextIndex;
 };
 
 //------------------------------------------------------------------------
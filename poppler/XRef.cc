@@ -16,7 +16,12 @@
 #include <stddef.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "goo/gmem.h"
+#include "goo/gfile.h"
+#include "goo/GooString.h"
+#include "GlobalParams.h"
 #include "Object.h"
 #include "Stream.h"
 #include "Lexer.h"
@@ -24,6 +29,7 @@
 #include "Dict.h"
 #include "Error.h"
 #include "ErrorCodes.h"
+#include "ProfileData.h"
 #include "XRef.h"
 
 //------------------------------------------------------------------------
@@ -31,6 +37,16 @@
 #define xrefSearchSize 1024	// read this many bytes at end of file
 				//   to look for 'startxref'
 
+#define constructBufSize 65536	// block size used when reconstructing
+				//   the xref table
+#define constructLineSize 256	// lines are split into chunks of this
+				//   size (incl. the terminating null)
+
+#define xrefCacheMagic "%PXC"	// reconstruction cache files start with
+#define xrefCacheVersion 1	//   this, followed by the version
+#define xrefCacheSample 65536	// bytes hashed at the beginning and end
+				//   of the file to identify it
+
 //------------------------------------------------------------------------
 // Permission bits
 // Note that the PDF spec uses 1 base (eg bit 3 is 1<<2)
@@ -208,12 +224,16 @@ XRef::XRef() {
   streamEnds = NULL;
   streamEndsLen = 0;
   objStr = NULL;
+  lastXRefPos = 0;
+  reconstructed = gFalse;
+  fileName = NULL;
 }
 
-XRef::XRef(BaseStream *strA) {
+XRef::XRef(BaseStream *strA, GooString *fileNameA) {
   Guint pos;
   Object obj;
 
+  fileName = fileNameA ? fileNameA->copy() : (GooString *)NULL;
   ok = gTrue;
   errCode = errNone;
   size = 0;
@@ -221,6 +241,8 @@ XRef::XRef(BaseStream *strA) {
   streamEnds = NULL;
   streamEndsLen = 0;
   objStr = NULL;
+  lastXRefPos = 0;
+  reconstructed = gFalse;
 
   encrypted = gFalse;
   permFlags = defPermFlags;
@@ -285,6 +307,9 @@ XRef::~XRef() {
   if (objStr) {
     delete objStr;
   }
+  if (fileName) {
+    delete fileName;
+  }
 }
 
 // Read the 'startxref' position.
@@ -675,8 +700,11 @@ GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
 GBool XRef::constructXRef() {
   Parser *parser;
   Object newTrailerDict, obj;
-  char buf[256];
-  Guint pos;
+  Guchar *buf;
+  char line[constructLineSize];
+  Guint bufStart, pos, trailerPos;
+  int bufLen, bufIdx, lineLen, next, n;
+  GBool eof;
   int num, gen;
   int newSize;
   int streamEndsSize;
@@ -687,28 +715,78 @@ GBool XRef::constructXRef() {
   gfree(entries);
   size = 0;
   entries = NULL;
+  reconstructed = gTrue;
 
   error(-1, "PDF file is damaged - attempting to reconstruct xref table...");
+  if (readXRefCache()) {
+    return gTrue;
+  }
   gotRoot = gFalse;
+  trailerPos = 0;
   streamEndsLen = streamEndsSize = 0;
 
+  // The file is read in large blocks, and split into lines the same
+  // way as Stream::getLine(buf, constructLineSize) does.  Only lines
+  // which can start with one of the interesting tokens are copied and
+  // parsed.
+  buf = (Guchar *)gmalloc(constructBufSize);
   str->reset();
+  bufStart = str->getPos();
+  bufLen = str->getChars(constructBufSize, buf);
+  eof = bufLen < constructBufSize;
+  bufIdx = 0;
   while (1) {
-    pos = str->getPos();
-    if (!str->getLine(buf, 256)) {
+
+    // keep a full line (plus the LF of a CR-LF) in the buffer
+    if (!eof && bufLen - bufIdx <= constructLineSize) {
+      memmove(buf, buf + bufIdx, bufLen - bufIdx);
+      bufStart += bufIdx;
+      bufLen -= bufIdx;
+      bufIdx = 0;
+      n = str->getChars(constructBufSize - bufLen, buf + bufLen);
+      bufLen += n;
+      eof = bufLen < constructBufSize;
+    }
+    if (bufIdx >= bufLen) {
       break;
     }
-    p = buf;
 
-    // skip whitespace
-    while (*p && Lexer::isSpace(*p & 0xff)) ++p;
+    // find the end of the line
+    pos = bufStart + bufIdx;
+    for (lineLen = 0;
+	 lineLen < constructLineSize - 1 && bufIdx + lineLen < bufLen &&
+	   buf[bufIdx + lineLen] != '\n' && buf[bufIdx + lineLen] != '\r';
+	 ++lineLen) ;
+    next = bufIdx + lineLen;
+    if (lineLen < constructLineSize - 1 && next < bufLen) {
+      if (buf[next] == '\r' && next + 1 < bufLen && buf[next + 1] == '\n') {
+	++next;
+      }
+      ++next;
+    }
+
+    // skip whitespace, and lines that can't contain anything useful
+    for (i = 0;
+	 i < lineLen && buf[bufIdx + i] && Lexer::isSpace(buf[bufIdx + i]);
+	 ++i) ;
+    if (i == lineLen ||
+	(buf[bufIdx + i] != 't' && buf[bufIdx + i] != 'e' &&
+	 !isdigit(buf[bufIdx + i]))) {
+      bufIdx = next;
+      continue;
+    }
+    memcpy(line, buf + bufIdx, lineLen);
+    line[lineLen] = '\0';
+    p = line + i;
+    bufIdx = next;
 
-    // got trailer dictionary
+    // got trailer dictionary (the lexer skips any whitespace between
+    // the keyword and the dictionary)
     if (!strncmp(p, "trailer", 7)) {
       obj.initNull();
       parser = new Parser(NULL,
 		 new Lexer(NULL,
-		   str->makeSubStream(pos + 7, gFalse, 0, &obj)),
+		   str->makeSubStream(pos + i + 7, gFalse, 0, &obj)),
 		 gFalse);
       parser->getObj(&newTrailerDict);
       if (newTrailerDict.isDict()) {
@@ -721,6 +799,7 @@ GBool XRef::constructXRef() {
 	  }
 	  newTrailerDict.copy(&trailerDict);
 	  gotRoot = gTrue;
+	  trailerPos = pos + i + 7;
 	}
 	obj.free();
       }
@@ -752,10 +831,12 @@ GBool XRef::constructXRef() {
 		  newSize = (num + 1 + 255) & ~255;
 		  if (newSize < 0) {
 		    error(-1, "Bad object number");
+		    gfree(buf);
 		    return gFalse;
 		  }
                   if (newSize*(int)sizeof(XRefEntry)/sizeof(XRefEntry) != newSize) {
                     error(-1, "Invalid 'obj' parameters.");
+		    gfree(buf);
                     return gFalse;
                   }
 		  entries = (XRefEntry *)
@@ -784,6 +865,7 @@ GBool XRef::constructXRef() {
 	streamEndsSize += 64;
         if (streamEndsSize*(int)sizeof(int)/sizeof(int) != streamEndsSize) {
           error(-1, "Invalid 'endstream' parameter.");
+	  gfree(buf);
           return gFalse;
         }
 	streamEnds = (Guint *)greallocn(streamEnds,
@@ -792,14 +874,248 @@ GBool XRef::constructXRef() {
       streamEnds[streamEndsLen++] = pos;
     }
   }
+  gfree(buf);
 
-  if (gotRoot)
+  if (gotRoot) {
+    writeXRefCache(trailerPos);
     return gTrue;
+  }
 
   error(-1, "Couldn't find trailer dictionary");
   return gFalse;
 }
 
+//------------------------------------------------------------------------
+// reconstruction cache
+//------------------------------------------------------------------------
+
+// Cache files are made of 32-bit little-endian words:
+//   magic, version, file size, mtime, hash,
+//   size, rootNum, rootGen, trailer position,
+//   nEntries, nEntries * (num, offset, gen),
+//   streamEndsLen, streamEndsLen * offset
+// Only the used (uncompressed) entries are stored, and the trailer
+// dictionary is parsed again from the file.
+
+static void writeCacheWord(FILE *f, Guint x) {
+  fputc(x & 0xff, f);
+  fputc((x >> 8) & 0xff, f);
+  fputc((x >> 16) & 0xff, f);
+  fputc((x >> 24) & 0xff, f);
+}
+
+static GBool readCacheWord(FILE *f, Guint *x) {
+  Guchar buf[4];
+
+  if (fread(buf, 1, 4, f) != 4) {
+    return gFalse;
+  }
+  *x = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((Guint)buf[3] << 24);
+  return gTrue;
+}
+
+// Returns the name of the cache file for this document, or NULL if
+// caching is disabled or the document isn't a file.  Also returns
+// the values identifying the file: its size, mtime, and a hash of its
+// size, mtime, and the bytes at its beginning and end.
+GooString *XRef::getXRefCacheName(Guint *fileSize, Guint *mtime,
+				  Guint *hash) {
+  GooString *dir, *name;
+  struct stat st;
+  Guchar *buf;
+  Guint h;
+  int n, i, j;
+
+  if (!fileName || !(dir = globalParams->getXRefCacheDir())) {
+    return NULL;
+  }
+  if (stat(fileName->getCString(), &st) < 0) {
+    delete dir;
+    return NULL;
+  }
+  *fileSize = (Guint)st.st_size;
+  *mtime = (Guint)st.st_mtime;
+
+  // FNV-1a
+  h = 2166136261U;
+  for (i = 0; i < 32; i += 8) {
+    h = (h ^ ((*fileSize >> i) & 0xff)) * 16777619U;
+    h = (h ^ ((*mtime >> i) & 0xff)) * 16777619U;
+  }
+  buf = (Guchar *)gmalloc(xrefCacheSample);
+  str->reset();
+  for (j = 0; j < 2; ++j) {
+    if (j) {
+      str->setPos(xrefCacheSample, -1);
+    }
+    n = str->getChars(xrefCacheSample, buf);
+    for (i = 0; i < n; ++i) {
+      h = (h ^ buf[i]) * 16777619U;
+    }
+  }
+  gfree(buf);
+  *hash = h;
+
+  name = GooString::format("{0:08ux}{1:08ux}.xref", *fileSize, h);
+  dir = appendToPath(dir, name->getCString());
+  delete name;
+  return dir;
+}
+
+GBool XRef::readXRefCache() {
+  GooString *name;
+  FILE *f;
+  Parser *parser;
+  Object obj, obj2;
+  char magic[4];
+  Guint fileSize, mtime, hash, x[3], trailerPos;
+  Guint sizeA, rootNumA, rootGenA, nEntries, nStreamEnds, i;
+  GBool res;
+
+  if (!(name = getXRefCacheName(&fileSize, &mtime, &hash))) {
+    return gFalse;
+  }
+  f = fopen(name->getCString(), "rb");
+  delete name;
+  if (!f) {
+    return gFalse;
+  }
+  res = gFalse;
+  if (fread(magic, 1, 4, f) != 4 || memcmp(magic, xrefCacheMagic, 4) ||
+      !readCacheWord(f, &x[0]) || x[0] != xrefCacheVersion ||
+      !readCacheWord(f, &x[0]) || x[0] != fileSize ||
+      !readCacheWord(f, &x[0]) || x[0] != mtime ||
+      !readCacheWord(f, &x[0]) || x[0] != hash ||
+      !readCacheWord(f, &sizeA) || sizeA > (1 << 28) ||
+      !readCacheWord(f, &rootNumA) || !readCacheWord(f, &rootGenA) ||
+      !readCacheWord(f, &trailerPos) || !readCacheWord(f, &nEntries) ||
+      nEntries > sizeA) {
+    goto err1;
+  }
+
+  entries = (XRefEntry *)gmallocn(sizeA, sizeof(XRefEntry));
+  for (i = 0; i < sizeA; ++i) {
+    entries[i].offset = 0xffffffff;
+    entries[i].gen = 0;
+    entries[i].type = xrefEntryFree;
+    entries[i].obj.initNull();
+  }
+  size = sizeA;
+  for (i = 0; i < nEntries; ++i) {
+    if (!readCacheWord(f, &x[0]) || x[0] >= sizeA ||
+	!readCacheWord(f, &x[1]) || !readCacheWord(f, &x[2])) {
+      goto err2;
+    }
+    entries[x[0]].offset = x[1];
+    entries[x[0]].gen = (int)x[2];
+    entries[x[0]].type = xrefEntryUncompressed;
+  }
+  if (!readCacheWord(f, &nStreamEnds) || nStreamEnds > fileSize) {
+    goto err2;
+  }
+  streamEnds = (Guint *)gmallocn(nStreamEnds ? nStreamEnds : 1,
+				 sizeof(Guint));
+  for (i = 0; i < nStreamEnds; ++i) {
+    if (!readCacheWord(f, &streamEnds[i])) {
+      goto err2;
+    }
+  }
+  streamEndsLen = (int)nStreamEnds;
+
+  // the trailer dictionary must still be there
+  obj.initNull();
+  obj2.initNull();
+  parser = new Parser(NULL,
+		      new Lexer(NULL,
+				str->makeSubStream(trailerPos, gFalse, 0, &obj)),
+		      gFalse);
+  parser->getObj(&obj);
+  delete parser;
+  if (obj.isDict() && obj.dictLookupNF("Root", &obj2)->isRef() &&
+      obj2.getRefNum() == (int)rootNumA && obj2.getRefGen() == (int)rootGenA) {
+    rootNum = rootNumA;
+    rootGen = rootGenA;
+    if (!trailerDict.isNone()) {
+      trailerDict.free();
+    }
+    obj.copy(&trailerDict);
+    res = gTrue;
+  }
+  obj2.free();
+  obj.free();
+  if (res) {
+    fclose(f);
+    return gTrue;
+  }
+
+ err2:
+  gfree(entries);
+  entries = NULL;
+  size = 0;
+  gfree(streamEnds);
+  streamEnds = NULL;
+  streamEndsLen = 0;
+ err1:
+  fclose(f);
+  return gFalse;
+}
+
+void XRef::writeXRefCache(Guint trailerPos) {
+  GooString *name, *tmpName;
+  FILE *f;
+  Guint fileSize, mtime, hash, n;
+  int i;
+  GBool res;
+
+  if (!(name = getXRefCacheName(&fileSize, &mtime, &hash))) {
+    return;
+  }
+
+  // write to a temporary file first, so other processes never see a
+  // partial cache file
+  tmpName = name->copy()->append(".tmp");
+  if (!(f = fopen(tmpName->getCString(), "wb"))) {
+    delete tmpName;
+    delete name;
+    return;
+  }
+  fwrite(xrefCacheMagic, 1, 4, f);
+  writeCacheWord(f, xrefCacheVersion);
+  writeCacheWord(f, fileSize);
+  writeCacheWord(f, mtime);
+  writeCacheWord(f, hash);
+  writeCacheWord(f, size);
+  writeCacheWord(f, rootNum);
+  writeCacheWord(f, rootGen);
+  writeCacheWord(f, trailerPos);
+  for (i = 0, n = 0; i < size; ++i) {
+    if (entries[i].type == xrefEntryUncompressed) {
+      ++n;
+    }
+  }
+  writeCacheWord(f, n);
+  for (i = 0; i < size; ++i) {
+    if (entries[i].type == xrefEntryUncompressed) {
+      writeCacheWord(f, i);
+      writeCacheWord(f, entries[i].offset);
+      writeCacheWord(f, entries[i].gen);
+    }
+  }
+  writeCacheWord(f, streamEndsLen);
+  for (i = 0; i < streamEndsLen; ++i) {
+    writeCacheWord(f, streamEnds[i]);
+  }
+  res = !ferror(f);
+  if (fclose(f)) {
+    res = gFalse;
+  }
+  if (!res || rename(tmpName->getCString(), name->getCString())) {
+    remove(tmpName->getCString());
+  }
+  delete tmpName;
+  delete name;
+}
+
 void XRef::setEncryption(int permFlagsA, GBool ownerPasswordOkA,
 			 Guchar *fileKeyA, int keyLengthA,
 			 int encVersionA, int encRevisionA,
@@ -865,6 +1181,8 @@ GBool XRef::okToAssemble(GBool ignoreOwnerPW) {
 }
 
 Object *XRef::fetch(int num, int gen, Object *obj) {
+  ProfileTimer timer(profileXRefFetch);
+  PageProfile *profile;
   XRefEntry *e;
   Parser *parser;
   Object obj1, obj2, obj3;
@@ -914,11 +1232,17 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
     if (gen != 0) {
       goto err;
     }
+    profile = PageProfile::getActive();
     if (!objStr || objStr->getObjStrNum() != (int)e->offset) {
       if (objStr) {
 	delete objStr;
       }
       objStr = new ObjectStream(this, e->offset);
+      if (profile) {
+	profile->count(profileObjStrCacheMiss);
+      }
+    } else if (profile) {
+      profile->count(profileObjStrCacheHit);
     }
     objStr->getObject(e->gen, num, obj);
     break;
@@ -1020,9 +1344,25 @@ void XRef::setModifiedObject (Object* o, Ref r) {
     error(-1,"XRef::setModifiedObject on unknown ref: %i, %i\n", r.num, r.gen);
     return;
   }
+  entries[r.num].obj.free();
   o->copy(&entries[r.num].obj);
 }
 
+Ref XRef::addIndirectObject(Object* o) {
+  Ref r;
+
+  entries = (XRefEntry *)greallocn(entries, size + 1, sizeof(XRefEntry));
+  r.num = size;
+  r.gen = 0;
+  entries[size].offset = 0;
+  entries[size].gen = 0;
+  entries[size].num = size;
+  entries[size].type = xrefEntryUncompressed;
+  o->copy(&entries[size].obj);
+  ++size;
+  return r;
+}
+
 //used to sort the entries
 int compare (const void* a, const void* b)
 {
@@ -17,6 +17,7 @@
 #include "Object.h"
 
 class Dict;
+class GooString;
 class Stream;
 class Parser;
 class ObjectStream;
@@ -44,8 +45,11 @@ public:
 
   // Constructor, create an empty XRef, used for PDF writing
   XRef();
-  // Constructor.  Read xref table from stream.
-  XRef(BaseStream *strA);
+  // Constructor.  Read xref table from stream.  If the xref table has
+  // to be reconstructed, and <fileNameA> is the name of the file
+  // <strA> reads from, the reconstructed table is cached in the
+  // directory set with GlobalParams::setXRefCacheDir.
+  XRef(BaseStream *strA, GooString *fileNameA = NULL);
 
   // Destructor.
   ~XRef();
@@ -91,6 +95,10 @@ public:
   // Return the offset of the last xref table.
   Guint getLastXRefPos() { return lastXRefPos; }
 
+  // Was the xref table rebuilt by scanning a damaged file?  If so,
+  // getLastXRefPos() does not point to a usable xref section.
+  GBool isReconstructed() { return reconstructed; }
+
   // Return the catalog object reference.
   int getRootNum() { return rootNum; }
   int getRootGen() { return rootGen; }
@@ -109,6 +117,11 @@ public:
 
   // Write access
   void setModifiedObject(Object* o, Ref r);
+  // Add <o> as a new indirect object, and return its reference.
+  Ref addIndirectObject(Object* o);
+  // Returns true if the object <num> was modified or added.
+  GBool isModifiedObject(int num)
+    { return num >= 0 && num < size && !entries[num].obj.isNull(); }
   void add(int num, int gen,  Guint offs, GBool used);
   void writeToFile(FILE* f);
 
@@ -124,6 +137,7 @@ private:
   int errCode;			// error code (if <ok> is false)
   Object trailerDict;		// trailer dictionary
   Guint lastXRefPos;		// offset of last xref table
+  GBool reconstructed;		// true if the xref table was rebuilt
   Guint *streamEnds;		// 'endstream' positions - only used in
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
@@ -136,6 +150,7 @@ private:
   int permFlags;		// permission bits
   Guchar fileKey[16];		// file decryption key
   GBool ownerPasswordOk;	// true if owner password is correct
+  GooString *fileName;		// file name, for the reconstruction cache
 
   Guint getStartXref();
   GBool readXRef(Guint *pos);
@@ -143,6 +158,9 @@ private:
   GBool readXRefStreamSection(Stream *xrefStr, int *w, int first, int n);
   GBool readXRefStream(Stream *xrefStr, Guint *pos);
   GBool constructXRef();
+  GooString *getXRefCacheName(Guint *fileSize, Guint *mtime, Guint *hash);
+  GBool readXRefCache();
+  void writeXRefCache(Guint trailerPos);
   Guint strToUnsigned(char *s);
 };
 
@@ -471,6 +471,9 @@ namespace Poppler {
         {
             delete m_doc->m_outputDev;
             m_doc->m_outputDev = NULL;
+#if defined(HAVE_SPLASH)
+            m_doc->resetSplashOutputDevs();
+#endif
         }
     }
 
@@ -484,6 +487,11 @@ namespace Poppler {
         return new PSConverter(m_doc);
     }
 
+    RenderContext *Document::renderContext() const
+    {
+        return new RenderContext(m_doc);
+    }
+
     QString Document::metadata() const
     {
         QString result;
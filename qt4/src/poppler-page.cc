@@ -170,7 +170,33 @@ Page::~Page()
   delete m_page;
 }
 
+#if defined(HAVE_SPLASH)
+/*
+  The size of the bitmap SplashOutputDev will allocate for this render:
+  the slice size, or else the crop box of the page, rotated and scaled
+  the way Gfx will set it up.
+*/
+static QSize splashBitmapSize(::Page *p, double xres, double yres, int rotation, int w, int h)
+{
+  if (w >= 0 && h >= 0)
+    return QSize(qMax(w, 1), qMax(h, 1));
+
+  int rotate = (rotation + p->getRotate()) % 360;
+  if (rotate < 0)
+    rotate += 360;
+  GfxState state(xres, yres, p->getCropBox(), rotate, gTrue);
+  int bw = (int)(state.getPageWidth() + 0.5);
+  int bh = (int)(state.getPageHeight() + 0.5);
+  return QSize(qMax(bw, 1), qMax(bh, 1));
+}
+#endif
+
 QImage Page::renderToImage(double xres, double yres, int x, int y, int w, int h, Rotation rotate) const
+{
+  return renderToImage(static_cast<RenderContext *>(0), xres, yres, x, y, w, h, rotate);
+}
+
+QImage Page::renderToImage(RenderContext *context, double xres, double yres, int x, int y, int w, int h, Rotation rotate) const
 {
   int rotation = (int)rotate * 90;
   QImage img;
@@ -179,16 +205,34 @@ QImage Page::renderToImage(double xres, double yres, int x, int y, int w, int h,
     case Poppler::Document::SplashBackend:
     {
 #if defined(HAVE_SPLASH)
-      SplashOutputDev *splash_output = static_cast<SplashOutputDev *>(m_page->parentDoc->m_doc->getOutputDev());
+      DocumentData *doc = m_page->parentDoc->m_doc;
+      // without a context of this document, take an output device
+      // for this render only
+      if (context && context->m_data->document != doc)
+        context = 0;
+      SplashOutputDev *splash_output = context ? context->m_data->splashOutputDev()
+                                               : doc->acquireSplashOutputDev();
+
+      // let splash render straight into the memory of the QImage; if
+      // the bitmap of the page turns out to have a different size,
+      // splash allocates its own one and it gets copied below
+      QSize size = splashBitmapSize(doc->doc->getCatalog()->getPage(m_page->index + 1),
+                                    xres, yres, rotation, w, h);
+      QImage tmpimg( size, QImage::Format_ARGB32 );
+      if ( !tmpimg.isNull() )
+      {
+        splash_output->setBitmap( new SplashBitmap( size.width(), size.height(), tmpimg.bytesPerLine(),
+                                                    splashModeXBGR8, gTrue, tmpimg.bits() ) );
+      }
 
-      m_page->parentDoc->m_doc->doc->displayPageSlice(splash_output, m_page->index + 1, xres, yres,
-						 rotation, false, true, false, x, y, w, h);
+      doc->doc->displayPageSlice(splash_output, m_page->index + 1, xres, yres,
+				 rotation, false, true, false, x, y, w, h);
 
-      SplashBitmap *bitmap = splash_output->getBitmap();
+      SplashBitmap *bitmap = splash_output->takeBitmap();
       int bw = bitmap->getWidth();
       int bh = bitmap->getHeight();
 
-      SplashColorPtr dataPtr = splash_output->getBitmap()->getDataPtr();
+      SplashColorPtr dataPtr = bitmap->getDataPtr();
 
       if (QSysInfo::BigEndian == QSysInfo::ByteOrder)
       {
@@ -206,11 +250,20 @@ QImage Page::renderToImage(double xres, double yres, int x, int y, int w, int h,
         }
       }
 
-      // construct a qimage SHARING the raw bitmap data in memory
-      QImage tmpimg( dataPtr, bw, bh, QImage::Format_ARGB32 );
-      img = tmpimg.copy();
+      if ( dataPtr == tmpimg.bits() )
+      {
+        img = tmpimg;
+      }
+      else
+      {
+        // construct a qimage SHARING the raw bitmap data in memory
+        QImage sharedimg( dataPtr, bw, bh, QImage::Format_ARGB32 );
+        img = sharedimg.copy();
+      }
       // unload underlying xpdf bitmap
-      splash_output->startPage( 0, NULL );
+      delete bitmap;
+      if (!context)
+        doc->releaseSplashOutputDev(splash_output);
 #endif
       break;
     }
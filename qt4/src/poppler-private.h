@@ -34,6 +34,8 @@
 #if defined(HAVE_SPLASH)
 #include <SplashOutputDev.h>
 #endif
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
 #include <QtCore/QVariant>
 
 class FormWidget;
@@ -122,6 +124,7 @@ namespace Poppler {
 		m_fontInfoScanner = 0;
 		m_backend = Document::SplashBackend;
 		m_outputDev = 0;
+		m_outputDevSerial = 0;
 		paperColor = Qt::white;
 		m_hints = 0;
 		// It might be more appropriate to delete these in PDFDoc
@@ -137,6 +140,9 @@ namespace Poppler {
 		delete doc;
 		qDeleteAll(m_embeddedFiles);
 		delete m_outputDev;
+#if defined(HAVE_SPLASH)
+		qDeleteAll(m_freeSplashOutputDevs);
+#endif
 		delete m_fontInfoScanner;
 		
 		count --;
@@ -154,15 +160,7 @@ namespace Poppler {
 			case Document::SplashBackend:
 			{
 #if defined(HAVE_SPLASH)
-			SplashColor bgColor;
-			bgColor[0] = paperColor.red();
-			bgColor[1] = paperColor.green();
-			bgColor[2] = paperColor.blue();
-			GBool AA = m_hints & Document::TextAntialiasing ? gTrue : gFalse;
-			SplashOutputDev * splashOutputDev = new SplashOutputDev(splashModeXBGR8, 4, gFalse, bgColor, gTrue, AA);
-			splashOutputDev->setVectorAntialias(m_hints & Document::Antialiasing ? gTrue : gFalse);
-			splashOutputDev->startDoc(doc->getXRef());
-			m_outputDev = splashOutputDev;
+			m_outputDev = createSplashOutputDev();
 #endif
 			break;
 			}
@@ -170,6 +168,63 @@ namespace Poppler {
 		}
 		return m_outputDev;
 	}
+
+#if defined(HAVE_SPLASH)
+	SplashOutputDev *createSplashOutputDev()
+	{
+		SplashColor bgColor;
+		bgColor[0] = paperColor.red();
+		bgColor[1] = paperColor.green();
+		bgColor[2] = paperColor.blue();
+		GBool AA = m_hints & Document::TextAntialiasing ? gTrue : gFalse;
+		SplashOutputDev * splashOutputDev = new SplashOutputDev(splashModeXBGR8, 4, gFalse, bgColor, gTrue, AA);
+		splashOutputDev->setVectorAntialias(m_hints & Document::Antialiasing ? gTrue : gFalse);
+		splashOutputDev->startDoc(doc->getXRef());
+		return splashOutputDev;
+	}
+
+	/*
+	  Render contexts: every page render takes a SplashOutputDev of its
+	  own, so renders of the same document never share a bitmap.  The
+	  output devices are kept around when a render is done, so their
+	  font caches are reused by the next one.
+	*/
+	SplashOutputDev *acquireSplashOutputDev()
+	{
+		QMutexLocker locker(&m_outputDevMutex);
+		SplashOutputDev *splashOutputDev;
+		if (m_freeSplashOutputDevs.isEmpty())
+			splashOutputDev = createSplashOutputDev();
+		else
+			splashOutputDev = m_freeSplashOutputDevs.takeLast();
+		m_busySplashOutputDevs.insert(splashOutputDev, m_outputDevSerial);
+		return splashOutputDev;
+	}
+
+	void releaseSplashOutputDev(SplashOutputDev *splashOutputDev)
+	{
+		QMutexLocker locker(&m_outputDevMutex);
+		// drop output devices created with outdated render settings
+		if (m_busySplashOutputDevs.take(splashOutputDev) == m_outputDevSerial)
+			m_freeSplashOutputDevs.append(splashOutputDev);
+		else
+			delete splashOutputDev;
+	}
+
+	bool isCurrentSplashOutputDev(SplashOutputDev *splashOutputDev)
+	{
+		QMutexLocker locker(&m_outputDevMutex);
+		return m_busySplashOutputDevs.value(splashOutputDev, -1) == m_outputDevSerial;
+	}
+
+	void resetSplashOutputDevs()
+	{
+		QMutexLocker locker(&m_outputDevMutex);
+		qDeleteAll(m_freeSplashOutputDevs);
+		m_freeSplashOutputDevs.clear();
+		++m_outputDevSerial;
+	}
+#endif
 	
 	void addTocChildren( QDomDocument * docSyn, QDomNode * parent, GooList * items )
 	{
@@ -237,6 +292,9 @@ namespace Poppler {
 			return;
 
 		paperColor = color;
+#if defined(HAVE_SPLASH)
+		resetSplashOutputDevs();
+#endif
 		if ( m_outputDev == NULL )
 			return;
 
@@ -278,12 +336,61 @@ namespace Poppler {
 	FontInfoScanner *m_fontInfoScanner;
 	Document::RenderBackend m_backend;
 	OutputDev *m_outputDev;
+#if defined(HAVE_SPLASH)
+	QList<SplashOutputDev*> m_freeSplashOutputDevs;
+	QHash<SplashOutputDev*, int> m_busySplashOutputDevs;
+#endif
+	QMutex m_outputDevMutex;
+	int m_outputDevSerial;
 	QList<EmbeddedFile*> m_embeddedFiles;
 	QColor paperColor;
 	int m_hints;
 	static int count;
     };
 
+    class RenderContextData
+    {
+	public:
+	RenderContextData(DocumentData *documentA)
+	{
+		document = documentA;
+#if defined(HAVE_SPLASH)
+		m_splashOutputDev = 0;
+#endif
+	}
+
+	~RenderContextData()
+	{
+#if defined(HAVE_SPLASH)
+		if (m_splashOutputDev)
+			document->releaseSplashOutputDev(m_splashOutputDev);
+#endif
+	}
+
+#if defined(HAVE_SPLASH)
+	/*
+	  The output device of the context, taken from the pool of the
+	  document; it is replaced when the render settings have changed.
+	*/
+	SplashOutputDev *splashOutputDev()
+	{
+		if (m_splashOutputDev && !document->isCurrentSplashOutputDev(m_splashOutputDev))
+		{
+			document->releaseSplashOutputDev(m_splashOutputDev);
+			m_splashOutputDev = 0;
+		}
+		if (!m_splashOutputDev)
+			m_splashOutputDev = document->acquireSplashOutputDev();
+		return m_splashOutputDev;
+	}
+#endif
+
+	DocumentData *document;
+#if defined(HAVE_SPLASH)
+	SplashOutputDev *m_splashOutputDev;
+#endif
+    };
+
     class FontInfoData
     {
 	public:
@@ -49,6 +49,8 @@ namespace Poppler {
 
     class PSConverter;
 
+    class RenderContext;
+
     /**
         Describes the physical location of text on a document page
        
@@ -315,6 +317,24 @@ namespace Poppler {
         */
 	QImage renderToImage(double xres=72.0, double yres=72.0, int x=-1, int y=-1, int w=-1, int h=-1, Rotation rotate = Rotate0) const;
 
+	/**
+	   Render the page to a QImage like renderToImage() above, using
+	   the given render \p context of the document.
+
+	   Renders through the same context reuse its output device and
+	   font caches. Each thread rendering pages of a document should
+	   use a context of its own; a context must not be used by two
+	   renders at the same time.
+
+	   \param context a render context created by Document::renderContext()
+	   of the document of this page. If it is \c 0, or was created by
+	   another document, this is the same as renderToImage() above.
+
+	   \note the context is only used by the \ref Document::SplashBackend
+	   "Splash" backend.
+        */
+	QImage renderToImage(RenderContext *context, double xres=72.0, double yres=72.0, int x=-1, int y=-1, int w=-1, int h=-1, Rotation rotate = Rotate0) const;
+
 	/**
 	   Returns the text that is inside a specified rectangle
 
@@ -803,6 +823,15 @@ QString subject = m_doc->info("Subject");
 	  The caller gets the ownership of the returned converter.
 	 */
 	PSConverter *psConverter() const;
+
+	/**
+	  Gets a new render context for this document, to be passed to
+	  Page::renderToImage().
+
+	  The caller gets the ownership of the returned context, which
+	  must be deleted before the document.
+	 */
+	RenderContext *renderContext() const;
 	
 	/**
 	  Gets the metadata stream contents
@@ -938,6 +967,35 @@ height = dummy.height();
     */
     QDateTime convertDate( char *dateString );
 
+    class RenderContextData;
+    /**
+       Context for rendering pages of a Document
+
+       A render context keeps the output device used to render pages
+       between calls of Page::renderToImage(), so that its font caches
+       are reused. Renders through different contexts don't share any
+       output device, so they can be run from different threads.
+
+       Changing the paper color or the render hints of the document
+       takes effect on the next render through the context.
+    */
+    class RenderContext
+    {
+        friend class Document;
+        friend class Page;
+        public:
+            /**
+              Destructor.
+            */
+            ~RenderContext();
+
+        private:
+            Q_DISABLE_COPY(RenderContext)
+
+            RenderContext(DocumentData *document);
+            RenderContextData *m_data;
+    };
+
     class SoundData;
     /**
        Container class for a sound file in a PDF document.
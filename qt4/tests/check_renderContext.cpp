@@ -0,0 +1,82 @@
+#include <QtTest/QtTest>
+
+#include <poppler-qt4.h>
+
+class TestRenderContext: public QObject
+{
+    Q_OBJECT
+private slots:
+    void checkRender();
+    void checkPaperColor();
+    void checkOtherDocument();
+};
+
+void TestRenderContext::checkRender()
+{
+    Poppler::Document *doc;
+    doc = Poppler::Document::load("../../../test/unittestcases/UseNone.pdf");
+    QVERIFY( doc );
+
+    Poppler::Page *page = doc->page(0);
+    QVERIFY( page );
+    Poppler::RenderContext *context = doc->renderContext();
+    QVERIFY( context );
+
+    QImage image = page->renderToImage(100.0, 100.0);
+    QVERIFY( !image.isNull() );
+    // the second render reuses the output device of the context
+    QCOMPARE( page->renderToImage(context, 100.0, 100.0), image );
+    QCOMPARE( page->renderToImage(context, 100.0, 100.0), image );
+    QCOMPARE( page->renderToImage(context, 100.0, 100.0, 10, 20, 30, 40),
+              page->renderToImage(100.0, 100.0, 10, 20, 30, 40) );
+
+    delete context;
+    delete page;
+    delete doc;
+}
+
+void TestRenderContext::checkPaperColor()
+{
+    Poppler::Document *doc;
+    doc = Poppler::Document::load("../../../test/unittestcases/UseNone.pdf");
+    QVERIFY( doc );
+
+    Poppler::Page *page = doc->page(0);
+    QVERIFY( page );
+    Poppler::RenderContext *context = doc->renderContext();
+
+    QImage white = page->renderToImage(context, 50.0, 50.0, 0, 0, 1, 1);
+    doc->setPaperColor(Qt::red);
+    QImage red = page->renderToImage(context, 50.0, 50.0, 0, 0, 1, 1);
+    QCOMPARE( red, page->renderToImage(50.0, 50.0, 0, 0, 1, 1) );
+    QVERIFY( red != white );
+
+    delete context;
+    delete page;
+    delete doc;
+}
+
+void TestRenderContext::checkOtherDocument()
+{
+    Poppler::Document *doc, *doc2;
+    doc = Poppler::Document::load("../../../test/unittestcases/UseNone.pdf");
+    QVERIFY( doc );
+    doc2 = Poppler::Document::load("../../../test/unittestcases/UseNone.pdf");
+    QVERIFY( doc2 );
+
+    Poppler::Page *page = doc->page(0);
+    QVERIFY( page );
+    Poppler::RenderContext *context = doc2->renderContext();
+
+    // a context of another document is ignored
+    QCOMPARE( page->renderToImage(context, 50.0, 50.0),
+              page->renderToImage(50.0, 50.0) );
+
+    delete context;
+    delete page;
+    delete doc2;
+    delete doc;
+}
+
+QTEST_MAIN(TestRenderContext)
+#include "check_renderContext.moc"
@@ -20,6 +20,7 @@
 #include "SplashPath.h"
 #include "SplashXPath.h"
 #include "SplashXPathScanner.h"
+#include "SplashXPathCache.h"
 #include "SplashPattern.h"
 #include "SplashScreen.h"
 #include "SplashFont.h"
@@ -704,6 +705,21 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
 			     GBool noClip) {
   int x;
 
+  // opaque solid span in a 1-bit bitmap: halftone it straight into
+  // the packed row
+  if (noClip && bitmap->mode == splashModeMono1 && !pipe->pattern &&
+      pipe->noTransparency && !state->blendFunc) {
+    state->screen->testSpan(x0, y, x1 - x0 + 1, pipe->cSrc, 0,
+			    &bitmap->data[y * bitmap->rowSize]);
+    if (bitmap->alpha) {
+      memset(&bitmap->alpha[y * bitmap->width + x0], 0xff, x1 - x0 + 1);
+    }
+    updateModX(x0);
+    updateModX(x1);
+    updateModY(y);
+    return;
+  }
+
   pipeSetXY(pipe, x0, y);
   if (noClip) {
     for (x = x0; x <= x1; ++x) {
@@ -814,6 +830,7 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   } else {
     aaBuf = NULL;
   }
+  xPathCache = NULL;
   clearModRegion();
   debugMode = gFalse;
 }
@@ -837,6 +854,7 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   } else {
     aaBuf = NULL;
   }
+  xPathCache = NULL;
   clearModRegion();
   debugMode = gFalse;
 }
@@ -849,6 +867,9 @@ Splash::~Splash() {
   if (vectorAntialias) {
     delete aaBuf;
   }
+  if (xPathCache) {
+    delete xPathCache;
+  }
 }
 
 //------------------------------------------------------------------------
@@ -1006,6 +1027,10 @@ SplashError Splash::clipToPath(SplashPath *path, GBool eo) {
   return state->clip->clipToPath(path, state->matrix, state->flatness, eo);
 }
 
+void Splash::setClipMaskThreshold(int threshold) {
+  state->clip->setMaskThreshold(threshold);
+}
+
 void Splash::setSoftMask(SplashBitmap *softMask) {
   state->setSoftMask(softMask);
 }
@@ -1182,14 +1207,15 @@ SplashError Splash::stroke(SplashPath *path) {
     return splashErrEmptyPath;
   }
   path2 = flattenPath(path, state->matrix, state->flatness);
-  if (state->lineDashLength > 0) {
-    dPath = makeDashedPath(path2);
-    SplashPath::destroy(path2);
-    path2 = dPath;
-  }
   if (state->lineWidth == 0) {
+    if (state->lineDashLength > 0) {
+      dPath = makeDashedPath(path2);
+      SplashPath::destroy(path2);
+      path2 = dPath;
+    }
     strokeNarrow(path2);
   } else {
+    // strokeWide handles the line dash itself
     strokeWide(path2);
   }
   SplashPath::destroy(path2);
@@ -1545,11 +1571,25 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
   if (path->length == 0) {
     return splashErrEmptyPath;
   }
-  xPath = new SplashXPath(path, state->matrix, state->flatness, gTrue);
-  if (vectorAntialias) {
-    xPath->aaScale();
+  // small paths go through the cache, so that repeated shapes are
+  // only flattened and sorted once (the cached paths are expanded
+  // without the translation, whether or not they are found, so the
+  // result doesn't depend on the cache contents)
+  if (SplashXPathCache::isCacheable(path)) {
+    if (!xPathCache) {
+      xPathCache = new SplashXPathCache();
+    }
+    xPath = xPathCache->getXPath(path, state->matrix, state->flatness);
+    if (vectorAntialias) {
+      xPath->aaScale();
+    }
+  } else {
+    xPath = new SplashXPath(path, state->matrix, state->flatness, gTrue);
+    if (vectorAntialias) {
+      xPath->aaScale();
+    }
+    xPath->sort();
   }
-  xPath->sort();
   scanner = new SplashXPathScanner(xPath, eo);
 
   // get the min and max x and y values
@@ -1712,8 +1752,9 @@ SplashError Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph) {
   SplashClipResult clipRes;
   GBool noClip;
   int alpha0, alpha;
-  Guchar *p;
-  int x1, y1, xx, xx1, yy;
+  Guchar *p, *d;
+  Guchar fill, lastMask, m0, m1;
+  int x1, y1, xx, xx1, yy, sh, rowBytes;
 
   if ((clipRes = state->clip->testRect(x0 - glyph->x,
 				       y0 - glyph->y,
@@ -1745,19 +1786,53 @@ SplashError Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph) {
 	pipeInit(&pipe, x0 - glyph->x, y0 - glyph->y,
 		 state->fillPattern, NULL, state->fillAlpha, gFalse, gFalse);
 	p = glyph->data;
-	for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
-	  pipeSetXY(&pipe, x0 - glyph->x, y1);
-	  for (xx = 0, x1 = x0 - glyph->x; xx < glyph->w; xx += 8) {
-	    alpha0 = *p++;
-	    for (xx1 = 0; xx1 < 8 && xx + xx1 < glyph->w; ++xx1, ++x1) {
-	      if (alpha0 & 0x80) {
-		pipeRun(&pipe);
-		updateModX(x1);
-		updateModY(y1);
-	      } else {
-		pipeIncX(&pipe);
+
+	// opaque solid black or white glyph in a 1-bit bitmap: merge
+	// the glyph bitmap into the destination a byte at a time
+	if (bitmap->mode == splashModeMono1 && !pipe.pattern &&
+	    pipe.noTransparency && !state->blendFunc && !bitmap->alpha &&
+	    state->screen->isStatic(pipe.cSrc[0])) {
+	  fill = state->screen->test(0, 0, pipe.cSrc[0]) ? 0xff : 0x00;
+	  x1 = x0 - glyph->x;
+	  sh = x1 & 7;
+	  rowBytes = (glyph->w + 7) >> 3;
+	  lastMask = (glyph->w & 7) ? (0xff00 >> (glyph->w & 7)) : 0xff;
+	  for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
+	    d = &bitmap->data[y1 * bitmap->rowSize + (x1 >> 3)];
+	    for (xx = 0; xx < rowBytes; ++xx, ++d) {
+	      alpha0 = *p++;
+	      if (xx == rowBytes - 1) {
+		alpha0 &= lastMask;
+	      }
+	      if (alpha0) {
+		m0 = alpha0 >> sh;
+		m1 = alpha0 << (8 - sh);
+		d[0] = (d[0] & ~m0) | (fill & m0);
+		if (m1) {
+		  d[1] = (d[1] & ~m1) | (fill & m1);
+		}
+	      }
+	    }
+	  }
+	  updateModX(x1);
+	  updateModX(x1 + glyph->w - 1);
+	  updateModY(y0 - glyph->y);
+	  updateModY(y0 - glyph->y + glyph->h - 1);
+	} else {
+	  for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
+	    pipeSetXY(&pipe, x0 - glyph->x, y1);
+	    for (xx = 0, x1 = x0 - glyph->x; xx < glyph->w; xx += 8) {
+	      alpha0 = *p++;
+	      for (xx1 = 0; xx1 < 8 && xx + xx1 < glyph->w; ++xx1, ++x1) {
+		if (alpha0 & 0x80) {
+		  pipeRun(&pipe);
+		  updateModX(x1);
+		  updateModY(y1);
+		} else {
+		  pipeIncX(&pipe);
+		}
+		alpha0 <<= 1;
 	      }
-	      alpha0 <<= 1;
 	    }
 	  }
 	}
@@ -1834,6 +1909,9 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
   int k1, spanXMin, spanXMax, spanY;
   SplashColorPtr pixBuf, p;
   int pixAcc;
+  GBool mono1, rowMono1, rowPainted;
+  SplashColorPtr maskRow, colorRow, d;
+  int monoX0, monoX1;
   int x, y, x1, x2, y2;
   SplashCoord y1;
   int n, m, i, j;
@@ -1972,6 +2050,30 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
     drawAAPixelInit();
   }
 
+  // opaque solid fills of upright masks into 1-bit bitmaps: fully
+  // covered pixels are collected in a packed row and merged into the
+  // bitmap a byte at a time; partially covered pixels still go
+  // through the pipe
+  mono1 = bitmap->mode == splashModeMono1 && !rot &&
+          xShear == 0 && yShear == 0 && !pipe.pattern &&
+          state->fillAlpha == 1 && !state->softMask &&
+          !state->blendFunc && !state->inNonIsolatedGroup &&
+          !bitmap->alpha;
+  if (mono1) {
+    if (xSign > 0) {
+      monoX0 = tx;
+    } else {
+      monoX0 = tx - (scaledWidth - 1);
+    }
+    monoX1 = monoX0 + (scaledWidth - 1);
+    maskRow = (SplashColorPtr)gmalloc(bitmap->rowSize);
+    colorRow = (SplashColorPtr)gmalloc(bitmap->rowSize);
+    memset(colorRow, 0, bitmap->rowSize);
+  } else {
+    monoX0 = monoX1 = 0;
+    maskRow = colorRow = NULL;
+  }
+
   // init y scale Bresenham
   yt = 0;
   lastYStep = 1;
@@ -2020,6 +2122,11 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
     } else {
       clipRes2 = clipRes;
     }
+    rowMono1 = mono1 && clipRes2 == splashClipAllInside;
+    if (rowMono1) {
+      memset(maskRow + (monoX0 >> 3), 0, (monoX1 >> 3) - (monoX0 >> 3) + 1);
+    }
+    rowPainted = gFalse;
 
     // init x scale Bresenham
     xt = 0;
@@ -2040,7 +2147,48 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
     // loop-invariant constants
     n = yStep > 0 ? yStep : 1;
 
-    for (x = 0; x < scaledWidth; ++x) {
+    // upright row in a 1-bit bitmap: pixel x lands at tx + xSign * x,
+    // with no shear, rotation, or clipping to deal with
+    if (rowMono1) {
+      for (x = 0; x < scaledWidth; ++x) {
+	xStep = xp;
+	xt += xq;
+	if (xt >= scaledWidth) {
+	  xt -= scaledWidth;
+	  ++xStep;
+	}
+	if (n == 1 && xStep <= 1) {
+	  m = 1;
+	  pixAcc = pixBuf[xSrc];
+	} else {
+	  m = xStep > 0 ? xStep : 1;
+	  p = pixBuf + xSrc;
+	  pixAcc = 0;
+	  for (i = 0; i < n; ++i) {
+	    for (j = 0; j < m; ++j) {
+	      pixAcc += *p++;
+	    }
+	    p += w - m;
+	  }
+	}
+	if (pixAcc != 0) {
+	  x2 = tx + xSign * x;
+	  if (pixAcc == n * m) {
+	    maskRow[x2 >> 3] |= 0x80 >> (x2 & 7);
+	    rowPainted = gTrue;
+	  } else {
+	    pipe.shape = (SplashCoord)pixAcc / (SplashCoord)(n * m);
+	    drawPixel(&pipe, x2, ty + ySign * y, gTrue);
+	  }
+	}
+	xSrc += xStep;
+      }
+      x = scaledWidth;
+    } else {
+      x = 0;
+    }
+
+    for (; x < scaledWidth; ++x) {
 
       // x scale Bresenham
       xStep = xp;
@@ -2092,10 +2240,26 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
       // y shear
       y1 += yShear1;
     }
+
+    // merge the fully covered pixels into the bitmap
+    if (rowPainted) {
+      y2 = ty + ySign * y;
+      state->screen->testSpan(monoX0, y2, scaledWidth, pipe.cSrc, 0,
+			      colorRow);
+      d = &bitmap->data[y2 * bitmap->rowSize];
+      for (i = monoX0 >> 3; i <= monoX1 >> 3; ++i) {
+	d[i] = (d[i] & ~maskRow[i]) | (colorRow[i] & maskRow[i]);
+      }
+      updateModX(monoX0);
+      updateModX(monoX1);
+      updateModY(y2);
+    }
   }
 
   // free memory
   gfree(pixBuf);
+  gfree(maskRow);
+  gfree(colorRow);
 
   return splashOk;
 }
@@ -2256,6 +2420,16 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
     return splashOk;
   }
 
+  // axis-aligned images (e.g., scanned pages) are resampled a row at
+  // a time
+  if (mat[1] == 0 && mat[2] == 0 &&
+      !(vectorAntialias && clipRes != splashClipAllInside)) {
+    drawImageAxisAligned(src, srcData, srcAlpha, w, h, nComps,
+			 tx, ty, scaledWidth, scaledHeight, xSign, ySign,
+			 clipRes);
+    return splashOk;
+  }
+
   // compute Bresenham parameters for x and y scaling
   yp = h / scaledHeight;
   yq = h % scaledHeight;
@@ -2953,6 +3127,285 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
   return splashOk;
 }
 
+// Draw an image with no rotation or shear.  This does the same box
+// filtering as the general case in drawImage, but separably, a whole
+// row at a time: each source row which maps to a destination row is
+// reduced horizontally, and the reduced rows are added up.  The source
+// rows are read sequentially, and the accumulator row is only
+// <scaledWidth> pixels wide.  Opaque rows which aren't clipped are
+// stored directly into the bitmap.
+void Splash::drawImageAxisAligned(SplashImageSource src, void *srcData,
+				  GBool srcAlpha, int w, int h, int nComps,
+				  int tx, int ty,
+				  int scaledWidth, int scaledHeight,
+				  int xSign, int ySign,
+				  SplashClipResult clipRes) {
+  SplashPipe pipe;
+  SplashClipResult clipRes2;
+  SplashColor pix;
+  SplashColorPtr colorBuf, lineBuf, p, d;
+  Guchar *alphaBuf, *q, *s;
+  SplashCoord *shapeLine;
+  SplashCoord pixMul0, pixMul1, pixMul, alphaMul;
+  int *colorAcc, *alphaAcc, *xSteps, *a;
+  int yp, yq, yt, yStep, lastYStep, xp, xq, xt, xStep;
+  int rowSize, x0, x1, xDest, yDest, nPixels, x, y, n, m, i, j;
+  int acc0, acc1, acc2, acc3;
+
+  // compute Bresenham parameters for x and y scaling
+  yp = h / scaledHeight;
+  yq = h % scaledHeight;
+  xp = w / scaledWidth;
+  xq = w % scaledWidth;
+
+  // the x steps are the same for every row
+  xSteps = (int *)gmallocn(scaledWidth, sizeof(int));
+  xt = 0;
+  for (x = 0; x < scaledWidth; ++x) {
+    xStep = xp;
+    xt += xq;
+    if (xt >= scaledWidth) {
+      xt -= scaledWidth;
+      ++xStep;
+    }
+    xSteps[x] = xStep;
+  }
+
+  // allocate buffers
+  rowSize = w * nComps;
+  colorBuf = (SplashColorPtr)gmallocn(yp + 1, rowSize);
+  colorAcc = (int *)gmallocn(scaledWidth * nComps, sizeof(int));
+  lineBuf = (SplashColorPtr)gmallocn(scaledWidth, nComps);
+  if (srcAlpha) {
+    alphaBuf = (Guchar *)gmallocn(yp + 1, w);
+    alphaAcc = (int *)gmallocn(scaledWidth, sizeof(int));
+    shapeLine = (SplashCoord *)gmallocn(scaledWidth, sizeof(SplashCoord));
+  } else {
+    alphaBuf = NULL;
+    alphaAcc = NULL;
+    shapeLine = NULL;
+  }
+
+  // the destination span of each row
+  if (xSign > 0) {
+    x0 = tx;
+  } else {
+    x0 = tx - (scaledWidth - 1);
+  }
+  x1 = x0 + (scaledWidth - 1);
+
+  // initialize the pixel pipe
+  pipeInit(&pipe, 0, 0, NULL, pix, state->fillAlpha, srcAlpha, gFalse);
+
+  // init y scale Bresenham
+  yt = 0;
+  lastYStep = 1;
+
+  for (y = 0; y < scaledHeight; ++y) {
+
+    // y scale Bresenham
+    yStep = yp;
+    yt += yq;
+    if (yt >= scaledHeight) {
+      yt -= scaledHeight;
+      ++yStep;
+    }
+
+    // read row(s) from image
+    n = (yp > 0) ? yStep : lastYStep;
+    if (n > 0) {
+      p = colorBuf;
+      q = alphaBuf;
+      for (i = 0; i < n; ++i) {
+	(*src)(srcData, p, q);
+	p += rowSize;
+	if (q) {
+	  q += w;
+	}
+      }
+    }
+    lastYStep = yStep;
+
+    // clipping test
+    yDest = ty + ySign * y;
+    if (clipRes != splashClipAllInside) {
+      clipRes2 = state->clip->testSpan(x0, x1, yDest);
+      if (clipRes2 == splashClipAllOutside) {
+	continue;
+      }
+    } else {
+      clipRes2 = clipRes;
+    }
+
+    // horizontal pass: sum the columns of each source row; vertical
+    // pass: add up the rows
+    n = yStep > 0 ? yStep : 1;
+    memset(colorAcc, 0, scaledWidth * nComps * sizeof(int));
+    p = colorBuf;
+    for (i = 0; i < n; ++i) {
+      s = p;
+      a = colorAcc;
+      switch (nComps) {
+      case 1:
+	for (x = 0; x < scaledWidth; ++x) {
+	  m = xSteps[x] > 0 ? xSteps[x] : 1;
+	  acc0 = 0;
+	  for (j = 0; j < m; ++j) {
+	    acc0 += s[j];
+	  }
+	  a[0] += acc0;
+	  s += xSteps[x];
+	  a += 1;
+	}
+	break;
+      case 3:
+	for (x = 0; x < scaledWidth; ++x) {
+	  m = xSteps[x] > 0 ? xSteps[x] : 1;
+	  acc0 = acc1 = acc2 = 0;
+	  for (j = 0; j < 3 * m; j += 3) {
+	    acc0 += s[j];
+	    acc1 += s[j + 1];
+	    acc2 += s[j + 2];
+	  }
+	  a[0] += acc0;
+	  a[1] += acc1;
+	  a[2] += acc2;
+	  s += 3 * xSteps[x];
+	  a += 3;
+	}
+	break;
+      case 4:
+	for (x = 0; x < scaledWidth; ++x) {
+	  m = xSteps[x] > 0 ? xSteps[x] : 1;
+	  acc0 = acc1 = acc2 = acc3 = 0;
+	  for (j = 0; j < 4 * m; j += 4) {
+	    acc0 += s[j];
+	    acc1 += s[j + 1];
+	    acc2 += s[j + 2];
+	    acc3 += s[j + 3];
+	  }
+	  a[0] += acc0;
+	  a[1] += acc1;
+	  a[2] += acc2;
+	  a[3] += acc3;
+	  s += 4 * xSteps[x];
+	  a += 4;
+	}
+	break;
+      }
+      p += rowSize;
+    }
+    if (srcAlpha) {
+      memset(alphaAcc, 0, scaledWidth * sizeof(int));
+      q = alphaBuf;
+      for (i = 0; i < n; ++i) {
+	s = q;
+	for (x = 0; x < scaledWidth; ++x) {
+	  m = xSteps[x] > 0 ? xSteps[x] : 1;
+	  acc0 = 0;
+	  for (j = 0; j < m; ++j) {
+	    acc0 += s[j];
+	  }
+	  alphaAcc[x] += acc0;
+	  s += xSteps[x];
+	}
+	q += w;
+      }
+    }
+
+    // normalize, and store the destination row left to right
+    m = xp > 0 ? xp : 1;
+    pixMul0 = (SplashCoord)1 / (SplashCoord)(n * m);
+    pixMul1 = (SplashCoord)1 / (SplashCoord)(n * (xp + 1));
+    a = colorAcc;
+    for (x = 0; x < scaledWidth; ++x, a += nComps) {
+      pixMul = (xSteps[x] == xp + 1) ? pixMul1 : pixMul0;
+      xDest = (xSign > 0) ? x : scaledWidth - 1 - x;
+      d = lineBuf + xDest * nComps;
+      for (j = 0; j < nComps; ++j) {
+	d[j] = (Guchar)(int)((SplashCoord)a[j] * pixMul);
+      }
+      if (nComps == 4 && bitmap->mode == splashModeXBGR8) {
+	d[3] = 255;
+      }
+      if (srcAlpha) {
+	alphaMul = pixMul * (1.0 / 255.0);
+	shapeLine[xDest] = (SplashCoord)alphaAcc[x] * alphaMul;
+      }
+    }
+    // opaque, unclipped row: store it directly
+    if (pipe.noTransparency && !state->blendFunc &&
+	clipRes2 == splashClipAllInside) {
+      nPixels = scaledWidth;
+      d = &bitmap->data[yDest * bitmap->rowSize];
+      if (bitmap->mode != splashModeMono1) {
+	d += x0 * nComps;
+      }
+      p = lineBuf;
+      switch (bitmap->mode) {
+      case splashModeMono1:
+	state->screen->testSpan(x0, yDest, nPixels, p, 1, d);
+	break;
+      case splashModeMono8:
+      case splashModeRGB8:
+#if SPLASH_CMYK
+      case splashModeCMYK8:
+#endif
+	memcpy(d, p, nPixels * nComps);
+	break;
+      case splashModeBGR8:
+	for (x = 0; x < nPixels; ++x, d += 3, p += 3) {
+	  d[0] = p[2];
+	  d[1] = p[1];
+	  d[2] = p[0];
+	}
+	break;
+      case splashModeXBGR8:
+	for (x = 0; x < nPixels; ++x, d += 4, p += 4) {
+	  d[0] = p[2];
+	  d[1] = p[1];
+	  d[2] = p[0];
+	  d[3] = 255;
+	}
+	break;
+      }
+      if (bitmap->alpha) {
+	memset(&bitmap->alpha[yDest * bitmap->width + x0], 0xff, nPixels);
+      }
+      updateModX(x0);
+      updateModX(x1);
+      updateModY(yDest);
+
+    // otherwise, run the row through the pipe
+    } else {
+      pipeSetXY(&pipe, x0, yDest);
+      for (x = 0; x < scaledWidth; ++x) {
+	if ((!srcAlpha || shapeLine[x] > 0) &&
+	    (clipRes2 == splashClipAllInside ||
+	     state->clip->test(x0 + x, yDest))) {
+	  pipe.cSrc = lineBuf + x * nComps;
+	  if (srcAlpha) {
+	    pipe.shape = shapeLine[x];
+	  }
+	  pipeRun(&pipe);
+	  updateModX(x0 + x);
+	  updateModY(yDest);
+	} else {
+	  pipeIncX(&pipe);
+	}
+      }
+    }
+  }
+
+  gfree(xSteps);
+  gfree(colorBuf);
+  gfree(colorAcc);
+  gfree(lineBuf);
+  gfree(alphaBuf);
+  gfree(alphaAcc);
+  gfree(shapeLine);
+}
+
 SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
 			      int xDest, int yDest, int w, int h,
 			      GBool noClip, GBool nonIsolated) {
@@ -3208,45 +3661,225 @@ SplashError Splash::blitTransparent(SplashBitmap *src, int xSrc, int ySrc,
 
 SplashPath *Splash::makeStrokePath(SplashPath *path, GBool flatten) {
   SplashPath *pathIn, *pathOut;
-  SplashCoord w, d, dx, dy, wdx, wdy, dxNext, dyNext, wdxNext, wdyNext;
-  SplashCoord crossprod, dotprod, miter, m;
-  GBool first, last, closed;
-  int subpathStart, next, i;
-  int left0, left1, left2, right0, right1, right2, join0, join1, join2;
-  int leftFirst, rightFirst, firstPt;
+  SplashCoord *mat, w, margin;
+  int i, j;
 
   if (flatten) {
     pathIn = flattenPath(path, state->matrix, state->flatness);
-    if (state->lineDashLength > 0) {
-      pathOut = makeDashedPath(pathIn);
-      SplashPath::destroy(pathIn);
-      pathIn = pathOut;
-    }
   } else {
     pathIn = path;
   }
 
-  subpathStart = 0; // make gcc happy
-  closed = gFalse; // make gcc happy
-  left0 = left1 = right0 = right1 = join0 = join1 = 0; // make gcc happy
-  leftFirst = rightFirst = firstPt = 0; // make gcc happy
+  // subpaths (or dashes) whose stroke lies entirely this far outside
+  // the clip rectangle (in device space) are skipped: the stroke is
+  // within w/2 * max(miterLimit, 1.5) of the path in user space, plus
+  // a pixel or two for stroke adjustment
+  mat = state->matrix;
+  w = (SplashCoord)0.5 * state->lineWidth;
+  if (state->lineJoin == splashLineJoinMiter && state->miterLimit > 1.5) {
+    w *= state->miterLimit;
+  } else {
+    w *= 1.5;
+  }
+  margin = w * splashSqrt(mat[0] * mat[0] + mat[1] * mat[1] +
+			  mat[2] * mat[2] + mat[3] * mat[3]) + 2;
 
   pathOut = SplashPath::create();
-  w = state->lineWidth;
+  if (state->lineDashLength > 0) {
+    strokeDashes(pathIn, pathOut, margin);
+  } else {
+    i = 0;
+    while (i < pathIn->length) {
+      for (j = i;
+	   j < pathIn->length - 1 && !(pathIn->flags[j] & splashPathLast);
+	   ++j) ;
+      if (strokeIsVisible(&pathIn->pts[i], j - i + 1, margin)) {
+	strokeSubpath(pathOut, &pathIn->pts[i], j - i + 1,
+		      pathIn->flags[i] & splashPathClosed);
+      }
+      i = j + 1;
+    }
+  }
 
-  for (i = 0; i < pathIn->length - 1; ++i) {
-    if (pathIn->flags[i] & splashPathLast) {
-      continue;
+  if (pathIn != path) {
+    SplashPath::destroy(pathIn);
+  }
+
+  return pathOut;
+}
+
+// Generate the dashes of each subpath of <path> and stroke them one
+// at a time into <pathOut>, without building the dashed path.  A dash
+// made of several segments gets a single outline (see strokeDash).
+void Splash::strokeDashes(SplashPath *path, SplashPath *pathOut,
+			  SplashCoord margin) {
+  SplashPathPoint *dash;
+  SplashCoord lineDashTotal;
+  SplashCoord lineDashStartPhase, lineDashDist, segLen;
+  SplashCoord x0, y0, x1, y1, xa, ya;
+  GBool lineDashStartOn, lineDashOn;
+  int lineDashStartIdx, lineDashIdx, dashLen, dashSize;
+  int i, j, k;
+
+  lineDashTotal = 0;
+  for (i = 0; i < state->lineDashLength; ++i) {
+    lineDashTotal += state->lineDash[i];
+  }
+  lineDashStartPhase = state->lineDashPhase;
+  i = splashFloor(lineDashStartPhase / lineDashTotal);
+  lineDashStartPhase -= (SplashCoord)i * lineDashTotal;
+  lineDashStartOn = gTrue;
+  lineDashStartIdx = 0;
+  while (lineDashStartPhase >= state->lineDash[lineDashStartIdx]) {
+    lineDashStartOn = !lineDashStartOn;
+    lineDashStartPhase -= state->lineDash[lineDashStartIdx];
+    ++lineDashStartIdx;
+  }
+
+  dashSize = 16;
+  dash = (SplashPathPoint *)gmallocn(dashSize, sizeof(SplashPathPoint));
+  dashLen = 0;
+
+  // process each subpath
+  i = 0;
+  while (i < path->length) {
+
+    // find the end of the subpath
+    for (j = i;
+	 j < path->length - 1 && !(path->flags[j] & splashPathLast);
+	 ++j) ;
+
+    // initialize the dash parameters
+    lineDashOn = lineDashStartOn;
+    lineDashIdx = lineDashStartIdx;
+    lineDashDist = state->lineDash[lineDashIdx] - lineDashStartPhase;
+
+    // process each segment of the subpath
+    for (k = i; k < j; ++k) {
+
+      // grab the segment
+      x0 = path->pts[k].x;
+      y0 = path->pts[k].y;
+      x1 = path->pts[k+1].x;
+      y1 = path->pts[k+1].y;
+      segLen = splashDist(x0, y0, x1, y1);
+
+      // process the segment
+      while (segLen > 0) {
+
+	if (lineDashDist >= segLen) {
+	  xa = x1;
+	  ya = y1;
+	  lineDashDist -= segLen;
+	  segLen = 0;
+	} else {
+	  xa = x0 + (lineDashDist / segLen) * (x1 - x0);
+	  ya = y0 + (lineDashDist / segLen) * (y1 - y0);
+	  segLen -= lineDashDist;
+	  lineDashDist = 0;
+	}
+	if (lineDashOn) {
+	  if (dashLen + 2 > dashSize) {
+	    dashSize *= 2;
+	    dash = (SplashPathPoint *)greallocn(dash, dashSize,
+						sizeof(SplashPathPoint));
+	  }
+	  if (dashLen == 0) {
+	    dash[dashLen].x = x0;
+	    dash[dashLen].y = y0;
+	    ++dashLen;
+	  }
+	  dash[dashLen].x = xa;
+	  dash[dashLen].y = ya;
+	  ++dashLen;
+	}
+	x0 = xa;
+	y0 = ya;
+
+	// get the next entry in the dash array
+	if (lineDashDist <= 0) {
+	  if (dashLen > 0) {
+	    if (strokeIsVisible(dash, dashLen, margin)) {
+	      strokeDash(pathOut, dash, dashLen);
+	    }
+	    dashLen = 0;
+	  }
+	  lineDashOn = !lineDashOn;
+	  if (++lineDashIdx == state->lineDashLength) {
+	    lineDashIdx = 0;
+	  }
+	  lineDashDist = state->lineDash[lineDashIdx];
+	}
+      }
     }
-    if ((first = pathIn->flags[i] & splashPathFirst)) {
-      subpathStart = i;
-      closed = pathIn->flags[i] & splashPathClosed;
+
+    // the subpath may end in the middle of a dash
+    if (dashLen > 0) {
+      if (strokeIsVisible(dash, dashLen, margin)) {
+	strokeDash(pathOut, dash, dashLen);
+      }
+      dashLen = 0;
     }
-    last = pathIn->flags[i+1] & splashPathLast;
+
+    i = j + 1;
+  }
+
+  gfree(dash);
+}
+
+// Returns false if the stroke of the <n> points <pts> (in user space)
+// lies entirely at least <margin> pixels outside the clip rectangle.
+GBool Splash::strokeIsVisible(SplashPathPoint *pts, int n,
+			      SplashCoord margin) {
+  SplashCoord xMin, yMin, xMax, yMax, x, y;
+  int i;
+
+  transform(state->matrix, pts[0].x, pts[0].y, &xMin, &yMin);
+  xMax = xMin;
+  yMax = yMin;
+  for (i = 1; i < n; ++i) {
+    transform(state->matrix, pts[i].x, pts[i].y, &x, &y);
+    if (x < xMin) {
+      xMin = x;
+    } else if (x > xMax) {
+      xMax = x;
+    }
+    if (y < yMin) {
+      yMin = y;
+    } else if (y > yMax) {
+      yMax = y;
+    }
+  }
+  return xMax + margin >= state->clip->getXMinI() &&
+	 xMin - margin <= state->clip->getXMaxI() + 1 &&
+	 yMax + margin >= state->clip->getYMinI() &&
+	 yMin - margin <= state->clip->getYMaxI() + 1;
+}
+
+// Add the stroke outline of the subpath <pts> (<n> points, flattened,
+// in user space) to <pathOut>: one closed rectangle per segment, plus
+// the caps and joins.
+void Splash::strokeSubpath(SplashPath *pathOut, SplashPathPoint *pts, int n,
+			   GBool closed) {
+  SplashCoord w, d, dx, dy, wdx, wdy, dxNext, dyNext, wdxNext, wdyNext;
+  SplashCoord crossprod, dotprod, miter, m;
+  GBool first, last;
+  int next, i;
+  int left0, left1, left2, right0, right1, right2, join0, join1, join2;
+  int leftFirst, rightFirst, firstPt;
+
+  left0 = left1 = right0 = right1 = join0 = join1 = 0; // make gcc happy
+  leftFirst = rightFirst = firstPt = 0; // make gcc happy
+
+  w = state->lineWidth;
+
+  for (i = 0; i < n - 1; ++i) {
+    first = i == 0;
+    last = i == n - 2;
 
     // compute the deltas for segment (i, i+1)
-    d = splashDist(pathIn->pts[i].x, pathIn->pts[i].y,
-		   pathIn->pts[i+1].x, pathIn->pts[i+1].y);
+    d = splashDist(pts[i].x, pts[i].y,
+		   pts[i+1].x, pts[i+1].y);
     if (d == 0) {
       // we need to draw end caps on zero-length lines
       //~ not clear what the behavior should be for splashLineCapButt
@@ -3255,16 +3888,16 @@ SplashPath *Splash::makeStrokePath(SplashPath *path, GBool flatten) {
       dy = 1;
     } else {
       d = (SplashCoord)1 / d;
-      dx = d * (pathIn->pts[i+1].x - pathIn->pts[i].x);
-      dy = d * (pathIn->pts[i+1].y - pathIn->pts[i].y);
+      dx = d * (pts[i+1].x - pts[i].x);
+      dy = d * (pts[i+1].y - pts[i].y);
     }
     wdx = (SplashCoord)0.5 * w * dx;
     wdy = (SplashCoord)0.5 * w * dy;
 
     // compute the deltas for segment (i+1, next)
-    next = last ? subpathStart + 1 : i + 2;
-    d = splashDist(pathIn->pts[i+1].x, pathIn->pts[i+1].y,
-		   pathIn->pts[next].x, pathIn->pts[next].y);
+    next = last ? 1 : i + 2;
+    d = splashDist(pts[i+1].x, pts[i+1].y,
+		   pts[next].x, pts[next].y);
     if (d == 0) {
       // we need to draw end caps on zero-length lines
       //~ not clear what the behavior should be for splashLineCapButt
@@ -3273,84 +3906,84 @@ SplashPath *Splash::makeStrokePath(SplashPath *path, GBool flatten) {
       dyNext = 1;
     } else {
       d = (SplashCoord)1 / d;
-      dxNext = d * (pathIn->pts[next].x - pathIn->pts[i+1].x);
-      dyNext = d * (pathIn->pts[next].y - pathIn->pts[i+1].y);
+      dxNext = d * (pts[next].x - pts[i+1].x);
+      dyNext = d * (pts[next].y - pts[i+1].y);
     }
     wdxNext = (SplashCoord)0.5 * w * dxNext;
     wdyNext = (SplashCoord)0.5 * w * dyNext;
 
     // draw the start cap
-    pathOut->moveTo(pathIn->pts[i].x - wdy, pathIn->pts[i].y + wdx);
-    if (i == subpathStart) {
+    pathOut->moveTo(pts[i].x - wdy, pts[i].y + wdx);
+    if (i == 0) {
       firstPt = pathOut->length - 1;
     }
     if (first && !closed) {
       switch (state->lineCap) {
       case splashLineCapButt:
-	pathOut->lineTo(pathIn->pts[i].x + wdy, pathIn->pts[i].y - wdx);
+	pathOut->lineTo(pts[i].x + wdy, pts[i].y - wdx);
 	break;
       case splashLineCapRound:
-	pathOut->curveTo(pathIn->pts[i].x - wdy - bezierCircle * wdx,
-			 pathIn->pts[i].y + wdx - bezierCircle * wdy,
-			 pathIn->pts[i].x - wdx - bezierCircle * wdy,
-			 pathIn->pts[i].y - wdy + bezierCircle * wdx,
-			 pathIn->pts[i].x - wdx,
-			 pathIn->pts[i].y - wdy);
-	pathOut->curveTo(pathIn->pts[i].x - wdx + bezierCircle * wdy,
-			 pathIn->pts[i].y - wdy - bezierCircle * wdx,
-			 pathIn->pts[i].x + wdy - bezierCircle * wdx,
-			 pathIn->pts[i].y - wdx - bezierCircle * wdy,
-			 pathIn->pts[i].x + wdy,
-			 pathIn->pts[i].y - wdx);
+	pathOut->curveTo(pts[i].x - wdy - bezierCircle * wdx,
+			 pts[i].y + wdx - bezierCircle * wdy,
+			 pts[i].x - wdx - bezierCircle * wdy,
+			 pts[i].y - wdy + bezierCircle * wdx,
+			 pts[i].x - wdx,
+			 pts[i].y - wdy);
+	pathOut->curveTo(pts[i].x - wdx + bezierCircle * wdy,
+			 pts[i].y - wdy - bezierCircle * wdx,
+			 pts[i].x + wdy - bezierCircle * wdx,
+			 pts[i].y - wdx - bezierCircle * wdy,
+			 pts[i].x + wdy,
+			 pts[i].y - wdx);
 	break;
       case splashLineCapProjecting:
-	pathOut->lineTo(pathIn->pts[i].x - wdx - wdy,
-			pathIn->pts[i].y + wdx - wdy);
-	pathOut->lineTo(pathIn->pts[i].x - wdx + wdy,
-			pathIn->pts[i].y - wdx - wdy);
-	pathOut->lineTo(pathIn->pts[i].x + wdy,
-			pathIn->pts[i].y - wdx);
+	pathOut->lineTo(pts[i].x - wdx - wdy,
+			pts[i].y + wdx - wdy);
+	pathOut->lineTo(pts[i].x - wdx + wdy,
+			pts[i].y - wdx - wdy);
+	pathOut->lineTo(pts[i].x + wdy,
+			pts[i].y - wdx);
 	break;
       }
     } else {
-      pathOut->lineTo(pathIn->pts[i].x + wdy, pathIn->pts[i].y - wdx);
+      pathOut->lineTo(pts[i].x + wdy, pts[i].y - wdx);
     }
 
     // draw the left side of the segment rectangle
     left2 = pathOut->length - 1;
-    pathOut->lineTo(pathIn->pts[i+1].x + wdy, pathIn->pts[i+1].y - wdx);
+    pathOut->lineTo(pts[i+1].x + wdy, pts[i+1].y - wdx);
 
     // draw the end cap
     if (last && !closed) {
       switch (state->lineCap) {
       case splashLineCapButt:
-	pathOut->lineTo(pathIn->pts[i+1].x - wdy, pathIn->pts[i+1].y + wdx);
+	pathOut->lineTo(pts[i+1].x - wdy, pts[i+1].y + wdx);
 	break;
       case splashLineCapRound:
-	pathOut->curveTo(pathIn->pts[i+1].x + wdy + bezierCircle * wdx,
-			 pathIn->pts[i+1].y - wdx + bezierCircle * wdy,
-			 pathIn->pts[i+1].x + wdx + bezierCircle * wdy,
-			 pathIn->pts[i+1].y + wdy - bezierCircle * wdx,
-			 pathIn->pts[i+1].x + wdx,
-			 pathIn->pts[i+1].y + wdy);
-	pathOut->curveTo(pathIn->pts[i+1].x + wdx - bezierCircle * wdy,
-			 pathIn->pts[i+1].y + wdy + bezierCircle * wdx,
-			 pathIn->pts[i+1].x - wdy + bezierCircle * wdx,
-			 pathIn->pts[i+1].y + wdx + bezierCircle * wdy,
-			 pathIn->pts[i+1].x - wdy,
-			 pathIn->pts[i+1].y + wdx);
+	pathOut->curveTo(pts[i+1].x + wdy + bezierCircle * wdx,
+			 pts[i+1].y - wdx + bezierCircle * wdy,
+			 pts[i+1].x + wdx + bezierCircle * wdy,
+			 pts[i+1].y + wdy - bezierCircle * wdx,
+			 pts[i+1].x + wdx,
+			 pts[i+1].y + wdy);
+	pathOut->curveTo(pts[i+1].x + wdx - bezierCircle * wdy,
+			 pts[i+1].y + wdy + bezierCircle * wdx,
+			 pts[i+1].x - wdy + bezierCircle * wdx,
+			 pts[i+1].y + wdx + bezierCircle * wdy,
+			 pts[i+1].x - wdy,
+			 pts[i+1].y + wdx);
 	break;
       case splashLineCapProjecting:
-	pathOut->lineTo(pathIn->pts[i+1].x + wdy + wdx,
-			pathIn->pts[i+1].y - wdx + wdy);
-	pathOut->lineTo(pathIn->pts[i+1].x - wdy + wdx,
-			pathIn->pts[i+1].y + wdx + wdy);
-	pathOut->lineTo(pathIn->pts[i+1].x - wdy,
-			pathIn->pts[i+1].y + wdx);
+	pathOut->lineTo(pts[i+1].x + wdy + wdx,
+			pts[i+1].y - wdx + wdy);
+	pathOut->lineTo(pts[i+1].x - wdy + wdx,
+			pts[i+1].y + wdx + wdy);
+	pathOut->lineTo(pts[i+1].x - wdy,
+			pts[i+1].y + wdx);
 	break;
       }
     } else {
-      pathOut->lineTo(pathIn->pts[i+1].x - wdy, pathIn->pts[i+1].y + wdx);
+      pathOut->lineTo(pts[i+1].x - wdy, pts[i+1].y + wdx);
     }
 
     // draw the right side of the segment rectangle
@@ -3379,67 +4012,67 @@ SplashPath *Splash::makeStrokePath(SplashPath *path, GBool flatten) {
 
       // round join
       if (state->lineJoin == splashLineJoinRound) {
-	pathOut->moveTo(pathIn->pts[i+1].x + (SplashCoord)0.5 * w,
-			pathIn->pts[i+1].y);
-	pathOut->curveTo(pathIn->pts[i+1].x + (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].y + bezierCircle2 * w,
-			 pathIn->pts[i+1].x + bezierCircle2 * w,
-			 pathIn->pts[i+1].y + (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].x,
-			 pathIn->pts[i+1].y + (SplashCoord)0.5 * w);
-	pathOut->curveTo(pathIn->pts[i+1].x - bezierCircle2 * w,
-			 pathIn->pts[i+1].y + (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].x - (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].y + bezierCircle2 * w,
-			 pathIn->pts[i+1].x - (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].y);
-	pathOut->curveTo(pathIn->pts[i+1].x - (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].y - bezierCircle2 * w,
-			 pathIn->pts[i+1].x - bezierCircle2 * w,
-			 pathIn->pts[i+1].y - (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].x,
-			 pathIn->pts[i+1].y - (SplashCoord)0.5 * w);
-	pathOut->curveTo(pathIn->pts[i+1].x + bezierCircle2 * w,
-			 pathIn->pts[i+1].y - (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].x + (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].y - bezierCircle2 * w,
-			 pathIn->pts[i+1].x + (SplashCoord)0.5 * w,
-			 pathIn->pts[i+1].y);
+	pathOut->moveTo(pts[i+1].x + (SplashCoord)0.5 * w,
+			pts[i+1].y);
+	pathOut->curveTo(pts[i+1].x + (SplashCoord)0.5 * w,
+			 pts[i+1].y + bezierCircle2 * w,
+			 pts[i+1].x + bezierCircle2 * w,
+			 pts[i+1].y + (SplashCoord)0.5 * w,
+			 pts[i+1].x,
+			 pts[i+1].y + (SplashCoord)0.5 * w);
+	pathOut->curveTo(pts[i+1].x - bezierCircle2 * w,
+			 pts[i+1].y + (SplashCoord)0.5 * w,
+			 pts[i+1].x - (SplashCoord)0.5 * w,
+			 pts[i+1].y + bezierCircle2 * w,
+			 pts[i+1].x - (SplashCoord)0.5 * w,
+			 pts[i+1].y);
+	pathOut->curveTo(pts[i+1].x - (SplashCoord)0.5 * w,
+			 pts[i+1].y - bezierCircle2 * w,
+			 pts[i+1].x - bezierCircle2 * w,
+			 pts[i+1].y - (SplashCoord)0.5 * w,
+			 pts[i+1].x,
+			 pts[i+1].y - (SplashCoord)0.5 * w);
+	pathOut->curveTo(pts[i+1].x + bezierCircle2 * w,
+			 pts[i+1].y - (SplashCoord)0.5 * w,
+			 pts[i+1].x + (SplashCoord)0.5 * w,
+			 pts[i+1].y - bezierCircle2 * w,
+			 pts[i+1].x + (SplashCoord)0.5 * w,
+			 pts[i+1].y);
 
       } else {
-	pathOut->moveTo(pathIn->pts[i+1].x, pathIn->pts[i+1].y);
+	pathOut->moveTo(pts[i+1].x, pts[i+1].y);
 
 	// angle < 180
 	if (crossprod < 0) {
-	  pathOut->lineTo(pathIn->pts[i+1].x - wdyNext,
-			  pathIn->pts[i+1].y + wdxNext);
+	  pathOut->lineTo(pts[i+1].x - wdyNext,
+			  pts[i+1].y + wdxNext);
 	  // miter join inside limit
 	  if (state->lineJoin == splashLineJoinMiter &&
 	      splashSqrt(miter) <= state->miterLimit) {
-	    pathOut->lineTo(pathIn->pts[i+1].x - wdy + wdx * m,
-			    pathIn->pts[i+1].y + wdx + wdy * m);
-	    pathOut->lineTo(pathIn->pts[i+1].x - wdy,
-			    pathIn->pts[i+1].y + wdx);
+	    pathOut->lineTo(pts[i+1].x - wdy + wdx * m,
+			    pts[i+1].y + wdx + wdy * m);
+	    pathOut->lineTo(pts[i+1].x - wdy,
+			    pts[i+1].y + wdx);
 	  // bevel join or miter join outside limit
 	  } else {
-	    pathOut->lineTo(pathIn->pts[i+1].x - wdy, pathIn->pts[i+1].y + wdx);
+	    pathOut->lineTo(pts[i+1].x - wdy, pts[i+1].y + wdx);
 	  }
 
 	// angle >= 180
 	} else {
-	  pathOut->lineTo(pathIn->pts[i+1].x + wdy,
-			  pathIn->pts[i+1].y - wdx);
+	  pathOut->lineTo(pts[i+1].x + wdy,
+			  pts[i+1].y - wdx);
 	  // miter join inside limit
 	  if (state->lineJoin == splashLineJoinMiter &&
 	      splashSqrt(miter) <= state->miterLimit) {
-	    pathOut->lineTo(pathIn->pts[i+1].x + wdy + wdx * m,
-			    pathIn->pts[i+1].y - wdx + wdy * m);
-	    pathOut->lineTo(pathIn->pts[i+1].x + wdyNext,
-			    pathIn->pts[i+1].y - wdxNext);
+	    pathOut->lineTo(pts[i+1].x + wdy + wdx * m,
+			    pts[i+1].y - wdx + wdy * m);
+	    pathOut->lineTo(pts[i+1].x + wdyNext,
+			    pts[i+1].y - wdxNext);
 	  // bevel join or miter join outside limit
 	  } else {
-	    pathOut->lineTo(pathIn->pts[i+1].x + wdyNext,
-			    pathIn->pts[i+1].y - wdxNext);
+	    pathOut->lineTo(pts[i+1].x + wdyNext,
+			    pts[i+1].y - wdxNext);
 	  }
 	}
       }
@@ -3449,8 +4082,8 @@ SplashPath *Splash::makeStrokePath(SplashPath *path, GBool flatten) {
 
     // add stroke adjustment hints
     if (state->strokeAdjust) {
-      if (i >= subpathStart + 1) {
-	if (i >= subpathStart + 2) {
+      if (i >= 1) {
+	if (i >= 2) {
 	  pathOut->addStrokeAdjustHint(left1, right1, left0 + 1, right0);
 	  pathOut->addStrokeAdjustHint(left1, right1, join0, left2);
 	} else {
@@ -3464,12 +4097,12 @@ SplashPath *Splash::makeStrokePath(SplashPath *path, GBool flatten) {
       right1 = right2;
       join0 = join1;
       join1 = join2;
-      if (i == subpathStart) {
+      if (i == 0) {
 	leftFirst = left2;
 	rightFirst = right2;
       }
       if (last) {
-	if (i >= subpathStart + 2) {
+	if (i >= 2) {
 	  pathOut->addStrokeAdjustHint(left1, right1, left0 + 1, right0);
 	  pathOut->addStrokeAdjustHint(left1, right1,
 				       join0, pathOut->length - 1);
@@ -3490,11 +4123,283 @@ SplashPath *Splash::makeStrokePath(SplashPath *path, GBool flatten) {
     }
   }
 
-  if (pathIn != path) {
-    SplashPath::destroy(pathIn);
+}
+
+// Add the stroke outline of the dash <pts> (<n> points, flattened, in
+// user space) to <pathOut>.  strokeSubpath gives every segment its own
+// rectangle and every join its own shape, all overlapping; a dash with
+// several segments is outlined instead as one polygon covering the
+// same area with about half the edges (see strokeDashOutline).
+// Dashes whose segments are all horizontal or vertical in device space
+// still go through strokeSubpath, for its stroke adjustment hints.
+void Splash::strokeDash(SplashPath *pathOut, SplashPathPoint *pts, int n) {
+  SplashCoord *mat, x0, y0, x1, y1;
+  GBool axisAligned;
+  int i;
+
+  if (n < 3) {
+    strokeSubpath(pathOut, pts, n, gFalse);
+    return;
   }
+  mat = state->matrix;
+  axisAligned = state->strokeAdjust;
+  for (i = 0; i < n - 1; ++i) {
+    if (pts[i].x == pts[i+1].x && pts[i].y == pts[i+1].y) {
+      // zero-length segments get the strokeSubpath treatment
+      strokeSubpath(pathOut, pts, n, gFalse);
+      return;
+    }
+    if (axisAligned) {
+      transform(mat, pts[i].x, pts[i].y, &x0, &y0);
+      transform(mat, pts[i+1].x, pts[i+1].y, &x1, &y1);
+      axisAligned = x0 == x1 || y0 == y1;
+    }
+  }
+  if (axisAligned || !strokeDashOutline(pathOut, pts, n)) {
+    strokeSubpath(pathOut, pts, n, gFalse);
+  }
+}
 
-  return pathOut;
+// Add the polygon outline of the open subpath <pts> (<n> >= 3 points,
+// no zero-length segments) to <pathOut>.  Returns false, without
+// adding anything, if the subpath doubles back on itself, in which
+// case strokeSubpath must be used.
+GBool Splash::strokeDashOutline(SplashPath *pathOut, SplashPathPoint *pts,
+				int n) {
+  SplashCoord w, d, dx, dy, wdx, wdy, dotprod;
+  int i;
+
+  w = state->lineWidth;
+  for (i = 0; i < n - 2; ++i) {
+    dotprod = (pts[i+1].x - pts[i].x) * (pts[i+2].x - pts[i+1].x) +
+              (pts[i+1].y - pts[i].y) * (pts[i+2].y - pts[i+1].y);
+    d = splashDist(pts[i].x, pts[i].y, pts[i+1].x, pts[i+1].y) *
+        splashDist(pts[i+1].x, pts[i+1].y, pts[i+2].x, pts[i+2].y);
+    if (dotprod < (SplashCoord)-0.99999 * d) {
+      return gFalse;
+    }
+  }
+
+  // start cap, from the right side to the left side
+  d = (SplashCoord)1 / splashDist(pts[0].x, pts[0].y, pts[1].x, pts[1].y);
+  dx = d * (pts[1].x - pts[0].x);
+  dy = d * (pts[1].y - pts[0].y);
+  wdx = (SplashCoord)0.5 * w * dx;
+  wdy = (SplashCoord)0.5 * w * dy;
+  pathOut->moveTo(pts[0].x - wdy, pts[0].y + wdx);
+  strokeCap(pathOut, pts[0].x, pts[0].y, -wdx, -wdy);
+
+  // left side
+  for (i = 1; i < n - 1; ++i) {
+    strokeJoinSide(pathOut, &pts[i-1], gTrue);
+  }
+
+  // end cap, from the left side to the right side
+  d = (SplashCoord)1 / splashDist(pts[n-2].x, pts[n-2].y,
+				  pts[n-1].x, pts[n-1].y);
+  dx = d * (pts[n-1].x - pts[n-2].x);
+  dy = d * (pts[n-1].y - pts[n-2].y);
+  wdx = (SplashCoord)0.5 * w * dx;
+  wdy = (SplashCoord)0.5 * w * dy;
+  pathOut->lineTo(pts[n-1].x + wdy, pts[n-1].y - wdx);
+  strokeCap(pathOut, pts[n-1].x, pts[n-1].y, wdx, wdy);
+
+  // right side
+  for (i = n - 2; i >= 1; --i) {
+    strokeJoinSide(pathOut, &pts[i-1], gFalse);
+  }
+  pathOut->close();
+
+  // round joins that couldn't be folded into the outline
+  if (state->lineJoin == splashLineJoinRound) {
+    for (i = 1; i < n - 1; ++i) {
+      if (splashDist(pts[i-1].x, pts[i-1].y, pts[i].x, pts[i].y) < 0.5 * w ||
+	  splashDist(pts[i].x, pts[i].y, pts[i+1].x, pts[i+1].y) < 0.5 * w) {
+	strokeRoundJoin(pathOut, pts[i].x, pts[i].y);
+      }
+    }
+  }
+
+  return gTrue;
+}
+
+// Add one side of the join at <pts>[1], between the segments
+// <pts>[0]-<pts>[1] and <pts>[1]-<pts>[2], to the outline built by
+// strokeDashOutline: the left side (<left> set) is walked forward,
+// the right side backward.  The current point is the offset start of
+// the segment before the join (in walking order); this adds the
+// points up to and including the offset start of the one after it.
+void Splash::strokeJoinSide(SplashPath *pathOut, SplashPathPoint *pts,
+			    GBool left) {
+  SplashCoord w, d0, d1, dx0, dy0, dx1, dy1, wdx0, wdy0, wdx1, wdy1;
+  SplashCoord xa, ya, xb, yb, x, y, crossprod, dotprod, t, m, s;
+  SplashCoord ux0, uy0, ux1, uy1, ux, uy, c;
+  GBool outer;
+
+  w = state->lineWidth;
+  x = pts[1].x;
+  y = pts[1].y;
+  d0 = splashDist(pts[0].x, pts[0].y, x, y);
+  d1 = splashDist(x, y, pts[2].x, pts[2].y);
+  dx0 = (x - pts[0].x) / d0;
+  dy0 = (y - pts[0].y) / d0;
+  dx1 = (pts[2].x - x) / d1;
+  dy1 = (pts[2].y - y) / d1;
+  wdx0 = (SplashCoord)0.5 * w * dx0;
+  wdy0 = (SplashCoord)0.5 * w * dy0;
+  wdx1 = (SplashCoord)0.5 * w * dx1;
+  wdy1 = (SplashCoord)0.5 * w * dy1;
+  crossprod = dx0 * dy1 - dy0 * dx1;
+  dotprod = dx0 * dx1 + dy0 * dy1;
+
+  // the offset points at the join on the two segments, in walking
+  // order, and the side of the turn this side is on
+  s = left ? 1 : -1;
+  if (left) {
+    xa = x + wdy0;  ya = y - wdx0;
+    xb = x + wdy1;  yb = y - wdx1;
+    outer = crossprod > 0;
+  } else {
+    xa = x - wdy1;  ya = y + wdx1;
+    xb = x - wdy0;  yb = y + wdx0;
+    outer = crossprod < 0;
+  }
+
+  if (!outer) {
+    // cut through the crossing point of the two offset lines if it is
+    // within the first half of the following segment and the last half
+    // of the preceding one, where both segment rectangles contain the
+    // corner that is cut off; otherwise go around the corner through
+    // the join point
+    t = (SplashCoord)0.5 * w * splashAbs(crossprod) / (1 + dotprod);
+    if (t <= 0.5 * d0 && t <= 0.5 * d1) {
+      pathOut->lineTo(x + s * wdy0 - t * dx0, y - s * wdx0 - t * dy0);
+    } else {
+      pathOut->lineTo(xa, ya);
+      pathOut->lineTo(x, y);
+      pathOut->lineTo(xb, yb);
+    }
+    return;
+  }
+
+  pathOut->lineTo(xa, ya);
+  switch (state->lineJoin) {
+  case splashLineJoinMiter:
+    // same miter point (and limit) as strokeSubpath
+    m = (SplashCoord)2 / ((SplashCoord)1 + dotprod);
+    if (splashSqrt(m) <= state->miterLimit) {
+      m = m < 1 ? 0 : splashSqrt(m - 1);
+      pathOut->lineTo(x + s * wdy0 + wdx0 * m, y - s * wdx0 + wdy0 * m);
+    }
+    break;
+  case splashLineJoinRound:
+    // an arc around the join point, in one or two pieces of up to 90
+    // degrees; if either segment is shorter than half the line width,
+    // the circle may stick out of the segment rectangles, so it is
+    // added separately by strokeDashOutline, and the outline goes
+    // through the join point
+    if (d0 < 0.5 * w || d1 < 0.5 * w) {
+      pathOut->lineTo(x, y);
+      break;
+    }
+    ux0 = (xa - x) / (0.5 * w);
+    uy0 = (ya - y) / (0.5 * w);
+    ux1 = (xb - x) / (0.5 * w);
+    uy1 = (yb - y) / (0.5 * w);
+    c = ux0 * ux1 + uy0 * uy1;
+    if (c < 0) {
+      ux = ux0 + ux1;
+      uy = uy0 + uy1;
+      t = splashSqrt(ux * ux + uy * uy);
+      ux /= t;
+      uy /= t;
+      c = splashSqrt((1 + c) / 2);
+      strokeArc(pathOut, x, y, ux0, uy0, ux, uy, c);
+      strokeArc(pathOut, x, y, ux, uy, ux1, uy1, c);
+    } else {
+      strokeArc(pathOut, x, y, ux0, uy0, ux1, uy1, c);
+    }
+    return;
+  case splashLineJoinBevel:
+    break;
+  }
+  pathOut->lineTo(xb, yb);
+}
+
+// Add a circular arc of radius lineWidth/2 around (<x>,<y>), from the
+// unit direction (<ux0>,<uy0>) to (<ux1>,<uy1>), which are at most 90
+// degrees apart (the cosine of the angle is <c>), to <pathOut>, as a
+// single Bezier curve.
+void Splash::strokeArc(SplashPath *pathOut, SplashCoord x, SplashCoord y,
+		       SplashCoord ux0, SplashCoord uy0,
+		       SplashCoord ux1, SplashCoord uy1, SplashCoord c) {
+  SplashCoord r, k, sh, ch;
+
+  // control point distance: 4/3 * tan(angle/4) * r, along the tangents
+  r = (SplashCoord)0.5 * state->lineWidth;
+  ch = splashSqrt((1 + c) / 2);
+  sh = splashSqrt((1 - c) / 2);
+  k = (SplashCoord)4 / 3 * sh / (1 + ch) * r;
+  if (ux0 * uy1 - uy0 * ux1 < 0) {
+    k = -k;
+  }
+  pathOut->curveTo(x + r * ux0 - k * uy0, y + r * uy0 + k * ux0,
+		   x + r * ux1 + k * uy1, y + r * uy1 - k * ux1,
+		   x + r * ux1, y + r * uy1);
+}
+
+// Add a line cap at (<x>,<y>), from the left side of the stroke to the
+// right side, for a segment ending there with half-width deltas
+// (<wdx>,<wdy>), to <pathOut>, as in strokeSubpath.
+void Splash::strokeCap(SplashPath *pathOut, SplashCoord x, SplashCoord y,
+		       SplashCoord wdx, SplashCoord wdy) {
+  switch (state->lineCap) {
+  case splashLineCapButt:
+    pathOut->lineTo(x - wdy, y + wdx);
+    break;
+  case splashLineCapRound:
+    pathOut->curveTo(x + wdy + bezierCircle * wdx,
+		     y - wdx + bezierCircle * wdy,
+		     x + wdx + bezierCircle * wdy,
+		     y + wdy - bezierCircle * wdx,
+		     x + wdx,
+		     y + wdy);
+    pathOut->curveTo(x + wdx - bezierCircle * wdy,
+		     y + wdy + bezierCircle * wdx,
+		     x - wdy + bezierCircle * wdx,
+		     y + wdx + bezierCircle * wdy,
+		     x - wdy,
+		     y + wdx);
+    break;
+  case splashLineCapProjecting:
+    pathOut->lineTo(x + wdy + wdx, y - wdx + wdy);
+    pathOut->lineTo(x - wdy + wdx, y + wdx + wdy);
+    pathOut->lineTo(x - wdy, y + wdx);
+    break;
+  }
+}
+
+// Add a round join at (<x>,<y>), i.e., a circle with diameter
+// lineWidth, to <pathOut>, as in strokeSubpath.
+void Splash::strokeRoundJoin(SplashPath *pathOut, SplashCoord x,
+			     SplashCoord y) {
+  SplashCoord w;
+
+  w = state->lineWidth;
+  pathOut->moveTo(x + (SplashCoord)0.5 * w, y);
+  pathOut->curveTo(x + (SplashCoord)0.5 * w, y + bezierCircle2 * w,
+		   x + bezierCircle2 * w, y + (SplashCoord)0.5 * w,
+		   x, y + (SplashCoord)0.5 * w);
+  pathOut->curveTo(x - bezierCircle2 * w, y + (SplashCoord)0.5 * w,
+		   x - (SplashCoord)0.5 * w, y + bezierCircle2 * w,
+		   x - (SplashCoord)0.5 * w, y);
+  pathOut->curveTo(x - (SplashCoord)0.5 * w, y - bezierCircle2 * w,
+		   x - bezierCircle2 * w, y - (SplashCoord)0.5 * w,
+		   x, y - (SplashCoord)0.5 * w);
+  pathOut->curveTo(x + bezierCircle2 * w, y - (SplashCoord)0.5 * w,
+		   x + (SplashCoord)0.5 * w, y - bezierCircle2 * w,
+		   x + (SplashCoord)0.5 * w, y);
+  pathOut->close();
 }
 
 void Splash::dumpPath(SplashPath *path) {
@@ -21,7 +21,9 @@ class SplashState;
 class SplashPattern;
 class SplashScreen;
 class SplashPath;
+struct SplashPathPoint;
 class SplashXPath;
+class SplashXPathCache;
 class SplashFont;
 struct SplashPipe;
 
@@ -121,6 +123,8 @@ public:
 			 SplashCoord x1, SplashCoord y1);
   // NB: uses untransformed coordinates.
   SplashError clipToPath(SplashPath *path, GBool eo);
+  // See SplashClip::setMaskThreshold.
+  void setClipMaskThreshold(int threshold);
   void setSoftMask(SplashBitmap *softMask);
   void setInNonIsolatedGroup(SplashBitmap *alpha0BitmapA,
 			     int alpha0XA, int alpha0YA);
@@ -207,8 +211,10 @@ public:
   //----- misc
 
   // Construct a path for a stroke, given the path to be stroked, and
-  // using the current line parameters.  If <flatten> is true, this
-  // function will first flatten the path and handle the linedash.
+  // using the current line parameters (including the line dash).  If
+  // <flatten> is true, this function will first flatten the path.
+  // Parts of the stroke which are entirely outside the clip
+  // rectangle may be left out.
   SplashPath *makeStrokePath(SplashPath *path, GBool flatten = gTrue);
 
   // Return the associated bitmap.
@@ -248,6 +254,10 @@ private:
   void drawAAPixel(SplashPipe *pipe, int x, int y);
   void drawSpan(SplashPipe *pipe, int x0, int x1, int y, GBool noClip);
   void drawAALine(SplashPipe *pipe, int x0, int x1, int y);
+  void drawImageAxisAligned(SplashImageSource src, void *srcData,
+			    GBool srcAlpha, int w, int h, int nComps,
+			    int tx, int ty, int scaledWidth, int scaledHeight,
+			    int xSign, int ySign, SplashClipResult clipRes);
   void transform(SplashCoord *matrix, SplashCoord xi, SplashCoord yi,
 		 SplashCoord *xo, SplashCoord *yo);
   void updateModX(int x);
@@ -263,6 +273,20 @@ private:
 		    SplashCoord *matrix, SplashCoord flatness2,
 		    SplashPath *fPath);
   SplashPath *makeDashedPath(SplashPath *xPath);
+  void strokeDashes(SplashPath *path, SplashPath *pathOut,
+		    SplashCoord margin);
+  GBool strokeIsVisible(SplashPathPoint *pts, int n, SplashCoord margin);
+  void strokeSubpath(SplashPath *pathOut, SplashPathPoint *pts, int n,
+		     GBool closed);
+  void strokeDash(SplashPath *pathOut, SplashPathPoint *pts, int n);
+  GBool strokeDashOutline(SplashPath *pathOut, SplashPathPoint *pts, int n);
+  void strokeJoinSide(SplashPath *pathOut, SplashPathPoint *pts, GBool left);
+  void strokeArc(SplashPath *pathOut, SplashCoord x, SplashCoord y,
+		 SplashCoord ux0, SplashCoord uy0,
+		 SplashCoord ux1, SplashCoord uy1, SplashCoord c);
+  void strokeCap(SplashPath *pathOut, SplashCoord x, SplashCoord y,
+		 SplashCoord wdx, SplashCoord wdy);
+  void strokeRoundJoin(SplashPath *pathOut, SplashCoord x, SplashCoord y);
   SplashError fillWithPattern(SplashPath *path, GBool eo,
 			      SplashPattern *pattern, SplashCoord alpha);
   SplashError fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph);
@@ -285,6 +309,8 @@ private:
   int modXMin, modYMin, modXMax, modYMax;
   SplashClipResult opClipRes;
   GBool vectorAntialias;
+  SplashXPathCache *xPathCache;	// expanded fill paths (NULL until
+				//   the first fill)
   GBool debugMode;
 };
 
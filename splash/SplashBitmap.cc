@@ -48,6 +48,7 @@ SplashBitmap::SplashBitmap(int widthA, int heightA, int rowPad,
   rowSize += rowPad - 1;
   rowSize -= rowSize % rowPad;
   data = (SplashColorPtr)gmalloc(rowSize * height);
+  ownData = gTrue;
   if (!topDown) {
     data += (height - 1) * rowSize;
     rowSize = -rowSize;
@@ -59,12 +60,29 @@ SplashBitmap::SplashBitmap(int widthA, int heightA, int rowPad,
   }
 }
 
+SplashBitmap::SplashBitmap(int widthA, int heightA, int rowSizeA,
+			   SplashColorMode modeA, GBool alphaA,
+			   SplashColorPtr dataA) {
+  width = widthA;
+  height = heightA;
+  rowSize = rowSizeA;
+  mode = modeA;
+  data = dataA;
+  ownData = gFalse;
+  if (alphaA) {
+    alpha = (Guchar *)gmalloc(width * height);
+  } else {
+    alpha = NULL;
+  }
+}
 
 SplashBitmap::~SplashBitmap() {
-  if (rowSize < 0) {
-    gfree(data + (height - 1) * rowSize);
-  } else {
-    gfree(data);
+  if (ownData) {
+    if (rowSize < 0) {
+      gfree(data + (height - 1) * rowSize);
+    } else {
+      gfree(data);
+    }
   }
   gfree(alpha);
 }
@@ -29,6 +29,13 @@ public:
 	       SplashColorMode modeA, GBool alphaA,
 	       GBool topDown = gTrue);
 
+  // Create a top-down bitmap which uses the caller's buffer <dataA>
+  // for its color data.  Rows are <rowSizeA> bytes apart, and the
+  // buffer must hold <rowSizeA> * <heightA> bytes.  It must stay valid
+  // for the life of the bitmap, and is not freed by it.
+  SplashBitmap(int widthA, int heightA, int rowSizeA,
+	       SplashColorMode modeA, GBool alphaA, SplashColorPtr dataA);
+
   ~SplashBitmap();
 
   int getWidth() { return width; }
@@ -54,6 +61,7 @@ private:
   SplashColorPtr data;		// pointer to row zero of the color data
   Guchar *alpha;		// pointer to row zero of the alpha data
 				//   (always top-down)
+  GBool ownData;		// set if <data> is freed by the destructor
 
   friend class Splash;
 };
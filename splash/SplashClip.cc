@@ -26,6 +26,94 @@
 
 #define splashClipEO       0x01	// use even-odd rule
 
+//------------------------------------------------------------------------
+// SplashClipMask
+//------------------------------------------------------------------------
+
+// Maximum size of a clip mask, in bytes.  Larger clip regions are
+// left as paths.
+#define splashClipMaxMaskSize (32 * 1024 * 1024)
+
+// The intersection of one or more clip paths, with one bit per pixel
+// (per sub-pixel, if anti-aliasing), in the coordinates used by the
+// paths' scanners.
+struct SplashClipMask {
+  int xMin, yMin, xMax, yMax;	// area covered by the mask; xMin is a
+				//   multiple of 8
+  int rowSize;			// size of a row, in bytes
+  Guchar *data;			// bits are set inside the clip region
+  int refCnt;
+};
+
+// Clear bits [<x0>, <x1>] of <row>.
+static void clearBits(Guchar *row, int x0, int x1) {
+  Guchar *p;
+
+  if (x0 > x1) {
+    return;
+  }
+  p = row + (x0 >> 3);
+  if ((x0 >> 3) == (x1 >> 3)) {
+    *p &= ~((0xff >> (x0 & 7)) & (0xff00 >> ((x1 & 7) + 1)));
+    return;
+  }
+  if (x0 & 7) {
+    *p++ &= 0xff00 >> (x0 & 7);
+    x0 = (x0 & ~7) + 8;
+  }
+  for (; x0 + 7 <= x1; x0 += 8) {
+    *p++ = 0;
+  }
+  if (x0 <= x1) {
+    *p &= 0xff >> ((x1 & 7) + 1);
+  }
+}
+
+static inline GBool maskTest(SplashClipMask *mask, int x, int y) {
+  if (x < mask->xMin || x > mask->xMax ||
+      y < mask->yMin || y > mask->yMax) {
+    return gFalse;
+  }
+  x -= mask->xMin;
+  return (mask->data[(y - mask->yMin) * mask->rowSize + (x >> 3)] &
+	  (0x80 >> (x & 7))) != 0;
+}
+
+// Returns true if all of the bits [<x0>, <x1>] in row <y> are set.
+static GBool maskTestSpan(SplashClipMask *mask, int x0, int x1, int y) {
+  Guchar *p;
+  Guchar m;
+
+  if (x0 < mask->xMin || x1 > mask->xMax ||
+      y < mask->yMin || y > mask->yMax) {
+    return gFalse;
+  }
+  x0 -= mask->xMin;
+  x1 -= mask->xMin;
+  p = mask->data + (y - mask->yMin) * mask->rowSize + (x0 >> 3);
+  if ((x0 >> 3) == (x1 >> 3)) {
+    m = (0xff >> (x0 & 7)) & (0xff00 >> ((x1 & 7) + 1));
+    return (*p & m) == m;
+  }
+  if (x0 & 7) {
+    m = 0xff >> (x0 & 7);
+    if ((*p++ & m) != m) {
+      return gFalse;
+    }
+    x0 = (x0 & ~7) + 8;
+  }
+  for (; x0 + 7 <= x1; x0 += 8) {
+    if (*p++ != 0xff) {
+      return gFalse;
+    }
+  }
+  if (x0 <= x1) {
+    m = 0xff00 >> ((x1 & 7) + 1);
+    return (*p & m) == m;
+  }
+  return gTrue;
+}
+
 //------------------------------------------------------------------------
 // SplashClip
 //------------------------------------------------------------------------
@@ -56,6 +144,9 @@ SplashClip::SplashClip(SplashCoord x0, SplashCoord y0,
   flags = NULL;
   scanners = NULL;
   length = size = 0;
+  nSegs = 0;
+  mask = NULL;
+  maskThreshold = 0;
 }
 
 SplashClip::SplashClip(SplashClip *clip) {
@@ -81,6 +172,11 @@ SplashClip::SplashClip(SplashClip *clip) {
     flags[i] = clip->flags[i];
     scanners[i] = new SplashXPathScanner(paths[i], flags[i] & splashClipEO);
   }
+  nSegs = clip->nSegs;
+  if ((mask = clip->mask)) {
+    ++mask->refCnt;
+  }
+  maskThreshold = clip->maskThreshold;
 }
 
 SplashClip::~SplashClip() {
@@ -93,6 +189,15 @@ SplashClip::~SplashClip() {
   gfree(paths);
   gfree(flags);
   gfree(scanners);
+  freeMask();
+}
+
+void SplashClip::freeMask() {
+  if (mask && --mask->refCnt == 0) {
+    gfree(mask->data);
+    delete mask;
+  }
+  mask = NULL;
 }
 
 void SplashClip::grow(int nPaths) {
@@ -125,6 +230,8 @@ void SplashClip::resetToRect(SplashCoord x0, SplashCoord y0,
   flags = NULL;
   scanners = NULL;
   length = size = 0;
+  nSegs = 0;
+  freeMask();
 
   if (x0 < x1) {
     xMin = x0;
@@ -243,11 +350,105 @@ SplashError SplashClip::clipToPath(SplashPath *path, SplashCoord *matrix,
     flags[length] = eo ? splashClipEO : 0;
     scanners[length] = new SplashXPathScanner(xPath, eo);
     ++length;
+    nSegs += xPath->length;
+    if (maskThreshold > 0 && nSegs >= maskThreshold) {
+      buildMask();
+    }
   }
 
   return splashOk;
 }
 
+// Rasterize the paths (and the previous mask, if any) into a new
+// mask covering the current clip rectangle, and drop the paths.
+void SplashClip::buildMask() {
+  SplashClipMask *newMask;
+  SplashXPathScanner *scanner;
+  Guchar *row;
+  int scale, xMinS, yMinS, xMaxS, yMaxS, x0, x1, xx, y, i;
+
+  // the area covered by the mask, in scanner coordinates
+  scale = antialias ? splashAASize : 1;
+  xMinS = xMinI * scale;
+  yMinS = yMinI * scale;
+  xMaxS = (xMaxI + 1) * scale - 1;
+  yMaxS = (yMaxI + 1) * scale - 1;
+  if (mask) {
+    if (xMinS < mask->xMin) {
+      xMinS = mask->xMin;
+    }
+    if (yMinS < mask->yMin) {
+      yMinS = mask->yMin;
+    }
+    if (xMaxS > mask->xMax) {
+      xMaxS = mask->xMax;
+    }
+    if (yMaxS > mask->yMax) {
+      yMaxS = mask->yMax;
+    }
+  }
+  if (xMaxS < xMinS || yMaxS < yMinS) {
+    return;
+  }
+
+  newMask = new SplashClipMask;
+  newMask->xMin = xMinS & ~7;
+  newMask->yMin = yMinS;
+  newMask->xMax = xMaxS;
+  newMask->yMax = yMaxS;
+  newMask->rowSize = ((xMaxS - newMask->xMin) >> 3) + 1;
+  if (yMaxS - yMinS + 1 > splashClipMaxMaskSize / newMask->rowSize) {
+    delete newMask;
+    return;
+  }
+  newMask->data = (Guchar *)gmallocn(yMaxS - yMinS + 1, newMask->rowSize);
+  newMask->refCnt = 1;
+
+  // start with the previous mask, or with the rectangle
+  for (y = yMinS; y <= yMaxS; ++y) {
+    row = newMask->data + (y - yMinS) * newMask->rowSize;
+    if (mask) {
+      memcpy(row, mask->data + (y - mask->yMin) * mask->rowSize +
+		  ((newMask->xMin - mask->xMin) >> 3),
+	     newMask->rowSize);
+    } else {
+      memset(row, 0xff, newMask->rowSize);
+    }
+    clearBits(row, 0, xMinS - newMask->xMin - 1);
+    clearBits(row, xMaxS - newMask->xMin + 1, newMask->rowSize * 8 - 1);
+  }
+
+  // clear everything outside each path's spans (using new scanners,
+  // since the old ones may be in the middle of a row)
+  for (i = 0; i < length; ++i) {
+    scanner = new SplashXPathScanner(paths[i], flags[i] & splashClipEO);
+    for (y = yMinS; y <= yMaxS; ++y) {
+      row = newMask->data + (y - yMinS) * newMask->rowSize;
+      xx = xMinS;
+      while (xx <= xMaxS && scanner->getNextSpan(y, &x0, &x1)) {
+	if (x0 > xMaxS) {
+	  x0 = xMaxS + 1;
+	}
+	clearBits(row, xx - newMask->xMin, x0 - 1 - newMask->xMin);
+	if (x1 >= xx) {
+	  xx = x1 + 1;
+	}
+      }
+      clearBits(row, xx - newMask->xMin, xMaxS - newMask->xMin);
+    }
+    delete scanner;
+  }
+
+  for (i = 0; i < length; ++i) {
+    delete paths[i];
+    delete scanners[i];
+  }
+  length = 0;
+  nSegs = 0;
+  freeMask();
+  mask = newMask;
+}
+
 GBool SplashClip::test(int x, int y) {
   int i;
 
@@ -258,12 +459,18 @@ GBool SplashClip::test(int x, int y) {
 
   // check the paths
   if (antialias) {
+    if (mask && !maskTest(mask, x * splashAASize, y * splashAASize)) {
+      return gFalse;
+    }
     for (i = 0; i < length; ++i) {
       if (!scanners[i]->test(x * splashAASize, y * splashAASize)) {
 	return gFalse;
       }
     }
   } else {
+    if (mask && !maskTest(mask, x, y)) {
+      return gFalse;
+    }
     for (i = 0; i < length; ++i) {
       if (!scanners[i]->test(x, y)) {
 	return gFalse;
@@ -288,7 +495,7 @@ SplashClipResult SplashClip::testRect(int rectXMin, int rectYMin,
   }
   if ((SplashCoord)rectXMin >= xMin && (SplashCoord)(rectXMax + 1) <= xMax &&
       (SplashCoord)rectYMin >= yMin && (SplashCoord)(rectYMax + 1) <= yMax &&
-      length == 0) {
+      length == 0 && !mask) {
     return splashClipAllInside;
   }
   return splashClipPartial;
@@ -312,6 +519,11 @@ SplashClipResult SplashClip::testSpan(int spanXMin, int spanXMax, int spanY) {
     return splashClipPartial;
   }
   if (antialias) {
+    if (mask && !maskTestSpan(mask, spanXMin * splashAASize,
+			      spanXMax * splashAASize + (splashAASize - 1),
+			      spanY * splashAASize)) {
+      return splashClipPartial;
+    }
     for (i = 0; i < length; ++i) {
       if (!scanners[i]->testSpan(spanXMin * splashAASize,
 				 spanXMax * splashAASize + (splashAASize - 1),
@@ -320,6 +532,9 @@ SplashClipResult SplashClip::testSpan(int spanXMin, int spanXMax, int spanY) {
       }
     }
   } else {
+    if (mask && !maskTestSpan(mask, spanXMin, spanXMax, spanY)) {
+      return splashClipPartial;
+    }
     for (i = 0; i < length; ++i) {
       if (!scanners[i]->testSpan(spanXMin, spanXMax, spanY)) {
 	return splashClipPartial;
@@ -330,8 +545,8 @@ SplashClipResult SplashClip::testSpan(int spanXMin, int spanXMax, int spanY) {
 }
 
 void SplashClip::clipAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y) {
-  int xx0, xx1, xx, yy, i;
-  SplashColorPtr p;
+  int xx0, xx1, xx, yy, yy1, i;
+  SplashColorPtr p, q;
 
   // zero out pixels with x < xMin
   xx0 = *x0 * splashAASize;
@@ -375,6 +590,29 @@ void SplashClip::clipAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y) {
     *x1 = splashFloor(xMax);
   }
 
+  // check the mask: the mask is byte-aligned with aaBuf, so this is
+  // a bytewise AND (pixels outside [*x0, *x1] are already zero)
+  if (mask && *x0 <= *x1) {
+    xx0 = (*x0 * splashAASize) & ~7;
+    xx1 = (*x1 + 1) * splashAASize - 1;
+    for (yy = 0; yy < splashAASize; ++yy) {
+      p = aaBuf->getDataPtr() + yy * aaBuf->getRowSize() + (xx0 >> 3);
+      yy1 = splashAASize * y + yy;
+      if (yy1 < mask->yMin || yy1 > mask->yMax) {
+	q = NULL;
+      } else {
+	q = mask->data + (yy1 - mask->yMin) * mask->rowSize;
+      }
+      for (xx = xx0; xx <= xx1; xx += 8) {
+	if (q && xx >= mask->xMin && xx <= mask->xMax) {
+	  *p++ &= q[(xx - mask->xMin) >> 3];
+	} else {
+	  *p++ = 0;
+	}
+      }
+    }
+  }
+
   // check the paths
   for (i = 0; i < length; ++i) {
     scanners[i]->clipAALine(aaBuf, x0, x1, y);
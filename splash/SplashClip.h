@@ -18,6 +18,7 @@ class SplashPath;
 class SplashXPath;
 class SplashXPathScanner;
 class SplashBitmap;
+struct SplashClipMask;
 
 //------------------------------------------------------------------------
 
@@ -56,6 +57,12 @@ public:
   SplashError clipToPath(SplashPath *path, SplashCoord *matrix,
 			 SplashCoord flatness, GBool eo);
 
+  // Once the clip paths have <threshold> or more segments in total,
+  // rasterize them into a bitmap mask, which replaces the paths, and
+  // is shared with copies of this clip.  Zero (the default) means
+  // never.
+  void setMaskThreshold(int threshold) { maskThreshold = threshold; }
+
   // Returns true if (<x>,<y>) is inside the clip.
   GBool test(int x, int y);
 
@@ -85,13 +92,16 @@ public:
   int getYMinI() { return yMinI; }
   int getYMaxI() { return yMaxI; }
 
-  // Get the number of arbitrary paths used by the clip region.
-  int getNumPaths() { return length; }
+  // Get the number of arbitrary paths used by the clip region (a
+  // mask counts as one path).
+  int getNumPaths() { return length + (mask ? 1 : 0); }
 
 private:
 
   SplashClip(SplashClip *clip);
   void grow(int nPaths);
+  void buildMask();
+  void freeMask();
 
   GBool antialias;
   SplashCoord xMin, yMin, xMax, yMax;
@@ -100,6 +110,9 @@ private:
   Guchar *flags;
   SplashXPathScanner **scanners;
   int length, size;
+  int nSegs;			// total number of segments in paths
+  SplashClipMask *mask;		// rasterized paths (NULL if none)
+  int maskThreshold;		// see setMaskThreshold
 };
 
 #endif
@@ -46,6 +46,7 @@ SplashFont::SplashFont(SplashFontFile *fontFileA, SplashCoord *matA,
 
   cache = NULL;
   cacheTags = NULL;
+  cacheHits = cacheMisses = 0;
 
   xMin = yMin = xMax = yMax = 0;
 }
@@ -127,9 +128,11 @@ GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
       bitmap->aa = aa;
       bitmap->data = cache + (i+j) * glyphSize;
       bitmap->freeData = gFalse;
+      ++cacheHits;
       return gTrue;
     }
   }
+  ++cacheMisses;
 
   // generate the glyph bitmap
   if (!makeGlyph(c, xFrac, yFrac, &bitmap2)) {
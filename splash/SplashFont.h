@@ -74,6 +74,11 @@ public:
   // Return the path for a glyph.
   virtual SplashPath *getGlyphPath(int c) = 0;
 
+  // Number of getGlyph calls which did / didn't find the glyph in the
+  // cache.
+  int getCacheHits() { return cacheHits; }
+  int getCacheMisses() { return cacheMisses; }
+
   // Return the font transform matrix.
   SplashCoord *getMatrix() { return mat; }
 
@@ -97,6 +102,8 @@ protected:
   int glyphSize;		// size of glyph bitmaps, in bytes
   int cacheSets;		// number of sets in cache
   int cacheAssoc;		// cache associativity (glyphs per set)
+  int cacheHits;		// glyph cache statistics
+  int cacheMisses;
 };
 
 #endif
@@ -119,6 +119,7 @@ private:
 
   friend class SplashXPath;
   friend class Splash;
+  friend class SplashXPathCache;
   // this is a temporary hack, until we read FreeType paths directly
   friend class ArthurOutputDev;
 };
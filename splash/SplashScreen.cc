@@ -378,6 +378,92 @@ int SplashScreen::test(int x, int y, Guchar value) {
   return value < mat[yy * size + xx] ? 0 : 1;
 }
 
+void SplashScreen::testSpan(int x, int y, int n, Guchar *values, int step,
+			    SplashColorPtr row) {
+  Guchar *thresh;
+  SplashColorPtr p;
+  Guchar mask, fill, v, b;
+  int xx, yy, i, j;
+
+  if (n <= 0) {
+    return;
+  }
+  p = row + (x >> 3);
+  mask = 0x80 >> (x & 7);
+
+  // solid span: write whole bytes
+  if (step == 0 && isStatic(values[0])) {
+    fill = values[0] < minVal ? 0x00 : 0xff;
+    for (i = 0; i < n && mask != 0x80; ++i) {
+      *p = (*p & ~mask) | (fill & mask);
+      if (!(mask >>= 1)) {
+	mask = 0x80;
+	++p;
+      }
+    }
+    if (n - i >= 8) {
+      memset(p, fill, (n - i) >> 3);
+      p += (n - i) >> 3;
+      i += (n - i) & ~7;
+    }
+    for (; i < n; ++i) {
+      *p = (*p & ~mask) | (fill & mask);
+      mask >>= 1;
+    }
+    return;
+  }
+
+  // same tests as test(), without the per-pixel modulus
+  if ((xx = x % size) < 0) {
+    xx = -xx;
+  }
+  if ((yy = y % size) < 0) {
+    yy = -yy;
+  }
+  thresh = mat + yy * size;
+  for (i = 0; i < n && mask != 0x80; ++i) {
+    v = *values;
+    values += step;
+    if (v >= minVal && (v >= maxVal || v >= thresh[xx])) {
+      *p |= mask;
+    } else {
+      *p &= ~mask;
+    }
+    if (++xx == size) {
+      xx = 0;
+    }
+    if (!(mask >>= 1)) {
+      mask = 0x80;
+      ++p;
+    }
+  }
+  for (; n - i >= 8; i += 8) {
+    b = 0;
+    for (j = 0; j < 8; ++j) {
+      v = *values;
+      values += step;
+      b = (b << 1) | (v >= minVal && (v >= maxVal || v >= thresh[xx]));
+      if (++xx == size) {
+	xx = 0;
+      }
+    }
+    *p++ = b;
+  }
+  for (; i < n; ++i) {
+    v = *values;
+    values += step;
+    if (v >= minVal && (v >= maxVal || v >= thresh[xx])) {
+      *p |= mask;
+    } else {
+      *p &= ~mask;
+    }
+    if (++xx == size) {
+      xx = 0;
+    }
+    mask >>= 1;
+  }
+}
+
 GBool SplashScreen::isStatic(Guchar value) {
   return value < minVal || value >= maxVal;
 }
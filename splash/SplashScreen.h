@@ -30,6 +30,14 @@ public:
   // level <value> at (<x>, <y>).
   int test(int x, int y, Guchar value);
 
+  // Halftone the <n> pixels starting at (<x>, <y>), with gray levels
+  // <values>[0], <values>[step], ..., into the packed 1-bit <row>
+  // (bit 0x80 of <row>[0] is pixel 0).  Gives the same result as
+  // calling test() on each pixel; <step> = 0 fills the span with a
+  // single gray level.
+  void testSpan(int x, int y, int n, Guchar *values, int step,
+		SplashColorPtr row);
+
   // Returns true if value is above the white threshold or below the
   // black threshold, i.e., if the corresponding halftone will be
   // solid white or black.
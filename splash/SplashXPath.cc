@@ -366,36 +366,44 @@ void SplashXPath::addSegment(SplashCoord x0, SplashCoord y0,
   if (end1) {
     segs[length].flags |= splashXPathEnd1;
   }
-  if (y1 == y0) {
-    segs[length].dxdy = segs[length].dydx = 0;
-    segs[length].flags |= splashXPathHoriz;
-    if (x1 == x0) {
-      segs[length].flags |= splashXPathVert;
+  setSlope(&segs[length]);
+  ++length;
+}
+
+// Set the slopes and the horizontal/vertical/flip flags of <seg> from
+// its end points.
+void SplashXPath::setSlope(SplashXPathSeg *seg) {
+  seg->flags &= ~(splashXPathHoriz | splashXPathVert | splashXPathFlip);
+  if (seg->y1 == seg->y0) {
+    seg->dxdy = seg->dydx = 0;
+    seg->flags |= splashXPathHoriz;
+    if (seg->x1 == seg->x0) {
+      seg->flags |= splashXPathVert;
     }
-  } else if (x1 == x0) {
-    segs[length].dxdy = segs[length].dydx = 0;
-    segs[length].flags |= splashXPathVert;
+  } else if (seg->x1 == seg->x0) {
+    seg->dxdy = seg->dydx = 0;
+    seg->flags |= splashXPathVert;
   } else {
 #if USE_FIXEDPOINT
-    if (FixedPoint::divCheck(x1 - x0, y1 - y0, &segs[length].dxdy)) {
-      segs[length].dydx = (SplashCoord)1 / segs[length].dxdy;
+    if (FixedPoint::divCheck(seg->x1 - seg->x0, seg->y1 - seg->y0,
+			     &seg->dxdy)) {
+      seg->dydx = (SplashCoord)1 / seg->dxdy;
     } else {
-      segs[length].dxdy = segs[length].dydx = 0;
-      if (splashAbs(x1 - x0) > splashAbs(y1 - y0)) {
-	segs[length].flags |= splashXPathHoriz;
+      seg->dxdy = seg->dydx = 0;
+      if (splashAbs(seg->x1 - seg->x0) > splashAbs(seg->y1 - seg->y0)) {
+	seg->flags |= splashXPathHoriz;
       } else {
-	segs[length].flags |= splashXPathVert;
+	seg->flags |= splashXPathVert;
       }
     }
 #else
-    segs[length].dxdy = (x1 - x0) / (y1 - y0);
-    segs[length].dydx = (SplashCoord)1 / segs[length].dxdy;
+    seg->dxdy = (seg->x1 - seg->x0) / (seg->y1 - seg->y0);
+    seg->dydx = (SplashCoord)1 / seg->dxdy;
 #endif
   }
-  if (y0 > y1) {
-    segs[length].flags |= splashXPathFlip;
+  if (seg->y0 > seg->y1) {
+    seg->flags |= splashXPathFlip;
   }
-  ++length;
 }
 
 static int cmpXPathSegs(const void *arg0, const void *arg1) {
@@ -438,6 +446,21 @@ void SplashXPath::aaScale() {
   }
 }
 
+void SplashXPath::offset(SplashCoord dx, SplashCoord dy) {
+  SplashXPathSeg *seg;
+  int i;
+
+  for (i = 0, seg = segs; i < length; ++i, ++seg) {
+    seg->x0 += dx;
+    seg->y0 += dy;
+    seg->x1 += dx;
+    seg->y1 += dy;
+    // the slopes have to be the ones computed from the translated
+    // points, as if the path had been expanded at this position
+    setSlope(seg);
+  }
+}
+
 void SplashXPath::sort() {
   qsort(segs, length, sizeof(SplashXPathSeg), &cmpXPathSegs);
 }
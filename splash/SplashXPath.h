@@ -65,6 +65,11 @@ public:
   // anti-aliased rendering.
   void aaScale();
 
+  // Translate all coordinates by (<dx>, <dy>).
+  void offset(SplashCoord dx, SplashCoord dy);
+
+  int getLength() { return length; }
+
   // Sort by upper coordinate (lower y), in y-major order.
   void sort();
 
@@ -86,6 +91,7 @@ private:
   void addSegment(SplashCoord x0, SplashCoord y0,
 		  SplashCoord x1, SplashCoord y1,
 		  GBool first, GBool last, GBool end0, GBool end1);
+  void setSlope(SplashXPathSeg *seg);
 
   SplashXPathSeg *segs;
   int length, size;		// length and size of segs array
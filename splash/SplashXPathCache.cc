@@ -0,0 +1,170 @@
+//========================================================================
+//
+// SplashXPathCache.cc
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "SplashPath.h"
+#include "SplashXPath.h"
+#include "SplashXPathCache.h"
+
+//------------------------------------------------------------------------
+
+#define splashXPathCacheSets  64
+#define splashXPathCacheAssoc 4
+
+// Expanded paths with more segments than this are not kept.
+#define splashXPathCacheMaxSegs 2048
+
+struct SplashXPathCacheEntry {
+  Guint hash;
+  int length;			// number of points (0 if unused)
+  SplashPathPoint *pts;		// the path, in user space
+  Guchar *flags;
+  SplashCoord mat[4];		// linear part of the matrix
+  SplashCoord flatness;
+  SplashXPath *xPath;		// expanded and sorted, without the
+				//   translation
+  Guint lastUse;
+};
+
+//------------------------------------------------------------------------
+
+// Number of points which are hashed (hits are checked against the
+// whole path anyway).
+#define splashXPathCacheHashPoints 8
+
+static inline Guint hashWords(Guint h, void *data, int nBytes) {
+  Guint *p;
+  int i;
+
+  p = (Guint *)data;
+  for (i = 0; i < nBytes / (int)sizeof(Guint); ++i) {
+    h = (h ^ p[i]) * 16777619;
+  }
+  return h;
+}
+
+//------------------------------------------------------------------------
+// SplashXPathCache
+//------------------------------------------------------------------------
+
+SplashXPathCache::SplashXPathCache() {
+  int i;
+
+  entries = (SplashXPathCacheEntry *)
+                gmallocn(splashXPathCacheSets * splashXPathCacheAssoc,
+			 sizeof(SplashXPathCacheEntry));
+  for (i = 0; i < splashXPathCacheSets * splashXPathCacheAssoc; ++i) {
+    entries[i].length = 0;
+    entries[i].pts = NULL;
+    entries[i].flags = NULL;
+    entries[i].xPath = NULL;
+    entries[i].lastUse = 0;
+  }
+  mruCounter = 0;
+  hits = misses = 0;
+}
+
+SplashXPathCache::~SplashXPathCache() {
+  int i;
+
+  for (i = 0; i < splashXPathCacheSets * splashXPathCacheAssoc; ++i) {
+    gfree(entries[i].pts);
+    gfree(entries[i].flags);
+    delete entries[i].xPath;
+  }
+  gfree(entries);
+}
+
+GBool SplashXPathCache::isCacheable(SplashPath *path) {
+  // stroke adjustment depends on the position in device space
+  return path->length > 0 && path->length <= splashXPathCacheMaxPoints &&
+         path->hintsLength == 0;
+}
+
+SplashXPath *SplashXPathCache::getXPath(SplashPath *path,
+					SplashCoord *matrix,
+					SplashCoord flatness) {
+  SplashXPathCacheEntry *set, *entry;
+  SplashXPath *xPath;
+  SplashCoord mat[6];
+  Guint h;
+  int i;
+
+  mat[0] = matrix[0];
+  mat[1] = matrix[1];
+  mat[2] = matrix[2];
+  mat[3] = matrix[3];
+  mat[4] = 0;
+  mat[5] = 0;
+
+  // FNV-1a, on words
+  h = 2166136261U ^ (Guint)path->length;
+  h = hashWords(h, path->pts,
+		(path->length < splashXPathCacheHashPoints
+		   ? path->length : splashXPathCacheHashPoints)
+		* sizeof(SplashPathPoint));
+  h = hashWords(h, mat, 4 * sizeof(SplashCoord));
+
+  // look for the path
+  set = &entries[(h % splashXPathCacheSets) * splashXPathCacheAssoc];
+  for (i = 0; i < splashXPathCacheAssoc; ++i) {
+    entry = &set[i];
+    if (entry->length == path->length && entry->hash == h &&
+	entry->mat[0] == mat[0] && entry->mat[1] == mat[1] &&
+	entry->mat[2] == mat[2] && entry->mat[3] == mat[3] &&
+	entry->flatness == flatness &&
+	!memcmp(entry->pts, path->pts,
+		path->length * sizeof(SplashPathPoint)) &&
+	!memcmp(entry->flags, path->flags, path->length)) {
+      ++hits;
+      entry->lastUse = ++mruCounter;
+      xPath = entry->xPath->copy();
+      xPath->offset(matrix[4], matrix[5]);
+      return xPath;
+    }
+  }
+  ++misses;
+
+  // expand the path without the translation, and keep a copy in the
+  // least recently used entry of the set
+  xPath = new SplashXPath(path, mat, flatness, gTrue);
+  xPath->sort();
+  if (xPath->getLength() <= splashXPathCacheMaxSegs) {
+    entry = &set[0];
+    for (i = 1; i < splashXPathCacheAssoc; ++i) {
+      if (set[i].lastUse < entry->lastUse) {
+	entry = &set[i];
+      }
+    }
+    if (entry->length < path->length) {
+      entry->pts = (SplashPathPoint *)greallocn(entry->pts, path->length,
+						sizeof(SplashPathPoint));
+      entry->flags = (Guchar *)greallocn(entry->flags, path->length,
+					 sizeof(Guchar));
+    }
+    memcpy(entry->pts, path->pts, path->length * sizeof(SplashPathPoint));
+    memcpy(entry->flags, path->flags, path->length);
+    entry->length = path->length;
+    entry->hash = h;
+    entry->mat[0] = mat[0];
+    entry->mat[1] = mat[1];
+    entry->mat[2] = mat[2];
+    entry->mat[3] = mat[3];
+    entry->flatness = flatness;
+    delete entry->xPath;
+    entry->xPath = xPath->copy();
+    entry->lastUse = ++mruCounter;
+  }
+  xPath->offset(matrix[4], matrix[5]);
+  return xPath;
+}
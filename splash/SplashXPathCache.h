@@ -0,0 +1,59 @@
+//========================================================================
+//
+// SplashXPathCache.h
+//
+//========================================================================
+
+#ifndef SPLASHXPATHCACHE_H
+#define SPLASHXPATHCACHE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "SplashTypes.h"
+
+class SplashPath;
+class SplashXPath;
+struct SplashXPathCacheEntry;
+
+//------------------------------------------------------------------------
+
+// Only paths with at most this many points are cached.
+#define splashXPathCacheMaxPoints 256
+
+//------------------------------------------------------------------------
+// SplashXPathCache
+//------------------------------------------------------------------------
+
+// Caches the expanded and sorted form of small fill paths, keyed by
+// the path (in user space) and the linear part of the matrix.  A
+// shape which is drawn repeatedly at different positions (a map
+// symbol, an arrowhead) is only flattened and sorted once; each use
+// gets a copy, translated into place.
+class SplashXPathCache {
+public:
+
+  SplashXPathCache();
+  ~SplashXPathCache();
+
+  // Returns true if <path> can be cached.
+  static GBool isCacheable(SplashPath *path);
+
+  // Returns an expanded, sorted copy of <path>, transformed by
+  // <matrix>, with all subpaths closed.  The caller owns the copy.
+  SplashXPath *getXPath(SplashPath *path, SplashCoord *matrix,
+			SplashCoord flatness);
+
+  int getHits() { return hits; }
+  int getMisses() { return misses; }
+
+private:
+
+  SplashXPathCacheEntry *entries;
+  Guint mruCounter;
+  int hits, misses;
+};
+
+#endif
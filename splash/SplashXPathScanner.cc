@@ -91,11 +91,14 @@ SplashXPathScanner::SplashXPathScanner(SplashXPath *xPathA, GBool eoA) {
 
   interY = yMin - 1;
   xPathIdx = 0;
+  active = NULL;
+  activeLen = activeSize = 0;
   inter = NULL;
   interLen = interSize = 0;
 }
 
 SplashXPathScanner::~SplashXPathScanner() {
+  gfree(active);
   gfree(inter);
 }
 
@@ -196,23 +199,41 @@ GBool SplashXPathScanner::getNextSpan(int y, int *x0, int *x1) {
 }
 
 void SplashXPathScanner::computeIntersections(int y) {
-  SplashCoord xSegMin, xSegMax, ySegMin, ySegMax, xx0, xx1;
+  SplashCoord ySegMin, ySegMax;
   SplashXPathSeg *seg;
+  SplashIntersect t;
   int i, j;
 
-  // find the first segment that intersects [y, y+1)
-  i = (y >= interY) ? xPathIdx : 0;
-  while (i < xPath->length &&
-	 xPath->segs[i].y0 < y && xPath->segs[i].y1 < y) {
-    ++i;
+  // the active list holds the segments whose y range overlaps
+  // [y, y+1), in xPath order, so segments that ended on earlier lines
+  // are not scanned again; it is rebuilt if y moves backward
+  if (y < interY) {
+    xPathIdx = 0;
+    activeLen = 0;
+  }
+  if (interSize < activeLen) {
+    interSize = activeLen;
+    inter = (SplashIntersect *)greallocn(inter, interSize,
+					 sizeof(SplashIntersect));
   }
-  xPathIdx = i;
 
-  // find all of the segments that intersect [y, y+1) and create an
-  // Intersect element for each one
+  // drop the segments that end before y, and intersect the others
+  // with [y, y+1)
   interLen = 0;
-  for (j = i; j < xPath->length; ++j) {
-    seg = &xPath->segs[j];
+  for (i = 0; i < activeLen; ++i) {
+    seg = &xPath->segs[active[i]];
+    ySegMax = (seg->flags & splashXPathFlip) ? seg->y0 : seg->y1;
+    if (ySegMax >= y) {
+      active[interLen] = active[i];
+      addIntersection(seg, y);
+    }
+  }
+  activeLen = interLen;
+
+  // add the segments that start before y+1 (the xPath is sorted by
+  // the upper end point)
+  for (; xPathIdx < xPath->length; ++xPathIdx) {
+    seg = &xPath->segs[xPathIdx];
     if (seg->flags & splashXPathFlip) {
       ySegMin = seg->y1;
       ySegMax = seg->y0;
@@ -220,80 +241,103 @@ void SplashXPathScanner::computeIntersections(int y) {
       ySegMin = seg->y0;
       ySegMax = seg->y1;
     }
-
-    // ensure that:      ySegMin < y+1
-    //              y <= ySegMax
     if (ySegMin >= y + 1) {
       break;
     }
-    if (ySegMax < y) {
-      continue;
-    }
-
-    if (interLen == interSize) {
-      if (interSize == 0) {
-	interSize = 16;
-      } else {
-	interSize *= 2;
+    if (ySegMax >= y) {
+      if (activeLen == activeSize) {
+	activeSize = activeSize ? 2 * activeSize : 16;
+	active = (int *)greallocn(active, activeSize, sizeof(int));
       }
-      inter = (SplashIntersect *)greallocn(inter, interSize,
-					   sizeof(SplashIntersect));
+      if (interLen == interSize) {
+	interSize = interSize ? 2 * interSize : 16;
+	inter = (SplashIntersect *)greallocn(inter, interSize,
+					     sizeof(SplashIntersect));
+      }
+      active[activeLen++] = xPathIdx;
+      addIntersection(seg, y);
     }
+  }
 
-    if (seg->flags & splashXPathHoriz) {
-      xx0 = seg->x0;
-      xx1 = seg->x1;
-    } else if (seg->flags & splashXPathVert) {
-      xx0 = xx1 = seg->x0;
-    } else {
-      if (seg->x0 < seg->x1) {
-	xSegMin = seg->x0;
-	xSegMax = seg->x1;
-      } else {
-	xSegMin = seg->x1;
-	xSegMax = seg->x0;
-      }
-      // intersection with top edge
-      xx0 = seg->x0 + ((SplashCoord)y - seg->y0) * seg->dxdy;
-      // intersection with bottom edge
-      xx1 = seg->x0 + ((SplashCoord)y + 1 - seg->y0) * seg->dxdy;
-      // the segment may not actually extend to the top and/or bottom edges
-      if (xx0 < xSegMin) {
-	xx0 = xSegMin;
-      } else if (xx0 > xSegMax) {
-	xx0 = xSegMax;
+  // the intersections are usually few, and insertion sort (which is
+  // stable, like the glibc qsort) is much cheaper for those
+  if (interLen <= 32) {
+    for (i = 1; i < interLen; ++i) {
+      t = inter[i];
+      for (j = i; j > 0 && inter[j-1].x0 > t.x0; --j) {
+	inter[j] = inter[j-1];
       }
-      if (xx1 < xSegMin) {
-	xx1 = xSegMin;
-      } else if (xx1 > xSegMax) {
-	xx1 = xSegMax;
-      }
-    }
-    if (xx0 < xx1) {
-      inter[interLen].x0 = splashFloor(xx0);
-      inter[interLen].x1 = splashFloor(xx1);
-    } else {
-      inter[interLen].x0 = splashFloor(xx1);
-      inter[interLen].x1 = splashFloor(xx0);
-    }
-    if (ySegMin <= y &&
-	(SplashCoord)y < ySegMax &&
-	!(seg->flags & splashXPathHoriz)) {
-      inter[interLen].count = eo ? 1
-	                         : (seg->flags & splashXPathFlip) ? 1 : -1;
-    } else {
-      inter[interLen].count = 0;
+      inter[j] = t;
     }
-    ++interLen;
+  } else {
+    qsort(inter, interLen, sizeof(SplashIntersect), &cmpIntersect);
   }
 
-  qsort(inter, interLen, sizeof(SplashIntersect), &cmpIntersect);
-
   interY = y;
   interIdx = 0;
   interCount = 0;
 }
 
+// Append the intersection of <seg> with [y, y+1) to <inter>, which
+// must have room for it.
+void SplashXPathScanner::addIntersection(SplashXPathSeg *seg, int y) {
+  SplashCoord xSegMin, xSegMax, ySegMin, ySegMax, xx0, xx1;
+  SplashIntersect *p;
+
+  if (seg->flags & splashXPathFlip) {
+    ySegMin = seg->y1;
+    ySegMax = seg->y0;
+  } else {
+    ySegMin = seg->y0;
+    ySegMax = seg->y1;
+  }
+
+  if (seg->flags & splashXPathHoriz) {
+    xx0 = seg->x0;
+    xx1 = seg->x1;
+  } else if (seg->flags & splashXPathVert) {
+    xx0 = xx1 = seg->x0;
+  } else {
+    if (seg->x0 < seg->x1) {
+      xSegMin = seg->x0;
+      xSegMax = seg->x1;
+    } else {
+      xSegMin = seg->x1;
+      xSegMax = seg->x0;
+    }
+    // intersection with top edge
+    xx0 = seg->x0 + ((SplashCoord)y - seg->y0) * seg->dxdy;
+    // intersection with bottom edge
+    xx1 = seg->x0 + ((SplashCoord)y + 1 - seg->y0) * seg->dxdy;
+    // the segment may not actually extend to the top and/or bottom edges
+    if (xx0 < xSegMin) {
+      xx0 = xSegMin;
+    } else if (xx0 > xSegMax) {
+      xx0 = xSegMax;
+    }
+    if (xx1 < xSegMin) {
+      xx1 = xSegMin;
+    } else if (xx1 > xSegMax) {
+      xx1 = xSegMax;
+    }
+  }
+  p = &inter[interLen++];
+  if (xx0 < xx1) {
+    p->x0 = splashFloor(xx0);
+    p->x1 = splashFloor(xx1);
+  } else {
+    p->x0 = splashFloor(xx1);
+    p->x1 = splashFloor(xx0);
+  }
+  if (ySegMin <= y &&
+      (SplashCoord)y < ySegMax &&
+      !(seg->flags & splashXPathHoriz)) {
+    p->count = eo ? 1 : (seg->flags & splashXPathFlip) ? 1 : -1;
+  } else {
+    p->count = 0;
+  }
+}
+
 void SplashXPathScanner::renderAALine(SplashBitmap *aaBuf,
 				      int *x0, int *x1, int y) {
   int xx0, xx1, xx, xxMin, xxMax, yy;
@@ -394,10 +438,10 @@ void SplashXPathScanner::clipAALine(SplashBitmap *aaBuf,
 	  *p++ &= mask;
 	  xx = (xx & ~7) + 8;
 	}
-	for (; xx + 7 <= xx0; xx += 8) {
+	for (; xx + 8 <= xx0; xx += 8) {
 	  *p++ = 0x00;
 	}
-	if (xx <= xx0) {
+	if (xx < xx0) {
 	  *p &= 0xff >> (xx0 & 7);
 	}
       }
@@ -412,15 +456,15 @@ void SplashXPathScanner::clipAALine(SplashBitmap *aaBuf,
       if (xx & 7) {
 	mask = (Guchar)(0xff00 >> (xx & 7));
 	if ((xx & ~7) == (xx0 & ~7)) {
-	  mask &= 0xff >> (xx0 & 7);
+	  mask |= 0xff >> (xx0 & 7);
 	}
 	*p++ &= mask;
 	xx = (xx & ~7) + 8;
       }
-      for (; xx + 7 <= xx0; xx += 8) {
+      for (; xx + 8 <= xx0; xx += 8) {
 	*p++ = 0x00;
       }
-      if (xx <= xx0) {
+      if (xx < xx0) {
 	*p &= 0xff >> (xx0 & 7);
       }
     }
@@ -15,6 +15,7 @@
 
 class SplashXPath;
 class SplashBitmap;
+struct SplashXPathSeg;
 struct SplashIntersect;
 
 //------------------------------------------------------------------------
@@ -65,6 +66,7 @@ public:
 private:
 
   void computeIntersections(int y);
+  void addIntersection(SplashXPathSeg *seg, int y);
 
   SplashXPath *xPath;
   GBool eo;
@@ -75,8 +77,12 @@ private:
 				//   getNextSpan 
   int interCount;		// current EO/NZWN counter - used by
 				//   getNextSpan
-  int xPathIdx;			// current index into <xPath> - used by
-				//   computeIntersections
+  int xPathIdx;			// next segment in <xPath> to be added to
+				//   <active> - used by computeIntersections
+  int *active;			// indexes of the segments that intersect
+				//   [interY, interY+1)
+  int activeLen;		// number of entries in <active>
+  int activeSize;		// size of the <active> array
   SplashIntersect *inter;	// intersections array for <interY>
   int interLen;			// number of intersections in <inter>
   int interSize;		// size of the <inter> array
@@ -0,0 +1,691 @@
+//========================================================================
+//
+// corpus-perf.cc
+//
+// Benchmarks a corpus of PDF files with the Splash, Cairo, text and
+// PostScript output devices, and compares the results with those of
+// an earlier run.
+//
+// Every page is rendered -loops times, by each device in -dev and (for
+// Splash and Cairo) at each resolution in -r.  For each page, the
+// wall time of the first render, the mean, standard deviation and
+// minimum over all renders, the peak RSS and the number of memory
+// allocations per render are recorded.  For PostScript, page 0 is the
+// document setup done by the PSOutputDev constructor.
+//
+// Results are written (with -o) as tab-separated lines:
+//
+//   file device dpi page loops first mean stddev min peakRSS allocs
+//
+// with times in milliseconds and the peak RSS in kB.  A file written
+// this way can be given back with -baseline.  A page is then reported
+// as a regression if its mean time grew by more than -threshold
+// percent and by more than -min ms, and the change is significant
+// (Welch's t statistic is above -t).  Allocation counts and peak RSS
+// are compared with the same percentage threshold.  The exit status
+// is 1 if there are regressions.
+//
+// Usage: corpus-perf [-dev splash,cairo,text,ps] [-r 72,150]
+//                    [-loops <n>] [-pages <n>] [-o <file>]
+//                    [-baseline <file>] [-threshold <percent>]
+//                    [-t <value>] [-min <ms>] <file or dir> ...
+//
+// Peak RSS (per page) and allocation counts are only measured on
+// Linux with glibc.
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#if HAVE_CAIRO
+#include <cairo.h>
+#endif
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "goo/GooList.h"
+#include "goo/GooHash.h"
+#include "goo/GooTimer.h"
+#include "goo/gfile.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "PDFDoc.h"
+#include "splash/SplashTypes.h"
+#include "SplashOutputDev.h"
+#include "TextOutputDev.h"
+#include "PSOutputDev.h"
+#if HAVE_CAIRO
+#include "CairoOutputDev.h"
+#endif
+
+#define maxResolutions 16
+
+static GBool useSplash = gTrue;
+static GBool useCairo = gFalse;
+static GBool useText = gFalse;
+static GBool usePS = gFalse;
+static int resolutions[maxResolutions] = { 150 };
+static int nResolutions = 1;
+static int loops = 5;
+static int maxPages = 0;
+static char *outFileName = NULL;
+static char *baselineFileName = NULL;
+static double threshold = 10;
+static double tMin = 3;
+static double minDiff = 0.2;
+
+//------------------------------------------------------------------------
+// allocation counting
+//------------------------------------------------------------------------
+
+#ifdef __GLIBC__
+
+// With glibc, the malloc functions defined here replace the library's
+// for the whole process (including libpoppler, and operator new), and
+// count the calls.
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+static double nAllocs = 0;
+
+extern "C" void *malloc(size_t size) {
+  ++nAllocs;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+  ++nAllocs;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) {
+  ++nAllocs;
+  return __libc_realloc(p, size);
+}
+
+static double getAllocCount() {
+  return nAllocs;
+}
+
+#else
+
+static double getAllocCount() {
+  return 0;
+}
+
+#endif
+
+//------------------------------------------------------------------------
+// peak RSS
+//------------------------------------------------------------------------
+
+// Reset the peak RSS to the current RSS (Linux 4.0 and later).
+static void resetPeakRSS() {
+#ifdef __linux__
+  FILE *f;
+
+  if ((f = fopen("/proc/self/clear_refs", "w"))) {
+    fputs("5", f);
+    fclose(f);
+  }
+#endif
+}
+
+// Returns the peak RSS in kB, or 0 if it's unknown.
+static long getPeakRSS() {
+  long rss;
+#ifdef __linux__
+  FILE *f;
+  char line[256];
+
+  rss = 0;
+  if ((f = fopen("/proc/self/status", "r"))) {
+    while (fgets(line, sizeof(line), f)) {
+      if (!strncmp(line, "VmHWM:", 6)) {
+	rss = atol(line + 6);
+	break;
+      }
+    }
+    fclose(f);
+  }
+#else
+  rss = 0;
+#endif
+  return rss;
+}
+
+//------------------------------------------------------------------------
+// PageResult
+//------------------------------------------------------------------------
+
+struct PageResult {
+  GooString *key;		// file, device, dpi and page, tab-separated
+  GooString *device;		// device name (plus "/dpi")
+  int loops;
+  double first;			// times in ms
+  double mean;
+  double stddev;
+  double min;
+  long peakRSS;			// kB
+  double allocs;		// allocations per render
+
+  ~PageResult() { delete key; delete device; }
+};
+
+static GooList *results;
+
+static PageResult *makeResult(GooString *fileName, const char *device,
+			      int dpi, int page) {
+  PageResult *r;
+
+  r = new PageResult;
+  r->key = GooString::format("{0:t}\t{1:s}\t{2:d}\t{3:d}",
+			     fileName, device, dpi, page);
+  r->device = GooString::format("{0:s}/{1:d}", device, dpi);
+  return r;
+}
+
+static void writeResult(FILE *f, PageResult *r) {
+  fprintf(f, "%s\t%d\t%.4f\t%.4f\t%.4f\t%.4f\t%ld\t%.0f\n",
+	  r->key->getCString(), r->loops, r->first, r->mean, r->stddev,
+	  r->min, r->peakRSS, r->allocs);
+}
+
+// Read the results written by writeResult into a hash (key ->
+// PageResult).  Returns NULL if <fileName> can't be read.
+static GooHash *readResults(char *fileName) {
+  GooHash *hash;
+  PageResult *r;
+  FILE *f;
+  char line[4096], device[64];
+  char *p, *fields;
+  int dpi, page, i;
+
+  if (!(f = fopen(fileName, "r"))) {
+    return NULL;
+  }
+  hash = new GooHash(gTrue);
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || !(p = strchr(line, '\t'))) {
+      continue;
+    }
+    // skip the file name, which can contain spaces
+    *p = '\0';
+    r = new PageResult;
+    if (sscanf(p + 1, "%63s %d %d %d %lf %lf %lf %lf %ld %lf", device,
+	       &dpi, &page, &r->loops, &r->first, &r->mean, &r->stddev,
+	       &r->min, &r->peakRSS, &r->allocs) != 10) {
+      r->key = r->device = NULL;
+      delete r;
+      continue;
+    }
+    // the key is everything up to the fourth tab
+    *p = '\t';
+    fields = p;
+    for (i = 0; i < 3 && fields; ++i) {
+      fields = strchr(fields + 1, '\t');
+    }
+    if (!fields) {
+      r->key = r->device = NULL;
+      delete r;
+      continue;
+    }
+    r->key = new GooString(line, (int)(fields - line));
+    r->device = GooString::format("{0:s}/{1:d}", device, dpi);
+    hash->replace(r->key->copy(), r);
+  }
+  fclose(f);
+  return hash;
+}
+
+//------------------------------------------------------------------------
+// running the devices
+//------------------------------------------------------------------------
+
+// Accumulates the render times for one page.
+class PageTimes {
+public:
+
+  PageTimes() { n = 0; sum = sum2 = 0; first = min = 0; }
+  void add(double t) {
+    if (n == 0) {
+      first = min = t;
+    } else if (t < min) {
+      min = t;
+    }
+    sum += t;
+    sum2 += t * t;
+    ++n;
+  }
+  void fill(PageResult *r) {
+    double var;
+
+    r->loops = n;
+    r->first = first * 1000;
+    r->min = min * 1000;
+    r->mean = n ? sum / n * 1000 : 0;
+    var = n > 1 ? (sum2 - sum * sum / n) / (n - 1) : 0;
+    r->stddev = var > 0 ? sqrt(var) * 1000 : 0;
+  }
+
+private:
+
+  int n;
+  double sum, sum2, first, min;
+};
+
+// Render page <pg> of <doc> on <out>.  For Cairo, a surface of the
+// right size is set up first.
+static void renderPage(PDFDoc *doc, OutputDev *out, const char *device,
+		       int pg, int dpi) {
+#if HAVE_CAIRO
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  int w, h;
+
+  if (!strcmp(device, "cairo")) {
+    w = (int)ceil(doc->getPageCropWidth(pg) * dpi / 72);
+    h = (int)ceil(doc->getPageCropHeight(pg) * dpi / 72);
+    if (doc->getPageRotate(pg) == 90 || doc->getPageRotate(pg) == 270) {
+      int t = w;
+      w = h;
+      h = t;
+    }
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+    cr = cairo_create(surface);
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_paint(cr);
+    ((CairoOutputDev *)out)->setCairo(cr);
+    doc->displayPage(out, pg, dpi, dpi, 0, gFalse, gTrue, gFalse);
+    ((CairoOutputDev *)out)->setCairo(NULL);
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+    return;
+  }
+#endif
+  doc->displayPage(out, pg, dpi, dpi, 0, gFalse, gTrue, gFalse);
+}
+
+static void nullOutput(void *stream, char *data, int len) {
+  *(double *)stream += len;
+}
+
+// Run <device> at <dpi> over the first <nPages> pages of <doc>.
+static void runDevice(GooString *fileName, PDFDoc *doc, int nPages,
+		      const char *device, int dpi) {
+  OutputDev *out;
+  PageResult *r;
+  PageTimes *times;
+  GooTimer timer;
+  SplashColor paperColor;
+  double psBytes, allocs;
+  GBool ok;
+  int pg, i;
+
+  out = NULL;
+  ok = gTrue;
+  psBytes = 0;
+  if (!strcmp(device, "splash")) {
+    paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+    out = new SplashOutputDev(splashModeRGB8, 4, gFalse, paperColor);
+    ((SplashOutputDev *)out)->startDoc(doc->getXRef());
+#if HAVE_CAIRO
+  } else if (!strcmp(device, "cairo")) {
+    out = new CairoOutputDev();
+    ((CairoOutputDev *)out)->startDoc(doc->getXRef());
+#endif
+  } else if (!strcmp(device, "text")) {
+    out = new TextOutputDev(NULL, gFalse, gFalse, gFalse);
+    ok = ((TextOutputDev *)out)->isOk();
+  } else if (!strcmp(device, "ps")) {
+    // the constructor writes the document setup (fonts, forms, ...)
+    r = makeResult(fileName, device, dpi, 0);
+    resetPeakRSS();
+    allocs = getAllocCount();
+    timer.start();
+    out = new PSOutputDev(&nullOutput, &psBytes, (char *)"corpus-perf",
+			  doc->getXRef(), doc->getCatalog(), 1, nPages,
+			  psModePS);
+    timer.stop();
+    ok = ((PSOutputDev *)out)->isOk();
+    times = new PageTimes();
+    times->add(timer.getElapsed());
+    times->fill(r);
+    r->peakRSS = getPeakRSS();
+    r->allocs = getAllocCount() - allocs;
+    results->append(r);
+    delete times;
+  }
+  if (!ok) {
+    fprintf(stderr, "%s: couldn't create %s output device\n",
+	    fileName->getCString(), device);
+    if (out) {
+      delete out;
+    }
+    return;
+  }
+
+  for (pg = 1; pg <= nPages; ++pg) {
+    r = makeResult(fileName, device, dpi, pg);
+    times = new PageTimes();
+    resetPeakRSS();
+    allocs = getAllocCount();
+    for (i = 0; i < loops; ++i) {
+      timer.start();
+      renderPage(doc, out, device, pg, dpi);
+      timer.stop();
+      times->add(timer.getElapsed());
+    }
+    times->fill(r);
+    r->peakRSS = getPeakRSS();
+    r->allocs = (getAllocCount() - allocs) / loops;
+    results->append(r);
+    delete times;
+  }
+
+  delete out;
+}
+
+static void runFile(GooString *fileName) {
+  PDFDoc *doc;
+  int nPages, i;
+
+  doc = new PDFDoc(fileName->copy());
+  if (!doc->isOk()) {
+    fprintf(stderr, "%s: couldn't open\n", fileName->getCString());
+    delete doc;
+    return;
+  }
+  nPages = doc->getNumPages();
+  if (maxPages > 0 && nPages > maxPages) {
+    nPages = maxPages;
+  }
+  if (useSplash) {
+    for (i = 0; i < nResolutions; ++i) {
+      runDevice(fileName, doc, nPages, "splash", resolutions[i]);
+    }
+  }
+  if (useCairo) {
+    for (i = 0; i < nResolutions; ++i) {
+      runDevice(fileName, doc, nPages, "cairo", resolutions[i]);
+    }
+  }
+  if (useText) {
+    runDevice(fileName, doc, nPages, "text", 72);
+  }
+  if (usePS) {
+    runDevice(fileName, doc, nPages, "ps", 72);
+  }
+  delete doc;
+}
+
+static void runPath(GooString *path) {
+  GDir *dir;
+  GDirEntry *ent;
+  FILE *f;
+
+  // directories are scanned recursively for PDF files
+  if (!(f = fopen(path->getCString(), "rb"))) {
+    fprintf(stderr, "%s: couldn't open\n", path->getCString());
+    return;
+  }
+  fclose(f);
+  dir = new GDir(path->getCString(), gTrue);
+  if (!(ent = dir->getNextEntry())) {
+    runFile(path);
+  } else {
+    do {
+      if (ent->isDir()) {
+	if (ent->getName()->cmp(".") && ent->getName()->cmp("..")) {
+	  runPath(ent->getFullPath());
+	}
+      } else if (ent->getName()->getLength() > 4 &&
+		 !strcasecmp(ent->getName()->getCString() +
+			     ent->getName()->getLength() - 4, ".pdf")) {
+	runFile(ent->getFullPath());
+      }
+      delete ent;
+    } while ((ent = dir->getNextEntry()));
+  }
+  delete dir;
+}
+
+//------------------------------------------------------------------------
+// comparing with the baseline
+//------------------------------------------------------------------------
+
+struct DeviceTotals {
+  double base, cur;
+  int nPages;
+};
+
+// Welch's t statistic for the difference between the means.
+static double welchT(PageResult *base, PageResult *cur) {
+  double se;
+
+  se = 0;
+  if (base->loops > 0) {
+    se += base->stddev * base->stddev / base->loops;
+  }
+  if (cur->loops > 0) {
+    se += cur->stddev * cur->stddev / cur->loops;
+  }
+  if (se <= 0) {
+    return cur->mean > base->mean ? HUGE_VAL
+                                  : cur->mean < base->mean ? -HUGE_VAL : 0;
+  }
+  return (cur->mean - base->mean) / sqrt(se);
+}
+
+static GBool grewBy(double base, double cur, double pct) {
+  return cur > base * (1 + pct / 100);
+}
+
+// Print the regressions (and significant improvements) with respect
+// to <baseline>, and per-device totals.  Returns the number of
+// regressions.
+static int compare(GooHash *baseline) {
+  GooHash *totals;
+  GooHashIter *iter;
+  GooString *key;
+  DeviceTotals *tot;
+  PageResult *base, *cur;
+  double t;
+  int nRegressions, nImprovements, nMissing, i;
+
+  totals = new GooHash(gTrue);
+  nRegressions = nImprovements = nMissing = 0;
+  for (i = 0; i < results->getLength(); ++i) {
+    cur = (PageResult *)results->get(i);
+    if (!(base = (PageResult *)baseline->lookup(cur->key))) {
+      ++nMissing;
+      continue;
+    }
+    if (!(tot = (DeviceTotals *)totals->lookup(cur->device))) {
+      tot = new DeviceTotals;
+      tot->base = tot->cur = 0;
+      tot->nPages = 0;
+      totals->add(cur->device->copy(), tot);
+    }
+    tot->base += base->mean;
+    tot->cur += cur->mean;
+    ++tot->nPages;
+
+    t = welchT(base, cur);
+    if (grewBy(base->mean, cur->mean, threshold) &&
+	cur->mean - base->mean > minDiff && t > tMin) {
+      printf("REGRESSION time   %s: %.3f -> %.3f ms (%+.1f%%, t = %.1f)\n",
+	     cur->key->getCString(), base->mean, cur->mean,
+	     (cur->mean / base->mean - 1) * 100, t);
+      ++nRegressions;
+    } else if (grewBy(cur->mean, base->mean, threshold) &&
+	       base->mean - cur->mean > minDiff && t < -tMin) {
+      printf("improvement time  %s: %.3f -> %.3f ms (%+.1f%%, t = %.1f)\n",
+	     cur->key->getCString(), base->mean, cur->mean,
+	     (cur->mean / base->mean - 1) * 100, t);
+      ++nImprovements;
+    }
+    if (grewBy(base->allocs, cur->allocs, threshold) &&
+	cur->allocs - base->allocs >= 10) {
+      printf("REGRESSION allocs %s: %.0f -> %.0f\n",
+	     cur->key->getCString(), base->allocs, cur->allocs);
+      ++nRegressions;
+    }
+    // small RSS changes are mostly noise from the allocator
+    if (base->peakRSS > 0 &&
+	grewBy((double)base->peakRSS, (double)cur->peakRSS, threshold) &&
+	cur->peakRSS - base->peakRSS > 1024) {
+      printf("REGRESSION rss    %s: %ld -> %ld kB\n",
+	     cur->key->getCString(), base->peakRSS, cur->peakRSS);
+      ++nRegressions;
+    }
+  }
+
+  totals->startIter(&iter);
+  while (totals->getNext(&iter, &key, (void **)&tot)) {
+    printf("%-12s %6d pages: %10.3f -> %10.3f ms (%+.1f%%)\n",
+	   key->getCString(), tot->nPages, tot->base, tot->cur,
+	   tot->base > 0 ? (tot->cur / tot->base - 1) * 100 : 0.0);
+  }
+  deleteGooHash(totals, DeviceTotals);
+
+  printf("%d regressions, %d improvements", nRegressions, nImprovements);
+  if (nMissing) {
+    printf(", %d pages not in the baseline", nMissing);
+  }
+  printf("\n");
+  return nRegressions;
+}
+
+//------------------------------------------------------------------------
+
+static GBool parseDevices(char *s) {
+  GooString *dev;
+  char *p;
+
+  useSplash = useCairo = useText = usePS = gFalse;
+  while (*s) {
+    if (!(p = strchr(s, ','))) {
+      p = s + strlen(s);
+    }
+    dev = new GooString(s, (int)(p - s));
+    if (!dev->cmp("splash")) {
+      useSplash = gTrue;
+    } else if (!dev->cmp("cairo")) {
+#if HAVE_CAIRO
+      useCairo = gTrue;
+#else
+      fprintf(stderr, "Cairo output isn't available in this build\n");
+#endif
+    } else if (!dev->cmp("text")) {
+      useText = gTrue;
+    } else if (!dev->cmp("ps")) {
+      usePS = gTrue;
+    } else {
+      fprintf(stderr, "Unknown output device '%s'\n", dev->getCString());
+      delete dev;
+      return gFalse;
+    }
+    delete dev;
+    s = *p ? p + 1 : p;
+  }
+  return gTrue;
+}
+
+static GBool parseResolutions(char *s) {
+  char *p;
+
+  nResolutions = 0;
+  while (*s && nResolutions < maxResolutions) {
+    resolutions[nResolutions] = (int)strtol(s, &p, 10);
+    if (p == s || resolutions[nResolutions] <= 0) {
+      return gFalse;
+    }
+    ++nResolutions;
+    s = *p == ',' ? p + 1 : p;
+  }
+  return nResolutions > 0;
+}
+
+int main(int argc, char *argv[]) {
+  GooHash *baseline;
+  GooString *path;
+  FILE *f;
+  int nRegressions, i;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+  results = new GooList();
+
+  for (i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-dev") && i + 1 < argc) {
+      if (!parseDevices(argv[++i])) {
+	return 2;
+      }
+    } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+      if (!parseResolutions(argv[++i])) {
+	fprintf(stderr, "Bad resolution list '%s'\n", argv[i]);
+	return 2;
+      }
+    } else if (!strcmp(argv[i], "-loops") && i + 1 < argc) {
+      loops = atoi(argv[++i]);
+      if (loops < 1) {
+	loops = 1;
+      }
+    } else if (!strcmp(argv[i], "-pages") && i + 1 < argc) {
+      maxPages = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      outFileName = argv[++i];
+    } else if (!strcmp(argv[i], "-baseline") && i + 1 < argc) {
+      baselineFileName = argv[++i];
+    } else if (!strcmp(argv[i], "-threshold") && i + 1 < argc) {
+      threshold = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+      tMin = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-min") && i + 1 < argc) {
+      minDiff = atof(argv[++i]);
+    } else {
+      path = new GooString(argv[i]);
+      runPath(path);
+      delete path;
+    }
+  }
+
+  if (outFileName) {
+    if (!(f = fopen(outFileName, "w"))) {
+      fprintf(stderr, "%s: couldn't write\n", outFileName);
+      return 2;
+    }
+    fprintf(f, "# file\tdevice\tdpi\tpage\tloops\tfirst\tmean\tstddev"
+	    "\tmin\tpeakRSS\tallocs\n");
+    for (i = 0; i < results->getLength(); ++i) {
+      writeResult(f, (PageResult *)results->get(i));
+    }
+    fclose(f);
+  } else if (!baselineFileName) {
+    for (i = 0; i < results->getLength(); ++i) {
+      writeResult(stdout, (PageResult *)results->get(i));
+    }
+  }
+
+  nRegressions = 0;
+  if (baselineFileName) {
+    if (!(baseline = readResults(baselineFileName))) {
+      fprintf(stderr, "%s: couldn't read\n", baselineFileName);
+      return 2;
+    }
+    nRegressions = compare(baseline);
+    deleteGooHash(baseline, PageResult);
+  }
+
+  deleteGooList(results, PageResult);
+  delete globalParams;
+  return nRegressions > 0 ? 1 : 0;
+}
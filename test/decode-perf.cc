@@ -0,0 +1,187 @@
+//========================================================================
+//
+// decode-perf.cc
+//
+// Measures how fast poppler decodes the image streams in a corpus of
+// PDF files.  Every stream whose outermost filter matches -filter
+// (JBIG2Decode by default) is fully decoded -loops times, and the
+// per-file and total decode times are printed.  Streams are read one
+// char at a time with getChar, or in blocks with getChars if -bulk is
+// given.
+//
+// Usage: decode-perf [-filter <name>] [-loops <n>] [-bulk]
+//                    <file or dir> ...
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "goo/gfile.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "PDFDoc.h"
+
+static const char *filterName = "JBIG2Decode";
+static int loops = 1;
+static GBool bulk = gFalse;
+
+static int totalStreams = 0;
+static double totalBytes = 0;
+static double totalTime = 0;
+
+// Returns true if the outermost filter of <str> is <filterName>.
+static GBool matchesFilter(Stream *str) {
+  Object filter, obj;
+  GBool match;
+
+  match = gFalse;
+  str->getDict()->lookup("Filter", &filter);
+  if (filter.isName()) {
+    match = filter.isName((char *)filterName);
+  } else if (filter.isArray() && filter.arrayGetLength() > 0) {
+    filter.arrayGet(filter.arrayGetLength() - 1, &obj);
+    match = obj.isName((char *)filterName);
+    obj.free();
+  }
+  filter.free();
+  return match;
+}
+
+#define bulkBufSize 65536
+
+// Decode all of <str>, returning the number of decoded bytes.
+static double decodeStream(Stream *str) {
+  static Guchar buf[bulkBufSize];
+  double n;
+  int m;
+
+  n = 0;
+  str->reset();
+  if (bulk) {
+    while ((m = str->getChars(bulkBufSize, buf)) > 0) {
+      n += m;
+    }
+  } else {
+    while (str->getChar() != EOF) {
+      ++n;
+    }
+  }
+  str->close();
+  return n;
+}
+
+static void runFile(GooString *fileName) {
+  PDFDoc *doc;
+  XRef *xref;
+  XRefEntry *entry;
+  Object obj;
+  GooTimer timer;
+  double bytes, time;
+  int nStreams, i, j;
+
+  doc = new PDFDoc(fileName->copy());
+  if (!doc->isOk()) {
+    fprintf(stderr, "%s: couldn't open\n", fileName->getCString());
+    delete doc;
+    return;
+  }
+  xref = doc->getXRef();
+
+  nStreams = 0;
+  bytes = 0;
+  time = 0;
+  for (i = 0; i < xref->getNumObjects(); ++i) {
+    entry = xref->getEntry(i);
+    if (entry->type == xrefEntryFree) {
+      continue;
+    }
+    xref->fetch(i, entry->type == xrefEntryCompressed ? 0 : entry->gen, &obj);
+    if (obj.isStream() && matchesFilter(obj.getStream())) {
+      ++nStreams;
+      for (j = 0; j < loops; ++j) {
+	timer.start();
+	bytes += decodeStream(obj.getStream());
+	timer.stop();
+	time += timer.getElapsed();
+      }
+    }
+    obj.free();
+  }
+
+  if (nStreams > 0) {
+    printf("%-40s %5d streams %10.0f bytes %9.3f ms\n",
+	   fileName->getCString(), nStreams, bytes, time * 1000);
+  }
+  totalStreams += nStreams;
+  totalBytes += bytes;
+  totalTime += time;
+  delete doc;
+}
+
+static void runPath(GooString *path) {
+  GDir *dir;
+  GDirEntry *ent;
+  FILE *f;
+
+  // directories are scanned (non-recursively) for PDF files
+  if (!(f = fopen(path->getCString(), "rb"))) {
+    fprintf(stderr, "%s: couldn't open\n", path->getCString());
+    return;
+  }
+  fclose(f);
+  dir = new GDir(path->getCString(), gTrue);
+  if (!(ent = dir->getNextEntry())) {
+    runFile(path);
+  } else {
+    do {
+      if (!ent->isDir() && ent->getName()->getLength() > 4 &&
+	  !strcasecmp(ent->getName()->getCString() +
+		      ent->getName()->getLength() - 4, ".pdf")) {
+	runFile(ent->getFullPath());
+      }
+      delete ent;
+    } while ((ent = dir->getNextEntry()));
+  }
+  delete dir;
+}
+
+int main(int argc, char *argv[]) {
+  GooString *path;
+  int i;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  for (i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-filter") && i + 1 < argc) {
+      filterName = argv[++i];
+    } else if (!strcmp(argv[i], "-loops") && i + 1 < argc) {
+      loops = atoi(argv[++i]);
+      if (loops < 1) {
+	loops = 1;
+      }
+    } else if (!strcmp(argv[i], "-bulk")) {
+      bulk = gTrue;
+    } else {
+      path = new GooString(argv[i]);
+      runPath(path);
+      delete path;
+    }
+  }
+
+  printf("total: %d %s streams, %.0f bytes in %.3f ms",
+	 totalStreams, filterName, totalBytes, totalTime * 1000);
+  if (totalTime > 0) {
+    printf(" (%.1f MB/s)", totalBytes / totalTime / (1024 * 1024));
+  }
+  printf("\n");
+
+  delete globalParams;
+  return 0;
+}
@@ -0,0 +1,153 @@
+//========================================================================
+//
+// save-perf.cc
+//
+// Compares the cost of saving a PDF file after changing a few objects:
+// the old byte-at-a-time copy of the whole file, the block copy done
+// by PDFDoc::saveWithoutChangesAs, and PDFDoc::saveAs, which appends
+// the changed objects as an incremental update.  The first -objects
+// page objects are marked as modified (unchanged), and the saved file
+// is reopened to check that it is still readable.
+//
+// Usage: save-perf [-objects <n>] [-loops <n>] <file.pdf> <output.pdf>
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "Catalog.h"
+#include "PDFDoc.h"
+
+static int nObjects = 10;
+static int loops = 5;
+
+// The copy loop used by PDFDoc::saveAs before incremental updates.
+static GBool byteCopy(PDFDoc *doc, GooString *name) {
+  BaseStream *str;
+  FILE *f;
+  int c;
+
+  if (!(f = fopen(name->getCString(), "wb"))) {
+    return gFalse;
+  }
+  str = doc->getBaseStream();
+  str->reset();
+  while ((c = str->getChar()) != EOF) {
+    fputc(c, f);
+  }
+  str->close();
+  fclose(f);
+  return gTrue;
+}
+
+static long fileSize(GooString *name) {
+  FILE *f;
+  long size;
+
+  if (!(f = fopen(name->getCString(), "rb"))) {
+    return 0;
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fclose(f);
+  return size;
+}
+
+int main(int argc, char *argv[]) {
+  PDFDoc *doc, *doc2;
+  GooString *inName, *outName;
+  GooTimer timer;
+  Object obj;
+  Ref *ref;
+  double byteTime, blockTime, incrTime;
+  int nPages, i;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  inName = outName = NULL;
+  for (i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-objects") && i + 1 < argc) {
+      nObjects = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-loops") && i + 1 < argc) {
+      loops = atoi(argv[++i]);
+      if (loops < 1) {
+	loops = 1;
+      }
+    } else if (!inName) {
+      inName = new GooString(argv[i]);
+    } else if (!outName) {
+      outName = new GooString(argv[i]);
+    }
+  }
+  if (!inName || !outName) {
+    fprintf(stderr,
+	    "Usage: save-perf [-objects <n>] [-loops <n>] <file.pdf> "
+	    "<output.pdf>\n");
+    return 1;
+  }
+
+  doc = new PDFDoc(inName->copy());
+  if (!doc->isOk()) {
+    fprintf(stderr, "%s: couldn't open\n", inName->getCString());
+    return 1;
+  }
+  nPages = doc->getNumPages();
+
+  byteTime = blockTime = incrTime = 0;
+  for (i = 0; i < loops; ++i) {
+    timer.start();
+    byteCopy(doc, outName);
+    timer.stop();
+    byteTime += timer.getElapsed();
+
+    timer.start();
+    doc->saveWithoutChangesAs(outName);
+    timer.stop();
+    blockTime += timer.getElapsed();
+  }
+
+  for (i = 1; i <= nObjects && i <= nPages; ++i) {
+    ref = doc->getCatalog()->getPageRef(i);
+    doc->getXRef()->fetch(ref->num, ref->gen, &obj);
+    doc->getXRef()->setModifiedObject(&obj, *ref);
+    obj.free();
+  }
+  for (i = 0; i < loops; ++i) {
+    timer.start();
+    if (!doc->saveAs(outName)) {
+      fprintf(stderr, "%s: couldn't save\n", outName->getCString());
+      return 1;
+    }
+    timer.stop();
+    incrTime += timer.getElapsed();
+  }
+
+  printf("%s: %ld bytes, %d modified objects\n", inName->getCString(),
+	 fileSize(inName), nObjects < nPages ? nObjects : nPages);
+  printf("byte copy:          %9.3f ms\n", byteTime * 1000 / loops);
+  printf("block copy:         %9.3f ms\n", blockTime * 1000 / loops);
+  printf("incremental update: %9.3f ms (%ld bytes appended)\n",
+	 incrTime * 1000 / loops, fileSize(outName) - fileSize(inName));
+
+  doc2 = new PDFDoc(outName->copy());
+  if (!doc2->isOk() || doc2->getNumPages() != nPages) {
+    fprintf(stderr, "%s: saved file is damaged\n", outName->getCString());
+    return 1;
+  }
+  delete doc2;
+
+  delete doc;
+  delete inName;
+  delete outName;
+  delete globalParams;
+  return 0;
+}
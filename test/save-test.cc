@@ -0,0 +1,172 @@
+//========================================================================
+//
+// save-test.cc
+//
+// Checks PDFDoc::saveAs on an intact file and on a damaged copy of it
+// whose startxref offset has been overwritten, so that its xref table
+// must be reconstructed.  In both cases the first page object is
+// marked as modified and a new object is added; the saved file must
+// open without reconstruction, with the same number of pages and the
+// new object.  Exits with status 1 on any failure.
+//
+// Usage: save-test <file.pdf> <output-prefix>
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "XRef.h"
+#include "Catalog.h"
+#include "PDFDoc.h"
+
+#define testValue 12345
+
+static int nErrors = 0;
+
+// Write a copy of <inName> to <outName> with the digits following the
+// last "startxref" replaced by zeros.
+static GBool writeDamagedCopy(GooString *inName, GooString *outName) {
+  FILE *f;
+  char *buf, *p, *q;
+  long len;
+
+  if (!(f = fopen(inName->getCString(), "rb"))) {
+    return gFalse;
+  }
+  fseek(f, 0, SEEK_END);
+  len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buf = (char *)gmalloc(len + 1);
+  if (fread(buf, 1, len, f) != (size_t)len) {
+    fclose(f);
+    gfree(buf);
+    return gFalse;
+  }
+  fclose(f);
+  buf[len] = '\0';
+
+  q = NULL;
+  for (p = buf; p + 9 <= buf + len; ++p) {
+    if (!strncmp(p, "startxref", 9)) {
+      q = p;
+    }
+  }
+  if (!q) {
+    gfree(buf);
+    return gFalse;
+  }
+  for (q += 9; q < buf + len && (*q == ' ' || *q == '\r' || *q == '\n');
+       ++q) ;
+  for (; q < buf + len && *q >= '0' && *q <= '9'; ++q) {
+    *q = '0';
+  }
+
+  if (!(f = fopen(outName->getCString(), "wb"))) {
+    gfree(buf);
+    return gFalse;
+  }
+  fwrite(buf, 1, len, f);
+  fclose(f);
+  gfree(buf);
+  return gTrue;
+}
+
+// Modify <doc>, save it as <outName>, and check the saved file.
+static void checkSave(const char *label, PDFDoc *doc, GooString *outName) {
+  PDFDoc *doc2;
+  Object obj;
+  Ref *pageRef, newRef;
+  int nPages;
+
+  nPages = doc->getNumPages();
+  pageRef = doc->getCatalog()->getPageRef(1);
+  doc->getXRef()->fetch(pageRef->num, pageRef->gen, &obj);
+  doc->getXRef()->setModifiedObject(&obj, *pageRef);
+  obj.free();
+  obj.initInt(testValue);
+  newRef = doc->getXRef()->addIndirectObject(&obj);
+  obj.free();
+
+  if (!doc->saveAs(outName)) {
+    printf("%s: couldn't save %s\n", label, outName->getCString());
+    ++nErrors;
+    return;
+  }
+
+  doc2 = new PDFDoc(outName->copy());
+  if (!doc2->isOk()) {
+    printf("%s: saved file doesn't open\n", label);
+    ++nErrors;
+  } else if (doc2->getXRef()->isReconstructed()) {
+    printf("%s: saved file has a damaged xref table\n", label);
+    ++nErrors;
+  } else if (doc2->getNumPages() != nPages) {
+    printf("%s: saved file has %d pages, expected %d\n",
+	   label, doc2->getNumPages(), nPages);
+    ++nErrors;
+  } else {
+    doc2->getXRef()->fetch(newRef.num, newRef.gen, &obj);
+    if (!obj.isInt() || obj.getInt() != testValue) {
+      printf("%s: new object %d is missing\n", label, newRef.num);
+      ++nErrors;
+    } else {
+      printf("%s: ok, %d pages\n", label, nPages);
+    }
+    obj.free();
+  }
+  delete doc2;
+}
+
+int main(int argc, char *argv[]) {
+  PDFDoc *doc;
+  GooString *inName, *damagedName, *outName;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: save-test <file.pdf> <output-prefix>\n");
+    return 1;
+  }
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+  inName = new GooString(argv[1]);
+
+  // intact file: incremental update
+  doc = new PDFDoc(inName->copy());
+  if (!doc->isOk() || doc->getXRef()->isReconstructed() ||
+      doc->getNumPages() < 1) {
+    fprintf(stderr, "%s: couldn't open\n", inName->getCString());
+    return 1;
+  }
+  outName = GooString::format("{0:s}-incr.pdf", argv[2]);
+  checkSave("intact", doc, outName);
+  delete outName;
+  delete doc;
+
+  // damaged file: reconstructed xref, so the file is rewritten
+  damagedName = GooString::format("{0:s}-damaged.pdf", argv[2]);
+  if (!writeDamagedCopy(inName, damagedName)) {
+    fprintf(stderr, "%s: couldn't write damaged copy\n",
+	    damagedName->getCString());
+    return 1;
+  }
+  doc = new PDFDoc(damagedName->copy());
+  if (!doc->isOk() || !doc->getXRef()->isReconstructed()) {
+    printf("damaged: copy wasn't reconstructed\n");
+    ++nErrors;
+  } else {
+    outName = GooString::format("{0:s}-repaired.pdf", argv[2]);
+    checkSave("damaged", doc, outName);
+    delete outName;
+  }
+  delete doc;
+  delete damagedName;
+
+  delete inName;
+  delete globalParams;
+  return nErrors ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+//========================================================================
+//
+// stroke-perf.cc
+//
+// Times Splash::stroke on full pages of dashed lines, like those in
+// engineering drawings and plots: a letter-size page at -r dpi (150 by
+// default), anti-aliased, with
+//
+//   polylines - 400 separate 150-segment random polylines, 2.5 wide,
+//               round caps and joins, dash [6 3]
+//   grid      - a grid of 468 straight lines, 1.5 wide, butt caps,
+//               dash [4 2 1 2]
+//   zigzag    - a single path with 1500 straight lines and a
+//               60000-segment random polyline, 1.2 wide, miter joins,
+//               dash [5 2]
+//
+// The paths are generated with a fixed seed, so runs are comparable.
+// Prints the best time of -loops runs for each case.
+//
+// Usage: stroke-perf [-r <dpi>] [-loops <n>] [<case> ...]
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goo/GooTimer.h"
+#include "splash/SplashTypes.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashPattern.h"
+#include "splash/SplashState.h"
+#include "splash/Splash.h"
+
+static double resolution = 150;
+static int loops = 3;
+
+static Guint seed;
+
+// Returns a pseudo-random number in [lo, hi).
+static double rnd(double lo, double hi) {
+  seed = seed * 1103515245 + 12345;
+  return lo + (hi - lo) * ((seed >> 8) & 0xffffff) / (double)0x1000000;
+}
+
+static double clampCoord(double x, double lo, double hi) {
+  return x < lo ? lo : x > hi ? hi : x;
+}
+
+static void strokePolylines(Splash *splash) {
+  SplashPath *path;
+  SplashCoord dash[2] = { 6, 3 };
+  double x, y;
+  int i, j;
+
+  splash->setLineWidth(2.5);
+  splash->setLineCap(splashLineCapRound);
+  splash->setLineJoin(splashLineJoinRound);
+  splash->setLineDash(dash, 2, 0);
+  for (i = 0; i < 400; ++i) {
+    path = SplashPath::create();
+    x = rnd(20, 590);
+    y = rnd(20, 770);
+    path->moveTo(x, y);
+    for (j = 0; j < 150; ++j) {
+      x = clampCoord(x + rnd(-8, 8), 5, 605);
+      y = clampCoord(y + rnd(-8, 8), 5, 785);
+      path->lineTo(x, y);
+    }
+    splash->stroke(path);
+    SplashPath::destroy(path);
+  }
+}
+
+static void strokeGrid(Splash *splash) {
+  SplashPath *path;
+  SplashCoord dash[4] = { 4, 2, 1, 2 };
+  int i;
+
+  splash->setLineWidth(1.5);
+  splash->setLineCap(splashLineCapButt);
+  splash->setLineJoin(splashLineJoinMiter);
+  splash->setLineDash(dash, 4, 0);
+  for (i = 0; i < 792; i += 3) {
+    path = SplashPath::create();
+    path->moveTo(10, i);
+    path->lineTo(600, i);
+    splash->stroke(path);
+    SplashPath::destroy(path);
+  }
+  for (i = 0; i < 612; i += 3) {
+    path = SplashPath::create();
+    path->moveTo(i, 5);
+    path->lineTo(i, 790);
+    splash->stroke(path);
+    SplashPath::destroy(path);
+  }
+}
+
+static void strokeZigzag(Splash *splash) {
+  SplashPath *path;
+  SplashCoord dash[2] = { 5, 2 };
+  double x, y;
+  int i;
+
+  splash->setLineWidth(1.2);
+  splash->setLineCap(splashLineCapButt);
+  splash->setLineJoin(splashLineJoinMiter);
+  splash->setLineDash(dash, 2, 0);
+  path = SplashPath::create();
+  for (i = 0; i < 1500; ++i) {
+    path->moveTo(10 + i * 0.4, 10);
+    path->lineTo(10 + i * 0.4, 780);
+  }
+  x = 300;
+  y = 400;
+  path->moveTo(x, y);
+  for (i = 0; i < 60000; ++i) {
+    x = clampCoord(x + rnd(-6, 6), 5, 605);
+    y = clampCoord(y + rnd(-6, 6), 5, 785);
+    path->lineTo(x, y);
+  }
+  splash->stroke(path);
+  SplashPath::destroy(path);
+}
+
+struct StrokeCase {
+  const char *name;
+  void (*run)(Splash *splash);
+};
+
+static StrokeCase cases[] = {
+  { "polylines", &strokePolylines },
+  { "grid",      &strokeGrid },
+  { "zigzag",    &strokeZigzag },
+  { NULL, NULL }
+};
+
+int main(int argc, char *argv[]) {
+  SplashBitmap *bitmap;
+  Splash *splash;
+  SplashColor white, blue;
+  SplashCoord mat[6];
+  GooTimer timer;
+  GBool all, found;
+  double t, best;
+  int w, h, i, j, k;
+
+  all = gTrue;
+  for (i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+      resolution = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-loops") && i + 1 < argc) {
+      loops = atoi(argv[++i]);
+    } else {
+      all = gFalse;
+    }
+  }
+  if (resolution <= 0 || loops < 1) {
+    fprintf(stderr, "Usage: stroke-perf [-r <dpi>] [-loops <n>] "
+	    "[<case> ...]\n");
+    return 1;
+  }
+
+  w = (int)(612 * resolution / 72 + 0.5);
+  h = (int)(792 * resolution / 72 + 0.5);
+  mat[0] = resolution / 72;
+  mat[1] = 0;
+  mat[2] = 0;
+  mat[3] = -resolution / 72;
+  mat[4] = 0;
+  mat[5] = h;
+  white[0] = white[1] = white[2] = 0xff;
+  blue[0] = blue[1] = 0x00;
+  blue[2] = 0x99;
+
+  for (k = 0; cases[k].name; ++k) {
+    found = all;
+    for (i = 1; i < argc; ++i) {
+      if (!strcmp(argv[i], cases[k].name)) {
+	found = gTrue;
+      } else if (!strcmp(argv[i], "-r") || !strcmp(argv[i], "-loops")) {
+	++i;
+      }
+    }
+    if (!found) {
+      continue;
+    }
+    best = 0;
+    for (j = 0; j < loops; ++j) {
+      bitmap = new SplashBitmap(w, h, 4, splashModeRGB8, gFalse);
+      splash = new Splash(bitmap, gTrue);
+      splash->clear(white);
+      splash->setMatrix(mat);
+      splash->setStrokePattern(new SplashSolidColor(blue));
+      seed = 7;
+      timer.start();
+      (*cases[k].run)(splash);
+      timer.stop();
+      t = timer.getElapsed();
+      if (j == 0 || t < best) {
+	best = t;
+      }
+      delete splash;
+      delete bitmap;
+    }
+    printf("%-10s %9.1f ms\n", cases[k].name, best * 1000);
+  }
+  return 0;
+}
@@ -0,0 +1,281 @@
+//========================================================================
+//
+// text-index-test.cc
+//
+// Checks TextIndex against TextPage::findText.  Every page of the
+// file is searched for each of the given strings (a few common ones
+// by default), case-sensitively and not, and the matches must be the
+// boxes found by repeated findText calls.  The index is then built
+// again incrementally, saved and loaded, and must give the same
+// results, and a saved index with a corrupt count must be rejected.
+// Prints the number of matches and exits with status 1 on
+// any difference.
+//
+// Usage: text-index-test <file.pdf> [<string> ...]
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "goo/GooString.h"
+#include "goo/GooList.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "TextIndex.h"
+
+static char *defaultStrings[] = {
+  "e", "the", "The", "ing", "in the", NULL
+};
+
+static int nErrors = 0;
+
+static int cmpMatches(const void *p1, const void *p2) {
+  TextIndexMatch *m1 = *(TextIndexMatch **)p1;
+  TextIndexMatch *m2 = *(TextIndexMatch **)p2;
+
+  if (m1->yMin != m2->yMin) {
+    return m1->yMin < m2->yMin ? -1 : 1;
+  }
+  if (m1->xMin != m2->xMin) {
+    return m1->xMin < m2->xMin ? -1 : 1;
+  }
+  return 0;
+}
+
+static GBool sameBox(double x0, double y0, double x1, double y1,
+		     TextIndexMatch *m) {
+  // the index keeps coordinates as floats
+  return fabs(x0 - m->xMin) < 0.01 && fabs(y0 - m->yMin) < 0.01 &&
+         fabs(x1 - m->xMax) < 0.01 && fabs(y1 - m->yMax) < 0.01;
+}
+
+// Returns the index of the first match at or after <i> which isn't at
+// the position of <prev> (findText reports each position once).
+static int skipSamePos(GooList *found, int i, TextIndexMatch *prev) {
+  TextIndexMatch *m;
+
+  for (; i < found->getLength(); ++i) {
+    m = (TextIndexMatch *)found->get(i);
+    if (!prev || m->yMin != prev->yMin || m->xMin != prev->xMin) {
+      break;
+    }
+  }
+  return i;
+}
+
+// Compare the matches of <u> on <page> found by <index> with the ones
+// found by findText on <text>.  Returns the number of matches.
+static int checkPage(TextIndex *index, TextOutputDev *text, int page,
+		     Unicode *u, int len, GBool caseSensitive, char *s) {
+  GooList *found;
+  TextIndexMatch *m, *prev;
+  double xMin, yMin, xMax, yMax;
+  int n, i;
+
+  found = index->findOnPage(page, u, len, caseSensitive);
+  found->sort(&cmpMatches);
+
+  // this is how the glib frontend used to search a page (the first
+  // call starts at the top, later ones after the last match)
+  n = 0;
+  prev = NULL;
+  xMin = yMin = 0;
+  i = 0;
+  while (text->findText(u, len, gFalse, gTrue, n > 0, gFalse,
+			caseSensitive, gFalse, &xMin, &yMin, &xMax, &yMax)) {
+    i = skipSamePos(found, i, prev);
+    if (i >= found->getLength() ||
+	!sameBox(xMin, yMin, xMax, yMax, (TextIndexMatch *)found->get(i))) {
+      printf("page %d, '%s'%s: findText match %g %g %g %g "
+	     "not found by the index\n",
+	     page, s, caseSensitive ? "" : " (any case)",
+	     xMin, yMin, xMax, yMax);
+      ++nErrors;
+      deleteGooList(found, TextIndexMatch);
+      return n;
+    }
+    prev = (TextIndexMatch *)found->get(i++);
+    ++n;
+  }
+  i = skipSamePos(found, i, prev);
+  if (i < found->getLength()) {
+    m = (TextIndexMatch *)found->get(i);
+    printf("page %d, '%s'%s: index match %g %g %g %g "
+	   "not found by findText\n",
+	   page, s, caseSensitive ? "" : " (any case)",
+	   m->xMin, m->yMin, m->xMax, m->yMax);
+    ++nErrors;
+  }
+  deleteGooList(found, TextIndexMatch);
+  return n;
+}
+
+// Compare the document-wide matches of two indexes.
+static void checkSame(TextIndex *index1, TextIndex *index2,
+		      Unicode *u, int len, char *what) {
+  GooList *l1, *l2;
+  TextIndexMatch *m1, *m2;
+  int i;
+
+  l1 = index1->find(u, len, gFalse);
+  l2 = index2->find(u, len, gFalse);
+  if (l1->getLength() != l2->getLength()) {
+    printf("%s: %d matches instead of %d\n",
+	   what, l2->getLength(), l1->getLength());
+    ++nErrors;
+  } else {
+    for (i = 0; i < l1->getLength(); ++i) {
+      m1 = (TextIndexMatch *)l1->get(i);
+      m2 = (TextIndexMatch *)l2->get(i);
+      if (m1->page != m2->page || m1->xMin != m2->xMin ||
+	  m1->yMin != m2->yMin || m1->xMax != m2->xMax ||
+	  m1->yMax != m2->yMax) {
+	printf("%s: match %d differs\n", what, i);
+	++nErrors;
+	break;
+      }
+    }
+  }
+  deleteGooList(l1, TextIndexMatch);
+  deleteGooList(l2, TextIndexMatch);
+}
+
+// Overwrite the character count of the first page record in a saved
+// index with a huge value, and the line count too if <which> is 0 (the
+// character count can't be smaller).
+static GBool corruptCount(GooString *fileName, int which) {
+  FILE *f;
+  Guchar buf[4];
+  int idLen;
+
+  if (!(f = fopen(fileName->getCString(), "r+b"))) {
+    return gFalse;
+  }
+  if (fseek(f, 8, SEEK_SET) || fread(buf, 1, 4, f) != 4) {
+    fclose(f);
+    return gFalse;
+  }
+  idLen = buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24);
+  // magic, version, id length, id, nPages, nIndexed, page number
+  fseek(f, 24 + idLen + 4 * which, SEEK_SET);
+  buf[0] = buf[1] = buf[2] = 0xff;
+  buf[3] = 0x7f;
+  for (; which < 2; ++which) {
+    fwrite(buf, 1, 4, f);
+  }
+  return fclose(f) == 0;
+}
+
+int main(int argc, char *argv[]) {
+  PDFDoc *doc;
+  TextIndex *index, *index2, *index3, *index4;
+  TextOutputDev *textOut;
+  char **strings;
+  char *s;
+  Unicode *u;
+  GooString *saveName;
+  int nStrings, nMatches, len, page, i, j;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: text-index-test <file.pdf> [<string> ...]\n");
+    return 1;
+  }
+  if (argc > 2) {
+    strings = argv + 2;
+    nStrings = argc - 2;
+  } else {
+    strings = defaultStrings;
+    for (nStrings = 0; defaultStrings[nStrings]; ++nStrings) ;
+  }
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+  doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk()) {
+    fprintf(stderr, "%s: couldn't open\n", argv[1]);
+    return 1;
+  }
+
+  // search each page with findOnPage, which indexes it on demand
+  index = new TextIndex(doc);
+  nMatches = 0;
+  for (page = 1; page <= doc->getNumPages(); ++page) {
+    textOut = new TextOutputDev(NULL, gFalse, gFalse, gFalse);
+    doc->displayPage(textOut, page, 72, 72, 0, gFalse, gTrue, gFalse);
+    for (i = 0; i < nStrings; ++i) {
+      s = strings[i];
+      len = strlen(s);
+      u = (Unicode *)gmallocn(len, sizeof(Unicode));
+      for (j = 0; j < len; ++j) {
+	u[j] = (Unicode)(s[j] & 0xff);
+      }
+      nMatches += checkPage(index, textOut, page, u, len, gTrue, s);
+      nMatches += checkPage(index, textOut, page, u, len, gFalse, s);
+      gfree(u);
+    }
+    delete textOut;
+  }
+  if (index->getNumIndexedPages() != doc->getNumPages()) {
+    printf("%d of %d pages indexed\n",
+	   index->getNumIndexedPages(), doc->getNumPages());
+    ++nErrors;
+  }
+
+  // an index built a page at a time, and a saved and reloaded one,
+  // give the same results
+  index2 = new TextIndex(doc);
+  for (i = 0; !index2->indexPages(1); ++i) {
+    if (index2->getNumIndexedPages() != i + 1) {
+      printf("indexPages(1) indexed %d pages after %d calls\n",
+	     index2->getNumIndexedPages(), i + 1);
+      ++nErrors;
+      break;
+    }
+  }
+  saveName = GooString::format("{0:s}.tidx", argv[1]);
+  index3 = new TextIndex(doc);
+  if (!index2->save(saveName->getCString()) ||
+      !index3->load(saveName->getCString())) {
+    printf("couldn't save and load the index\n");
+    ++nErrors;
+  }
+  // a corrupt line or character count is rejected, not allocated
+  for (i = 0; i < 2; ++i) {
+    index4 = new TextIndex(doc);
+    if (index2->save(saveName->getCString()) &&
+	corruptCount(saveName, i) &&
+	index4->load(saveName->getCString())) {
+      printf("loaded an index with a corrupt %s count\n",
+	     i ? "character" : "line");
+      ++nErrors;
+    }
+    delete index4;
+  }
+  remove(saveName->getCString());
+  for (i = 0; i < nStrings; ++i) {
+    s = strings[i];
+    len = strlen(s);
+    u = (Unicode *)gmallocn(len, sizeof(Unicode));
+    for (j = 0; j < len; ++j) {
+      u[j] = (Unicode)(s[j] & 0xff);
+    }
+    checkSame(index, index2, u, len, "incremental index");
+    checkSame(index, index3, u, len, "loaded index");
+    gfree(u);
+  }
+
+  printf("%s: %d pages, %d matches, %d errors\n",
+	 argv[1], doc->getNumPages(), nMatches, nErrors);
+
+  delete saveName;
+  delete index;
+  delete index2;
+  delete index3;
+  delete doc;
+  delete globalParams;
+  return nErrors ? 1 : 0;
+}
@@ -16,6 +16,7 @@
 #include "GlobalParams.h"
 #include "Object.h"
 #include "PDFDoc.h"
+#include "ProfileData.h"
 #include "splash/SplashBitmap.h"
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
@@ -36,6 +37,13 @@ static GBool gray = gFalse;
 static char enableFreeTypeStr[16] = "";
 static char antialiasStr[16] = "";
 static char vectorAntialiasStr[16] = "";
+static GBool hideAnnotations = gFalse;
+static int formCacheMB = 0;
+static int t3CacheMB = -1;
+static int clipMaskSegs = -1;
+static char cMapCacheDir[256] = "";
+static char xrefCacheDir[256] = "";
+static char profileFileName[256] = "";
 static char ownerPassword[33] = "";
 static char userPassword[33] = "";
 static GBool quiet = gFalse;
@@ -78,6 +86,20 @@ static ArgDesc argDesc[] = {
    "enable font anti-aliasing: yes, no"},
   {"-aaVector",   argString,      vectorAntialiasStr, sizeof(vectorAntialiasStr),
    "enable vector anti-aliasing: yes, no"},
+  {"-hide-annotations", argFlag, &hideAnnotations, 0,
+   "don't draw (or parse) annotations"},
+  {"-form-cache", argInt,  &formCacheMB,    0,
+   "keep up to this many MB of rasterized forms for reuse (0 = off)"},
+  {"-t3-cache",  argInt,   &t3CacheMB,      0,
+   "keep up to this many MB of rasterized Type 3 glyphs (0 = off)"},
+  {"-clip-mask", argInt,   &clipMaskSegs,   0,
+   "rasterize clip paths with at least this many segments (0 = off)"},
+  {"-cmap-cache", argString, cMapCacheDir,  sizeof(cMapCacheDir),
+   "directory for compiled CMaps and CID-to-Unicode tables"},
+  {"-xref-cache", argString, xrefCacheDir,  sizeof(xrefCacheDir),
+   "directory for reconstructed xref tables of damaged files"},
+  {"-profile", argString,  profileFileName, sizeof(profileFileName),
+   "write a JSON rendering profile of each page to this file"},
   
   {"-opw",    argString,   ownerPassword,  sizeof(ownerPassword),
    "owner password (for encrypted files)"},
@@ -103,17 +125,30 @@ void savePageSlice(PDFDoc *doc,
                    SplashOutputDev *splashOut, 
                    int pg, int x, int y, int w, int h, 
                    double pg_w, double pg_h, 
-                   char *ppmFile) {
+                   char *ppmFile, FILE *profileFile) {
+  PageProfile *profile;
+
   if (w == 0) w = (int)ceil(pg_w);
   if (h == 0) h = (int)ceil(pg_h);
   w = (x+w > pg_w ? (int)ceil(pg_w-x) : w);
   h = (y+h > pg_h ? (int)ceil(pg_h-y) : h);
+  profile = NULL;
+  if (profileFile) {
+    profile = new PageProfile(pg);
+    profile->start();
+  }
   doc->displayPageSlice(splashOut, 
     pg, resolution, resolution, 
     0,
     gTrue, gFalse, gFalse,
     x, y, w, h
   );
+  if (profile) {
+    profile->stop();
+    profile->writeJSON(profileFile);
+    fprintf(profileFile, pg < lastPage ? ",\n" : "\n");
+    delete profile;
+  }
   if (ppmFile != NULL) {
     splashOut->getBitmap()->writePNMFile(ppmFile);
   } else {
@@ -129,6 +164,7 @@ int main(int argc, char *argv[]) {
   GooString *ownerPW, *userPW;
   SplashColor paperColor;
   SplashOutputDev *splashOut;
+  FILE *profileFile;
   GBool ok;
   int exitCode;
   int pg, pg_num_len;
@@ -169,6 +205,24 @@ int main(int argc, char *argv[]) {
       fprintf(stderr, "Bad '-aaVector' value on command line\n");
     }
   }
+  if (hideAnnotations) {
+    globalParams->setDrawAnnotations(gFalse);
+  }
+  if (formCacheMB > 0) {
+    globalParams->setFormCacheSize(formCacheMB * 1024 * 1024);
+  }
+  if (t3CacheMB >= 0) {
+    globalParams->setT3CacheSize(t3CacheMB * 1024 * 1024);
+  }
+  if (clipMaskSegs >= 0) {
+    globalParams->setClipMaskThreshold(clipMaskSegs);
+  }
+  if (cMapCacheDir[0]) {
+    globalParams->setCMapCacheDir(cMapCacheDir);
+  }
+  if (xrefCacheDir[0]) {
+    globalParams->setXRefCacheDir(xrefCacheDir);
+  }
   if (quiet) {
     globalParams->setErrQuiet(quiet);
   }
@@ -209,6 +263,17 @@ int main(int argc, char *argv[]) {
   if (lastPage < 1 || lastPage > doc->getNumPages())
     lastPage = doc->getNumPages();
 
+  // open the profile file
+  profileFile = NULL;
+  if (profileFileName[0]) {
+    if (!(profileFile = fopen(profileFileName, "w"))) {
+      fprintf(stderr, "Couldn't open profile file '%s'\n", profileFileName);
+      exitCode = 2;
+      goto err1;
+    }
+    fprintf(profileFile, "[\n");
+  }
+
   // write PPM files
   paperColor[0] = 255;
   paperColor[1] = 255;
@@ -237,12 +302,18 @@ int main(int argc, char *argv[]) {
       snprintf(ppmFile, PPM_FILE_SZ, "%.*s-%0*d.%s",
               PPM_FILE_SZ - 32, ppmRoot, pg_num_len, pg,
               mono ? "pbm" : gray ? "pgm" : "ppm");
-      savePageSlice(doc, splashOut, pg, x, y, w, h, pg_w, pg_h, ppmFile);
+      savePageSlice(doc, splashOut, pg, x, y, w, h, pg_w, pg_h, ppmFile,
+		    profileFile);
     } else {
-      savePageSlice(doc, splashOut, pg, x, y, w, h, pg_w, pg_h, NULL);
+      savePageSlice(doc, splashOut, pg, x, y, w, h, pg_w, pg_h, NULL,
+		    profileFile);
     }
   }
   delete splashOut;
+  if (profileFile) {
+    fprintf(profileFile, "]\n");
+    fclose(profileFile);
+  }
 
   exitCode = 0;
 
@@ -43,6 +43,8 @@ static GBool htmlMeta = gFalse;
 static char textEncName[128] = "";
 static char textEOL[16] = "";
 static GBool noPageBreaks = gFalse;
+static char cMapCacheDir[256] = "";
+static char xrefCacheDir[256] = "";
 static char ownerPassword[33] = "\001";
 static char userPassword[33] = "\001";
 static GBool quiet = gFalse;
@@ -66,6 +68,10 @@ static ArgDesc argDesc[] = {
    "output end-of-line convention (unix, dos, or mac)"},
   {"-nopgbrk", argFlag,     &noPageBreaks,  0,
    "don't insert page breaks between pages"},
+  {"-cmap-cache", argString, cMapCacheDir, sizeof(cMapCacheDir),
+   "directory for compiled CMaps and CID-to-Unicode tables"},
+  {"-xref-cache", argString, xrefCacheDir, sizeof(xrefCacheDir),
+   "directory for reconstructed xref tables of damaged files"},
   {"-opw",     argString,   ownerPassword,  sizeof(ownerPassword),
    "owner password (for encrypted files)"},
   {"-upw",     argString,   userPassword,   sizeof(userPassword),
@@ -125,6 +131,12 @@ int main(int argc, char *argv[]) {
   if (noPageBreaks) {
     globalParams->setTextPageBreaks(gFalse);
   }
+  if (cMapCacheDir[0]) {
+    globalParams->setCMapCacheDir(cMapCacheDir);
+  }
+  if (xrefCacheDir[0]) {
+    globalParams->setXRefCacheDir(xrefCacheDir);
+  }
   if (quiet) {
     globalParams->setErrQuiet(quiet);
   }